@@ -0,0 +1,50 @@
+#pragma once
+
+// Small helpers shared by the benchmarks.
+
+#include <chrono>
+#include <cstddef>
+#include <print>
+#include <string>
+
+namespace bench {
+using std::string;
+
+/// @brief Runs fn reps times and returns the best time for one run, in
+/// nanoseconds. The best time is the least disturbed by other processes.
+/// @tparam Fn
+/// @param reps
+/// @param fn
+/// @return double
+template <class Fn>
+double best_time_ns(size_t reps, Fn&& fn) {
+    using clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (size_t i = 0; i < reps; ++i) {
+        const auto start = clock::now();
+        fn();
+        const auto stop = clock::now();
+        const double ns =
+            std::chrono::duration<double, std::nano>(stop - start).count();
+        if (i == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+/// @brief Prints one result line as "name: x rows/ns (y ms)".
+/// @param name
+/// @param rows
+/// @param ns
+inline void report(const string& name, size_t rows, double ns) {
+    std::println("{:<40} {:>8.3f} rows/ns {:>10.3f} ms", name,
+                 static_cast<double>(rows) / ns, ns / 1.0e6);
+}
+
+/// @brief Somewhere to put results so that the compiler cannot optimize
+/// away the work that produced them.
+inline volatile size_t sink{0};
+
+/// @brief Keeps the compiler from optimizing away a result.
+/// @param value
+inline void keep(size_t value) { sink = sink + value; }
+}  // namespace bench
@@ -0,0 +1,61 @@
+#pragma once
+
+// Fused (one pass, a block at a time) versus clause-at-a-time execution of
+// AND queries with 2 to 6 scanned clauses.
+
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_utils.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "table.hpp"
+
+namespace bench {
+
+inline void fused_bench(size_t rows) {
+    // Six integer columns, each clause keeping about half the rows, so every
+    // clause has work to do and none can be answered from an index.
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> dist{0, 999};
+    std::vector<string> lines{"A,B,C,D,E,F"};
+    lines.reserve(rows + 1);
+    for (size_t i = 0; i < rows; ++i) {
+        lines.push_back(std::format("{},{},{},{},{},{}", dist(gen), dist(gen),
+                                    dist(gen), dist(gen), dist(gen),
+                                    dist(gen)));
+    }
+    const auto input = jt::parse_lines(lines);
+    if (!input) {
+        std::println("fused: could not build the table");
+        return;
+    }
+    const jt::table t(*input);
+
+    const string clauses[] = {R"-(("A" < 500))-", R"-(("B" >= 500))-",
+                              R"-(("C" < 500))-", R"-(("D" >= 500))-",
+                              R"-(("E" < 500))-", R"-(("F" >= 500))-"};
+
+    std::println("fused: {} rows", rows);
+    string line{"query " + clauses[0]};
+    for (size_t n = 2; n <= std::size(clauses); ++n) {
+        line += " && " + clauses[n - 1];
+        const auto statement = jt::parse_query_statement(line);
+        if (!statement) continue;
+        const auto plan = jt::query_plan::make(t, *statement);
+        if (!plan) continue;
+
+        const double fused_ns = best_time_ns(5, [&] {
+            keep(plan->execute(jt::execution_mode::fused).count());
+        });
+        report(std::format("{} clauses (fused)", n), rows, fused_ns);
+        const double separate_ns = best_time_ns(5, [&] {
+            keep(plan->execute(jt::execution_mode::clause_at_a_time).count());
+        });
+        report(std::format("{} clauses (clause at a time)", n), rows,
+               separate_ns);
+    }
+}
+}  // namespace bench
@@ -0,0 +1,67 @@
+#pragma once
+
+// Scaling of fused scans with the number of threads, for the clauses that
+// cost the most per row: point in polygon and tags.
+
+#include <algorithm>
+#include <format>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_utils.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "table.hpp"
+#include "scheduler.hpp"
+
+namespace bench {
+
+inline void parallel_bench(size_t rows) {
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<float> lat{49.0f, 60.0f};
+    std::uniform_real_distribution<float> lon{-120.0f, -110.0f};
+    std::uniform_int_distribution<int> tag{0, 199};
+    std::vector<string> lines{"Where,Tags"};
+    lines.reserve(rows + 1);
+    for (size_t i = 0; i < rows; ++i) {
+        lines.push_back(std::format(R"-("{:.5f}, {:.5f}","""t{}, t{}, t{}""")-",
+                                    lat(gen), lon(gen), tag(gen), tag(gen),
+                                    tag(gen)));
+    }
+    const auto input = jt::parse_lines(lines);
+    if (!input) {
+        std::println("parallel: could not build the table");
+        return;
+    }
+    const jt::table t(*input);
+
+    const string queries[][2] = {
+        {"inside",
+         R"-(query ("Where" inside (50.0, -119.0) (59.0, -118.0) (58.0, -111.0) (54.0, -114.0) (51.0, -112.0)))-"},
+        {"tags", R"-(query ("Tags" tags t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39, t40))-"}};
+
+    const size_t max_threads =
+        std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::println("parallel: {} rows, up to {} threads", rows, max_threads);
+    for (const auto& [name, line] : queries) {
+        const auto statement = jt::parse_query_statement(line);
+        if (!statement) continue;
+        const auto plan = jt::query_plan::make(t, *statement);
+        if (!plan) continue;
+        // Scan even if the planner would use an index.
+        const auto& clauses = plan->clauses();
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            // The calling thread works too.
+            jt::scheduler sched{threads - 1};
+            const double ns = best_time_ns(5, [&] {
+                keep(jt::fused_scan(t.columns(), clauses,
+                                    jt::bitmap(rows, true), &sched)
+                         .count());
+            });
+            report(std::format("{} ({} threads)", name, threads), rows, ns);
+        }
+    }
+}
+}  // namespace bench
@@ -0,0 +1,67 @@
+#pragma once
+
+// Scan rate of the column comparison kernels, scalar versus AVX2.
+
+#include <cstdint>
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_utils.hpp"
+#include "bitmap.hpp"
+#include "predicate.hpp"
+#include "simd_kernels.hpp"
+
+namespace bench {
+
+inline void scan_bench(size_t rows) {
+    using jt::comparison_op;
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::int32_t> int_dist{0, 4000};
+    std::vector<std::int32_t> ints(rows);
+    std::vector<float> floats(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        ints[i] = int_dist(gen);
+        floats[i] = static_cast<float>(ints[i]) / 100.0f;
+    }
+
+    const std::pair<comparison_op, string> ops[] = {
+        {comparison_op::equal_to, "="},
+        {comparison_op::not_equal_to, "!="},
+        {comparison_op::less, "<"},
+        {comparison_op::less_equal, "<="},
+        {comparison_op::greater, ">"},
+        {comparison_op::greater_equal, ">="}};
+
+    const std::pair<jt::simd_level, string> levels[] = {
+        {jt::simd_level::scalar, "scalar"}, {jt::simd_level::avx2, "avx2"}};
+
+    jt::bitmap out(rows);
+    std::println("scan: {} rows", rows);
+    for (const auto& [level, level_name] : levels) {
+        if (level == jt::simd_level::avx2 &&
+            jt::detected_simd_level() != jt::simd_level::avx2) {
+            std::println("avx2 not supported on this CPU");
+            continue;
+        }
+        jt::set_simd_level(level);
+        for (const auto& [op, op_name] : ops) {
+            const double int_ns = best_time_ns(5, [&] {
+                jt::compare_int32(ints, op, 2000, out.words());
+                keep(out.words()[0]);
+            });
+            report(std::format("int32 {} ({})", op_name, level_name), rows,
+                   int_ns);
+            const double float_ns = best_time_ns(5, [&] {
+                jt::compare_float(floats, op, 20.0f, out.words());
+                keep(out.words()[0]);
+            });
+            report(std::format("float {} ({})", op_name, level_name), rows,
+                   float_ns);
+        }
+    }
+    jt::set_simd_level(jt::detected_simd_level());
+}
+}  // namespace bench
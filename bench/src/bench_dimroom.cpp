@@ -0,0 +1,22 @@
+// Benchmark driver.
+#include <cstdlib>
+#include <string>
+
+// NOLINTBEGIN(unused-includes)
+#include "../include/bench_utils.hpp"
+#include "../include/fused_bench.hpp"
+#include "../include/parallel_bench.hpp"
+#include "../include/scan_bench.hpp"
+// NOLINTEND(unused-includes)
+
+int main(int argc, char* argv[]) {
+    // The number of rows can be given on the command line.
+    const size_t rows =
+        (argc > 1) ? std::stoul(argv[1]) : size_t{1} << 24;
+
+    bench::scan_bench(rows);
+    // Building the table goes through the CSV parser, so use fewer rows.
+    bench::fused_bench(rows / 16);
+    bench::parallel_bench(rows / 16);
+    return EXIT_SUCCESS;
+}
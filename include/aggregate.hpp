@@ -0,0 +1,149 @@
+#pragma once
+
+// Aggregation of query results: counts, sums, averages, minimums and
+// maximums, over all the matching rows or by group.
+// The selected rows are walked once, reading the typed columns directly. Each
+// row's group is found from its group column: text columns by dictionary
+// code, booleans by value, and integer columns with a narrow range by offset
+// from their minimum, all of which index straight into an array of
+// accumulators; other integer and floating point columns go through a flat
+// open-addressing hash table. The rows are split into one range per thread,
+// each with its own accumulators, and the partial results are merged at the
+// end.
+// The merged totals can be kept as aggregate_groups rather than turned into
+// rows, so that the totals of several shards of a table can be merged in turn
+// (see shard.hpp); an average is only divided out once every shard's sum and
+// count are in.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief An aggregate with its column resolved.
+struct plan_aggregate {
+    aggregate_fn fn{aggregate_fn::count};
+
+    /// @brief The column aggregated, or nothing for a count of rows.
+    std::optional<size_t> column{};
+    e_cell_data_type type{e_cell_data_type::undetermined};
+
+    /// @brief Heading for the result column, such as "avg(DPI)".
+    string heading{};
+};
+
+/// @brief The result of an aggregation, one row per group, ready to print
+/// like the rows of a table.
+struct aggregate_result {
+    vector<string> headings{};
+    vector<row> rows{};
+};
+
+/// @brief Running totals of one aggregated column in one group.
+struct aggregate_totals {
+    std::uint64_t count{0};
+    double sum{0.0};
+    double min{std::numeric_limits<double>::infinity()};
+    double max{-std::numeric_limits<double>::infinity()};
+
+    void add(double v) noexcept {
+        ++count;
+        sum += v;
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+
+    void merge(const aggregate_totals& other) noexcept {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+/// @brief One group's totals, before they are turned into a row.
+struct aggregate_group {
+    /// @brief The group's value; empty for the group of rows without one,
+    /// and for the one group of a statement without "group by".
+    data_cell key{e_cell_data_type::undetermined, std::nullopt};
+
+    /// @brief Rows in the group.
+    std::uint64_t rows{0};
+
+    /// @brief The totals of each aggregate's column; unused for a count of
+    /// rows.
+    vector<aggregate_totals> totals{};
+};
+
+/// @brief The groups of an aggregation, in output order.
+using aggregate_groups = vector<aggregate_group>;
+
+/// @brief An aggregate statement, planned against a table. The rows to
+/// aggregate come from a query_plan of the statement's clauses.
+class aggregate_plan {
+    std::shared_ptr<const column_store> columns_{};
+    vector<plan_aggregate> aggregates_{};
+    std::optional<size_t> group_column_{};
+    string group_name_{};
+    e_cell_data_type group_type_{e_cell_data_type::undetermined};
+
+   public:
+    /// @brief Resolves the aggregates and group column of a statement.
+    /// @param t
+    /// @param statement
+    /// @return The plan, or the first problem found.
+    static std::expected<aggregate_plan, plan_error> make(
+        const table& t, const query_statement& statement);
+
+    const vector<plan_aggregate>& aggregates() const noexcept {
+        return aggregates_;
+    }
+
+    /// @brief Aggregates the selected rows. Groups come out in the order of
+    /// their values, with the group of rows that have no value last; an
+    /// aggregate over a group with no values is left empty.
+    /// @param selection Rows to aggregate.
+    /// @param sched Threads to use, or nullptr to run on the calling thread.
+    /// @return aggregate_result
+    aggregate_result run(const bitmap& selection,
+                         scheduler* sched = &scheduler::shared()) const {
+        return finish(run_groups(selection, sched));
+    }
+
+    /// @brief Totals the selected rows by group, without making rows.
+    /// @param selection Rows to aggregate.
+    /// @param sched Threads to use, or nullptr to run on the calling thread.
+    /// @return The groups that have rows, in output order.
+    aggregate_groups run_groups(const bitmap& selection,
+                                scheduler* sched = &scheduler::shared()) const;
+
+    /// @brief Merges the groups of several shards of a table; groups with
+    /// the same value are added together.
+    /// @param parts Groups from run_groups() of the same statement.
+    /// @return The groups, in output order.
+    aggregate_groups merge(std::span<const aggregate_groups> parts) const;
+
+    /// @brief Turns totals into the rows of the result.
+    /// @param groups In output order.
+    /// @return aggregate_result
+    aggregate_result finish(const aggregate_groups& groups) const;
+};
+
+}  // namespace jt
@@ -0,0 +1,104 @@
+#pragma once
+
+// Running many saved queries against a table at once, for jobs that are not
+// interactive.
+// query_batch::make() parses and plans every line of a batch file. The
+// clauses of all the plans go into one list, keeping a clause that several
+// queries share (the same clause_key) only once, and the list is sorted by
+// column. query_batch::execute() then evaluates every clause in one pass
+// over the table: each morsel goes to one thread, which takes the columns in
+// turn and walks the morsel a block at a time, applying every clause on the
+// column to a block while its values are in cache. Each clause fills its own
+// bitmap, and a query's result is the AND of its clauses' bitmaps, so a
+// hundred queries on the same few columns read each column once rather than
+// a hundred times. Clauses the column's index can answer are looked up
+// instead.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "column_store.hpp"
+#include "projection.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief One planned query of a batch.
+struct batch_query {
+    /// @brief Position among the batch's statements, from 1; blank lines
+    /// and comments are not counted, statements that failed are.
+    size_t number{0};
+
+    /// @brief Line in the batch file, from 1.
+    size_t line_number{0};
+
+    string text{};
+    query_plan plan{};
+
+    /// @brief The columns to write: those a select statement names, or all.
+    projection columns{};
+
+    /// @brief Positions of the plan's clauses in query_batch::clauses().
+    vector<size_t> clauses{};
+};
+
+/// @brief A line of a batch file that could not be planned.
+struct batch_problem {
+    size_t number{0};
+    size_t line_number{0};
+    string message{};
+};
+
+/// @brief The queries of a batch file, planned against a table, with their
+/// clauses shared out.
+class query_batch {
+    std::shared_ptr<const column_store> columns_{};
+    vector<batch_query> queries_{};
+    vector<batch_problem> problems_{};
+
+    /// @brief Every different clause of the batch, sorted by column.
+    vector<plan_clause> clauses_{};
+
+    /// @brief Number of clauses in all the queries, before sharing.
+    size_t clause_uses_{0};
+
+   public:
+    /// @brief Parses and plans the lines of a batch file. Blank lines and
+    /// lines starting with '#' are skipped. Each other line must be a query
+    /// or select statement; any that is not, or that cannot be planned, is
+    /// recorded as a problem and left out.
+    /// @param t
+    /// @param lines
+    /// @return query_batch
+    static query_batch make(const table& t, const vector<string>& lines);
+
+    /// @brief The queries that were planned, in file order.
+    const vector<batch_query>& queries() const noexcept { return queries_; }
+
+    /// @brief The lines that could not be planned.
+    const vector<batch_problem>& problems() const noexcept {
+        return problems_;
+    }
+
+    /// @brief Every different clause of the batch.
+    const vector<plan_clause>& clauses() const noexcept { return clauses_; }
+
+    /// @brief Number of clauses in all the queries, counting each time a
+    /// clause is used.
+    size_t clause_uses() const noexcept { return clause_uses_; }
+
+    /// @brief Evaluates every clause in one pass, then each query.
+    /// @param sched Threads to use, or nullptr to run on the calling thread.
+    /// @return Each query's result, in the order of queries(); as
+    /// query_plan::execute() would return it.
+    vector<bitmap> execute(scheduler* sched = &scheduler::shared()) const;
+};
+
+}  // namespace jt
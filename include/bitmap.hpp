@@ -0,0 +1,196 @@
+#pragma once
+
+// Selection bitmaps. One bit per table row; bit i is set if row i is selected.
+// Bits are stored in 64-bit words so that ANDing clauses together is a word
+// at a time.
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace jt {
+using std::vector;
+
+/// @brief A fixed-size set of row numbers, stored one bit per row.
+class bitmap {
+   public:
+    /// @brief Storage unit for the bits.
+    using word_t = std::uint64_t;
+
+    /// @brief Number of bits in a word.
+    static constexpr size_t word_bits{64};
+
+    /// @brief Number of words needed to hold n bits.
+    /// @param n
+    /// @return size_t
+    static constexpr size_t words_for(size_t n) noexcept {
+        return (n + word_bits - 1) / word_bits;
+    }
+
+   private:
+    vector<word_t> words_{};
+    size_t size_{0};
+
+    /// @brief Keeps the unused bits of the last word at zero, so that count()
+    /// and the word-wise operators never see rows past the end.
+    void clear_tail() noexcept {
+        const size_t tail = size_ % word_bits;
+        if (tail != 0 && !words_.empty()) {
+            words_.back() &= (word_t{1} << tail) - 1;
+        }
+    }
+
+   public:
+    /// @brief Default constructor; an empty bitmap.
+    bitmap() noexcept = default;
+
+    /// @brief Constructor for a bitmap of n rows, all set or all clear.
+    /// @param n Number of rows.
+    /// @param all_set If true, every row is selected.
+    explicit bitmap(size_t n, bool all_set = false)
+        : words_(words_for(n), all_set ? ~word_t{0} : word_t{0}), size_{n} {
+        clear_tail();
+    }
+
+    /// @brief Changes the number of rows. Rows added are clear.
+    /// @param n
+    void resize(size_t n) {
+        words_.resize(words_for(n), word_t{0});
+        size_ = n;
+        clear_tail();
+    }
+
+    /// @brief Makes a bitmap of n rows from a sorted or unsorted list of row
+    /// numbers.
+    /// @tparam Ids Range of integral row numbers.
+    /// @param n
+    /// @param ids
+    /// @return bitmap
+    template <class Ids>
+    static bitmap from_ids(size_t n, const Ids& ids) {
+        bitmap result(n);
+        for (const auto id : ids) {
+            result.set(static_cast<size_t>(id));
+        }
+        return result;
+    }
+
+    /// @brief Number of rows (bits) covered by the bitmap.
+    constexpr size_t size() const noexcept { return size_; }
+
+    /// @brief Number of words used.
+    constexpr size_t word_count() const noexcept { return words_.size(); }
+
+    /// @brief Read access to the words, for kernels.
+    std::span<const word_t> words() const noexcept { return words_; }
+
+    /// @brief Write access to the words, for kernels.
+    /// @note Kernels must not set bits past size().
+    std::span<word_t> words() noexcept { return words_; }
+
+    bool test(size_t i) const noexcept {
+        return (words_[i / word_bits] >> (i % word_bits)) & word_t{1};
+    }
+
+    void set(size_t i) noexcept {
+        words_[i / word_bits] |= word_t{1} << (i % word_bits);
+    }
+
+    void reset(size_t i) noexcept {
+        words_[i / word_bits] &= ~(word_t{1} << (i % word_bits));
+    }
+
+    /// @brief Number of selected rows.
+    /// @return size_t
+    size_t count() const noexcept {
+        size_t result{0};
+        for (const word_t w : words_) {
+            result += static_cast<size_t>(std::popcount(w));
+        }
+        return result;
+    }
+
+    /// @brief True if no rows are selected.
+    bool none() const noexcept {
+        return std::ranges::all_of(words_, [](word_t w) { return w == 0; });
+    }
+
+    /// @brief Intersection (AND) with another bitmap of the same size.
+    bitmap& operator&=(const bitmap& other) noexcept {
+        const size_t n = std::min(words_.size(), other.words_.size());
+        for (size_t i = 0; i < n; ++i) {
+            words_[i] &= other.words_[i];
+        }
+        return *this;
+    }
+
+    /// @brief Union (OR) with another bitmap of the same size.
+    bitmap& operator|=(const bitmap& other) noexcept {
+        const size_t n = std::min(words_.size(), other.words_.size());
+        for (size_t i = 0; i < n; ++i) {
+            words_[i] |= other.words_[i];
+        }
+        return *this;
+    }
+
+    /// @brief Removes the rows that are set in other (AND NOT).
+    bitmap& and_not(const bitmap& other) noexcept {
+        const size_t n = std::min(words_.size(), other.words_.size());
+        for (size_t i = 0; i < n; ++i) {
+            words_[i] &= ~other.words_[i];
+        }
+        return *this;
+    }
+
+    /// @brief Complement, within size().
+    bitmap& flip() noexcept {
+        for (word_t& w : words_) {
+            w = ~w;
+        }
+        clear_tail();
+        return *this;
+    }
+
+    bool operator==(const bitmap& other) const noexcept = default;
+
+    /// @brief Calls fn(row_number) for every selected row, in row order.
+    /// @tparam Fn
+    /// @param fn
+    template <class Fn>
+    void for_each_set(Fn&& fn) const {
+        for (size_t wi = 0; wi < words_.size(); ++wi) {
+            word_t w = words_[wi];
+            while (w != 0) {
+                const size_t bit = static_cast<size_t>(std::countr_zero(w));
+                fn(wi * word_bits + bit);
+                w &= w - 1;
+            }
+        }
+    }
+
+    /// @brief The selected row numbers, in row order.
+    /// @return vector<uint32_t>
+    vector<std::uint32_t> to_ids() const {
+        vector<std::uint32_t> result;
+        result.reserve(count());
+        for_each_set([&result](size_t i) {
+            result.push_back(static_cast<std::uint32_t>(i));
+        });
+        return result;
+    }
+};
+
+inline bitmap operator&(bitmap lhs, const bitmap& rhs) noexcept {
+    lhs &= rhs;
+    return lhs;
+}
+
+inline bitmap operator|(bitmap lhs, const bitmap& rhs) noexcept {
+    lhs |= rhs;
+    return lhs;
+}
+
+}  // namespace jt
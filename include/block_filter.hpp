@@ -0,0 +1,249 @@
+#pragma once
+
+// Per-block clause filters, for fused execution of a conjunction.
+// A fused scan walks the column store one block of rows at a time and applies
+// every scanned clause to that block before moving on to the next, so the
+// values of a block are still in cache for the later clauses and no clause
+// builds a full-length bitmap of its own. Each filter ANDs its result into
+// the block's selection words; once a block has no rows left, the remaining
+// filters are skipped for it. Filters that work a row at a time (tags and
+// the polygon crossing test) only look at the rows still selected.
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "columns.hpp"
+#include "contains.hpp"
+#include "coordinates.hpp"
+#include "predicate.hpp"
+#include "simd_kernels.hpp"
+
+namespace jt {
+using std::vector;
+
+/// @brief A block of rows being filtered.
+struct row_block {
+    using word_t = bitmap::word_t;
+
+    /// @brief First row; always a multiple of bitmap::word_bits.
+    size_t first{0};
+
+    /// @brief One past the last row.
+    size_t last{0};
+
+    /// @brief The selection words for rows [first, last).
+    std::span<word_t> selection{};
+
+    /// @brief Working space, the same size as selection.
+    std::span<word_t> scratch{};
+
+    /// @brief More working space, the same size as selection.
+    std::span<word_t> spare{};
+
+    /// @brief Number of rows in the block.
+    size_t size() const noexcept { return last - first; }
+
+    /// @brief True if no rows in the block are still selected.
+    bool none() const noexcept {
+        return std::ranges::all_of(selection, [](word_t w) { return w == 0; });
+    }
+
+    /// @brief The words of a whole-column bitmap that cover this block.
+    std::span<const word_t> words_of(const bitmap& b) const noexcept {
+        return b.words().subspan(first / bitmap::word_bits, selection.size());
+    }
+
+    /// @brief Calls keep(row) for each selected row in the block, and
+    /// deselects the rows for which it returns false.
+    /// @tparam Fn
+    /// @param keep
+    template <class Fn>
+    void retain_if(Fn&& keep) {
+        for (size_t wi = 0; wi < selection.size(); ++wi) {
+            word_t w = selection[wi];
+            while (w != 0) {
+                const word_t bit = w & (~w + 1);
+                const size_t r = first + wi * bitmap::word_bits +
+                                 static_cast<size_t>(std::countr_zero(w));
+                if (!keep(r)) selection[wi] &= ~bit;
+                w &= w - 1;
+            }
+        }
+    }
+};
+
+/// @brief ANDs the comparison result in block.scratch into the selection,
+/// applying a null mask first.
+/// @param block
+/// @param present Rows that have a value, or nullptr if every row counts.
+/// @param empty_matches Whether rows without a value should be selected.
+inline void merge_scratch(row_block& block, const bitmap* present,
+                          bool empty_matches) noexcept {
+    if (!present) {
+        for (size_t i = 0; i < block.selection.size(); ++i) {
+            block.selection[i] &= block.scratch[i];
+        }
+        return;
+    }
+    const auto p = block.words_of(*present);
+    for (size_t i = 0; i < block.selection.size(); ++i) {
+        const auto w = empty_matches ? (block.scratch[i] | ~p[i])
+                                     : (block.scratch[i] & p[i]);
+        block.selection[i] &= w;
+    }
+}
+
+/// @brief A clause whose result is known without looking at the rows.
+struct constant_filter {
+    bool matches{false};
+
+    void apply(row_block& block) const noexcept {
+        if (!matches) std::ranges::fill(block.selection, 0);
+    }
+};
+
+/// @brief Compares an int32 column: integer values, or text dictionary
+/// codes.
+struct int32_filter {
+    std::span<const std::int32_t> values{};
+    comparison_op op{comparison_op::equal_to};
+    std::int32_t value{0};
+
+    /// @brief Rows with a value, or nullptr if every row counts.
+    const bitmap* present{nullptr};
+
+    void apply(row_block& block) const noexcept {
+        compare_int32(values.subspan(block.first, block.size()), op, value,
+                      block.scratch);
+        merge_scratch(block, present, op == comparison_op::not_equal_to);
+    }
+};
+
+/// @brief Compares a floating point column.
+struct float_filter {
+    std::span<const float> values{};
+    comparison_op op{comparison_op::equal_to};
+    float value{0.0f};
+    const bitmap* present{nullptr};
+
+    void apply(row_block& block) const noexcept {
+        compare_float(values.subspan(block.first, block.size()), op, value,
+                      block.scratch);
+        merge_scratch(block, present, op == comparison_op::not_equal_to);
+    }
+};
+
+/// @brief Compares a boolean column. Whether a true or a false cell matches
+/// is worked out when the filter is made.
+struct boolean_filter {
+    const bitmap* values{nullptr};
+    bool true_matches{false};
+    bool false_matches{false};
+
+    void apply(row_block& block) const noexcept {
+        const auto v = block.words_of(*values);
+        for (size_t i = 0; i < block.selection.size(); ++i) {
+            const auto w = (true_matches ? v[i] : 0) |
+                           (false_matches ? ~v[i] : 0);
+            block.selection[i] &= w;
+        }
+    }
+};
+
+/// @brief Compares a coordinate column with one coordinate.
+struct coordinate_filter {
+    const coordinate_column* col{nullptr};
+    coordinate value{};
+    bool negate{false};
+
+    void apply(row_block& block) const noexcept {
+        const std::span<const float> lats{col->latitudes};
+        const std::span<const float> longs{col->longitudes};
+        compare_float(lats.subspan(block.first, block.size()),
+                      comparison_op::equal_to, value.latitude, block.scratch);
+        compare_float(longs.subspan(block.first, block.size()),
+                      comparison_op::equal_to, value.longitude, block.spare);
+        const auto p = block.words_of(col->present);
+        for (size_t i = 0; i < block.selection.size(); ++i) {
+            const auto at = block.scratch[i] & block.spare[i] & p[i];
+            block.selection[i] &= negate ? ~at : at;
+        }
+    }
+};
+
+/// @brief Selects the points of a coordinate column inside a polygon: the
+/// polygon's bounding box with the kernels, then the crossing test for the
+/// rows inside the box.
+struct inside_filter {
+    const coordinate_column* col{nullptr};
+    std::span<const coordinate> polygon{};
+    float latitude_min{0.0f};
+    float latitude_max{0.0f};
+    float longitude_min{0.0f};
+    float longitude_max{0.0f};
+
+    void apply(row_block& block) const {
+        const std::span<const float> lats =
+            std::span<const float>{col->latitudes}.subspan(block.first,
+                                                           block.size());
+        const std::span<const float> longs =
+            std::span<const float>{col->longitudes}.subspan(block.first,
+                                                            block.size());
+        auto bound = [&block](std::span<const float> values,
+                              comparison_op op, float v) {
+            compare_float(values, op, v, block.spare);
+            for (size_t i = 0; i < block.scratch.size(); ++i) {
+                block.scratch[i] &= block.spare[i];
+            }
+        };
+        compare_float(lats, comparison_op::greater_equal, latitude_min,
+                      block.scratch);
+        bound(lats, comparison_op::less_equal, latitude_max);
+        bound(longs, comparison_op::greater_equal, longitude_min);
+        bound(longs, comparison_op::less_equal, longitude_max);
+        merge_scratch(block, &col->present, false);
+
+        block.retain_if([this](size_t r) {
+            const coordinate point{coordinate::format::decimal,
+                                   col->latitudes[r], col->longitudes[r]};
+            return point_in_polygon_span(point, polygon);
+        });
+    }
+};
+
+/// @brief Selects the rows of a tags column that have any of a set of tags.
+struct tags_filter {
+    const tags_column* col{nullptr};
+
+    /// @brief Indexed by tag code.
+    vector<bool> wanted{};
+
+    void apply(row_block& block) const {
+        block.retain_if([this](size_t r) {
+            for (auto i = col->offsets[r]; i < col->offsets[r + 1]; ++i) {
+                if (wanted[col->tag_ids[i]]) return true;
+            }
+            return false;
+        });
+    }
+};
+
+/// @brief One clause, prepared for fused execution.
+using block_filter =
+    std::variant<constant_filter, int32_filter, float_filter, boolean_filter,
+                 coordinate_filter, inside_filter, tags_filter>;
+
+/// @brief Applies a filter to a block of rows.
+/// @param filter
+/// @param block
+inline void apply_filter(const block_filter& filter, row_block& block) {
+    std::visit([&block](const auto& f) { f.apply(block); }, filter);
+}
+
+}  // namespace jt
@@ -0,0 +1,100 @@
+#pragma once
+
+// Reading the lines of CSV files, and reading a catalog that is split across
+// several files, such as one per year or per camera. The files can be named
+// one by one, by a directory that holds them, or by a pattern such as
+// "catalog/*.csv". Each file is read and parsed on a task of its own, then
+// the files are put together into one table: columns with the same name
+// become one column, whose type is the files' types combined with
+// e_cell_data_type's ||, and a "Source File" column says which file each row
+// came from. A row from a file without one of the columns is empty in it.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief The lines of part of a file.
+struct file_lines {
+    /// @brief The lines, trimmed; blank lines are left out.
+    vector<string> lines{};
+
+    /// @brief Offset just after the last line break read.
+    std::uint64_t end{0};
+
+    /// @brief Offset of the end of the file when it was read.
+    std::uint64_t read{0};
+
+    /// @brief Whether the last of lines has no line break after it, so may
+    /// still be being written.
+    bool unfinished{false};
+};
+
+/// @brief Reads the lines of a file from an offset to its end.
+/// @param filename
+/// @param from Offset of the start of a line.
+/// @return The lines, or a message if the file cannot be read.
+std::expected<file_lines, string> read_lines(const string& filename,
+                                             std::uint64_t from);
+
+/// @brief Name of the column that says which file a row was read from.
+inline constexpr std::string_view source_column_name{"Source File"};
+
+/// @brief Whether paths name a single file rather than a set of them.
+/// @param paths Files, directories and patterns, as expand_catalog_paths()
+/// takes.
+bool names_one_file(const vector<string>& paths);
+
+/// @brief Lists the files that paths name. A directory names the ".csv"
+/// files in it, and a path whose last part holds '*' or '?' the files in
+/// its directory whose names match it; each is listed in name order. Any
+/// other path is taken to be a file.
+/// @param paths
+/// @return The files, or a message if a directory cannot be read or names
+/// no files.
+std::expected<vector<string>, string> expand_catalog_paths(
+    const vector<string>& paths);
+
+/// @brief One file of a catalog, parsed.
+struct catalog_part {
+    string filename{};
+    parser::header_fields_t header_fields{};
+    vector<row> rows{};
+};
+
+/// @brief How long a file of a catalog took to read.
+struct file_load {
+    string filename{};
+    size_t rows{0};
+
+    /// @brief Time spent reading and parsing the file.
+    std::chrono::nanoseconds load{};
+};
+
+/// @brief Puts the files of a catalog together into one table, in the
+/// order given, with a source column.
+/// @param parts
+/// @return The table, or a message if a column has types in two files that
+/// do not combine, or a file has a column named like the source column.
+std::expected<table, string> combine_catalog_parts(
+    vector<catalog_part>&& parts);
+
+/// @brief Reads and parses files in parallel, and puts them together with
+/// combine_catalog_parts().
+/// @param filenames
+/// @param loads Set to how long each file took.
+/// @return The table, or a message saying what was wrong.
+std::expected<table, string> read_catalog_files(
+    const vector<string>& filenames, vector<file_load>& loads);
+
+}  // namespace jt
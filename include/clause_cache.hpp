@@ -0,0 +1,198 @@
+#pragma once
+
+// A cache of clause results.
+// Interactive sessions re-run the same clauses over and over, combined with
+// different other clauses, so the selection bitmap for each clause is kept,
+// keyed by the clause in a normalized form: its column, its operator, and
+// its value converted to the column's type. The least recently used results
+// are dropped when the cache goes over its memory budget.
+// Results belong to one version of the table's data, identified by the
+// column store's generation; using the cache with a different generation
+// empties it.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "bitmap.hpp"
+#include "predicate.hpp"
+
+namespace jt {
+using std::string;
+
+/// @brief A clause in normalized form.
+struct clause_key {
+    size_t column{0};
+    comparison_op op{comparison_op::equal_to};
+
+    /// @brief The clause's value after conversion to the column's type,
+    /// encoded so that equal values have equal encodings (tags are sorted,
+    /// polygons are encoded point by point).
+    string value{};
+
+    bool operator==(const clause_key&) const = default;
+};
+
+/// @brief Hash for clause_key.
+struct clause_key_hash {
+    size_t operator()(const clause_key& key) const noexcept {
+        size_t h = std::hash<string>{}(key.value);
+        h ^= key.column + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h ^= static_cast<size_t>(key.op) + 0x9e3779b97f4a7c15ULL + (h << 6) +
+             (h >> 2);
+        return h;
+    }
+};
+
+/// @brief Least recently used cache of clause selection bitmaps, with a
+/// memory budget. Safe to use from several threads.
+class clause_cache {
+   public:
+    /// @brief Budget used if none is given: 64 MiB, which holds 32 results
+    /// for a table of 16 million rows.
+    static constexpr size_t default_budget{size_t{64} << 20};
+
+    /// @brief What the cache has done, for tuning the budget.
+    struct statistics {
+        size_t hits{0};
+        size_t misses{0};
+        size_t entries{0};
+        size_t bytes{0};
+    };
+
+   private:
+    struct entry {
+        clause_key key{};
+        std::shared_ptr<const bitmap> selection{};
+        size_t bytes{0};
+    };
+    using entry_list = std::list<entry>;
+
+    mutable std::mutex mutex_{};
+    size_t budget_{default_budget};
+    std::uint64_t generation_{0};
+
+    /// @brief Most recently used first.
+    entry_list entries_{};
+    std::unordered_map<clause_key, entry_list::iterator, clause_key_hash>
+        lookup_{};
+    statistics stats_{};
+
+    /// @brief Memory charged for one result.
+    static size_t bytes_for(const bitmap& b) noexcept {
+        return b.word_count() * sizeof(bitmap::word_t) + sizeof(entry);
+    }
+
+    /// @brief Empties the cache if it holds results for another generation.
+    /// Called with mutex_ held.
+    void use_generation(std::uint64_t generation) {
+        if (generation == generation_) return;
+        drop_all();
+        generation_ = generation;
+    }
+
+    void drop_all() {
+        entries_.clear();
+        lookup_.clear();
+        stats_.entries = 0;
+        stats_.bytes = 0;
+    }
+
+    /// @brief Drops least recently used results until the cache is within
+    /// its budget. Called with mutex_ held.
+    void trim_to_budget() {
+        while (stats_.bytes > budget_ && !entries_.empty()) {
+            const entry& oldest = entries_.back();
+            stats_.bytes -= oldest.bytes;
+            lookup_.erase(oldest.key);
+            entries_.pop_back();
+            --stats_.entries;
+        }
+    }
+
+   public:
+    /// @brief Constructor.
+    /// @param budget_bytes Most memory the results may use.
+    explicit clause_cache(size_t budget_bytes = default_budget) noexcept
+        : budget_{budget_bytes} {}
+
+    clause_cache(const clause_cache&) = delete;
+    clause_cache& operator=(const clause_cache&) = delete;
+
+    /// @brief Looks up a clause's result.
+    /// @param generation Generation of the column store being queried.
+    /// @param key
+    /// @return The result, or nullptr if it is not cached.
+    std::shared_ptr<const bitmap> find(std::uint64_t generation,
+                                       const clause_key& key) {
+        std::lock_guard lock(mutex_);
+        use_generation(generation);
+        const auto it = lookup_.find(key);
+        if (it == lookup_.end()) {
+            ++stats_.misses;
+            return nullptr;
+        }
+        ++stats_.hits;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->selection;
+    }
+
+    /// @brief Stores a clause's result. A result larger than the whole
+    /// budget is not stored.
+    /// @param generation Generation of the column store it was computed on.
+    /// @param key
+    /// @param selection
+    void insert(std::uint64_t generation, const clause_key& key,
+                std::shared_ptr<const bitmap> selection) {
+        if (!selection) return;
+        const size_t bytes = bytes_for(*selection);
+        std::lock_guard lock(mutex_);
+        use_generation(generation);
+        if (bytes > budget_) return;
+        if (const auto it = lookup_.find(key); it != lookup_.end()) {
+            stats_.bytes -= it->second->bytes;
+            entries_.erase(it->second);
+            lookup_.erase(it);
+            --stats_.entries;
+        }
+        entries_.push_front(entry{key, std::move(selection), bytes});
+        lookup_.emplace(key, entries_.begin());
+        ++stats_.entries;
+        stats_.bytes += bytes;
+        trim_to_budget();
+    }
+
+    /// @brief Drops every result.
+    void clear() {
+        std::lock_guard lock(mutex_);
+        drop_all();
+    }
+
+    /// @brief Changes the memory budget, dropping results if need be.
+    /// @param budget_bytes
+    void set_budget(size_t budget_bytes) {
+        std::lock_guard lock(mutex_);
+        budget_ = budget_bytes;
+        trim_to_budget();
+    }
+
+    /// @brief The memory budget, in bytes.
+    size_t budget() const {
+        std::lock_guard lock(mutex_);
+        return budget_;
+    }
+
+    /// @brief Hit and miss counts, and current size.
+    statistics stats() const {
+        std::lock_guard lock(mutex_);
+        return stats_;
+    }
+};
+
+}  // namespace jt
@@ -0,0 +1,393 @@
+#pragma once
+
+// Indexes over the columns in a column_store.
+// Text and tags columns get posting lists: for each dictionary code, the rows
+// that have it. Integer and floating point columns get a sorted index: the
+// rows that have a value, ordered by that value. Either kind of index turns a
+// comparison into a contiguous run of row ids, so a selective clause costs
+// time in proportion to its matches rather than to the table size.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "columns.hpp"
+#include "predicate.hpp"
+#include "utility.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief Stands for no row, such as for a row of an edited column that is
+/// not a copy of an old one, or an old row that is no longer there.
+inline constexpr std::uint32_t no_row =
+    std::numeric_limits<std::uint32_t>::max();
+
+/// @brief For each code, the rows that have it, in row order.
+/// The rows for code c are rows[offsets[c]] up to rows[offsets[c + 1]], so
+/// the rows for a range of codes are also contiguous.
+struct posting_lists {
+    vector<std::uint32_t> offsets{};
+    vector<std::uint32_t> rows{};
+
+    /// @brief Number of codes.
+    size_t code_count() const noexcept {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    /// @brief Number of rows with a code in [first, last).
+    size_t count(size_t first, size_t last) const noexcept {
+        return offsets[last] - offsets[first];
+    }
+
+    /// @brief The rows with a code in [first, last).
+    std::span<const std::uint32_t> range(size_t first,
+                                         size_t last) const noexcept {
+        return std::span<const std::uint32_t>{rows}.subspan(
+            offsets[first], offsets[last] - offsets[first]);
+    }
+
+    /// @brief Builds posting lists from one code per row, by counting sort.
+    /// @param codes
+    /// @param code_count
+    /// @return posting_lists
+    static posting_lists from_codes(std::span<const std::int32_t> codes,
+                                    size_t code_count) {
+        posting_lists result{};
+        result.offsets.assign(code_count + 1, 0);
+        for (const auto code : codes) ++result.offsets[code + 1];
+        std::partial_sum(result.offsets.begin(), result.offsets.end(),
+                         result.offsets.begin());
+
+        result.rows.resize(codes.size());
+        vector<std::uint32_t> next(result.offsets.begin(),
+                                   result.offsets.end() - 1);
+        for (size_t r = 0; r < codes.size(); ++r) {
+            result.rows[next[codes[r]]++] = static_cast<std::uint32_t>(r);
+        }
+        return result;
+    }
+
+    /// @brief Builds posting lists from a tags column, where a row can have
+    /// any number of codes.
+    /// @param col
+    /// @return posting_lists
+    static posting_lists from_tags(const tags_column& col) {
+        posting_lists result{};
+        result.offsets.assign(col.dictionary.size() + 1, 0);
+        for (const auto id : col.tag_ids) ++result.offsets[id + 1];
+        std::partial_sum(result.offsets.begin(), result.offsets.end(),
+                         result.offsets.begin());
+
+        result.rows.resize(col.tag_ids.size());
+        vector<std::uint32_t> next(result.offsets.begin(),
+                                   result.offsets.end() - 1);
+        const size_t n = col.offsets.empty() ? 0 : col.offsets.size() - 1;
+        for (size_t r = 0; r < n; ++r) {
+            for (auto i = col.offsets[r]; i < col.offsets[r + 1]; ++i) {
+                result.rows[next[col.tag_ids[i]]++] =
+                    static_cast<std::uint32_t>(r);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Adds codes for rows after the last row in the lists. Each
+    /// list is the old list followed by its new rows, so nothing is sorted.
+    /// @param old
+    /// @param codes The new rows' codes, in row order; less than
+    /// old.code_count().
+    /// @param rows The row of each code.
+    /// @return posting_lists
+    static posting_lists appended(const posting_lists& old,
+                                  std::span<const std::uint32_t> codes,
+                                  std::span<const std::uint32_t> rows) {
+        const size_t code_count = old.code_count();
+        vector<std::uint32_t> added(code_count + 1, 0);
+        for (const auto code : codes) ++added[code + 1];
+        std::partial_sum(added.begin(), added.end(), added.begin());
+
+        posting_lists result{};
+        result.offsets.resize(code_count + 1);
+        for (size_t c = 0; c <= code_count; ++c) {
+            result.offsets[c] = old.offsets[c] + added[c];
+        }
+        result.rows.resize(old.rows.size() + codes.size());
+        vector<std::uint32_t> next(code_count);
+        for (size_t c = 0; c < code_count; ++c) {
+            const auto old_rows = old.range(c, c + 1);
+            std::ranges::copy(old_rows,
+                              result.rows.begin() + result.offsets[c]);
+            next[c] = result.offsets[c] +
+                      static_cast<std::uint32_t>(old_rows.size());
+        }
+        for (size_t i = 0; i < codes.size(); ++i) {
+            result.rows[next[codes[i]]++] = rows[i];
+        }
+        return result;
+    }
+};
+
+/// @brief The rows of a numeric column that have a value, ordered by value
+/// (and by row within equal values).
+/// @tparam T
+template <typename T>
+struct sorted_index {
+    vector<std::uint32_t> order{};
+
+    /// @brief Builds the index for a column.
+    /// @param col
+    /// @return sorted_index
+    static sorted_index make(const typed_column<T>& col) {
+        sorted_index result{};
+        result.order.reserve(col.present.count());
+        col.present.for_each_set([&result](size_t r) {
+            result.order.push_back(static_cast<std::uint32_t>(r));
+        });
+        std::ranges::stable_sort(result.order, {}, [&col](std::uint32_t r) {
+            return col.values[r];
+        });
+        return result;
+    }
+
+    /// @brief Adds the rows of a column from first_row on, all after the
+    /// rows already in the index. Only the new rows are sorted; they are then
+    /// merged in after the old rows with equal values.
+    /// @param old
+    /// @param col The whole column, old rows and new.
+    /// @param first_row
+    /// @return sorted_index
+    static sorted_index appended(const sorted_index& old,
+                                 const typed_column<T>& col, size_t first_row) {
+        vector<std::uint32_t> added{};
+        for (size_t r = first_row; r < col.values.size(); ++r) {
+            if (col.present.test(r)) {
+                added.push_back(static_cast<std::uint32_t>(r));
+            }
+        }
+        auto value = [&col](std::uint32_t r) { return col.values[r]; };
+        std::ranges::stable_sort(added, {}, value);
+        sorted_index result{};
+        result.order.resize(old.order.size() + added.size());
+        std::ranges::merge(old.order, added, result.order.begin(), {}, value,
+                           value);
+        return result;
+    }
+
+    /// @brief The index of an edited column. The old rows still there keep
+    /// their order, under their new row numbers, and only the rows with new
+    /// values are sorted before being merged in. Equal values stay in row
+    /// order, as make() leaves them.
+    /// @param old
+    /// @param col The edited column.
+    /// @param moved_to For each old row, its new row number, or no_row if
+    /// it is gone; old rows keep their relative order.
+    /// @param added The rows with new values, in row order.
+    /// @return sorted_index
+    static sorted_index edited(const sorted_index& old,
+                               const typed_column<T>& col,
+                               std::span<const std::uint32_t> moved_to,
+                               vector<std::uint32_t> added) {
+        vector<std::uint32_t> kept{};
+        kept.reserve(old.order.size());
+        for (const auto r : old.order) {
+            if (moved_to[r] != no_row) kept.push_back(moved_to[r]);
+        }
+        std::ranges::stable_sort(
+            added, {}, [&col](std::uint32_t r) { return col.values[r]; });
+        sorted_index result{};
+        result.order.resize(kept.size() + added.size());
+        std::ranges::merge(kept, added, result.order.begin(),
+                           [&col](std::uint32_t lhs, std::uint32_t rhs) {
+                               if (col.values[lhs] < col.values[rhs]) {
+                                   return true;
+                               }
+                               if (col.values[rhs] < col.values[lhs]) {
+                                   return false;
+                               }
+                               return lhs < rhs;
+                           });
+        return result;
+    }
+
+    /// @brief Position of the first row whose value is not less than v.
+    size_t lower_bound(const typed_column<T>& col, T v) const {
+        const auto it = std::ranges::lower_bound(
+            order, v, {}, [&col](std::uint32_t r) { return col.values[r]; });
+        return static_cast<size_t>(it - order.begin());
+    }
+
+    /// @brief Position of the first row whose value is greater than v.
+    size_t upper_bound(const typed_column<T>& col, T v) const {
+        const auto it = std::ranges::upper_bound(
+            order, v, {}, [&col](std::uint32_t r) { return col.values[r]; });
+        return static_cast<size_t>(it - order.begin());
+    }
+};
+
+/// @brief The index for one column; std::monostate if it has none.
+using column_index =
+    std::variant<std::monostate, posting_lists, sorted_index<std::int32_t>,
+                 sorted_index<float>>;
+
+/// @brief A half-open range of positions in an index.
+using index_range = std::pair<size_t, size_t>;
+
+/// @brief The range of sorted-index positions for a comparison. Uses the
+/// same semantics as the scan kernels: floating point equality is an
+/// interval compare, and not_equal_to is handled by the caller.
+/// @tparam T
+/// @param col
+/// @param idx
+/// @param op
+/// @param v
+/// @return index_range
+template <typename T>
+index_range sorted_range(const typed_column<T>& col, const sorted_index<T>& idx,
+                         comparison_op op, T v) {
+    T lo = v;
+    T hi = v;
+    if constexpr (std::is_same_v<T, float>) {
+        lo = v - epsilon<float>();
+        hi = v + epsilon<float>();
+    }
+    const size_t n = idx.order.size();
+    switch (op) {
+        case comparison_op::less:
+            return {0, idx.lower_bound(col, v)};
+        case comparison_op::less_equal:
+            return {0, idx.upper_bound(col, hi)};
+        case comparison_op::greater:
+            return {idx.upper_bound(col, v), n};
+        case comparison_op::greater_equal:
+            return {idx.lower_bound(col, lo), n};
+        default:
+            return {idx.lower_bound(col, lo), idx.upper_bound(col, hi)};
+    }
+}
+
+/// @brief The range of dictionary codes for a text comparison; not_equal_to
+/// is handled by the caller.
+/// @param dictionary Sorted dictionary.
+/// @param op
+/// @param v
+/// @return index_range
+inline index_range code_range(const vector<string>& dictionary,
+                              comparison_op op, const string& v) {
+    const auto it = std::ranges::lower_bound(dictionary, v);
+    const size_t code = static_cast<size_t>(it - dictionary.begin());
+    const bool found = it != dictionary.end() && *it == v;
+    const size_t after = found ? code + 1 : code;
+    switch (op) {
+        case comparison_op::less:
+            return {0, code};
+        case comparison_op::less_equal:
+            return {0, after};
+        case comparison_op::greater:
+            return {after, dictionary.size()};
+        case comparison_op::greater_equal:
+            return {code, dictionary.size()};
+        default:
+            return {code, after};
+    }
+}
+
+/// @brief Looks up a comparison on a numeric column in its sorted index.
+/// An empty cell matches only not_equal_to, as with select_integer().
+/// @tparam T
+/// @param col
+/// @param idx
+/// @param op
+/// @param v
+/// @return bitmap
+template <typename T>
+bitmap index_lookup(const typed_column<T>& col, const sorted_index<T>& idx,
+                    comparison_op op, T v) {
+    const size_t n = col.values.size();
+    const bool negate = op == comparison_op::not_equal_to;
+    const auto [first, last] =
+        sorted_range(col, idx, negate ? comparison_op::equal_to : op, v);
+    bitmap result = bitmap::from_ids(
+        n, std::span<const std::uint32_t>{idx.order}.subspan(first,
+                                                             last - first));
+    if (negate) result.flip();
+    return result;
+}
+
+/// @brief Looks up a comparison on a text column in its posting lists.
+/// @param col
+/// @param idx
+/// @param op
+/// @param v
+/// @return bitmap
+inline bitmap index_lookup(const text_column& col, const posting_lists& idx,
+                           comparison_op op, const string& v) {
+    const size_t n = col.codes.size();
+    const bool negate = op == comparison_op::not_equal_to;
+    const auto [first, last] = code_range(
+        col.dictionary, negate ? comparison_op::equal_to : op, v);
+    bitmap result = bitmap::from_ids(n, idx.range(first, last));
+    if (negate) result.flip();
+    return result;
+}
+
+/// @brief Counts the rows that index_lookup() would select for a numeric
+/// column, without building the bitmap.
+/// @tparam T
+/// @param col
+/// @param idx
+/// @param op
+/// @param v
+/// @return Number of rows.
+template <typename T>
+size_t index_count(const typed_column<T>& col, const sorted_index<T>& idx,
+                   comparison_op op, T v) {
+    const bool negate = op == comparison_op::not_equal_to;
+    const auto [first, last] =
+        sorted_range(col, idx, negate ? comparison_op::equal_to : op, v);
+    return negate ? col.values.size() - (last - first) : last - first;
+}
+
+/// @brief Counts the rows that index_lookup() would select for a text
+/// column, without building the bitmap.
+/// @param col
+/// @param idx
+/// @param op
+/// @param v
+/// @return Number of rows.
+inline size_t index_count(const text_column& col, const posting_lists& idx,
+                          comparison_op op, const string& v) {
+    const bool negate = op == comparison_op::not_equal_to;
+    const auto [first, last] = code_range(
+        col.dictionary, negate ? comparison_op::equal_to : op, v);
+    const size_t matches = idx.count(first, last);
+    return negate ? col.codes.size() - matches : matches;
+}
+
+/// @brief Looks up the rows that have any of the given tags.
+/// @param col
+/// @param idx
+/// @param tags
+/// @return bitmap
+inline bitmap index_lookup(const tags_column& col, const posting_lists& idx,
+                           const vector<string>& tags) {
+    bitmap result(col.present.size());
+    for (const string& tag : tags) {
+        const auto [first, last] =
+            code_range(col.dictionary, comparison_op::equal_to, tag);
+        for (const auto r : idx.range(first, last)) result.set(r);
+    }
+    return result;
+}
+
+}  // namespace jt
@@ -0,0 +1,196 @@
+#pragma once
+
+// Statistics about the columns in a column_store, used by the query planner
+// to estimate how many rows a clause will match.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "column_index.hpp"
+#include "columns.hpp"
+#include "predicate.hpp"
+
+namespace jt {
+using std::vector;
+
+/// @brief Equi-width histogram of a numeric column's values.
+struct histogram {
+    /// @brief Number of buckets used for every histogram.
+    static constexpr size_t bucket_count{64};
+
+    double min{0.0};
+    double max{0.0};
+
+    /// @brief Number of values in each bucket.
+    vector<std::uint32_t> counts{};
+
+    /// @brief Number of different values in each bucket.
+    vector<std::uint32_t> distinct{};
+
+    /// @brief The bucket a value belongs in; values outside [min, max] go in
+    /// the first or last bucket.
+    size_t bucket_for(double v) const noexcept {
+        if (!(max > min) || v <= min) return 0;
+        if (v >= max) return counts.size() - 1;
+        const auto b = static_cast<size_t>((v - min) / (max - min) *
+                                           static_cast<double>(counts.size()));
+        return std::min(b, counts.size() - 1);
+    }
+
+    /// @brief Estimated number of values less than v.
+    double estimate_below(double v) const noexcept {
+        if (counts.empty() || v <= min) return 0.0;
+        double result = 0.0;
+        if (v > max) {
+            for (const auto c : counts) result += c;
+            return result;
+        }
+        const size_t b = bucket_for(v);
+        for (size_t i = 0; i < b; ++i) result += counts[i];
+        // Assume the bucket's values are spread evenly through it, and leave
+        // out the ones equal to v.
+        const double width = (max - min) / static_cast<double>(counts.size());
+        const double bucket_lo = min + width * static_cast<double>(b);
+        const double fraction =
+            width > 0.0 ? std::clamp((v - bucket_lo) / width, 0.0, 1.0) : 0.0;
+        return result + (counts[b] - estimate_equal(v)) * fraction;
+    }
+
+    /// @brief Estimated number of values equal to v.
+    double estimate_equal(double v) const noexcept {
+        if (counts.empty() || v < min || v > max) return 0.0;
+        const size_t b = bucket_for(v);
+        if (distinct[b] == 0) return 0.0;
+        return static_cast<double>(counts[b]) / distinct[b];
+    }
+
+    /// @brief Estimated number of values v that satisfy "value op v".
+    double estimate(comparison_op op, double v) const noexcept {
+        double total = 0.0;
+        for (const auto c : counts) total += c;
+        const double below = estimate_below(v);
+        const double equal = estimate_equal(v);
+        switch (op) {
+            case comparison_op::less:
+                return below;
+            case comparison_op::less_equal:
+                return std::min(total, below + equal);
+            case comparison_op::greater:
+                return std::max(0.0, total - below - equal);
+            case comparison_op::greater_equal:
+                return std::max(0.0, total - below);
+            case comparison_op::not_equal_to:
+                return total - equal;
+            default:
+                return equal;
+        }
+    }
+
+    /// @brief Builds a histogram from a column and its sorted index.
+    /// @tparam T
+    /// @param col
+    /// @param idx
+    /// @return histogram
+    template <typename T>
+    static histogram make(const typed_column<T>& col,
+                          const sorted_index<T>& idx) {
+        histogram result{};
+        if (idx.order.empty()) return result;
+        result.min = col.values[idx.order.front()];
+        result.max = col.values[idx.order.back()];
+        result.counts.assign(bucket_count, 0);
+        result.distinct.assign(bucket_count, 0);
+        bool first = true;
+        T previous{};
+        for (const auto r : idx.order) {
+            const T v = col.values[r];
+            const size_t b = result.bucket_for(static_cast<double>(v));
+            ++result.counts[b];
+            if (first || v != previous) ++result.distinct[b];
+            first = false;
+            previous = v;
+        }
+        return result;
+    }
+};
+
+/// @brief Bounding box of a coordinate column.
+struct geo_bounds {
+    float latitude_min{0.0f};
+    float latitude_max{0.0f};
+    float longitude_min{0.0f};
+    float longitude_max{0.0f};
+};
+
+/// @brief Statistics for one column.
+struct column_stats {
+    size_t row_count{0};
+
+    /// @brief Number of rows with a value.
+    size_t present_count{0};
+
+    /// @brief Number of different values, where known.
+    size_t distinct_count{0};
+
+    /// @brief For integer and floating point columns.
+    std::optional<histogram> values_histogram{};
+
+    /// @brief For coordinate columns.
+    std::optional<geo_bounds> bounds{};
+
+    template <typename T>
+    static column_stats make(const typed_column<T>& col,
+                             const sorted_index<T>& idx) {
+        column_stats result{col.values.size(), idx.order.size()};
+        result.values_histogram = histogram::make(col, idx);
+        for (const auto d : result.values_histogram->distinct) {
+            result.distinct_count += d;
+        }
+        return result;
+    }
+
+    static column_stats make(const boolean_column& col) {
+        const size_t present = col.present.count();
+        const size_t trues = col.values.count();
+        return column_stats{col.present.size(), present,
+                            static_cast<size_t>(trues > 0) +
+                                static_cast<size_t>(present > trues)};
+    }
+
+    static column_stats make(const text_column& col) {
+        return column_stats{col.codes.size(), col.present.count(),
+                            col.dictionary.size()};
+    }
+
+    static column_stats make(const tags_column& col) {
+        return column_stats{col.present.size(), col.present.count(),
+                            col.dictionary.size()};
+    }
+
+    static column_stats make(const coordinate_column& col) {
+        column_stats result{col.latitudes.size(), col.present.count()};
+        bool first = true;
+        geo_bounds box{};
+        col.present.for_each_set([&](size_t r) {
+            const float lat = col.latitudes[r];
+            const float lon = col.longitudes[r];
+            if (first) {
+                box = geo_bounds{lat, lat, lon, lon};
+                first = false;
+                return;
+            }
+            box.latitude_min = std::min(box.latitude_min, lat);
+            box.latitude_max = std::max(box.latitude_max, lat);
+            box.longitude_min = std::min(box.longitude_min, lon);
+            box.longitude_max = std::max(box.longitude_max, lon);
+        });
+        if (!first) result.bounds = box;
+        return result;
+    }
+};
+
+}  // namespace jt
@@ -0,0 +1,1049 @@
+#pragma once
+
+// Column-oriented copy of a table's data.
+// Integer, floating point and boolean values are kept in contiguous arrays,
+// one per column, so that a query can compare a whole column at once with
+// the kernels in simd_kernels.hpp. Text is dictionary encoded, so text
+// comparisons become integer comparisons of codes. Whether a cell has a value
+// is kept in a separate bitmap for each column.
+// Each column also gets statistics (column_stats.hpp) and, where one helps,
+// an index (column_index.hpp).
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "cell.hpp"
+#include "column_index.hpp"
+#include "column_stats.hpp"
+#include "columns.hpp"
+#include "contains.hpp"
+#include "coordinates.hpp"
+#include "parser.hpp"
+#include "predicate.hpp"
+#include "scheduler.hpp"
+#include "simd_kernels.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief Column-oriented copy of a table's cells.
+class column_store {
+   public:
+    /// @brief One column. Column types that are not stored yet are
+    /// represented by std::monostate.
+    using column =
+        std::variant<std::monostate, integer_column, floating_column,
+                     boolean_column, text_column, coordinate_column,
+                     tags_column>;
+
+   private:
+    vector<column> columns_{};
+    vector<column_stats> stats_{};
+    vector<column_index> indexes_{};
+    size_t row_count_{0};
+    std::uint64_t generation_{0};
+
+    /// @brief A number that no other column store made by this process has.
+    static std::uint64_t next_generation() noexcept {
+        static std::atomic<std::uint64_t> counter{0};
+        return ++counter;
+    }
+
+   public:
+    /// @brief Default constructor; no columns and no rows.
+    column_store() noexcept = default;
+
+    /// @brief Builds the columns for the given header fields and rows. Each
+    /// column, with its index and statistics, is built as a separate task.
+    /// @param hfs
+    /// @param rws
+    /// @param sched
+    /// @return Shared, immutable column store.
+    static std::shared_ptr<const column_store> make(
+        const parser::header_fields_t& hfs, const vector<row>& rws,
+        scheduler& sched = scheduler::shared()) {
+        auto result = std::make_shared<column_store>();
+        result->row_count_ = rws.size();
+        result->generation_ = next_generation();
+        result->columns_.resize(hfs.size());
+        result->stats_.resize(hfs.size());
+        result->indexes_.resize(hfs.size());
+        sched.parallel_for(hfs.size(), [&](size_t col_idx) {
+            column& col = result->columns_[col_idx];
+            col = make_column(hfs[col_idx].data_type, col_idx, rws);
+            result->indexes_[col_idx] = make_index(col);
+            result->stats_[col_idx] =
+                make_stats(col, result->indexes_[col_idx]);
+        });
+        return result;
+    }
+
+    /// @brief Builds the columns for rows added after the rows of this
+    /// store. Numeric, boolean and coordinate columns are copied and
+    /// extended, and the new rows are merged into their sorted indexes. Text
+    /// and tags columns are extended the same way while the new rows only
+    /// hold values already in their dictionaries; a new value changes the
+    /// codes of the values after it, so such a column is rebuilt instead.
+    /// Statistics are worked out again for every column.
+    /// @param hfs
+    /// @param rws All the rows, this store's first.
+    /// @param sched
+    /// @return Shared, immutable column store with a new generation.
+    std::shared_ptr<const column_store> appended(
+        const parser::header_fields_t& hfs, const vector<row>& rws,
+        scheduler& sched = scheduler::shared()) const {
+        auto result = std::make_shared<column_store>();
+        result->row_count_ = rws.size();
+        result->generation_ = next_generation();
+        result->columns_.resize(hfs.size());
+        result->stats_.resize(hfs.size());
+        result->indexes_.resize(hfs.size());
+        sched.parallel_for(hfs.size(), [&](size_t col_idx) {
+            column& col = result->columns_[col_idx];
+            column_index& idx = result->indexes_[col_idx];
+            bool extended = false;
+            if (col_idx < columns_.size()) {
+                col = columns_[col_idx];
+                idx = indexes_[col_idx];
+                extended = extend_column(col, idx, col_idx, rws);
+            }
+            if (!extended) {
+                col = make_column(hfs[col_idx].data_type, col_idx, rws);
+                idx = make_index(col);
+            }
+            result->stats_[col_idx] = make_stats(col, idx);
+        });
+        return result;
+    }
+
+    /// @brief Builds the columns for an edited version of this store's rows,
+    /// where most rows are unchanged copies of old ones, such as after a
+    /// file with a few changed lines is read again. The unchanged rows'
+    /// values are copied from the old columns, and keep their order in the
+    /// sorted indexes; only the other rows' values are read from the cells
+    /// and sorted. Text and tags columns keep their dictionaries, unless a
+    /// row brings a value the dictionary does not have or the last row with
+    /// a value is gone; such a column is built again, as is one that is not
+    /// in this store.
+    /// @param hfs
+    /// @param rws All the rows of the new version.
+    /// @param source For each row, the row of this store it is a copy of, or
+    /// no_row; the rows copied are in increasing order.
+    /// @param sched
+    /// @return Shared, immutable column store with a new generation.
+    std::shared_ptr<const column_store> edited(
+        const parser::header_fields_t& hfs, const vector<row>& rws,
+        std::span<const std::uint32_t> source,
+        scheduler& sched = scheduler::shared()) const {
+        vector<std::uint32_t> moved_to(row_count_, no_row);
+        for (size_t r = 0; r < source.size(); ++r) {
+            if (source[r] != no_row) {
+                moved_to[source[r]] = static_cast<std::uint32_t>(r);
+            }
+        }
+        auto result = std::make_shared<column_store>();
+        result->row_count_ = rws.size();
+        result->generation_ = next_generation();
+        result->columns_.resize(hfs.size());
+        result->stats_.resize(hfs.size());
+        result->indexes_.resize(hfs.size());
+        sched.parallel_for(hfs.size(), [&](size_t col_idx) {
+            column& col = result->columns_[col_idx];
+            column_index& idx = result->indexes_[col_idx];
+            const bool edited =
+                col_idx < columns_.size() &&
+                edit_column(columns_[col_idx], indexes_[col_idx], col, idx,
+                            col_idx, rws, source, moved_to);
+            if (!edited) {
+                col = make_column(hfs[col_idx].data_type, col_idx, rws);
+                idx = make_index(col);
+            }
+            result->stats_[col_idx] = make_stats(col, idx);
+        });
+        return result;
+    }
+
+    /// @brief Number of rows in every column.
+    constexpr size_t row_count() const noexcept { return row_count_; }
+
+    /// @brief Identifies this version of the data; every column store made
+    /// gets a new generation, so results computed from one store are never
+    /// mistaken for another's.
+    constexpr std::uint64_t generation() const noexcept { return generation_; }
+
+    /// @brief Number of columns.
+    size_t column_count() const noexcept { return columns_.size(); }
+
+    /// @brief The column at the given index.
+    /// @param col_idx
+    /// @return const reference to the column.
+    const column& at(size_t col_idx) const { return columns_.at(col_idx); }
+
+    /// @brief The column at the given index if it is stored as type C.
+    /// @tparam C One of the column types.
+    /// @param col_idx
+    /// @return Pointer to the column, or nullptr.
+    template <class C>
+    const C* get_if(size_t col_idx) const noexcept {
+        if (col_idx >= columns_.size()) return nullptr;
+        return std::get_if<C>(&columns_[col_idx]);
+    }
+
+    /// @brief Statistics for the column at the given index.
+    /// @param col_idx
+    /// @return const reference to the column's statistics.
+    const column_stats& stats(size_t col_idx) const {
+        return stats_.at(col_idx);
+    }
+
+    /// @brief The index for the column at the given index if it is of type I.
+    /// @tparam I posting_lists or sorted_index<T>.
+    /// @param col_idx
+    /// @return Pointer to the index, or nullptr.
+    template <class I>
+    const I* get_index_if(size_t col_idx) const noexcept {
+        if (col_idx >= indexes_.size()) return nullptr;
+        return std::get_if<I>(&indexes_[col_idx]);
+    }
+
+   private:
+    // The extend_ functions fill in a column's rows from the number it
+    // already has up to the end of rws, so that one code builds a column
+    // from nothing and adds appended rows to a copy of one.
+
+    template <typename T, typename Column>
+    static void extend_typed_column(Column& col, size_t col_idx,
+                                    const vector<row>& rws) {
+        const size_t first = col.values.size();
+        col.values.resize(rws.size());
+        col.present.resize(rws.size());
+        for (size_t r = first; r < rws.size(); ++r) {
+            if (col_idx >= rws[r].size()) continue;
+            const cell_value_type& cvt = rws[r][col_idx].value;
+            if (!cvt) continue;
+            if (const T* v = std::get_if<T>(&*cvt)) {
+                col.values[r] = *v;
+                col.present.set(r);
+            }
+        }
+    }
+
+    template <typename T, typename Column>
+    static Column make_typed_column(size_t col_idx, const vector<row>& rws) {
+        Column col{};
+        extend_typed_column<T>(col, col_idx, rws);
+        return col;
+    }
+
+    static void extend_boolean_column(boolean_column& col, size_t col_idx,
+                                      const vector<row>& rws) {
+        const size_t first = col.present.size();
+        col.values.resize(rws.size());
+        col.present.resize(rws.size());
+        for (size_t r = first; r < rws.size(); ++r) {
+            if (col_idx >= rws[r].size()) continue;
+            const cell_value_type& cvt = rws[r][col_idx].value;
+            if (!cvt) continue;
+            if (const bool* v = std::get_if<bool>(&*cvt)) {
+                if (*v) col.values.set(r);
+                col.present.set(r);
+            }
+        }
+    }
+
+    static boolean_column make_boolean_column(size_t col_idx,
+                                              const vector<row>& rws) {
+        boolean_column col{};
+        extend_boolean_column(col, col_idx, rws);
+        return col;
+    }
+
+    /// @brief Sorts and removes duplicates from a dictionary.
+    static void finish_dictionary(vector<string>& dictionary) {
+        std::ranges::sort(dictionary);
+        const auto dups = std::ranges::unique(dictionary);
+        dictionary.erase(dups.begin(), dups.end());
+    }
+
+    static std::uint32_t code_for(const vector<string>& dictionary,
+                                  const string& s) {
+        const auto it = std::ranges::lower_bound(dictionary, s);
+        return static_cast<std::uint32_t>(it - dictionary.begin());
+    }
+
+    static text_column make_text_column(size_t col_idx,
+                                        const vector<row>& rws) {
+        static const string no_text{};
+        text_column col{};
+        col.present = bitmap(rws.size());
+        vector<const string*> cells(rws.size(), &no_text);
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (col_idx >= rws[r].size()) continue;
+            const cell_value_type& cvt = rws[r][col_idx].value;
+            if (!cvt) continue;
+            if (const string* v = std::get_if<string>(&*cvt)) {
+                cells[r] = v;
+                col.present.set(r);
+            }
+        }
+
+        col.dictionary.reserve(rws.size() + 1);
+        col.dictionary.push_back(no_text);
+        for (const string* s : cells) col.dictionary.push_back(*s);
+        finish_dictionary(col.dictionary);
+
+        col.codes.resize(rws.size());
+        for (size_t r = 0; r < rws.size(); ++r) {
+            col.codes[r] =
+                static_cast<std::int32_t>(code_for(col.dictionary, *cells[r]));
+        }
+        return col;
+    }
+
+    /// @brief Adds the text of the rows after the column's last row, if it
+    /// is all in the dictionary already.
+    /// @param col
+    /// @param col_idx
+    /// @param rws
+    /// @param codes Set to the new rows' codes.
+    /// @return false, leaving col part way, if a row has new text.
+    static bool extend_text_column(text_column& col, size_t col_idx,
+                                   const vector<row>& rws,
+                                   vector<std::uint32_t>& codes) {
+        static const string no_text{};
+        const size_t first = col.codes.size();
+        col.present.resize(rws.size());
+        for (size_t r = first; r < rws.size(); ++r) {
+            const string* text = &no_text;
+            if (col_idx < rws[r].size() && rws[r][col_idx].value) {
+                if (const string* v =
+                        std::get_if<string>(&*rws[r][col_idx].value)) {
+                    text = v;
+                    col.present.set(r);
+                }
+            }
+            const std::uint32_t code = code_for(col.dictionary, *text);
+            if (code >= col.dictionary.size() ||
+                col.dictionary[code] != *text) {
+                return false;
+            }
+            codes.push_back(code);
+            col.codes.push_back(static_cast<std::int32_t>(code));
+        }
+        return true;
+    }
+
+    /// @brief Adds the tags of the rows after the column's last row, if
+    /// they are all in the dictionary already.
+    /// @param col
+    /// @param col_idx
+    /// @param rws
+    /// @param ids Set to the new rows' tag ids, in row order.
+    /// @param id_rows Set to the row of each id.
+    /// @return false, leaving col part way, if a row has a new tag.
+    static bool extend_tags_column(tags_column& col, size_t col_idx,
+                                   const vector<row>& rws,
+                                   vector<std::uint32_t>& ids,
+                                   vector<std::uint32_t>& id_rows) {
+        using tags_t = vector<string>;
+        if (col.offsets.empty()) col.offsets.push_back(0);
+        const size_t first = col.offsets.size() - 1;
+        col.present.resize(rws.size());
+        for (size_t r = first; r < rws.size(); ++r) {
+            if (col_idx < rws[r].size() && rws[r][col_idx].value) {
+                if (const tags_t* v =
+                        std::get_if<tags_t>(&*rws[r][col_idx].value)) {
+                    col.present.set(r);
+                    for (const string& tag : *v) {
+                        const std::uint32_t id = code_for(col.dictionary, tag);
+                        if (id >= col.dictionary.size() ||
+                            col.dictionary[id] != tag) {
+                            return false;
+                        }
+                        col.tag_ids.push_back(id);
+                        ids.push_back(id);
+                        id_rows.push_back(static_cast<std::uint32_t>(r));
+                    }
+                }
+            }
+            col.offsets.push_back(
+                static_cast<std::uint32_t>(col.tag_ids.size()));
+        }
+        return true;
+    }
+
+    static void extend_coordinate_column(coordinate_column& col,
+                                         size_t col_idx,
+                                         const vector<row>& rws) {
+        const size_t first = col.latitudes.size();
+        col.latitudes.resize(rws.size());
+        col.longitudes.resize(rws.size());
+        col.present.resize(rws.size());
+        for (size_t r = first; r < rws.size(); ++r) {
+            if (col_idx >= rws[r].size()) continue;
+            const cell_value_type& cvt = rws[r][col_idx].value;
+            if (!cvt) continue;
+            if (const coordinate* v = std::get_if<coordinate>(&*cvt)) {
+                col.latitudes[r] = v->latitude;
+                col.longitudes[r] = v->longitude;
+                col.present.set(r);
+            }
+        }
+    }
+
+    static coordinate_column make_coordinate_column(size_t col_idx,
+                                                    const vector<row>& rws) {
+        coordinate_column col{};
+        extend_coordinate_column(col, col_idx, rws);
+        return col;
+    }
+
+    static tags_column make_tags_column(size_t col_idx,
+                                        const vector<row>& rws) {
+        using tags_t = vector<string>;
+        tags_column col{};
+        col.present = bitmap(rws.size());
+        vector<const tags_t*> cells(rws.size(), nullptr);
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (col_idx >= rws[r].size()) continue;
+            const cell_value_type& cvt = rws[r][col_idx].value;
+            if (!cvt) continue;
+            if (const tags_t* v = std::get_if<tags_t>(&*cvt)) {
+                cells[r] = v;
+                col.present.set(r);
+                col.dictionary.insert(col.dictionary.end(), v->begin(),
+                                      v->end());
+            }
+        }
+        finish_dictionary(col.dictionary);
+
+        col.offsets.reserve(rws.size() + 1);
+        col.offsets.push_back(0);
+        for (const tags_t* tags : cells) {
+            if (tags) {
+                for (const string& tag : *tags) {
+                    col.tag_ids.push_back(code_for(col.dictionary, tag));
+                }
+            }
+            col.offsets.push_back(
+                static_cast<std::uint32_t>(col.tag_ids.size()));
+        }
+        return col;
+    }
+
+    static column_index make_index(const column& col) {
+        if (const auto* c = std::get_if<integer_column>(&col)) {
+            return sorted_index<std::int32_t>::make(*c);
+        }
+        if (const auto* c = std::get_if<floating_column>(&col)) {
+            return sorted_index<float>::make(*c);
+        }
+        if (const auto* c = std::get_if<text_column>(&col)) {
+            return posting_lists::from_codes(c->codes, c->dictionary.size());
+        }
+        if (const auto* c = std::get_if<tags_column>(&col)) {
+            return posting_lists::from_tags(*c);
+        }
+        return std::monostate{};
+    }
+
+    static column_stats make_stats(const column& col,
+                                   const column_index& idx) {
+        if (const auto* c = std::get_if<integer_column>(&col)) {
+            return column_stats::make(
+                *c, std::get<sorted_index<std::int32_t>>(idx));
+        }
+        if (const auto* c = std::get_if<floating_column>(&col)) {
+            return column_stats::make(*c, std::get<sorted_index<float>>(idx));
+        }
+        return std::visit(
+            [](const auto& c) -> column_stats {
+                using C = std::decay_t<decltype(c)>;
+                if constexpr (std::is_same_v<C, std::monostate> ||
+                              std::is_same_v<C, integer_column> ||
+                              std::is_same_v<C, floating_column>) {
+                    return column_stats{};
+                } else {
+                    return column_stats::make(c);
+                }
+            },
+            col);
+    }
+
+    /// @brief Extends a copy of a column, and its index, to all of rws.
+    /// @param col
+    /// @param idx
+    /// @param col_idx
+    /// @param rws
+    /// @return false if the column has to be rebuilt instead.
+    static bool extend_column(column& col, column_index& idx, size_t col_idx,
+                              const vector<row>& rws) {
+        if (auto* c = std::get_if<integer_column>(&col)) {
+            const size_t first = c->values.size();
+            extend_typed_column<int>(*c, col_idx, rws);
+            idx = sorted_index<std::int32_t>::appended(
+                std::get<sorted_index<std::int32_t>>(idx), *c, first);
+        } else if (auto* c = std::get_if<floating_column>(&col)) {
+            const size_t first = c->values.size();
+            extend_typed_column<float>(*c, col_idx, rws);
+            idx = sorted_index<float>::appended(
+                std::get<sorted_index<float>>(idx), *c, first);
+        } else if (auto* c = std::get_if<boolean_column>(&col)) {
+            extend_boolean_column(*c, col_idx, rws);
+        } else if (auto* c = std::get_if<coordinate_column>(&col)) {
+            extend_coordinate_column(*c, col_idx, rws);
+        } else if (auto* c = std::get_if<text_column>(&col)) {
+            const auto first = static_cast<std::uint32_t>(c->codes.size());
+            vector<std::uint32_t> codes{};
+            if (!extend_text_column(*c, col_idx, rws, codes)) return false;
+            vector<std::uint32_t> code_rows(codes.size());
+            std::iota(code_rows.begin(), code_rows.end(), first);
+            idx = posting_lists::appended(std::get<posting_lists>(idx), codes,
+                                          code_rows);
+        } else if (auto* c = std::get_if<tags_column>(&col)) {
+            vector<std::uint32_t> ids{};
+            vector<std::uint32_t> id_rows{};
+            if (!extend_tags_column(*c, col_idx, rws, ids, id_rows)) {
+                return false;
+            }
+            idx = posting_lists::appended(std::get<posting_lists>(idx), ids,
+                                          id_rows);
+        }
+        return true;
+    }
+
+    // The edit_ functions build a column for an edited version of the rows,
+    // copying the values of the rows that are unchanged copies of old rows
+    // from the old column, and reading only the other rows' cells.
+
+    /// @brief The value of type V in a cell, if it has one.
+    template <typename V>
+    static const V* cell_value(const vector<row>& rws, size_t r,
+                               size_t col_idx) {
+        if (col_idx >= rws[r].size()) return nullptr;
+        const cell_value_type& cvt = rws[r][col_idx].value;
+        return cvt ? std::get_if<V>(&*cvt) : nullptr;
+    }
+
+    template <typename V, typename T>
+    static void edit_typed_column(const typed_column<T>& old,
+                                  const sorted_index<T>& old_idx,
+                                  typed_column<T>& col, sorted_index<T>& idx,
+                                  size_t col_idx, const vector<row>& rws,
+                                  std::span<const std::uint32_t> source,
+                                  std::span<const std::uint32_t> moved_to) {
+        col.values.assign(rws.size(), T{});
+        col.present = bitmap(rws.size());
+        vector<std::uint32_t> added{};
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (const std::uint32_t s = source[r]; s != no_row) {
+                col.values[r] = old.values[s];
+                if (old.present.test(s)) col.present.set(r);
+            } else if (const V* v = cell_value<V>(rws, r, col_idx)) {
+                col.values[r] = *v;
+                col.present.set(r);
+                added.push_back(static_cast<std::uint32_t>(r));
+            }
+        }
+        idx = sorted_index<T>::edited(old_idx, col, moved_to,
+                                      std::move(added));
+    }
+
+    static void edit_boolean_column(const boolean_column& old,
+                                    boolean_column& col, size_t col_idx,
+                                    const vector<row>& rws,
+                                    std::span<const std::uint32_t> source) {
+        col.values = bitmap(rws.size());
+        col.present = bitmap(rws.size());
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (const std::uint32_t s = source[r]; s != no_row) {
+                if (old.values.test(s)) col.values.set(r);
+                if (old.present.test(s)) col.present.set(r);
+            } else if (const bool* v = cell_value<bool>(rws, r, col_idx)) {
+                if (*v) col.values.set(r);
+                col.present.set(r);
+            }
+        }
+    }
+
+    static void edit_coordinate_column(const coordinate_column& old,
+                                       coordinate_column& col, size_t col_idx,
+                                       const vector<row>& rws,
+                                       std::span<const std::uint32_t> source) {
+        col.latitudes.assign(rws.size(), 0.0f);
+        col.longitudes.assign(rws.size(), 0.0f);
+        col.present = bitmap(rws.size());
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (const std::uint32_t s = source[r]; s != no_row) {
+                col.latitudes[r] = old.latitudes[s];
+                col.longitudes[r] = old.longitudes[s];
+                if (old.present.test(s)) col.present.set(r);
+            } else if (const coordinate* v =
+                           cell_value<coordinate>(rws, r, col_idx)) {
+                col.latitudes[r] = v->latitude;
+                col.longitudes[r] = v->longitude;
+                col.present.set(r);
+            }
+        }
+    }
+
+    /// @brief Whether a dictionary has a value that no row has any more,
+    /// which building the column again would leave out.
+    /// @param idx
+    /// @param always_code A code every dictionary has, used or not.
+    static bool has_unused_code(const posting_lists& idx,
+                                size_t always_code = no_row) {
+        for (size_t c = 0; c < idx.code_count(); ++c) {
+            if (c != always_code && idx.count(c, c + 1) == 0) return true;
+        }
+        return false;
+    }
+
+    /// @return false if a row has text the dictionary does not, or no row
+    /// has some text in it any more.
+    static bool edit_text_column(const text_column& old, text_column& col,
+                                 posting_lists& idx, size_t col_idx,
+                                 const vector<row>& rws,
+                                 std::span<const std::uint32_t> source) {
+        static const string no_text{};
+        col.dictionary = old.dictionary;
+        col.codes.resize(rws.size());
+        col.present = bitmap(rws.size());
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (const std::uint32_t s = source[r]; s != no_row) {
+                col.codes[r] = old.codes[s];
+                if (old.present.test(s)) col.present.set(r);
+                continue;
+            }
+            const string* text = cell_value<string>(rws, r, col_idx);
+            if (text) col.present.set(r);
+            if (!text) text = &no_text;
+            const std::uint32_t code = code_for(col.dictionary, *text);
+            if (code >= col.dictionary.size() ||
+                col.dictionary[code] != *text) {
+                return false;
+            }
+            col.codes[r] = static_cast<std::int32_t>(code);
+        }
+        idx = posting_lists::from_codes(col.codes, col.dictionary.size());
+        return !has_unused_code(idx, code_for(col.dictionary, no_text));
+    }
+
+    /// @return false if a row has a tag the dictionary does not, or no row
+    /// has some tag any more.
+    static bool edit_tags_column(const tags_column& old, tags_column& col,
+                                 posting_lists& idx, size_t col_idx,
+                                 const vector<row>& rws,
+                                 std::span<const std::uint32_t> source) {
+        col.dictionary = old.dictionary;
+        col.present = bitmap(rws.size());
+        col.offsets.reserve(rws.size() + 1);
+        col.offsets.push_back(0);
+        for (size_t r = 0; r < rws.size(); ++r) {
+            if (const std::uint32_t s = source[r]; s != no_row) {
+                col.tag_ids.insert(
+                    col.tag_ids.end(), old.tag_ids.begin() + old.offsets[s],
+                    old.tag_ids.begin() + old.offsets[s + 1]);
+                if (old.present.test(s)) col.present.set(r);
+            } else if (const auto* tags =
+                           cell_value<vector<string>>(rws, r, col_idx)) {
+                col.present.set(r);
+                for (const string& tag : *tags) {
+                    const std::uint32_t id = code_for(col.dictionary, tag);
+                    if (id >= col.dictionary.size() ||
+                        col.dictionary[id] != tag) {
+                        return false;
+                    }
+                    col.tag_ids.push_back(id);
+                }
+            }
+            col.offsets.push_back(
+                static_cast<std::uint32_t>(col.tag_ids.size()));
+        }
+        idx = posting_lists::from_tags(col);
+        return !has_unused_code(idx);
+    }
+
+    /// @brief Builds a column, and its index, for an edited version of the
+    /// rows of an old one.
+    /// @return false if the column has to be built from the cells instead.
+    static bool edit_column(const column& old, const column_index& old_idx,
+                            column& col, column_index& idx, size_t col_idx,
+                            const vector<row>& rws,
+                            std::span<const std::uint32_t> source,
+                            std::span<const std::uint32_t> moved_to) {
+        if (const auto* c = std::get_if<integer_column>(&old)) {
+            integer_column edited{};
+            sorted_index<std::int32_t> edited_idx{};
+            edit_typed_column<int>(
+                *c, std::get<sorted_index<std::int32_t>>(old_idx), edited,
+                edited_idx, col_idx, rws, source, moved_to);
+            col = std::move(edited);
+            idx = std::move(edited_idx);
+        } else if (const auto* c = std::get_if<floating_column>(&old)) {
+            floating_column edited{};
+            sorted_index<float> edited_idx{};
+            edit_typed_column<float>(*c, std::get<sorted_index<float>>(old_idx),
+                                     edited, edited_idx, col_idx, rws, source,
+                                     moved_to);
+            col = std::move(edited);
+            idx = std::move(edited_idx);
+        } else if (const auto* c = std::get_if<boolean_column>(&old)) {
+            boolean_column edited{};
+            edit_boolean_column(*c, edited, col_idx, rws, source);
+            col = std::move(edited);
+        } else if (const auto* c = std::get_if<coordinate_column>(&old)) {
+            coordinate_column edited{};
+            edit_coordinate_column(*c, edited, col_idx, rws, source);
+            col = std::move(edited);
+        } else if (const auto* c = std::get_if<text_column>(&old)) {
+            text_column edited{};
+            posting_lists edited_idx{};
+            if (!edit_text_column(*c, edited, edited_idx, col_idx, rws,
+                                  source)) {
+                return false;
+            }
+            col = std::move(edited);
+            idx = std::move(edited_idx);
+        } else if (const auto* c = std::get_if<tags_column>(&old)) {
+            tags_column edited{};
+            posting_lists edited_idx{};
+            if (!edit_tags_column(*c, edited, edited_idx, col_idx, rws,
+                                  source)) {
+                return false;
+            }
+            col = std::move(edited);
+            idx = std::move(edited_idx);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static column make_column(e_cell_data_type ecdt, size_t col_idx,
+                              const vector<row>& rws) {
+        switch (ecdt) {
+            case e_cell_data_type::integer:
+                return make_typed_column<int, integer_column>(col_idx, rws);
+
+            case e_cell_data_type::floating:
+                return make_typed_column<float, floating_column>(col_idx,
+                                                                 rws);
+
+            case e_cell_data_type::boolean:
+                return make_boolean_column(col_idx, rws);
+
+            case e_cell_data_type::text:
+                return make_text_column(col_idx, rws);
+
+            case e_cell_data_type::geo_coordinate:
+                return make_coordinate_column(col_idx, rws);
+
+            case e_cell_data_type::tags:
+                return make_tags_column(col_idx, rws);
+
+            default:
+                return std::monostate{};
+        }
+    }
+};
+
+namespace {
+/// @brief Evaluates a boolean comparison for known operands.
+template <comparison_op Op>
+struct bool_compare {
+    static bool run(bool lhs, bool rhs) noexcept {
+        return predicate<bool, Op>{}(lhs, rhs);
+    }
+};
+
+constexpr auto bool_compare_table = make_dispatch_table<bool_compare>();
+}  // namespace
+
+/// @brief Applies a column's null mask to a comparison result.
+/// @param result Comparison result; changed in place.
+/// @param present Rows that have a value.
+/// @param empty_matches Whether rows without a value should be selected.
+inline void apply_null_mask(bitmap& result, const bitmap& present,
+                            bool empty_matches) {
+    result &= present;
+    if (empty_matches) {
+        bitmap absent{present};
+        result |= absent.flip();
+    }
+}
+
+/// @brief Calls fn(first_row, last_row) for each run of consecutive 64-row
+/// blocks that hold at least one candidate, or once for all n rows if
+/// candidates is null. first_row is always a multiple of 64, so the rows of
+/// a run line up with whole selection words.
+/// @tparam Fn
+/// @param n Number of rows.
+/// @param candidates Rows still in the running, or nullptr for all rows.
+/// @param fn
+template <class Fn>
+void for_each_candidate_run(size_t n, const bitmap* candidates, Fn&& fn) {
+    if (!candidates) {
+        if (n > 0) fn(size_t{0}, n);
+        return;
+    }
+    const auto words = candidates->words();
+    size_t wi = 0;
+    while (wi < words.size()) {
+        if (words[wi] == 0) {
+            ++wi;
+            continue;
+        }
+        const size_t first = wi;
+        while (wi < words.size() && words[wi] != 0) ++wi;
+        fn(first * bitmap::word_bits, std::min(n, wi * bitmap::word_bits));
+    }
+}
+
+/// @brief Runs compare_int32 on the blocks of rows that hold candidates.
+inline void compare_int32_runs(std::span<const std::int32_t> values,
+                               comparison_op op, std::int32_t query_value,
+                               bitmap& out, const bitmap* candidates) {
+    for_each_candidate_run(
+        values.size(), candidates, [&](size_t first, size_t last) {
+            compare_int32(values.subspan(first, last - first), op,
+                          query_value,
+                          out.words().subspan(first / bitmap::word_bits,
+                                              bitmap::words_for(last - first)));
+        });
+}
+
+/// @brief Runs compare_float on the blocks of rows that hold candidates.
+inline void compare_float_runs(std::span<const float> values, comparison_op op,
+                               float query_value, bitmap& out,
+                               const bitmap* candidates) {
+    for_each_candidate_run(
+        values.size(), candidates, [&](size_t first, size_t last) {
+            compare_float(values.subspan(first, last - first), op, query_value,
+                          out.words().subspan(first / bitmap::word_bits,
+                                              bitmap::words_for(last - first)));
+        });
+}
+
+// Each select_ function below takes an optional bitmap of candidate rows.
+// When given, only the blocks of rows holding candidates are examined, and
+// the result only contains candidates.
+
+/// @brief Selects the rows of an integer column that satisfy the comparison.
+/// An empty cell is not equal to anything.
+/// @param col
+/// @param op
+/// @param query_value
+/// @param candidates
+/// @return bitmap
+inline bitmap select_integer(const integer_column& col, comparison_op op,
+                             int query_value,
+                             const bitmap* candidates = nullptr) {
+    bitmap result(col.values.size());
+    compare_int32_runs(col.values, op, query_value, result, candidates);
+    apply_null_mask(result, col.present, op == comparison_op::not_equal_to);
+    if (candidates) result &= *candidates;
+    return result;
+}
+
+/// @brief Selects the rows of a floating point column that satisfy the
+/// comparison. An empty cell is not equal to anything.
+/// @param col
+/// @param op
+/// @param query_value
+/// @param candidates
+/// @return bitmap
+inline bitmap select_floating(const floating_column& col, comparison_op op,
+                              float query_value,
+                              const bitmap* candidates = nullptr) {
+    bitmap result(col.values.size());
+    compare_float_runs(col.values, op, query_value, result, candidates);
+    apply_null_mask(result, col.present, op == comparison_op::not_equal_to);
+    if (candidates) result &= *candidates;
+    return result;
+}
+
+/// @brief Selects the rows of a boolean column that satisfy the comparison.
+/// An empty cell counts as false.
+/// Since a cell can only be true or false, the comparison is worked out for
+/// both values once and the result is built from the column's bits.
+/// @param col
+/// @param op
+/// @param query_value
+/// @param candidates
+/// @return bitmap
+inline bitmap select_boolean(const boolean_column& col, comparison_op op,
+                             bool query_value,
+                             const bitmap* candidates = nullptr) {
+    const auto compare = bool_compare_table[dispatch_index(op)];
+    const bool true_matches = compare(true, query_value);
+    const bool false_matches = compare(false, query_value);
+
+    bitmap result(col.values.size(), false);
+    if (true_matches) result |= col.values;
+    if (false_matches) {
+        bitmap falses{col.values};
+        result |= falses.flip();
+    }
+    if (candidates) result &= *candidates;
+    return result;
+}
+
+/// @brief Selects the rows of a text column that satisfy the comparison.
+/// An empty cell counts as the empty string.
+/// The query value is located in the sorted dictionary once; the comparison
+/// is then done on the codes by the integer kernel.
+/// @param col
+/// @param op
+/// @param query_value
+/// @param candidates
+/// @return bitmap
+inline bitmap select_text(const text_column& col, comparison_op op,
+                          const string& query_value,
+                          const bitmap* candidates = nullptr) {
+    using co = comparison_op;
+    const auto it = std::ranges::lower_bound(col.dictionary, query_value);
+    const auto code = static_cast<std::int32_t>(it - col.dictionary.begin());
+    const bool found = it != col.dictionary.end() && *it == query_value;
+
+    const size_t n = col.codes.size();
+    if (!found) {
+        // code is where query_value would be inserted.
+        switch (op) {
+            case co::equal_to:
+                return bitmap(n);
+            case co::not_equal_to:
+                return candidates ? *candidates : bitmap(n, true);
+            case co::less_equal:
+                op = co::less;
+                break;
+            case co::greater:
+                op = co::greater_equal;
+                break;
+            default:
+                break;
+        }
+    }
+
+    bitmap result(n);
+    compare_int32_runs(col.codes, op, code, result, candidates);
+    if (candidates) result &= *candidates;
+    return result;
+}
+
+/// @brief Selects the rows of a coordinate column at (or, for !=, not at) the
+/// given coordinate. An empty cell is not equal to anything.
+/// @param col
+/// @param op equal_to or not_equal_to.
+/// @param query_value
+/// @param candidates
+/// @return bitmap
+inline bitmap select_coordinate(const coordinate_column& col, comparison_op op,
+                                const coordinate& query_value,
+                                const bitmap* candidates = nullptr) {
+    const size_t n = col.latitudes.size();
+    bitmap result(n);
+    compare_float_runs(col.latitudes, comparison_op::equal_to,
+                       query_value.latitude, result, candidates);
+    bitmap longitudes(n);
+    compare_float_runs(col.longitudes, comparison_op::equal_to,
+                       query_value.longitude, longitudes, candidates);
+    result &= longitudes;
+    result &= col.present;
+    if (op == comparison_op::not_equal_to) result.flip();
+    if (candidates) result &= *candidates;
+    return result;
+}
+
+/// @brief Selects the rows of a coordinate column that are inside a polygon.
+/// The polygon's bounding box is checked for the whole column first; the
+/// crossing test is only run on the rows inside the box.
+/// @param col
+/// @param polygn
+/// @param candidates
+/// @return bitmap
+inline bitmap select_inside(const coordinate_column& col,
+                            const polygon_t& polygn,
+                            const bitmap* candidates = nullptr) {
+    const size_t n = col.latitudes.size();
+    bitmap result(n);
+    if (polygn.size() < 3) return result;
+
+    const auto lats = std::ranges::minmax(polygn, {}, &coordinate::latitude);
+    const auto longs = std::ranges::minmax(polygn, {}, &coordinate::longitude);
+
+    bitmap box(n);
+    compare_float_runs(col.latitudes, comparison_op::greater_equal,
+                       lats.min.latitude, box, candidates);
+    bitmap bound(n);
+    compare_float_runs(col.latitudes, comparison_op::less_equal,
+                       lats.max.latitude, bound, candidates);
+    box &= bound;
+    compare_float_runs(col.longitudes, comparison_op::greater_equal,
+                       longs.min.longitude, bound, candidates);
+    box &= bound;
+    compare_float_runs(col.longitudes, comparison_op::less_equal,
+                       longs.max.longitude, bound, candidates);
+    box &= bound;
+    box &= col.present;
+    if (candidates) box &= *candidates;
+
+    box.for_each_set([&](size_t r) {
+        const coordinate point{coordinate::format::decimal, col.latitudes[r],
+                               col.longitudes[r]};
+        if (point_in_polygon_span(point, polygn)) {
+            result.set(r);
+        }
+    });
+    return result;
+}
+
+/// @brief Selects the rows of a tags column that have any of the given tags.
+/// @param col
+/// @param tags
+/// @param candidates
+/// @return bitmap
+inline bitmap select_tags(const tags_column& col, const vector<string>& tags,
+                          const bitmap* candidates = nullptr) {
+    const size_t n = col.present.size();
+    bitmap result(n);
+
+    vector<bool> wanted(col.dictionary.size(), false);
+    bool any_wanted = false;
+    for (const string& tag : tags) {
+        const auto it = std::ranges::lower_bound(col.dictionary, tag);
+        if (it != col.dictionary.end() && *it == tag) {
+            wanted[static_cast<size_t>(it - col.dictionary.begin())] = true;
+            any_wanted = true;
+        }
+    }
+    if (!any_wanted) return result;
+
+    auto check_row = [&](size_t r) {
+        for (auto i = col.offsets[r]; i < col.offsets[r + 1]; ++i) {
+            if (wanted[col.tag_ids[i]]) {
+                result.set(r);
+                return;
+            }
+        }
+    };
+    if (candidates) {
+        candidates->for_each_set(check_row);
+    } else {
+        for (size_t r = 0; r < n; ++r) check_row(r);
+    }
+    return result;
+}
+
+}  // namespace jt
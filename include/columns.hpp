@@ -0,0 +1,64 @@
+#pragma once
+
+// The column types kept by column_store. Each holds one column's values in
+// contiguous storage, and a bitmap of the rows that have a value.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief A column of fixed-size values, stored contiguously, and the rows
+/// that have a value. Rows without a value hold T{}.
+/// @tparam T
+template <typename T>
+struct typed_column {
+    vector<T> values{};
+    bitmap present{};
+};
+
+/// @brief Column of integers.
+using integer_column = typed_column<std::int32_t>;
+
+/// @brief Column of floating point numbers.
+using floating_column = typed_column<float>;
+
+/// @brief Column of booleans, stored as bits. Rows without a value are false.
+struct boolean_column {
+    bitmap values{};
+    bitmap present{};
+};
+
+/// @brief Column of text, dictionary encoded. The dictionary is sorted, so
+/// comparing two codes gives the same answer as comparing their strings.
+/// Rows without a value are stored as the empty string.
+struct text_column {
+    vector<string> dictionary{};
+    vector<std::int32_t> codes{};
+    bitmap present{};
+};
+
+/// @brief Column of geo-coordinates, as separate latitude and longitude
+/// arrays.
+struct coordinate_column {
+    vector<float> latitudes{};
+    vector<float> longitudes{};
+    bitmap present{};
+};
+
+/// @brief Column of tag lists. The tags of row r are
+/// tag_ids[offsets[r]] up to tag_ids[offsets[r + 1]], as indexes into the
+/// sorted dictionary.
+struct tags_column {
+    vector<string> dictionary{};
+    vector<std::uint32_t> offsets{};
+    vector<std::uint32_t> tag_ids{};
+    bitmap present{};
+};
+
+}  // namespace jt
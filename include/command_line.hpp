@@ -3,10 +3,13 @@
 // Class to do command-line I/O.
 
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <expected>
 #include <format>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <print>
 #include <regex>
@@ -14,10 +17,18 @@
 #include <utility>
 #include <vector>
 
+#include "aggregate.hpp"
+#include "bitmap.hpp"
+#include "catalog_files.hpp"
+#include "clause_cache.hpp"
 #include "command_handler.hpp"
 #include "coordinates.hpp"
 #include "dimroomConfig.h"
+#include "facets.hpp"
+#include "live_table.hpp"
 #include "query.hpp"
+#include "result_writer.hpp"
+#include "shard.hpp"
 #include "table.hpp"
 #include "utility.hpp"
 
@@ -40,21 +51,108 @@ using std::regex;
 using std::regex_match;
 namespace ranges = std::ranges;
 
-/// @brief Returns a polygon_t if parsing was successful, otherwise returns an error.
-using expected_polygon_t = std::expected<polygon_t, convert_error>;
+/// @brief Prints the rows of an aggregation, as the "aggregate" command
+/// does.
+/// @param out
+/// @param result
+/// @param rows Number of rows aggregated.
+void print_aggregate_result(std::FILE* out, const aggregate_result& result,
+                            size_t rows);
+
+/// @brief Prints facet counts, as the "facets" command does.
+/// @param out
+/// @param result
+void print_facet_result(std::FILE* out, const facet_result& result);
+
+/// @brief Prints how many rows each file of a catalog held, and how long it
+/// took to read.
+/// @param out
+/// @param loads
+void print_file_loads(std::FILE* out, const vector<file_load>& loads);
+
+/// @brief Settings taken from the program's arguments.
+struct program_options {
+    /// @brief The first of csv_filenames.
+    string csv_filename{};
+
+    /// @brief The CSV files the table is read from, or the directories and
+    /// patterns naming them; see catalog_files.hpp.
+    vector<string> csv_filenames{};
+
+    /// @brief Threads to use, counting the main thread; 0 means one per
+    /// hardware thread. Set with --threads N.
+    size_t threads{0};
+
+    /// @brief Memory budget of the query result cache, in MiB. Set with
+    /// --cache-mb N; 0 turns the cache off.
+    size_t cache_megabytes{clause_cache::default_budget >> 20};
+
+    /// @brief How query results are written. Set with
+    /// --format csv|tsv|jsonl.
+    output_format format{output_format::csv};
+
+    /// @brief Rows per page of query results; 0 prints them all at once.
+    /// Set with --page N.
+    size_t page_rows{0};
+
+    /// @brief File of queries to run without prompting; see batch.hpp. Set
+    /// with --batch FILE.
+    string batch_filename{};
+
+    /// @brief Directory the results of a batch are written to. Set with
+    /// --out DIR.
+    string out_directory{"."};
+
+    /// @brief Unix domain socket to answer commands on, instead of
+    /// prompting; see query_server.hpp. Set with --serve PATH.
+    string serve_socket{};
+
+    /// @brief Worker processes to split the table across, or 0 for none;
+    /// see shard.hpp. Set with --shards N.
+    size_t shards{0};
+
+    /// @brief How rows are assigned to shards. Set with
+    /// --shard-by filename|tile.
+    shard_key shard_by{shard_key::filename};
+
+    /// @brief The shard this process holds, as a worker. Set with
+    /// --shard I/N; the coordinator passes it to the workers it starts.
+    optional<shard_spec> shard{};
+
+    /// @brief Take the table from shared memory if another process has
+    /// published it, and publish it otherwise; see shared_catalog.hpp. Set
+    /// with --shm.
+    bool share_memory{false};
+
+    /// @brief Add the rows appended to the file while the program runs; see
+    /// table_follower.hpp. Set with --follow.
+    bool follow{false};
+
+    /// @brief Directory of images to make the table from, instead of a CSV
+    /// file; see image_scan.hpp. Set with --scan DIR.
+    string scan_directory{};
+};
 
 /// @brief Parses and interprets the command line.
 class command_line {
    public:
+    /// @brief Reads the program's arguments: options, then the CSV filenames.
+    /// @param argv
+    /// @return The options, or a message saying what was wrong.
+    std::expected<program_options, string> parse_options(
+        const vector<string>& argv) const;
+
     // This is intended to extract the name of the input CSV file from the
     // command line.
     optional<string> get_csv_filename(int argc, const vector<string>& argv) {
         if (argc <= 1) {
             return std::nullopt;
         }
-
-        const string filename{argv[1]};
-        return filename;
+        const auto options = parse_options(argv);
+        if (!options || options->csv_filename.empty()) {
+            return std::nullopt;
+        }
+        return options->csv_filename;
     }
 
    private:
@@ -69,6 +167,26 @@ class command_line {
         "\"query (\"column name\" tags \"tag1\", \"tag2\", ...)\" - look for "
         "tags "
         "in a column",
+        "\"query (...) order by \"column name\" [asc|desc] limit N\" - sort "
+        "the rows found and show the first N",
+        "\"refine (...) && (...)\" - apply more clauses to the previous "
+        "query's result",
+        "\"select \"column name\", ... where (...) && (...)\" - query, "
+        "printing only the named columns",
+        "\"count (...) && (...)\" - count the matching rows without printing "
+        "them",
+        "\"aggregate count, avg(\"column name\") group by \"column name\" "
+        "where (...)\" - summarize the matching rows",
+        "\tavailable aggregates are count, count(col), sum(col), avg(col), "
+        "min(col), max(col)",
+        "\"facets (...) && (...) by \"column name\", ... top N\" - count "
+        "the values of several columns over the matching rows",
+        "\"page N\" - print query results N rows at a time, asking before "
+        "each page; \"page 0\" prints them all at once",
+        "\"reload\" - read the file again; queries already running finish "
+        "with the data they started with",
+        "\"threads\" - show what each worker thread has done",
+        "\"cache\" - show how well the query result cache is doing",
         "\"exit\" - end program",
         "\"quit\" - end program",
         "\"help\" - print help message"};
@@ -76,44 +194,198 @@ class command_line {
     const regex quit_cmd_rx{R"(^\s*(quit|exit)\b.*)", regex::icase};
     const regex help_cmd_rx{R"(^\s*help\b.*)", regex::icase};
     const regex describe_cmd_rx{R"(^\s*describe\b.*)", regex::icase};
-    const regex query_cmd_rx{R"(^\s*query\b\s+\(.*)", regex::icase};
+    const regex query_cmd_rx{R"(^\s*(query|refine)\b\s+\(.*)", regex::icase};
+    const regex select_cmd_rx{R"(^\s*select\b\s+".*)", regex::icase};
+    const regex count_cmd_rx{R"(^\s*count\b\s+\(.*)", regex::icase};
+    const regex aggregate_cmd_rx{R"(^\s*aggregate\b.*)", regex::icase};
+    const regex facets_cmd_rx{R"(^\s*facets\b\s+\(.*)", regex::icase};
+    const regex reload_cmd_rx{R"(^\s*reload\s*$)", regex::icase};
+    const regex page_cmd_rx{R"(^\s*page\b.*)", regex::icase};
+    const regex threads_cmd_rx{R"(^\s*threads\b.*)", regex::icase};
+    const regex cache_cmd_rx{R"(^\s*cache\b.*)", regex::icase};
+
+    /// @brief Results of the clauses of recent queries; may be shared with
+    /// other sessions.
+    std::shared_ptr<clause_cache> cache_{std::make_shared<clause_cache>()};
+
+    /// @brief Recent facet counts.
+    facet_cache facets_{};
+
+    /// @brief How query results are written.
+    output_format format_{output_format::csv};
+
+    /// @brief Rows per page of query results; 0 turns paging off.
+    size_t page_rows_{0};
+
+    /// @brief Where results, and messages such as errors and timings, are
+    /// written.
+    std::FILE* out_{stdout};
+    std::FILE* err_{stderr};
+
+    /// @brief Whether a user at the terminal reads the output, so that it
+    /// can be paged.
+    bool interactive_{true};
+
+    /// @brief Rows asked of a row_cursor at a time when not paging.
+    static constexpr size_t rows_per_batch{4096};
+
+    /// @brief The previous query's clauses and result, so that a query that
+    /// only adds clauses can start from that result.
+    struct last_result {
+        std::uint64_t generation{0};
+        vector<clause_key> clauses{};
+        bitmap selection{};
+    };
+    optional<last_result> last_{};
 
     void print_help() const {
         ranges::for_each(help_strings,
-                         [](const string& s) { cerr << s << endl; });
+                         [this](const string& s) { println(err_, "{}", s); });
+    }
+
+    void describe_table(const table& t) {
+        ranges::for_each(t.header_fields_,
+                         [this](const parser::header_field& hf) {
+                             println(out_,
+                                     "Column Name: \"{}\"; Column Type : {}",
+                                     hf.text, hf.data_type);
+                         });
     }
 
-    void describe_table(table& t) {
-        ranges::for_each(t.header_fields_, [](const parser::header_field& hf) {
-            println("Column Name: \"{}\"; Column Type : {}", hf.text,
-                    hf.data_type);
-        });
+    /// @brief The query result cache, or nullptr if it is turned off.
+    clause_cache* active_cache() const {
+        return cache_->budget() > 0 ? cache_.get() : nullptr;
     }
 
+    /// @brief Prints the shared scheduler's per-worker counters.
+    void describe_threads() const;
+
+    /// @brief Prints the query result cache's counters.
+    void describe_cache() const;
+
    public:
-    /// @brief Experimental attempt to parse ANDed queries.
+    /// @brief Sets the query result cache's memory budget.
+    /// @param bytes 0 turns the cache off.
+    void set_cache_budget(size_t bytes) { cache_->set_budget(bytes); }
+
+    /// @brief Uses a query result cache shared with other sessions.
+    /// @param cache
+    void share_cache(std::shared_ptr<clause_cache> cache) {
+        cache_ = std::move(cache);
+    }
+
+    /// @brief Sets where results and messages are written. Output that is
+    /// not read at the terminal is never paged.
+    /// @param out
+    /// @param err
+    /// @param interactive
+    void set_output(std::FILE* out, std::FILE* err, bool interactive) noexcept {
+        out_ = out;
+        err_ = err;
+        interactive_ = interactive;
+    }
+
+    /// @brief Sets how query results are written.
+    /// @param format
+    void set_output_format(output_format format) noexcept { format_ = format; }
+
+    /// @brief Sets the rows per page of query results.
+    /// @param rows 0 turns paging off.
+    void set_page_rows(size_t rows) noexcept { page_rows_ = rows; }
+
+    /// @brief Runs every query of a batch file, writing each result to its
+    /// own file in the chosen format, named for the query's position in the
+    /// file (query-001.csv and so on).
+    /// @param t
+    /// @param batch_filename
+    /// @param out_directory Created if need be.
+    /// @return EXIT_SUCCESS, or EXIT_FAILURE if a query could not be run or
+    /// a result could not be written.
+    int run_batch(const table& t, const string& batch_filename,
+                  const string& out_directory) const;
+
+    /// @brief Handles the "reload" command: reads the table's file again,
+    /// and reports how long that took and the peak memory used.
+    /// @param tables
+    void do_reload(live_table& tables);
+
+    /// @brief Handles the "page" command: "page N" sets the rows per page,
+    /// and "page" alone shows it.
+    /// @param page_line
+    void do_page(const string& page_line);
+
+    /// @brief Parses, plans and runs a query, printing the matching rows as
+    /// they are found, a page at a time if paging is on; a select statement
+    /// prints only the columns it names.
     /// @param t
     /// @param query_line
-    void do_query(table& t, const string& query_line);
+    void do_query(const table& t, const string& query_line);
 
-  private:
-    table _do_one_query(const table& t, const string& query_clause);
+    /// @brief Parses, plans and runs a count statement, printing only the
+    /// number of matching rows.
+    /// @param t
+    /// @param count_line
+    void do_count(const table& t, const string& count_line);
 
-    table _do_one_query(table&& t, const string& query_clause);
+    /// @brief Parses, plans and runs an aggregate statement, printing one
+    /// row per group.
+    /// @param t
+    /// @param aggregate_line
+    void do_aggregate(const table& t, const string& aggregate_line);
 
-    /// @brief Take a query string and a set of current results and run the
-    /// query on those results.
+    /// @brief Parses, plans and runs a facets statement, printing the most
+    /// common values of each column.
     /// @param t
-    /// @param query_clause
-    /// @param rows_to_query
-    /// @return
-    template <class TABLE>
-    table do_one_query(TABLE&& t, const string& query_clause) {
-        return _do_one_query(std::forward<TABLE>(t), query_clause);
+    /// @param facets_line
+    void do_facets(const table& t, const string& facets_line);
+
+    /// @brief Runs one command, as typed at the prompt.
+    /// @param tables
+    /// @param input_line Trimmed.
+    /// @return false if the command was "quit" or "exit".
+    bool run_command(live_table& tables, const string& input_line) {
+        if (regex_match(input_line, quit_cmd_rx)) {
+            return false;
+        }
+        if (regex_match(input_line, reload_cmd_rx)) {
+            do_reload(tables);
+            return true;
+        }
+
+        // The whole command uses one version of the table, even if it is
+        // reloaded meanwhile.
+        const std::shared_ptr<const table> snapshot = tables.snapshot();
+        const table& table_to_use = *snapshot;
+
+        if (std::regex_match(input_line, help_cmd_rx)) {
+            print_help();
+        } else if (regex_match(input_line, describe_cmd_rx)) {
+            describe_table(table_to_use);
+        } else if (regex_match(input_line, query_cmd_rx)) {
+            do_query(table_to_use, input_line);
+        } else if (regex_match(input_line, select_cmd_rx)) {
+            do_query(table_to_use, input_line);
+        } else if (regex_match(input_line, count_cmd_rx)) {
+            do_count(table_to_use, input_line);
+        } else if (regex_match(input_line, aggregate_cmd_rx)) {
+            do_aggregate(table_to_use, input_line);
+        } else if (regex_match(input_line, facets_cmd_rx)) {
+            do_facets(table_to_use, input_line);
+        } else if (regex_match(input_line, page_cmd_rx)) {
+            do_page(input_line);
+        } else if (regex_match(input_line, threads_cmd_rx)) {
+            describe_threads();
+        } else if (regex_match(input_line, cache_cmd_rx)) {
+            describe_cache();
+        }
+
+        else {
+            println(out_, "command line \"{}\" not understood", input_line);
+        }
+        return true;
     }
 
-  public:
-    int read_eval_print(table& table_to_use) {
+    int read_eval_print(live_table& tables) {
         println(stderr, "Welcome to DimRoom");
         println(stderr, "Enter the command \"help\" for help.");
         const string prompt_str = std::format(
@@ -121,39 +393,15 @@ class command_line {
         while (auto line_input = lineread(prompt_str)) {
             string input_line{*line_input};
             trim(input_line);
-            if (regex_match(input_line, quit_cmd_rx)) {
+            if (!run_command(tables, input_line)) {
                 println("Goodbye.");
                 return EXIT_SUCCESS;
             }
-
-            if (std::regex_match(input_line, help_cmd_rx)) {
-                print_help();
-            } else if (regex_match(input_line, describe_cmd_rx)) {
-                describe_table(table_to_use);
-            } else if (regex_match(input_line, query_cmd_rx)) {
-                do_query(table_to_use, input_line);
-            }
-
-            else {
-                cout << "command line \"" << input_line << "\" not understood"
-                     << endl;
-            }
         }
 
         println("Goodbye.");
         return EXIT_SUCCESS;
     }
-
-    /// @brief Parses a query that does not involve geo-coordinates
-    /// @param t The table to query.
-    /// @param query_line
-    /// @return table::rows
-    jt::table::rows parse_non_poly_query(table& t, const string& query_line);
 };
 
-/// @brief Parses geo-coordinate points in a query
-/// @param query_line
-/// @return A polygon or an error.
-expected_polygon_t parse_points_in_query(const string& query_line);
-
 }  // namespace jt
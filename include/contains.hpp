@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <print>
 #include <ranges>
+#include <span>
 #include <tuple>
 #include <utility>
 
@@ -66,4 +67,22 @@ bool point_in_polygon(const jt::coordinate &coord, Container &&polygn) {
     return std::ranges::fold_left(verts.begin(), verts.end(), false,
                                   flip_inside_state_fn);
 }
+
+/// @brief The same test as point_in_polygon, done in place on the polygon's
+/// vertices instead of on rotated copies of them. Used when testing many
+/// points against one polygon.
+/// @param coord
+/// @param polygn
+/// @return true if coord is inside polygn.
+inline bool point_in_polygon_span(const jt::coordinate &coord,
+                                  std::span<const jt::coordinate> polygn) {
+    bool inside = false;
+    if (polygn.empty()) return inside;
+    for (size_t i = 0, j = polygn.size() - 1; i < polygn.size(); j = i++) {
+        if (flip_inside_state(coord, zip_coordinates{polygn[i], polygn[j]})) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
 }  // namespace jt
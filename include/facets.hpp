@@ -0,0 +1,174 @@
+#pragma once
+
+// Facet counts: how many of the rows matched by a query have each value of
+// several columns, as shown by a filter bar beside search results.
+// Text columns are counted by dictionary code, tags columns by tag id and
+// booleans by value, so each column's counts are a flat array indexed by
+// value. The selected rows are walked once, adding to every column's array;
+// each thread counts its own range of rows, and the arrays are summed.
+// Results are kept in a facet_cache, keyed by the statement's normalized
+// clauses and columns, so that a filter bar redrawn for the same search is
+// not counted again.
+// The counts of several shards of a table can be added up with
+// facet_plan::merge(), as long as each shard returns all of its values.
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <list>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "cell_types.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief How many rows have one value.
+struct facet_count {
+    string value{};
+    size_t rows{0};
+
+    bool operator==(const facet_count&) const = default;
+};
+
+/// @brief The most common values of one column.
+struct facet {
+    string column_name{};
+
+    /// @brief The most common values, most rows first; values with equal
+    /// counts are in value order.
+    vector<facet_count> top{};
+
+    /// @brief Number of different values found.
+    size_t distinct{0};
+
+    /// @brief Number of rows without a value.
+    size_t missing{0};
+};
+
+/// @brief Facet counts for each of a statement's columns.
+struct facet_result {
+    /// @brief Number of rows counted.
+    size_t rows{0};
+
+    vector<facet> facets{};
+};
+
+/// @brief A facets statement, planned against a table. The rows to count
+/// come from a query_plan of the statement's clauses.
+class facet_plan {
+   public:
+    /// @brief Values returned per column if the statement does not say.
+    static constexpr size_t default_top{10};
+
+   private:
+    struct facet_column {
+        string column_name{};
+        size_t column{0};
+        e_cell_data_type type{e_cell_data_type::undetermined};
+    };
+
+    std::shared_ptr<const column_store> columns_{};
+    vector<facet_column> facet_columns_{};
+    size_t top_{default_top};
+
+   public:
+    /// @brief Resolves the columns of a statement. With no columns named,
+    /// every text, boolean and tags column is used.
+    /// @param t
+    /// @param statement
+    /// @return The plan, or the first problem found.
+    static std::expected<facet_plan, plan_error> make(
+        const table& t, const query_statement& statement);
+
+    /// @brief Counts the values of each column over the selected rows.
+    /// @param selection
+    /// @param sched Threads to use, or nullptr to run on the calling thread.
+    /// @return facet_result
+    facet_result run(const bitmap& selection,
+                     scheduler* sched = &scheduler::shared()) const;
+
+    /// @brief Values returned per column.
+    size_t top() const noexcept { return top_; }
+
+    /// @brief Adds up the counts of several shards of a table. Each part
+    /// must hold every value its shard found, as from a plan of the same
+    /// statement with no limit on the values returned.
+    /// @param parts
+    /// @return The counts over all the shards, cut to this plan's top.
+    facet_result merge(std::span<const facet_result> parts) const;
+
+    /// @brief A key that is the same for any two statements that count the
+    /// same columns over the same rows, whatever the order of their clauses.
+    /// @param plan The plan of the statement's clauses.
+    /// @return string
+    string cache_key(const query_plan& plan) const;
+};
+
+/// @brief The most recently computed facet results, for one version of the
+/// table's data (see column_store::generation()).
+class facet_cache {
+   public:
+    /// @brief Results kept if no capacity is given.
+    static constexpr size_t default_capacity{32};
+
+   private:
+    std::uint64_t generation_{0};
+    size_t capacity_{default_capacity};
+
+    /// @brief Most recently used first.
+    std::list<std::pair<string, facet_result>> entries_{};
+
+   public:
+    explicit facet_cache(size_t capacity = default_capacity) noexcept
+        : capacity_{capacity} {}
+
+    /// @brief Looks up a result, emptying the cache if it is for another
+    /// generation.
+    /// @param generation
+    /// @param key From facet_plan::cache_key().
+    /// @return The result, or nullptr.
+    const facet_result* find(std::uint64_t generation, const string& key) {
+        if (generation != generation_) {
+            entries_.clear();
+            generation_ = generation;
+            return nullptr;
+        }
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->first == key) {
+                entries_.splice(entries_.begin(), entries_, it);
+                return &entries_.front().second;
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Stores a result, dropping the least recently used if full.
+    /// @param generation
+    /// @param key
+    /// @param result
+    void insert(std::uint64_t generation, string key, facet_result result) {
+        if (generation != generation_) {
+            entries_.clear();
+            generation_ = generation;
+        }
+        if (capacity_ == 0) return;
+        entries_.emplace_front(std::move(key), std::move(result));
+        if (entries_.size() > capacity_) entries_.pop_back();
+    }
+
+    /// @brief Number of results held.
+    size_t size() const noexcept { return entries_.size(); }
+};
+
+}  // namespace jt
@@ -0,0 +1,89 @@
+#pragma once
+
+// Building a table straight from a directory of images, rather than from a
+// CSV file. The directory tree is walked on the shared scheduler, a task for
+// each directory, and each JPEG, TIFF and PNG file found is read on a task
+// too. Only the bytes of a file's header that are needed are read, with
+// pread() through a small window: the JPEG segments up to the frame header,
+// the PNG chunks up to the image data, and the TIFF directories (IFDs) they
+// point to. The Exif and GPS IFDs give the date the photo was taken and
+// where, and the resolution; the frame header, IHDR chunk or first IFD give
+// the size in pixels. The parser is written here, with no library.
+//
+// The table has the columns of the sample catalog that images describe,
+// with the same names and types, so the same queries work on it; a value
+// that is not in a file's header is empty.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "coordinates.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+
+/// @brief What the header of an image file says about it.
+struct image_info {
+    /// @brief "jpeg", "tiff" or "png".
+    string type{};
+
+    /// @brief Size of the file.
+    std::uint64_t bytes{0};
+
+    /// @brief Size in pixels.
+    std::optional<std::uint32_t> width{};
+    std::optional<std::uint32_t> height{};
+
+    /// @brief Horizontal resolution, in dots per inch.
+    std::optional<std::uint32_t> dpi{};
+
+    /// @brief Where the photo was taken, from the GPS IFD.
+    std::optional<coordinate> location{};
+
+    /// @brief When the photo was taken, as "YYYY-MM-DD HH:MM:SS"; empty if
+    /// not known.
+    string taken{};
+};
+
+/// @brief Reads the header of an image held in memory.
+/// @param bytes The start of the file, or all of it.
+/// @param file_bytes Size of the whole file.
+/// @return What the header says, or nothing if it is not a JPEG, TIFF or
+/// PNG image.
+std::optional<image_info> read_image_info(std::span<const unsigned char> bytes,
+                                          std::uint64_t file_bytes);
+
+/// @brief Reads the header of an image file.
+/// @param filename
+/// @return What the header says, or nothing if the file cannot be read or
+/// is not a JPEG, TIFF or PNG image.
+std::optional<image_info> read_image_file(const string& filename);
+
+/// @brief What a scan found, and how long it took.
+struct scan_stats {
+    size_t directories{0};
+
+    /// @brief Files with the extension of an image.
+    size_t files{0};
+
+    /// @brief Files whose header could be read.
+    size_t images{0};
+
+    std::chrono::nanoseconds time{};
+};
+
+/// @brief Finds the images in a directory and those below it, and makes a
+/// table of them, in order of their paths.
+/// @param directory
+/// @param stats Set to what was found.
+/// @return The table, or a message if the directory cannot be read.
+std::expected<table, string> scan_images(const string& directory,
+                                         scan_stats& stats);
+
+}  // namespace jt
@@ -0,0 +1,223 @@
+#pragma once
+
+// A table that can be reloaded from its file while queries are running.
+// Each command takes a snapshot, a shared_ptr to the current table, and uses
+// it from start to finish, so a command never sees two versions of the data.
+// reload() reads the file into a new table off to the side while commands
+// carry on with the old one, then publishes the new table with one atomic
+// store. The old table is freed when the last snapshot of it is released,
+// so memory is only doubled while the new table is built and while commands
+// that started before the swap finish. The new table's column store has a
+// new generation, so results cached for the old one are never used for it.
+// The pointer is a std::atomic<std::shared_ptr> where the standard library
+// has one; otherwise it is guarded by a mutex held only to copy or replace
+// it.
+//
+// A file that only grows, such as a catalog that rows are appended to as
+// photos arrive, can be followed instead: catch_up() reads only the lines
+// added since the table was read, checks their types against the columns,
+// and publishes a copy of the table with the new rows added, whose columns
+// and indexes are extended rather than built again. Anything else, such as
+// a shorter file or a value of another type, makes it read the whole file.
+// See table_follower.hpp for watching the file.
+//
+// reload() keeps a hash of each line of the file. When the file is read
+// again with the same header, the new lines' hashes are compared with the
+// old ones (see row_diff.hpp), and only the lines inserted or changed are
+// parsed; the other rows are copied from the old table, and the columns and
+// indexes are built from the old ones (see column_store::edited()). A file
+// with many changes, or a change that would give a column another type, is
+// read as a whole instead. A table that keeps only some of the file's rows,
+// such as a worker's shard, is always read whole, as its rows are not the
+// file's lines; the rows it does not keep are dropped as soon as they are
+// parsed, before any table or column store is made of them.
+//
+// A table can also be read from several files, or from the directories and
+// patterns that name them (see catalog_files.hpp). reload() then lists and
+// reads all of them again, and says how long each one took. A table that is
+// not read from CSV files at all, such as one made by scanning a directory
+// of images (see image_scan.hpp), is made again by its loader.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "catalog_files.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+
+/// @brief What a reload did, and what it cost.
+struct reload_stats {
+    /// @brief Rows in the new table.
+    size_t rows{0};
+
+    /// @brief Time spent reading the file and building the new table.
+    std::chrono::nanoseconds load{};
+
+    /// @brief Time spent publishing the new table.
+    std::chrono::nanoseconds swap{};
+
+    /// @brief About how many snapshots of the old table were still held
+    /// when the new one was published; the old table is freed once they
+    /// are released.
+    size_t old_readers{0};
+
+    /// @brief Peak resident memory of the process, in bytes, before and
+    /// after the reload; 0 where it cannot be measured.
+    size_t peak_bytes_before{0};
+    size_t peak_bytes_after{0};
+
+    /// @brief Whether the whole file was read, rather than only the lines
+    /// added to it.
+    bool whole_file{true};
+
+    /// @brief Rows catch_up() added to the end of the table.
+    size_t appended{0};
+
+    /// @brief Whether reload() applied only the lines that changed, rather
+    /// than building the table again.
+    bool diffed{false};
+
+    /// @brief When diffed, rows added, removed, and changed in place.
+    size_t inserted{0};
+    size_t deleted{0};
+    size_t updated{0};
+
+    /// @brief For a table read from several files, the files read and how
+    /// long each one took; empty otherwise.
+    std::vector<file_load> files{};
+};
+
+/// @brief The peak resident memory of the process so far.
+/// @return Bytes, or 0 where it cannot be measured.
+size_t peak_resident_bytes() noexcept;
+
+/// @brief The current version of a table read from a file.
+class live_table {
+   public:
+    /// @brief Removes the rows a table does not keep from the rows parsed
+    /// from its file, given the columns with the types parsing found.
+    using row_filter = std::function<void(const parser::header_fields_t&,
+                                          parser::all_data_fields_t&)>;
+
+    /// @brief Makes a table that is not read from CSV files.
+    using loader = std::function<std::expected<table, string>()>;
+
+   private:
+    string filename_{};
+    row_filter keep_{};
+
+    /// @brief The files, directories and patterns a table read from several
+    /// files is read from; empty for a table read from filename_.
+    std::vector<string> sources_{};
+
+    /// @brief Makes the table, for one not read from CSV files.
+    loader load_{};
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<std::shared_ptr<const table>> current_{};
+#else
+    mutable std::mutex current_mutex_{};
+    std::shared_ptr<const table> current_{};
+#endif
+
+    /// @brief Held while reloading, so that reloads do not overlap.
+    std::mutex reload_mutex_{};
+
+    /// @brief How much of the file the current table was read from;
+    /// unknown for a table not read by reload().
+    std::optional<std::uint64_t> bytes_read_{};
+
+    /// @brief Whether the file's last line had no line break after it when
+    /// it was read.
+    bool unfinished_line_{false};
+
+    /// @brief Publishes a table that was read starting at load_start, and
+    /// fills in the timings and memory use.
+    void publish(table t, std::chrono::steady_clock::time_point load_start,
+                 reload_stats& stats);
+
+    /// @brief Hashes of the lines the current table was read from, the
+    /// header's first and then one per row; unknown for a table not read by
+    /// reload(), or with a row filter.
+    std::optional<std::vector<std::uint64_t>> line_hashes_{};
+
+    /// @brief The current table with the changes between the lines it was
+    /// read from and the file's lines now applied.
+    /// @param lines The file's lines, header first.
+    /// @param hashes The lines' hashes.
+    /// @param stats Set to the numbers of rows changed.
+    /// @return The table, or nothing if the file has to be read as a whole.
+    std::optional<table> edited(const std::vector<string>& lines,
+                                std::span<const std::uint64_t> hashes,
+                                reload_stats& stats) const;
+
+    /// @brief reload(), with reload_mutex_ held.
+    std::expected<reload_stats, string> reload_locked();
+
+   public:
+    /// @brief Starts with a table already read from a file.
+    /// @param filename The file reload() reads.
+    /// @param t
+    /// @param keep Applied to the rows each reload() and catch_up() parse,
+    /// such as to keep only one shard's; t should already have only the rows
+    /// it keeps.
+    live_table(string filename, table t, row_filter keep = {});
+
+    /// @brief Starts with a table already read from several files.
+    /// @param sources The files, directories and patterns reload() reads,
+    /// as expand_catalog_paths() takes.
+    /// @param t
+    live_table(std::vector<string> sources, table t);
+
+    /// @brief Starts with no rows, for a table not read from CSV files.
+    /// @param name What the table is made from, such as a directory.
+    /// @param load Makes the table each time reload() is called.
+    live_table(string name, loader load);
+
+    live_table(const live_table&) = delete;
+    live_table& operator=(const live_table&) = delete;
+
+    /// @brief The current table. It stays valid, and unchanged, for as long
+    /// as the snapshot is held, even if a reload replaces it.
+    std::shared_ptr<const table> snapshot() const;
+
+    /// @brief The file the table is read from, or its sources separated by
+    /// commas.
+    const string& filename() const noexcept { return filename_; }
+
+    /// @brief Publishes a new version of the table.
+    /// @param t
+    /// @return The previous version.
+    std::shared_ptr<const table> replace(table t);
+
+    /// @brief Reads the file again and publishes the result. Commands that
+    /// are running, or start while the file is read, use the old table. If
+    /// only a few lines changed, only those are parsed and indexed.
+    /// @return What the reload did, or a message if the file could not be
+    /// read; the old table is then kept.
+    std::expected<reload_stats, string> reload();
+
+    /// @brief Adds the lines written to the end of the file since it was
+    /// last read, and publishes the result. A line not yet finished is left
+    /// for the next call. The whole file is read again instead if it is
+    /// shorter than before, a new line does not have the table's columns
+    /// and types, the last line read had not been finished, the table was
+    /// not read by reload(), or it is not read from a single file.
+    /// @return What was done, or a message if the file could not be read;
+    /// the old table is then kept.
+    std::expected<reload_stats, string> catch_up();
+};
+
+}  // namespace jt
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <expected>
 #include <fstream>
 #include <iostream>
 #include <print>
 #include <ranges>
 #include <regex>
+#include <stop_token>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -15,6 +17,7 @@
 #include "cell_types.hpp"
 #include "jt_concepts.hpp"
 #include "parse_utils.hpp"
+#include "scheduler.hpp"
 #include "utility.hpp"
 
 namespace jt {
@@ -336,18 +339,36 @@ static inline expected<parser::header_and_data, parser::error> __parse_lines(
     parser::header_and_data result(*h_and_d);
     auto data_range = ranges::subrange(second_line_it, last_line_it);
 
-    size_t data_col_idx = 1;
-    for (auto current_line_it = second_line_it; current_line_it != last_line_it;
-         ++current_line_it) {
-        const string& s = *current_line_it;
-        auto dfs = parser::parse_data_row(s);
-        if (dfs) {
-            result.all_data_fields.push_back(*dfs);
-        } else {
-            println(stderr, "could not parse data at column {}", data_col_idx);
-            return unexpected(parser::error::file_parse_error);
+    // The rows are parsed in chunks on the shared scheduler. A row that
+    // cannot be parsed cancels the chunks that have not started yet.
+    constexpr size_t chunk_rows{4096};
+    const size_t row_count = in_lines.size() - 1;
+    result.all_data_fields.resize(row_count);
+    std::atomic<size_t> bad_row{row_count};
+    {
+        task_group group{scheduler::shared()};
+        for (size_t begin = 0; begin < row_count; begin += chunk_rows) {
+            group.run([&, begin](std::stop_token stop) {
+                const size_t end = std::min(row_count, begin + chunk_rows);
+                for (size_t i = begin; i < end; ++i) {
+                    if (stop.stop_requested()) return;
+                    auto dfs = parser::parse_data_row(in_lines[i + 1]);
+                    if (!dfs) {
+                        size_t expected_bad = row_count;
+                        bad_row.compare_exchange_strong(expected_bad, i);
+                        group.cancel();
+                        return;
+                    }
+                    result.all_data_fields[i] = std::move(*dfs);
+                }
+            });
         }
-        ++data_col_idx;
+        group.wait();
+    }
+    if (bad_row.load() < row_count) {
+        println(stderr, "could not parse data at column {}",
+                bad_row.load() + 1);
+        return unexpected(parser::error::file_parse_error);
     }
 
     const auto cell_data_types_vec_ex =
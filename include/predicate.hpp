@@ -0,0 +1,125 @@
+#pragma once
+
+// Comparison predicates that are fixed at compile time.
+// Each (value type, comparison operator) pair gets its own instantiation,
+// so the comparison in a scan loop is a direct, inlinable call instead of a
+// call through a std::function.
+
+#include <array>
+#include <cstddef>
+
+#include "utility.hpp"
+
+namespace jt {
+
+/// @brief The kinds of comparison operators that can be used in a query.
+enum class comparison_op : unsigned int {
+    invalid,
+    equal_to,
+    not_equal_to,
+    greater,
+    less,
+    greater_equal,
+    less_equal,
+    inside,
+    tags
+};
+
+/// @brief Number of comparison_op values; used to size dispatch tables.
+constexpr size_t comparison_op_count{9};
+
+/// @brief Compares a cell value (lhs) with a query value (rhs).
+/// @tparam T Value type of the column.
+/// @tparam Op Comparison operator. Anything that is not a relational operator
+/// is treated as equality.
+template <typename T, comparison_op Op>
+struct predicate {
+    constexpr bool operator()(const T& lhs, const T& rhs) const noexcept {
+        if constexpr (Op == comparison_op::not_equal_to) {
+            return lhs != rhs;
+        } else if constexpr (Op == comparison_op::greater) {
+            return lhs > rhs;
+        } else if constexpr (Op == comparison_op::greater_equal) {
+            return lhs >= rhs;
+        } else if constexpr (Op == comparison_op::less) {
+            return lhs < rhs;
+        } else if constexpr (Op == comparison_op::less_equal) {
+            return lhs <= rhs;
+        } else {
+            return lhs == rhs;
+        }
+    }
+};
+
+// bool is a special case.
+// Assume false < true.
+// Bool comparison functions are found in utility.hpp.
+template <comparison_op Op>
+struct predicate<bool, Op> {
+    constexpr bool operator()(bool lhs, bool rhs) const noexcept {
+        if constexpr (Op == comparison_op::not_equal_to) {
+            return bool_not_equal_to(lhs, rhs);
+        } else if constexpr (Op == comparison_op::greater) {
+            return bool_greater(lhs, rhs);
+        } else if constexpr (Op == comparison_op::greater_equal) {
+            return bool_greater_equal(lhs, rhs);
+        } else if constexpr (Op == comparison_op::less) {
+            return bool_less(lhs, rhs);
+        } else if constexpr (Op == comparison_op::less_equal) {
+            return bool_less_equal(lhs, rhs);
+        } else {
+            return bool_equal_to(lhs, rhs);
+        }
+    }
+};
+
+// float is a special case.
+// Floating point numbers have to be compared for closeness, not equality.
+// is_close function is found in utility.hpp.
+template <comparison_op Op>
+struct predicate<float, Op> {
+    constexpr bool operator()(float lhs, float rhs) const noexcept {
+        if constexpr (Op == comparison_op::not_equal_to) {
+            return !is_close(lhs, rhs);
+        } else if constexpr (Op == comparison_op::greater) {
+            return lhs > rhs;
+        } else if constexpr (Op == comparison_op::greater_equal) {
+            return is_close(lhs, rhs) || (lhs >= rhs);
+        } else if constexpr (Op == comparison_op::less) {
+            return lhs < rhs;
+        } else if constexpr (Op == comparison_op::less_equal) {
+            return is_close(lhs, rhs) || (lhs <= rhs);
+        } else {
+            return is_close(lhs, rhs);
+        }
+    }
+};
+
+/// @brief Builds a table of Kernel<Op>::run function pointers indexed by
+/// comparison_op, so that a kernel is chosen once per query clause.
+/// @tparam Kernel Class template whose run() contains the loop for one
+/// comparison operator.
+/// @return std::array of function pointers.
+template <template <comparison_op> class Kernel>
+consteval auto make_dispatch_table() noexcept {
+    using co = comparison_op;
+    using fn_t = decltype(&Kernel<co::equal_to>::run);
+    // invalid, inside and tags are not scalar comparisons; they fall back
+    // to equality, as the old get_comparison_function did.
+    return std::array<fn_t, comparison_op_count>{
+        &Kernel<co::equal_to>::run,      &Kernel<co::equal_to>::run,
+        &Kernel<co::not_equal_to>::run,  &Kernel<co::greater>::run,
+        &Kernel<co::less>::run,          &Kernel<co::greater_equal>::run,
+        &Kernel<co::less_equal>::run,    &Kernel<co::equal_to>::run,
+        &Kernel<co::equal_to>::run};
+}
+
+/// @brief Index into a dispatch table made by make_dispatch_table.
+/// @param op
+/// @return size_t
+constexpr size_t dispatch_index(comparison_op op) noexcept {
+    const auto idx = static_cast<size_t>(op);
+    return idx < comparison_op_count ? idx : 0;
+}
+
+}  // namespace jt
@@ -0,0 +1,88 @@
+#pragma once
+
+// Projection of query results onto some of a table's columns: the columns
+// a select statement names, or all of them. The projection only resolves the
+// names; result_writer reads each projected column from its typed column in
+// the column store, so columns that are not projected are never read.
+
+#include <cstddef>
+#include <expected>
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cell.hpp"
+#include "column_store.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief The columns a query returns, resolved against a table. The
+/// projection refers to the table's rows, so it must not outlive the table.
+class projection {
+   public:
+    /// @brief One projected column.
+    struct projected_column {
+        string column_name{};
+        size_t column{0};
+    };
+
+   private:
+    std::shared_ptr<const column_store> columns_{};
+    const vector<row>* rows_{nullptr};
+    vector<projected_column> projected_{};
+
+   public:
+    /// @brief Every column of a table, in order.
+    /// @param t
+    /// @return projection
+    static projection all(const table& t) {
+        projection result{};
+        result.columns_ = t.column_store_ptr();
+        result.rows_ = &t.rows_;
+        for (size_t i = 0; i < t.header_fields_.size(); ++i) {
+            result.projected_.push_back({t.header_field_at_index(i).text, i});
+        }
+        return result;
+    }
+
+    /// @brief Resolves the named columns.
+    /// @param t
+    /// @param columns
+    /// @return The projection, or an unknown_column error.
+    static std::expected<projection, plan_error> make(
+        const table& t, const vector<column_ref>& columns) {
+        projection result{};
+        result.columns_ = t.column_store_ptr();
+        result.rows_ = &t.rows_;
+        for (const column_ref& ref : columns) {
+            const auto col_idx = t.index_for_column_name(ref.column_name);
+            if (!col_idx) {
+                return std::unexpected(plan_error{
+                    plan_error::kind::unknown_column,
+                    std::format("Column \"{}\" is not in this file.",
+                                ref.column_name)});
+            }
+            result.projected_.push_back({ref.column_name, *col_idx});
+        }
+        return result;
+    }
+
+    /// @brief The projected columns, in order.
+    const vector<projected_column>& columns() const noexcept {
+        return projected_;
+    }
+
+    /// @brief The column store the projected columns are read from.
+    const column_store& store() const noexcept { return *columns_; }
+
+    /// @brief The table's rows, for column types the store does not keep.
+    const vector<row>& rows() const noexcept { return *rows_; }
+};
+
+}  // namespace jt
@@ -9,8 +9,10 @@
 #include <string>
 #include <vector>
 
+#include "bitmap.hpp"
 #include "command_handler.hpp"
 #include "coordinates.hpp"
+#include "predicate.hpp"
 #include "table.hpp"
 #include "utility.hpp"
 
@@ -37,17 +39,7 @@ namespace ranges = std::ranges;
 class query {
    public:
     /// @brief The kinds of comparison operators that can be used.
-    enum class comparison : unsigned int {
-        invalid,
-        equal_to,
-        not_equal_to,
-        greater,
-        less,
-        greater_equal,
-        less_equal,
-        inside,
-        tags
-    };
+    using comparison = comparison_op;
 
     /// @brief Reference to the table being queried.
     table& t;
@@ -116,29 +108,37 @@ class query {
         const polygon_t& polygn,
         table::opt_rows rows_to_query = table::opt_rows{});
 
-   private:
-    // functions that begin with "vw_" return views of filtered rows that match
-    // the search criteria.
+    // Column-oriented versions of the scalar matches. These always search
+    // the whole table, using the table's column_store, and return the
+    // selected rows as a bitmap.
 
-    auto vw_string_match(const string& query_value,
-                         ranges::ref_view<table::rows> targets);
+    bitmap integer_select(int query_value) const;
 
-    auto vw_integer_match(int query_value,
-                          ranges::ref_view<table::rows> targets);
+    bitmap floating_select(float query_value) const;
 
-    auto vw_boolean_match(bool query_value,
-                          ranges::ref_view<table::rows> targets);
+    bitmap boolean_select(bool query_value) const;
 
-    auto vw_floating_match(float query_value,
-                           ranges::ref_view<table::rows> targets);
+   private:
+    /// @brief Runs a scalar comparison over the target rows, using the
+    /// predicate kernel chosen for this query's comparison operator.
+    /// @tparam T Value type of the column.
+    /// @param query_value
+    /// @param targets
+    /// @return Rows that match.
+    template <typename T>
+    table::rows scalar_match(const T& query_value,
+                             const table::rows& targets) const;
+
+    // functions that begin with "vw_" return views of filtered rows that match
+    // the search criteria.
 
-    auto vw_geo_query_match(const coordinate& coord,
-                            ranges::ref_view<table::rows> targets);
+    auto vw_geo_query_match(const coordinate& coord, size_t col_idx,
+                            const table::rows& targets) const;
 
-    auto vw_tags_match(const vector<string>& tags,
-                       ranges::ref_view<table::rows> targets);
+    auto vw_tags_match(const vector<string>& tags, size_t col_idx,
+                       const table::rows& targets) const;
 
-    auto vw_point_in_polygon_match(const polygon_t& polygn,
-                                   ranges::ref_view<table::rows> targets);
+    auto vw_point_in_polygon_match(const polygon_t& polygn, size_t col_idx,
+                                   const table::rows& targets) const;
 };
 }  // namespace jt
@@ -0,0 +1,176 @@
+#pragma once
+
+// Lexer, recursive-descent parser and syntax tree for the query language.
+//
+// statement   := ("query" | "refine" | "count") conjunction [order] [limit]
+//              | "select" column { "," column } ["where" conjunction]
+//                [order] [limit]
+//              | "aggregate" aggregates [group] ["where" conjunction]
+//              | "facets" conjunction ["by" column { "," column }]
+//                ["top" number]
+// conjunction := clause { "&&" clause }
+// order       := "order" "by" column ["asc" | "desc"]
+// limit       := "limit" number
+// aggregates  := aggregate { "," aggregate }
+// aggregate   := "count" ["(" column ")"]
+//              | ("sum" | "avg" | "min" | "max") "(" column ")"
+// group       := "group" "by" column
+// clause      := "(" column [operator] value ")"
+// column      := quoted string
+// operator    := "=" | "!=" | "<" | "<=" | ">" | ">=" | "inside" | "tags"
+//
+// The value depends on the operator:
+//   inside  - three or more points, each "(coordinate)" or "coordinate"
+//   tags    - tag { "," tag }, where a tag is a quoted string or bare words
+//   others  - a quoted string, a "(coordinate)", or bare text up to the ")"
+//             that closes the clause. No operator means "=".
+
+#include <cstddef>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "predicate.hpp"
+
+namespace jt {
+using std::string;
+using std::string_view;
+using std::vector;
+
+/// @brief The kinds of tokens in a query line.
+enum class token_kind {
+    end,
+    left_paren,
+    right_paren,
+    comma,
+    and_op,
+    comparison,
+    quoted,
+    word
+};
+
+/// @brief One token. text is the token's text without any double quotes;
+/// begin and end are its position in the source line, including quotes.
+struct token {
+    token_kind kind{token_kind::end};
+    string text{};
+    size_t begin{0};
+    size_t end{0};
+};
+
+/// @brief Describes a syntax error and where in the line it was found.
+struct query_syntax_error {
+    string message{};
+    size_t position{0};
+};
+
+/// @brief Splits a query line into tokens.
+/// @param source
+/// @return The tokens, ending with a token_kind::end token, or an error.
+std::expected<vector<token>, query_syntax_error> tokenize_query(
+    string_view source);
+
+/// @brief One parenthesized clause, as written.
+struct query_clause {
+    /// @brief Name of the column, without quotes.
+    string column_name{};
+
+    /// @brief The operator; "=" if none was given.
+    comparison_op op{comparison_op::equal_to};
+
+    /// @brief The value for scalar comparisons, without surrounding quotes.
+    string value{};
+
+    /// @brief The tags for a "tags" clause, or the points of an "inside"
+    /// clause.
+    vector<string> values{};
+
+    /// @brief Position of the clause in the source line.
+    size_t position{0};
+
+    bool operator==(const query_clause&) const = default;
+};
+
+/// @brief An "order by" suffix, as written.
+struct order_clause {
+    /// @brief Name of the column, without quotes.
+    string column_name{};
+
+    bool descending{false};
+
+    /// @brief Position of the column name in the source line.
+    size_t position{0};
+
+    bool operator==(const order_clause&) const = default;
+};
+
+/// @brief A column named in a statement, outside a clause.
+struct column_ref {
+    /// @brief Name of the column, without quotes.
+    string column_name{};
+
+    /// @brief Position of the column name in the source line.
+    size_t position{0};
+
+    bool operator==(const column_ref&) const = default;
+};
+
+/// @brief The functions an aggregate statement can compute.
+enum class aggregate_fn { count, sum, avg, min, max };
+
+/// @brief One aggregate, as written.
+struct aggregate_call {
+    aggregate_fn fn{aggregate_fn::count};
+
+    /// @brief The column aggregated; empty for a plain "count", which counts
+    /// rows.
+    column_ref column{};
+
+    bool operator==(const aggregate_call&) const = default;
+};
+
+/// @brief A parsed command line.
+struct query_statement {
+    /// @brief The kinds of statements. A refine statement applies its
+    /// clauses to the result of the previous query; a count statement only
+    /// reports how many rows match; a select statement is a query that
+    /// returns only some columns; an aggregate statement summarizes the
+    /// matching rows, by group; a facets statement counts the values of
+    /// several columns over the matching rows.
+    enum class kind { query, refine, count, select, aggregate, facets };
+
+    kind statement_kind{kind::query};
+
+    /// @brief The clauses, which are ANDed together.
+    vector<query_clause> where{};
+
+    /// @brief The column to sort the result by, if any.
+    std::optional<order_clause> order_by{};
+
+    /// @brief Most rows to return, if limited. For facets, the most values
+    /// to return per column.
+    std::optional<size_t> limit{};
+
+    /// @brief The columns a select statement returns, in order.
+    vector<column_ref> select_columns{};
+
+    /// @brief What an aggregate statement computes.
+    vector<aggregate_call> aggregates{};
+
+    /// @brief The column an aggregate statement groups by, if any.
+    std::optional<column_ref> group_by{};
+
+    /// @brief The columns a facets statement counts; empty means every
+    /// column that can be counted.
+    vector<column_ref> facet_columns{};
+};
+
+/// @brief Parses a query command line into a statement.
+/// @param source
+/// @return The statement, or a syntax error.
+std::expected<query_statement, query_syntax_error> parse_query_statement(
+    string_view source);
+
+}  // namespace jt
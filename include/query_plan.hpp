@@ -0,0 +1,298 @@
+#pragma once
+
+// Turns a parsed query statement into an executable plan.
+// Planning looks up each clause's column and converts its value to the
+// column's type once. It then estimates how many rows each clause matches,
+// from the column statistics, and decides whether to answer the clause from
+// the column's index or by scanning. Indexed clauses run first, smallest
+// first; the scanned clauses follow, cheapest per row eliminated first, and
+// only look at the rows that are still candidates. By default the scanned
+// clauses are fused: the rows are walked once, a block at a time, and every
+// scanned clause is applied to a block before moving on to the next. The
+// blocks are grouped into morsels, which run in parallel on the scheduler.
+// Given a clause_cache, a plan takes what results it can from the cache, and
+// runs the scanned clauses that are not there in one pass over the whole
+// table, a block at a time, giving each clause its own result to cache for
+// later queries that share it. If the cached clauses leave few rows, the
+// others are fused over just those rows instead, and not cached.
+// A plan can also sort its result by one column and limit the number of rows
+// returned; see row_order.hpp. With a small limit and clauses that match many
+// rows, the sort column's index can be walked first instead, testing each row
+// it reaches against the clauses, so that most rows are never looked at.
+// A plan keeps a reference to the column store it was planned against, so it
+// can be executed any number of times.
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "block_filter.hpp"
+#include "clause_cache.hpp"
+#include "cell_types.hpp"
+#include "column_store.hpp"
+#include "coordinates.hpp"
+#include "predicate.hpp"
+#include "query_ast.hpp"
+#include "table.hpp"
+#include "scheduler.hpp"
+
+namespace jt {
+using std::string;
+using std::vector;
+
+/// @brief A clause with its column resolved and its value converted to the
+/// column's type.
+struct plan_clause {
+    /// @brief The converted value: int, float, bool or string for scalar
+    /// comparisons, coordinate for a coordinate comparison, vector<string>
+    /// for tags and polygon_t for "inside".
+    using value_t = std::variant<std::monostate, int, float, bool, string,
+                                 coordinate, vector<string>, polygon_t>;
+
+    string column_name{};
+    size_t column{0};
+    e_cell_data_type type{e_cell_data_type::undetermined};
+    comparison_op op{comparison_op::equal_to};
+    value_t value{};
+
+    /// @brief Estimated number of matching rows.
+    double estimated_rows{0.0};
+
+    /// @brief Estimated cost, in nanoseconds, of scanning one row.
+    double scan_cost{0.0};
+
+    /// @brief Whether the clause is answered from the column's index.
+    bool use_index{false};
+};
+
+/// @brief The column a plan's result is sorted by.
+struct plan_order {
+    string column_name{};
+    size_t column{0};
+    e_cell_data_type type{e_cell_data_type::undetermined};
+    bool descending{false};
+};
+
+/// @brief Why a statement could not be planned.
+struct plan_error {
+    enum class kind { unknown_column, bad_value, wrong_operator, unsupported };
+
+    kind error_kind{kind::unsupported};
+    string message{};
+};
+
+/// @brief How the scanned clauses of a plan are run.
+enum class execution_mode {
+    /// @brief One pass over the rows, a block at a time, applying the
+    /// scanned clauses to each block in turn until the block has no rows
+    /// left.
+    fused,
+
+    /// @brief One pass per clause, each producing a bitmap of the whole
+    /// table.
+    clause_at_a_time
+};
+
+/// @brief Number of rows in a block of a fused scan. A block of 4-byte
+/// values is 16 KiB, so a few columns' worth stay in cache while every
+/// clause is applied.
+constexpr size_t fused_block_rows{4096};
+
+/// @brief Number of rows in a morsel, the unit of work handed to a thread by
+/// a parallel fused scan. A multiple of fused_block_rows, and so of the
+/// bitmap word size, so that no two morsels share a selection word.
+constexpr size_t morsel_rows{4 * fused_block_rows};
+
+/// @brief A selection with fewer than one row in this many is sparse: the
+/// clauses a cache does not have are scanned over just its rows, rather than
+/// over the whole table so that their results can be cached.
+constexpr size_t sparse_selection_ratio{16};
+
+/// @brief Whether a selection is sparse; see sparse_selection_ratio.
+inline bool is_sparse(const bitmap& selection) noexcept {
+    return selection.count() * sparse_selection_ratio < selection.size();
+}
+
+/// @brief An executable query plan.
+class query_plan {
+    friend class row_cursor;
+
+    std::shared_ptr<const column_store> columns_{};
+    vector<plan_clause> clauses_{};
+    std::optional<plan_order> order_{};
+    std::optional<size_t> limit_{};
+
+    const column_store& store() const noexcept;
+
+    /// @brief Applies the clauses to the rows of result.
+    /// @param result Starting selection.
+    /// @param restricted Whether result already excludes some rows.
+    /// @param mode
+    /// @param sched
+    bitmap run(bitmap result, bool restricted, execution_mode mode,
+               scheduler* sched) const;
+
+   public:
+    /// @brief Plans a statement against a table.
+    /// @param t
+    /// @param statement
+    /// @return The plan, or the first problem found.
+    static std::expected<query_plan, plan_error> make(
+        const table& t, const query_statement& statement);
+
+    /// @brief The planned clauses, in the order they are executed.
+    /// Indexed clauses come first.
+    const vector<plan_clause>& clauses() const noexcept { return clauses_; }
+
+    /// @brief The column to sort the result by, if any.
+    const std::optional<plan_order>& order() const noexcept { return order_; }
+
+    /// @brief Most rows to return, if limited.
+    std::optional<size_t> limit() const noexcept { return limit_; }
+
+    /// @brief Number of rows in the column store the plan was made for.
+    size_t row_count() const noexcept {
+        return columns_ ? columns_->row_count() : 0;
+    }
+
+    /// @brief Runs the plan.
+    /// @param mode
+    /// @param sched Threads for a fused scan, or nullptr to run it on the
+    /// calling thread.
+    /// @param cache If given, clause results are taken from and added to it,
+    /// and mode is ignored; see the comment at the top of this file.
+    /// @return The rows that satisfy every clause.
+    bitmap execute(execution_mode mode = execution_mode::fused,
+                   scheduler* sched = &scheduler::shared(),
+                   clause_cache* cache = nullptr) const;
+
+    /// @brief Counts the rows that satisfy every clause. A plan with one
+    /// clause that the column's index can answer is counted from the index
+    /// alone, without reading the rows or building a bitmap; otherwise the
+    /// result bitmap is built and its bits counted.
+    /// @param sched
+    /// @param cache As for execute().
+    /// @return Number of rows, no more than the plan's limit.
+    size_t count(scheduler* sched = &scheduler::shared(),
+                 clause_cache* cache = nullptr) const;
+
+    /// @brief Puts a result's rows in output order: sorted if the plan has
+    /// an order, and cut to the limit if it has one. The first K of many
+    /// rows are picked with a bounded heap, or, when the sort column's index
+    /// is likely to reach K selected rows quickly, by walking the index.
+    /// @param selection A result of this plan.
+    /// @return Row numbers, in order.
+    vector<std::uint32_t> ordered_rows(const bitmap& selection) const;
+
+    /// @brief The plan's first rows in output order, found by walking the
+    /// sort column's index and testing each row it reaches against the
+    /// clauses, without running the clauses over the table. Only done when
+    /// the walk is expected to reach the limit after testing fewer rows than
+    /// a scan would look at.
+    /// @return Row numbers, in order: the limit's worth, or every match if
+    /// there are fewer. Nothing if the plan has no order or no limit, the
+    /// sort column has no index, or scanning is expected to be cheaper.
+    std::optional<vector<std::uint32_t>> walk_index() const;
+
+    /// @brief Runs the plan on some of the rows, such as a previous query's
+    /// result.
+    /// @param candidates The rows to consider.
+    /// @param sched
+    /// @return The candidates that satisfy every clause.
+    bitmap execute_within(bitmap candidates,
+                          scheduler* sched = &scheduler::shared()) const;
+
+    /// @brief A copy of the plan without the given clauses, for applying
+    /// just the clauses that a previous result does not already reflect.
+    /// @param keys Normalized clauses to leave out; see make_clause_key().
+    /// @return query_plan
+    query_plan without(const vector<clause_key>& keys) const;
+};
+
+/// @brief Evaluates one planned clause by scanning its column.
+/// @param cs
+/// @param clause
+/// @param candidates If given, only these rows are examined.
+/// @return The rows that satisfy the clause (and are candidates).
+bitmap evaluate_clause(const column_store& cs, const plan_clause& clause,
+                       const bitmap* candidates = nullptr);
+
+/// @brief The normalized form of a planned clause, for clause_cache.
+/// @param clause
+/// @return clause_key
+clause_key make_clause_key(const plan_clause& clause);
+
+/// @brief Prepares one planned clause for a fused scan.
+/// @param cs
+/// @param clause
+/// @return The clause's filter. It refers to cs and to clause, which must
+/// outlive it.
+block_filter make_block_filter(const column_store& cs,
+                               const plan_clause& clause);
+
+/// @brief Filters the rows [first, last) of a fused scan, a block at a
+/// time, clearing the bits of rows that fail a filter.
+/// @param filters Applied in this order within each block.
+/// @param words The selection's words; only those for [first, last) are
+/// touched. first must be a multiple of fused_block_rows.
+/// @param first
+/// @param last
+void fused_scan_rows(std::span<const block_filter> filters,
+                     std::span<bitmap::word_t> words, size_t first,
+                     size_t last);
+
+/// @brief Filters the rows [first, last) like fused_scan_rows(), and also
+/// gives each filter a result of its own, for a clause cache. Each block is
+/// run through every filter, since each filter's result must be complete,
+/// and the selection keeps the rows that all of them keep.
+/// @param filters
+/// @param own A result for each filter, with the rows [first, last) set.
+/// @param words The selection's words; only those for [first, last) are
+/// touched. first must be a multiple of fused_block_rows.
+/// @param first
+/// @param last
+void fused_scan_rows_each(std::span<const block_filter> filters,
+                          std::span<bitmap> own,
+                          std::span<bitmap::word_t> words, size_t first,
+                          size_t last);
+
+/// @brief Applies the scanned clauses to the rows of candidates, in one pass
+/// a block at a time. Each morsel's rows are filtered by one thread, which
+/// writes only that morsel's words of the result, so the result does not
+/// depend on how the morsels were shared out.
+/// @param cs
+/// @param clauses Applied in this order within each block.
+/// @param candidates Rows to consider; consumed.
+/// @param sched Threads to use, or nullptr to run on the calling thread.
+/// @return The candidates that satisfy every clause.
+bitmap fused_scan(const column_store& cs, std::span<const plan_clause> clauses,
+                  bitmap candidates, scheduler* sched = nullptr);
+
+/// @brief Evaluates one planned clause from its column's index.
+/// @param cs
+/// @param clause
+/// @return The rows that satisfy the clause.
+bitmap lookup_clause(const column_store& cs, const plan_clause& clause);
+
+/// @brief Counts the rows that satisfy a clause from its column's index,
+/// without building a bitmap.
+/// @param cs
+/// @param clause
+/// @return The count, or nothing if the index cannot answer the clause.
+std::optional<size_t> count_from_index(const column_store& cs,
+                                       const plan_clause& clause);
+
+/// @brief Estimates how many rows satisfy a clause.
+/// @param cs
+/// @param clause
+/// @return Estimated number of rows.
+double estimate_rows(const column_store& cs, const plan_clause& clause);
+
+}  // namespace jt
@@ -0,0 +1,96 @@
+#pragma once
+
+// A daemon that loads a table once and answers commands over a Unix domain
+// socket, so that scripts do not reload a large file for every query. The
+// protocol is described in query_socket.hpp.
+// Each connection is served by its own thread, with its own command_line
+// session: commands on one connection run in order, and "refine" works from
+// that connection's previous query. Connections run at the same time; each
+// command reads a snapshot of the table (see live_table.hpp), so a "reload"
+// from one client does not hold up the others; query plans run on the shared
+// scheduler, and the sessions share one clause cache, which is safe to use
+// from several threads. A command's output is collected in memory and sent
+// when the command finishes.
+
+#if !defined(_WIN64)
+
+#include <atomic>
+#include <cstddef>
+#include <expected>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "clause_cache.hpp"
+#include "live_table.hpp"
+#include "result_writer.hpp"
+
+namespace jt {
+using std::string;
+
+/// @brief Serves commands on a Unix domain socket.
+class query_server {
+    /// @brief A connection and the thread serving it.
+    struct connection {
+        int fd{-1};
+
+        /// @brief Set, under mutex_, when fd has been closed.
+        bool finished{false};
+        std::jthread thread{};
+    };
+
+    live_table& tables_;
+    output_format format_;
+    std::shared_ptr<clause_cache> cache_;
+
+    string path_{};
+    int listen_fd_{-1};
+
+    /// @brief A pipe that wakes run() when stop() is called.
+    int wake_fds_[2]{-1, -1};
+    std::atomic<bool> stopping_{false};
+
+    std::mutex mutex_{};
+    std::list<connection> connections_{};
+
+    /// @brief Joins the threads of connections that have closed.
+    void reap_finished();
+
+   public:
+    /// @brief A server for a table; call listen(), then run().
+    /// @param tables Must outlive the server.
+    /// @param format How query results are written.
+    /// @param cache_bytes Memory budget of the shared clause cache.
+    query_server(live_table& tables, output_format format = output_format::csv,
+                 size_t cache_bytes = clause_cache::default_budget);
+
+    query_server(const query_server&) = delete;
+    query_server& operator=(const query_server&) = delete;
+
+    /// @brief Stops, closes the connections and removes the socket.
+    ~query_server();
+
+    /// @brief Creates the socket and listens on it. A socket file left at
+    /// the path by an earlier server is replaced.
+    /// @param path
+    /// @return Empty, or a message saying what went wrong.
+    std::expected<void, string> listen(const string& path);
+
+    /// @brief Accepts connections, each served on its own thread, until
+    /// stop() is called; then closes them and waits for their threads.
+    void run();
+
+    /// @brief Makes run() return. Safe to call from a signal handler.
+    void stop() noexcept;
+
+    /// @brief Answers commands on a connected socket until the client
+    /// closes it or quits. The caller closes the socket.
+    /// @param fd
+    void serve_connection(int fd);
+};
+
+}  // namespace jt
+
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+// The protocol spoken over the Unix domain socket of `dimroom --serve`.
+// Every message is a frame: a four-byte length, in network byte order,
+// followed by that many bytes. A client sends one frame per command, holding
+// the command as it would be typed at the prompt. The server answers each
+// command with two frames: what the command wrote to standard output (result
+// rows and counts), then what it wrote to standard error (errors and
+// timings). A client may send any number of commands on one connection; the
+// server answers them in order, and closes the connection after "quit" or
+// "exit". Commands from different connections run at the same time.
+//
+// These helpers are shared by the server and dimroom-client. Unix domain
+// sockets are not available on Windows builds.
+
+#if !defined(_WIN64)
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace jt {
+using std::string;
+using std::string_view;
+
+/// @brief Largest command a server accepts, in bytes.
+constexpr size_t max_command_bytes{size_t{1} << 20};
+
+/// @brief Writes all of a buffer to a socket, retrying after signals.
+/// @param fd
+/// @param data
+/// @param size
+/// @return false if the connection failed.
+inline bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/// @brief Reads exactly size bytes from a socket, retrying after signals.
+/// @param fd
+/// @param data
+/// @param size
+/// @return false if the connection failed or was closed first.
+inline bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::read(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/// @brief Sends one frame.
+/// @param fd
+/// @param payload No more than 4 GiB - 1 bytes.
+/// @return false if the payload is too large or the connection failed.
+inline bool write_frame(int fd, string_view payload) {
+    if (payload.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return false;
+    }
+    const std::uint32_t length =
+        htonl(static_cast<std::uint32_t>(payload.size()));
+    char header[sizeof length];
+    std::memcpy(header, &length, sizeof length);
+    return write_all(fd, header, sizeof header) &&
+           write_all(fd, payload.data(), payload.size());
+}
+
+/// @brief Receives one frame.
+/// @param fd
+/// @param max_bytes Longest payload accepted.
+/// @return The payload, or nothing if the connection was closed or failed,
+/// or the frame was too long.
+inline std::optional<string> read_frame(
+    int fd, size_t max_bytes = std::numeric_limits<std::uint32_t>::max()) {
+    char header[sizeof(std::uint32_t)];
+    if (!read_all(fd, header, sizeof header)) return std::nullopt;
+    std::uint32_t length = 0;
+    std::memcpy(&length, header, sizeof length);
+    length = ntohl(length);
+    if (length > max_bytes) return std::nullopt;
+    string payload(length, '\0');
+    if (!read_all(fd, payload.data(), payload.size())) return std::nullopt;
+    return payload;
+}
+
+/// @brief Fills in the address of a socket path.
+/// @param path
+/// @param address
+/// @return Empty, or a message if the path is too long.
+inline std::expected<void, string> socket_address(const string& path,
+                                                  sockaddr_un& address) {
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof address.sun_path) {
+        return std::unexpected(std::format(
+            "socket path \"{}\" must have 1 to {} characters", path,
+            sizeof address.sun_path - 1));
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return {};
+}
+
+/// @brief Connects to a server's socket.
+/// @param path
+/// @return The connected socket, or a message saying what went wrong.
+inline std::expected<int, string> connect_to_server(const string& path) {
+    sockaddr_un address{};
+    if (auto ok = socket_address(path, address); !ok) {
+        return std::unexpected(ok.error());
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return std::unexpected(
+            std::format("could not make a socket: {}", std::strerror(errno)));
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                  sizeof address) != 0) {
+        const int error = errno;
+        ::close(fd);
+        return std::unexpected(std::format("could not connect to \"{}\": {}",
+                                           path, std::strerror(error)));
+    }
+    return fd;
+}
+
+}  // namespace jt
+
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+// Buffered output of query results as CSV, TSV or JSON Lines.
+// Rows are formatted straight from the column store into one reusable
+// buffer: numbers with std::to_chars, text and tags from their dictionaries.
+// The buffer is written with a single fwrite each time it passes
+// result_writer::chunk_bytes, and once more when the writer is flushed or
+// destroyed, so printing many rows costs a handful of system calls rather
+// than a stream and a flush per row.
+//
+// CSV fields that contain a comma, a double quote or a line break are quoted,
+// with their double quotes doubled; tags are written as one quoted list, the
+// way they are read. TSV fields escape tabs, line breaks and backslashes.
+// JSON Lines writes one object per row, keyed by column name, with missing
+// values as null and tags as arrays.
+
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "column_store.hpp"
+#include "projection.hpp"
+
+namespace jt {
+using std::string;
+using std::string_view;
+using std::vector;
+
+/// @brief The formats results can be written in.
+enum class output_format { csv, tsv, jsonl };
+
+/// @brief Looks up an output format by name: "csv", "tsv" or "jsonl".
+/// @param name
+/// @return The format, or nothing if the name is not known.
+std::optional<output_format> output_format_from_name(string_view name);
+
+/// @brief The name of an output format, which is also its file extension.
+/// @param format
+/// @return "csv", "tsv" or "jsonl".
+string_view output_format_name(output_format format) noexcept;
+
+/// @brief Writes the projected columns of result rows to a file.
+class result_writer {
+   public:
+    /// @brief Buffered bytes that trigger a write.
+    static constexpr size_t chunk_bytes{size_t{1} << 16};
+
+   private:
+    const projection& columns_;
+    std::FILE* out_;
+    output_format format_;
+
+    /// @brief The store's column for each projected column.
+    vector<const column_store::column*> sources_{};
+
+    /// @brief For JSON Lines, each column's quoted key and colon.
+    vector<string> keys_{};
+
+    string buffer_{};
+
+    /// @brief Reused while formatting a tags cell.
+    string scratch_{};
+
+    void append_text(string_view text);
+    void append_cell(size_t i, size_t r);
+    void end_line();
+
+   public:
+    /// @brief A writer for rows of the given projection.
+    /// @param columns Must outlive the writer.
+    /// @param out nullptr to keep the text until take_text() is called.
+    /// @param format
+    result_writer(const projection& columns, std::FILE* out,
+                  output_format format = output_format::csv);
+
+    result_writer(const result_writer&) = delete;
+    result_writer& operator=(const result_writer&) = delete;
+
+    /// @brief Flushes what is left.
+    ~result_writer() { flush(); }
+
+    /// @brief Writes the column names; JSON Lines has no heading line.
+    void write_headings();
+
+    /// @brief Writes the projected cells of one row.
+    /// @param r
+    void write_row(size_t r);
+
+    /// @brief Writes out the buffer.
+    void flush();
+
+    /// @brief Returns the text formatted since it was last written out or
+    /// taken, rather than writing it.
+    string take_text() {
+        string text{};
+        text.swap(buffer_);
+        return text;
+    }
+};
+
+}  // namespace jt
@@ -0,0 +1,138 @@
+#pragma once
+
+// Pulling the rows of a query result as they are found.
+// A result without an order is produced in row order, so it need not be
+// complete before its first rows are printed. row_cursor::stream() applies
+// the plan's indexed clauses up front, then runs the fused scan a batch of
+// morsels at a time, only when more rows are asked for: the first batch is a
+// single morsel, so the first rows come back after scanning morsel_rows rows,
+// and each batch after that is twice as large, up to a few morsels per
+// thread, so a long result is still scanned in parallel. The rows of each
+// batch are handed out in order. Once the last morsel is scanned, the
+// cursor's selection is the complete result, as execute() would return. With
+// a clause cache, the scanned clauses that were not in the cache each fill a
+// result of their own as the morsels are scanned, and are cached when the
+// scan is complete; unless the cached clauses left few rows, in which case
+// the others are fused over just those rows, as in query_plan::execute().
+// Once a plan's limit has been handed out, the morsels not yet scanned are
+// left alone, and the result is marked truncated: its selection holds only
+// the rows of the morsels scanned, and the scanned clauses are not cached.
+// A result that has to be sorted, or that is already known, is wrapped with
+// row_cursor::from_rows() so that it is consumed the same way; a sorted,
+// limited result found by query_plan::walk_index() is truncated too, unless
+// it has fewer rows than the limit.
+//
+// This is a pull iterator rather than a std::generator, which not every
+// standard library we build with provides yet.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "block_filter.hpp"
+#include "clause_cache.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+
+namespace jt {
+using std::vector;
+
+/// @brief The rows of a query result, pulled a batch at a time.
+class row_cursor {
+   public:
+    /// @brief Most morsels scanned per batch, per thread.
+    static constexpr size_t max_batch_morsels_per_thread{4};
+
+   private:
+    query_plan plan_{};
+    scheduler* sched_{nullptr};
+    clause_cache* cache_{nullptr};
+    std::uint64_t generation_{0};
+
+    /// @brief The result; complete once every morsel has been scanned.
+    bitmap selection_{};
+
+    /// @brief Filters of the scanned clauses; with a cache, of those that
+    /// were not in it.
+    vector<block_filter> filters_{};
+
+    /// @brief The scanned clauses to cache, and their results so far, in the
+    /// order of filters_; empty if they are not to be cached.
+    vector<clause_key> miss_keys_{};
+    vector<bitmap> miss_selections_{};
+
+    size_t morsels_{0};
+    size_t next_morsel_{0};
+    size_t batch_morsels_{1};
+
+    /// @brief Rows found and not yet handed out.
+    vector<std::uint32_t> rows_{};
+    size_t next_row_{0};
+
+    /// @brief Rows handed out, and most to hand out.
+    size_t produced_{0};
+    std::optional<size_t> limit_{};
+
+    /// @brief Whether the search stopped at the limit; see truncated().
+    bool truncated_{false};
+
+    row_cursor() = default;
+
+    /// @brief Scans the next batch of morsels, adding their rows to rows_
+    /// if collect is set.
+    void scan_batch(size_t morsels, bool collect);
+
+    /// @brief Called once the last morsel has been scanned.
+    void complete();
+
+   public:
+    row_cursor(row_cursor&&) noexcept = default;
+    row_cursor& operator=(row_cursor&&) noexcept = default;
+    row_cursor(const row_cursor&) = delete;
+    row_cursor& operator=(const row_cursor&) = delete;
+
+    /// @brief A cursor that finds the rows of an unordered plan as they are
+    /// asked for. A plan with an order is run to completion and sorted,
+    /// unless query_plan::walk_index() finds its rows.
+    /// @param plan
+    /// @param sched Threads to scan with, or nullptr to scan on the calling
+    /// thread.
+    /// @param cache If given, clause results are taken from and added to it.
+    /// @return row_cursor
+    static row_cursor stream(const query_plan& plan,
+                             scheduler* sched = &scheduler::shared(),
+                             clause_cache* cache = nullptr);
+
+    /// @brief A cursor over rows that are already known.
+    /// @param rows The rows to hand out, in order.
+    /// @param selection The whole result.
+    /// @return row_cursor
+    static row_cursor from_rows(vector<std::uint32_t> rows, bitmap selection);
+
+    /// @brief The next rows, in order, scanning more of the table if needed.
+    /// @param max_rows Most rows to return.
+    /// @return The rows; empty once there are no more. Valid until the next
+    /// call.
+    std::span<const std::uint32_t> next(size_t max_rows);
+
+    /// @brief Scans whatever is left without handing out any more rows,
+    /// unless the limit has been handed out.
+    /// @return The complete result; if truncated(), only the rows found
+    /// before the search stopped.
+    const bitmap& finish();
+
+    /// @brief Whether the search stopped at the plan's limit, so that there
+    /// may be more rows than finish() returns.
+    bool truncated() const noexcept { return truncated_; }
+
+    /// @brief Whether every row has been handed out.
+    bool done() const noexcept;
+
+    /// @brief Number of rows handed out so far.
+    size_t produced() const noexcept { return produced_; }
+};
+
+}  // namespace jt
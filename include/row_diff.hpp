@@ -0,0 +1,63 @@
+#pragma once
+
+// Finding the lines that changed between two versions of a CSV file, so that
+// "reload" only parses and indexes those (see live_table.hpp). Each line is
+// reduced to a 64-bit hash, and the two sequences of hashes are compared with
+// Myers' O(ND) difference algorithm, whose cost grows with the number of
+// changes D rather than with the square of the file's length. Lines that
+// are the same at the start and end of the file are matched before the
+// algorithm starts, so an edit near one end is found in a single pass.
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace jt {
+using std::vector;
+
+/// @brief A 64-bit hash of a line, computed as xxHash64 with seed 0. It is
+/// only compared within one process, so it is read in the machine's byte
+/// order.
+/// @param line
+/// @return hash
+std::uint64_t line_hash(std::string_view line) noexcept;
+
+/// @brief How a new version of a sequence of lines is made from an old one.
+struct line_diff {
+    /// @brief Marks a new line that is not a copy of an old one.
+    static constexpr std::uint32_t no_line =
+        std::numeric_limits<std::uint32_t>::max();
+
+    /// @brief For each new line, the old line it is an unchanged copy of,
+    /// or no_line. The old lines kept are in increasing order.
+    vector<std::uint32_t> source{};
+
+    /// @brief New lines that do not replace an old one.
+    size_t inserted{0};
+
+    /// @brief Old lines that were removed without a replacement.
+    size_t deleted{0};
+
+    /// @brief Old lines replaced by a different line in the same place.
+    size_t updated{0};
+
+    /// @brief Lines inserted, deleted or updated.
+    size_t changed() const noexcept { return inserted + deleted + updated; }
+};
+
+/// @brief Finds the fewest lines to delete and insert to turn one sequence
+/// of lines into another. A deletion and an insertion between the same
+/// unchanged lines count as an update.
+/// @param old_lines Hashes of the old lines.
+/// @param new_lines Hashes of the new lines.
+/// @param max_edits Deletions and insertions to give up after.
+/// @return The difference, or nothing if it needs more than max_edits.
+std::optional<line_diff> diff_lines(std::span<const std::uint64_t> old_lines,
+                                    std::span<const std::uint64_t> new_lines,
+                                    size_t max_edits);
+
+}  // namespace jt
@@ -0,0 +1,230 @@
+#pragma once
+
+// Ordering the rows of a query result by one column.
+// Rows are compared by the column's stored values: numbers as numbers, and
+// text by dictionary code, which orders the same as the strings since the
+// dictionary is sorted. Rows without a value come after all the rows that
+// have one, whichever the direction, and equal values keep row order.
+// When only the first K rows are wanted, they are picked with a bounded heap
+// of K rows as the selection is walked, so the cost is n log K rather than a
+// sort of every match. With an index over the column, the rows can instead be
+// taken in the index's order, stopping once K selected rows have been found;
+// the selection can then also be a test of one row, so that rows are only
+// tested as the walk reaches them.
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "column_index.hpp"
+#include "columns.hpp"
+
+namespace jt {
+using std::vector;
+
+/// @brief Orders row numbers by a column's values.
+/// @tparam Values Indexable by row: a span of numbers or of dictionary
+/// codes, or a bitmap of booleans.
+template <class Values>
+struct row_order {
+    const Values* values{nullptr};
+    const bitmap* present{nullptr};
+    bool descending{false};
+
+    /// @brief Whether row a goes before row b.
+    bool operator()(std::uint32_t a, std::uint32_t b) const noexcept {
+        const bool has_a = present->test(a);
+        const bool has_b = present->test(b);
+        if (has_a != has_b) return has_a;
+        if (has_a) {
+            const auto va = value(a);
+            const auto vb = value(b);
+            if (va < vb) return !descending;
+            if (vb < va) return descending;
+        }
+        return a < b;
+    }
+
+   private:
+    auto value(std::uint32_t r) const noexcept {
+        if constexpr (std::is_same_v<Values, bitmap>) {
+            return values->test(r);
+        } else {
+            return (*values)[r];
+        }
+    }
+};
+
+/// @brief The first k selected rows, in row order.
+/// @param selection
+/// @param k
+/// @return Row numbers.
+inline vector<std::uint32_t> first_rows(const bitmap& selection, size_t k) {
+    vector<std::uint32_t> result{};
+    const auto words = selection.words();
+    for (size_t wi = 0; wi < words.size() && result.size() < k; ++wi) {
+        bitmap::word_t w = words[wi];
+        while (w != 0 && result.size() < k) {
+            result.push_back(static_cast<std::uint32_t>(
+                wi * bitmap::word_bits +
+                static_cast<size_t>(std::countr_zero(w))));
+            w &= w - 1;
+        }
+    }
+    return result;
+}
+
+/// @brief The selected rows in order, all of them or the first k.
+/// Below k rows a bounded heap keeps the best k seen so far; its top is the
+/// worst of them, which each later row only has to beat.
+/// @tparam Less
+/// @param selection
+/// @param k Number of rows wanted.
+/// @param less
+/// @return Row numbers, in order.
+template <class Less>
+vector<std::uint32_t> top_rows(const bitmap& selection, size_t k,
+                               const Less& less) {
+    const size_t matches = selection.count();
+    if (k >= matches) {
+        vector<std::uint32_t> all = selection.to_ids();
+        std::ranges::sort(all, less);
+        return all;
+    }
+
+    vector<std::uint32_t> heap{};
+    if (k == 0) return heap;
+    heap.reserve(k);
+    selection.for_each_set([&heap, k, &less](size_t i) {
+        const auto r = static_cast<std::uint32_t>(i);
+        if (heap.size() < k) {
+            heap.push_back(r);
+            std::ranges::push_heap(heap, less);
+        } else if (less(r, heap.front())) {
+            std::ranges::pop_heap(heap, less);
+            heap.back() = r;
+            std::ranges::push_heap(heap, less);
+        }
+    });
+    std::ranges::sort_heap(heap, less);
+    return heap;
+}
+
+namespace {
+/// @brief Whether a selection holds a row.
+/// @tparam Selection A bitmap, or a function of the row number.
+template <class Selection>
+bool holds(const Selection& selection, std::uint32_t r) {
+    if constexpr (std::is_same_v<Selection, bitmap>) {
+        return selection.test(r);
+    } else {
+        return selection(r);
+    }
+}
+
+/// @brief Adds the selected rows without a value, in row order, until there
+/// are k rows.
+template <class Selection>
+void append_missing(vector<std::uint32_t>& result, const Selection& selection,
+                    const bitmap& present, size_t k) {
+    if (result.size() >= k) return;
+    if constexpr (std::is_same_v<Selection, bitmap>) {
+        bitmap missing{selection};
+        missing.and_not(present);
+        for (const auto r : first_rows(missing, k - result.size())) {
+            result.push_back(r);
+        }
+    } else {
+        const auto words = present.words();
+        const size_t tail = present.size() % bitmap::word_bits;
+        for (size_t wi = 0; wi < words.size() && result.size() < k; ++wi) {
+            bitmap::word_t w = ~words[wi];
+            if (wi + 1 == words.size() && tail != 0) {
+                w &= (bitmap::word_t{1} << tail) - 1;
+            }
+            while (w != 0 && result.size() < k) {
+                const auto r = static_cast<std::uint32_t>(
+                    wi * bitmap::word_bits +
+                    static_cast<size_t>(std::countr_zero(w)));
+                if (selection(r)) result.push_back(r);
+                w &= w - 1;
+            }
+        }
+    }
+}
+}  // namespace
+
+/// @brief The selected rows of a numeric column in its sorted index's
+/// order, stopping once k have been found. Going down, each run of equal
+/// values is still taken in row order, so ties come out as row_order puts
+/// them.
+/// @tparam T
+/// @tparam Selection A bitmap, or a function of the row number.
+/// @param col
+/// @param idx
+/// @param selection
+/// @param descending
+/// @param k
+/// @return Row numbers, in order.
+template <typename T, class Selection>
+vector<std::uint32_t> rows_in_index_order(const typed_column<T>& col,
+                                          const sorted_index<T>& idx,
+                                          const Selection& selection,
+                                          bool descending, size_t k) {
+    vector<std::uint32_t> result{};
+    const std::span<const std::uint32_t> order{idx.order};
+    auto take = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last && result.size() < k; ++i) {
+            if (holds(selection, order[i])) result.push_back(order[i]);
+        }
+    };
+    if (descending) {
+        size_t end = order.size();
+        while (end > 0 && result.size() < k) {
+            const size_t begin =
+                idx.lower_bound(col, col.values[order[end - 1]]);
+            take(begin, end);
+            end = begin;
+        }
+    } else {
+        take(0, order.size());
+    }
+    append_missing(result, selection, col.present, k);
+    return result;
+}
+
+/// @brief The selected rows of a text column in dictionary order, from its
+/// posting lists, stopping once k have been found.
+/// @tparam Selection A bitmap, or a function of the row number.
+/// @param col
+/// @param idx
+/// @param selection
+/// @param descending
+/// @param k
+/// @return Row numbers, in order.
+template <class Selection>
+vector<std::uint32_t> rows_in_index_order(const text_column& col,
+                                          const posting_lists& idx,
+                                          const Selection& selection,
+                                          bool descending, size_t k) {
+    vector<std::uint32_t> result{};
+    const size_t codes = idx.code_count();
+    for (size_t n = 0; n < codes && result.size() < k; ++n) {
+        const size_t code = descending ? codes - 1 - n : n;
+        for (const auto r : idx.range(code, code + 1)) {
+            if (result.size() >= k) break;
+            if (col.present.test(r) && holds(selection, r)) {
+                result.push_back(r);
+            }
+        }
+    }
+    append_missing(result, selection, col.present, k);
+    return result;
+}
+
+}  // namespace jt
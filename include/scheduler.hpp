@@ -0,0 +1,212 @@
+#pragma once
+
+// The program's task scheduler: one set of worker threads shared by loading,
+// index building and query execution, so that they do not each start their
+// own threads.
+// Each worker has its own deque of tasks. A worker takes its newest task
+// first, and when its deque is empty it steals the oldest task from another
+// worker, so a worker that finishes early picks up work left by a slow one.
+// Tasks are run in task groups, which can be waited for and cancelled
+// together. A thread waiting for a group runs queued tasks while it waits, so
+// a task can start and wait for a group of its own without tying up a worker.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace jt {
+using std::vector;
+
+/// @brief What one worker has done, for tuning the number of threads.
+struct worker_counters {
+    /// @brief Tasks run.
+    std::uint64_t tasks_run{0};
+
+    /// @brief Tasks taken from another worker's deque.
+    std::uint64_t tasks_stolen{0};
+
+    /// @brief Time spent running tasks.
+    std::chrono::nanoseconds busy{0};
+
+    /// @brief Time spent waiting for tasks.
+    std::chrono::nanoseconds idle{0};
+};
+
+/// @brief A fixed set of worker threads that share out tasks by stealing.
+class scheduler {
+   public:
+    using task = std::function<void()>;
+
+   private:
+    struct worker_queue {
+        std::mutex mutex{};
+        std::deque<task> tasks{};
+    };
+
+    /// @brief Written by one worker; read by counters().
+    struct worker_stats {
+        std::atomic<std::uint64_t> tasks_run{0};
+        std::atomic<std::uint64_t> tasks_stolen{0};
+        std::atomic<std::int64_t> busy_ns{0};
+        std::atomic<std::int64_t> idle_ns{0};
+    };
+
+    vector<std::unique_ptr<worker_queue>> queues_{};
+    vector<std::unique_ptr<worker_stats>> stats_{};
+    vector<std::thread> threads_{};
+
+    std::mutex sleep_mutex_{};
+    std::condition_variable wake_{};
+    std::atomic<size_t> pending_{0};
+    bool stopping_{false};
+
+    std::atomic<size_t> next_queue_{0};
+
+    /// @brief Takes a task: the newest from queue home, or else the oldest
+    /// from any other queue.
+    /// @param home
+    /// @param stolen Set to whether the task came from another queue.
+    std::optional<task> take(size_t home, bool& stolen);
+
+    void worker_loop(size_t index);
+
+   public:
+    /// @brief Starts the workers.
+    /// @param worker_count Number of threads; 0 means tasks only run on
+    /// threads that wait for a task group.
+    explicit scheduler(size_t worker_count);
+
+    /// @brief Runs any tasks still queued, then stops the workers.
+    ~scheduler();
+
+    scheduler(const scheduler&) = delete;
+    scheduler& operator=(const scheduler&) = delete;
+
+    /// @brief Number of worker threads.
+    size_t worker_count() const noexcept { return threads_.size(); }
+
+    /// @brief Queues a task to run on some worker.
+    /// @param t
+    void submit(task t);
+
+    /// @brief Runs one queued task on the calling thread, if there is one.
+    /// @return Whether a task was run.
+    bool run_one();
+
+    /// @brief Calls fn(i) for every i in [0, count), spread across the
+    /// workers and the calling thread, and returns when all the calls have
+    /// finished. fn must not throw.
+    /// @tparam Fn
+    /// @param count
+    /// @param fn
+    template <class Fn>
+    void parallel_for(size_t count, Fn&& fn);
+
+    /// @brief A snapshot of each worker's counters.
+    vector<worker_counters> counters() const;
+
+    /// @brief The scheduler shared by the whole program.
+    static scheduler& shared();
+
+    /// @brief Sets the number of threads, including the calling thread, that
+    /// shared() will use. Must be called before shared() is first used.
+    /// @param threads 0 means one per hardware thread.
+    /// @return false if the shared scheduler has already started.
+    static bool set_shared_threads(size_t threads);
+};
+
+/// @brief A set of tasks that are waited for, and can be cancelled,
+/// together. Cancellation is cooperative: tasks that have not started are
+/// skipped, and running tasks can check stop_token().
+class task_group {
+    /// @brief Owned by the group and by its queued tasks, so that the last
+    /// task can signal it even once wait() has returned and the group is
+    /// gone.
+    struct state {
+        std::atomic<size_t> pending{0};
+        std::stop_source stop{};
+    };
+
+    scheduler& scheduler_;
+    std::shared_ptr<state> state_{std::make_shared<state>()};
+
+   public:
+    explicit task_group(scheduler& s) : scheduler_{s} {}
+
+    /// @brief Waits for the group's tasks.
+    ~task_group() { wait(); }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    /// @brief Queues fn as part of the group. fn takes either no arguments or
+    /// a std::stop_token, and must not throw.
+    /// @tparam Fn
+    /// @param fn
+    template <class Fn>
+    void run(Fn&& fn) {
+        state_->pending.fetch_add(1, std::memory_order_relaxed);
+        scheduler_.submit([s = state_, fn = std::forward<Fn>(fn)]() mutable {
+            if (!s->stop.stop_requested()) {
+                if constexpr (std::is_invocable_v<Fn&, std::stop_token>) {
+                    fn(s->stop.get_token());
+                } else {
+                    fn();
+                }
+            }
+            if (s->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                s->pending.notify_all();
+            }
+        });
+    }
+
+    /// @brief Returns when every task in the group has finished or been
+    /// skipped. Runs queued tasks, of any group, while it waits.
+    void wait() {
+        std::atomic<size_t>& pending = state_->pending;
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (scheduler_.run_one()) continue;
+            const size_t left = pending.load(std::memory_order_acquire);
+            if (left > 0) pending.wait(left, std::memory_order_acquire);
+        }
+    }
+
+    /// @brief Asks the group's tasks to stop.
+    void cancel() noexcept { state_->stop.request_stop(); }
+
+    /// @brief Whether cancel() has been called.
+    bool cancelled() const noexcept { return state_->stop.stop_requested(); }
+
+    /// @brief Token that running tasks can poll.
+    std::stop_token stop_token() const noexcept {
+        return state_->stop.get_token();
+    }
+};
+
+template <class Fn>
+void scheduler::parallel_for(size_t count, Fn&& fn) {
+    if (count == 0) return;
+    if (count == 1 || threads_.empty()) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    task_group group{*this};
+    for (size_t i = 0; i < count; ++i) {
+        group.run([&fn, i] { fn(i); });
+    }
+    group.wait();
+}
+
+}  // namespace jt
@@ -0,0 +1,234 @@
+#pragma once
+
+// A table split across worker processes, for files too large to query
+// comfortably in one.
+// `dimroom --shards N FILE` starts N workers on this machine, each a
+// `dimroom --serve` that reads the file but keeps only its own shard of the
+// rows, and then prompts for commands as usual. Each command is sent to every
+// worker over its Unix domain socket, and the answers are merged: counts are
+// added; rows are concatenated, or for an "order by" merged by their sort
+// values, so each worker only sends its own first K rows of a "limit K"; the
+// totals of each aggregate group are added before averages are divided out;
+// and facet counts are added up value by value. The statement itself is sent
+// rather than a plan, so that each worker plans against the statistics and
+// indexes of its own rows. Before sending, the coordinator plans the
+// statement against the columns alone, so mistakes are reported without
+// asking the workers.
+//
+// Rows go to shards by a hash of their file name: the "Filename" column, or
+// the first column if there is none. With --shard-by tile they go by the 10
+// degree square that their first geographic coordinate is in, so that the
+// rows of one area stay together; rows without a coordinate go by file name.
+//
+// The coordinator speaks to the workers with shard requests: a command frame
+// (see query_socket.hpp) holding "shard:" and a verb, then usually the
+// statement. A worker answers with the usual two frames; the first holds a
+// record of fields, each written as its length in decimal, a colon and its
+// bytes, and the second any messages. Without "order by", rows come shard by
+// shard, rather than in the order of the file; "refine" and "page" are not
+// available.
+
+#include <cstddef>
+#include <cstdio>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "clause_cache.hpp"
+#include "live_table.hpp"
+#include "parser.hpp"
+#include "result_writer.hpp"
+#include "table.hpp"
+
+#if !defined(_WIN64)
+#include <sys/types.h>
+#endif
+
+namespace jt {
+using std::string;
+using std::string_view;
+using std::vector;
+
+/// @brief How rows are assigned to shards.
+enum class shard_key { filename, tile };
+
+/// @brief Looks up a shard key by name: "filename" or "tile".
+/// @param name
+/// @return The key, or nothing if the name is not known.
+std::optional<shard_key> shard_key_from_name(string_view name);
+
+/// @brief The name of a shard key.
+/// @param key
+/// @return "filename" or "tile".
+string_view shard_key_name(shard_key key) noexcept;
+
+/// @brief Which shard of a table a worker holds.
+struct shard_spec {
+    size_t index{0};
+    size_t count{1};
+    shard_key key{shard_key::filename};
+};
+
+/// @brief The rows of a table that belong to one shard, in their order in
+/// the table. The column types are kept, even if the shard's own rows would
+/// suggest others.
+/// @param t
+/// @param spec
+/// @return table
+table make_shard(const table& t, const shard_spec& spec);
+
+/// @brief Keeps the parsed rows that belong to one shard, as make_shard()
+/// would, before any table or column store is made of them.
+/// @param hfs The columns, with the types found for the whole file.
+/// @param rows The rows' fields; the rows of other shards are removed.
+/// @param spec
+void keep_shard_fields(const parser::header_fields_t& hfs,
+                       parser::all_data_fields_t& rows,
+                       const shard_spec& spec);
+
+/// @brief Adds a field to a record.
+/// @param record
+/// @param field
+void append_field(string& record, string_view field);
+
+/// @brief Splits a record into its fields.
+/// @param record
+/// @return The fields, or nothing if the record is malformed.
+std::optional<vector<string>> split_fields(string_view record);
+
+/// @brief Whether a command is a shard request.
+/// @param command
+inline bool is_shard_request(string_view command) noexcept {
+    return command.starts_with("shard:");
+}
+
+/// @brief A worker's answer to a shard request: the record, and messages.
+struct shard_answer {
+    string out{};
+    string err{};
+};
+
+/// @brief Answers a shard request from a coordinator.
+/// @param tables The worker's shard.
+/// @param command
+/// @param cache Query result cache, or nullptr.
+/// @return shard_answer
+shard_answer answer_shard_request(live_table& tables, string_view command,
+                                  clause_cache* cache);
+
+#if !defined(_WIN64)
+
+/// @brief Worker processes started for a coordinator, each serving one
+/// shard on a socket in a directory of its own. The workers are stopped when
+/// this is destroyed.
+class shard_workers {
+    string directory_{};
+    vector<pid_t> pids_{};
+    vector<string> sockets_{};
+
+   public:
+    shard_workers() = default;
+    shard_workers(const shard_workers&) = delete;
+    shard_workers& operator=(const shard_workers&) = delete;
+
+    /// @brief Stops the workers and removes their sockets.
+    ~shard_workers();
+
+    /// @brief Starts the workers, and waits until every one has read its
+    /// shard and is listening.
+    /// @param program This program, run once per worker.
+    /// @param options Options passed to every worker, such as --threads.
+    /// @param csv_filename
+    /// @param count
+    /// @param key
+    /// @return Empty, or a message saying what went wrong.
+    std::expected<void, string> start(const string& program,
+                                      const vector<string>& options,
+                                      const string& csv_filename, size_t count,
+                                      shard_key key);
+
+    /// @brief The workers' sockets, in shard order.
+    const vector<string>& sockets() const noexcept { return sockets_; }
+};
+
+/// @brief Answers commands by asking the workers of every shard and merging
+/// what they say.
+class shard_coordinator {
+    /// @brief One connected socket per shard.
+    vector<int> fds_{};
+
+    /// @brief The workers' columns, without rows, to plan against.
+    table schema_{};
+
+    output_format format_{output_format::csv};
+
+    /// @brief Set once a shard could not be reached.
+    bool lost_{false};
+
+    /// @brief A shard's answer to a request.
+    struct reply {
+        string out{};
+        string err{};
+    };
+
+    /// @brief Sends a request to every shard, then collects the answers.
+    /// @return The answers in shard order, or nothing if a shard could not
+    /// be reached; that is reported to err.
+    std::optional<vector<reply>> ask_all(string_view request, std::FILE* err);
+
+    /// @brief Asks the first shard for the columns.
+    std::expected<void, string> read_schema();
+
+    void do_rows(const string& line, std::FILE* out, std::FILE* err);
+    void do_count(const string& line, std::FILE* out, std::FILE* err);
+    void do_aggregate(const string& line, std::FILE* out, std::FILE* err);
+    void do_facets(const string& line, std::FILE* out, std::FILE* err);
+    void do_reload(std::FILE* out, std::FILE* err);
+
+    /// @brief Sends an ordinary command to every shard, and prints each
+    /// answer under the shard's number.
+    void do_each(const string& line, std::FILE* out, std::FILE* err);
+
+   public:
+    shard_coordinator() = default;
+    shard_coordinator(shard_coordinator&& other) noexcept;
+    shard_coordinator& operator=(shard_coordinator&& other) noexcept;
+    shard_coordinator(const shard_coordinator&) = delete;
+    shard_coordinator& operator=(const shard_coordinator&) = delete;
+
+    /// @brief Closes the connections.
+    ~shard_coordinator();
+
+    /// @brief Connects to the workers of every shard.
+    /// @param sockets In shard order.
+    /// @param format How query results are written.
+    /// @return The coordinator, or a message saying what went wrong.
+    static std::expected<shard_coordinator, string> connect(
+        const vector<string>& sockets,
+        output_format format = output_format::csv);
+
+    /// @brief Number of shards.
+    size_t shard_count() const noexcept { return fds_.size(); }
+
+    /// @brief The columns of the table, with no rows.
+    const table& schema() const noexcept { return schema_; }
+
+    /// @brief Runs one command, as typed at the prompt.
+    /// @param input_line Trimmed.
+    /// @param out Where results are written.
+    /// @param err Where messages are written.
+    /// @return false if the command was "quit" or "exit", or the shards
+    /// could no longer be reached.
+    bool run_command(const string& input_line, std::FILE* out = stdout,
+                     std::FILE* err = stderr);
+
+    /// @brief Prompts for commands until "quit" or the end of input.
+    /// @return EXIT_SUCCESS, or EXIT_FAILURE if a shard was lost.
+    int read_eval_print();
+};
+
+#endif
+
+}  // namespace jt
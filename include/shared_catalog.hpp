@@ -0,0 +1,104 @@
+#pragma once
+
+// A loaded table published in POSIX shared memory, so that other dimroom
+// processes on the same machine can take it from there instead of reading
+// and parsing the CSV file again.
+// `--shm` looks for an image of the file under a name made from the file's
+// path, size and modification time; a changed file gets a new name, so an
+// image is never used for a file it was not made from. The first process to
+// find no image reads the file and publishes one; the others attach to it.
+//
+// The shared memory object starts with a control page, mapped writable by
+// every process: a self-describing header (magic, layout version, sizes) and
+// a table of the processes attached. The image follows, mapped read-only once
+// written: the column names and types, an offset per row, and then the cells
+// of each row in turn. Attaching decodes the rows in parallel chunks and
+// builds the column store from them; this skips reading the file, splitting
+// its lines and deducing the column types.
+//
+// A process holds a slot with its process id while it is attached. When the
+// last one detaches, the object is removed. The slot of a process that ended
+// without detaching is taken over by the next process to attach, and is not
+// counted when deciding whether it was the last.
+
+#if !defined(_WIN64)
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <string>
+
+#include "table.hpp"
+
+namespace jt {
+using std::string;
+
+/// @brief A table image in POSIX shared memory, and this process's
+/// attachment to it. Detaches when destroyed.
+class shared_catalog {
+    struct control;
+
+    string name_{};
+    control* control_{nullptr};
+    const std::byte* image_{nullptr};
+    size_t mapped_bytes_{0};
+    size_t slot_{0};
+
+    /// @brief Maps an open shared memory object, waits until its image is
+    /// written, and takes a slot.
+    static std::expected<shared_catalog, string> map(const string& name,
+                                                     int fd);
+
+    /// @brief Gives up the slot and unmaps; removes the object if no other
+    /// process is attached.
+    void detach() noexcept;
+
+   public:
+    /// @brief Processes that can be attached to one image at once.
+    static constexpr size_t max_holders{128};
+
+    shared_catalog() = default;
+    shared_catalog(shared_catalog&& other) noexcept;
+    shared_catalog& operator=(shared_catalog&& other) noexcept;
+    shared_catalog(const shared_catalog&) = delete;
+    shared_catalog& operator=(const shared_catalog&) = delete;
+
+    /// @brief Detaches.
+    ~shared_catalog() { detach(); }
+
+    /// @brief The shared memory name for the current version of a file.
+    /// @param csv_filename
+    /// @return The name, or a message if the file cannot be examined.
+    static std::expected<string, string> name_for(const string& csv_filename);
+
+    /// @brief Publishes a table under a name, and attaches to it.
+    /// @param t
+    /// @param name
+    /// @return The attachment, or a message; an image already published
+    /// under the name is not replaced.
+    static std::expected<shared_catalog, string> publish(const table& t,
+                                                         const string& name);
+
+    /// @brief Attaches to a published table.
+    /// @param name
+    /// @return The attachment, or a message if there is no image under the
+    /// name or it is not one this program can read.
+    static std::expected<shared_catalog, string> attach(const string& name);
+
+    /// @brief Rebuilds the table from the image.
+    /// @return table
+    table read_table() const;
+
+    /// @brief The shared memory name.
+    const string& name() const noexcept { return name_; }
+
+    /// @brief Number of live processes attached, including this one.
+    size_t holders() const noexcept;
+
+    /// @brief Size of the image, without the control page.
+    size_t image_bytes() const noexcept;
+};
+
+}  // namespace jt
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+// Comparison kernels for contiguous integer and floating point columns.
+// Each kernel compares every value in a column with a query value and writes
+// one bit per row into 64-bit selection words.
+// An AVX2 version is used when the CPU supports it; otherwise a scalar
+// version with the same results is used.
+
+#include <cstdint>
+#include <span>
+
+#include "bitmap.hpp"
+#include "predicate.hpp"
+
+namespace jt {
+
+/// @brief The instruction sets the kernels can use.
+enum class simd_level { scalar, avx2 };
+
+/// @brief Checks (once) which instruction set this CPU supports.
+/// @return The best simd_level available.
+simd_level detected_simd_level() noexcept;
+
+/// @brief The instruction set the kernels currently use. Defaults to
+/// detected_simd_level().
+simd_level active_simd_level() noexcept;
+
+/// @brief Forces the kernels to use a particular instruction set, e.g. for
+/// benchmarks and tests. Requests for an unsupported level are ignored.
+/// @param level
+void set_simd_level(simd_level level) noexcept;
+
+/// @brief Compares each value with query_value and sets bit i of out if
+/// values[i] op query_value.
+/// @param values Column values.
+/// @param op Comparison operator.
+/// @param query_value
+/// @param out Selection words; must hold bitmap::words_for(values.size()).
+void compare_int32(std::span<const std::int32_t> values, comparison_op op,
+                   std::int32_t query_value,
+                   std::span<bitmap::word_t> out) noexcept;
+
+/// @brief Compares each value with query_value and sets bit i of out if
+/// values[i] op query_value. Equality uses is_close semantics, done as an
+/// interval compare against [query_value - epsilon, query_value + epsilon].
+/// @param values Column values.
+/// @param op Comparison operator.
+/// @param query_value
+/// @param out Selection words; must hold bitmap::words_for(values.size()).
+void compare_float(std::span<const float> values, comparison_op op,
+                   float query_value, std::span<bitmap::word_t> out) noexcept;
+
+}  // namespace jt
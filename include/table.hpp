@@ -1,18 +1,23 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <set>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "bitmap.hpp"
 #include "cell.hpp"
+#include "column_store.hpp"
 #include "parser.hpp"
 #include "utility.hpp"
 
@@ -84,6 +89,11 @@ class table {
     /// @brief Column names with tags data type.
     type_column_name_set tags_fields{};
 
+    /// @brief Column-oriented copy of rows_, shared between copies of the
+    /// table. It is built whenever the rows are set by a constructor, so
+    /// rows_ should not be modified directly.
+    std::shared_ptr<const column_store> columns_{};
+
     /// @brief Creates a map of column names to header index values.
     /// @param hfs
     /// @return
@@ -110,7 +120,8 @@ class table {
           rows_{rws},
           name{name},
           column_name_index_map{
-              headers_to_column_name_index_map(header_fields_)} {}
+              headers_to_column_name_index_map(header_fields_)},
+          columns_{column_store::make(header_fields_, rows_)} {}
 
     /// @brief Constructor taking headers and data.
     /// @param h_and_d
@@ -124,7 +135,8 @@ class table {
         : header_fields_{other.header_fields_},
           rows_{other.rows_},
           name{other.name},
-          column_name_index_map{other.column_name_index_map} {}
+          column_name_index_map{other.column_name_index_map},
+          columns_{other.columns_} {}
 
     /// @brief Special copy constructor that replaces the rows.
     /// @param other_table
@@ -133,7 +145,8 @@ class table {
         : header_fields_{other_table.header_fields_},
           name{other_table.name},
           column_name_index_map{other_table.column_name_index_map},
-          rows_{rows_subset} {}
+          rows_{rows_subset},
+          columns_{column_store::make(header_fields_, rows_)} {}
 
     /// @brief Special copy constructor that replaces the optional rows.
     /// @param other_table
@@ -142,7 +155,9 @@ class table {
         : header_fields_{other_table.header_fields_},
           name{other_table.name},
           column_name_index_map{other_table.column_name_index_map},
-          rows_{rows_subset ? *rows_subset : other_table.rows_} {}
+          rows_{rows_subset ? *rows_subset : other_table.rows_},
+          columns_{rows_subset ? column_store::make(header_fields_, rows_)
+                               : other_table.columns_} {}
 
     /// @brief Move constructor.
     /// @param other
@@ -150,7 +165,8 @@ class table {
         : header_fields_{std::move(other.header_fields_)},
           rows_{std::move(other.rows_)},
           name{std::move(other.name)},
-          column_name_index_map{std::move(other.column_name_index_map)} {}
+          column_name_index_map{std::move(other.column_name_index_map)},
+          columns_{std::move(other.columns_)} {}
 
     /// @brief Special move constructor that replaces the rows.
     /// @param other_table
@@ -159,7 +175,8 @@ class table {
         : header_fields_{std::move(other_table.header_fields_)},
           name{std::move(other_table.name)},
           column_name_index_map{std::move(other_table.column_name_index_map)},
-          rows_{std::move(rows_subset)} {}
+          rows_{std::move(rows_subset)},
+          columns_{column_store::make(header_fields_, rows_)} {}
 
     /// @brief Special move constructor that replaces the optional rows.
     /// @param other_table
@@ -169,7 +186,9 @@ class table {
           name{other_table.name},
           column_name_index_map{other_table.column_name_index_map},
           rows_{rows_subset ? std::move(*rows_subset)
-                            : std::move(other_table.rows_)} {}
+                            : std::move(other_table.rows_)},
+          columns_{rows_subset ? column_store::make(header_fields_, rows_)
+                               : std::move(other_table.columns_)} {}
 
     /// @brief Static factory function for tables from files.
     /// @param filename
@@ -196,6 +215,7 @@ class table {
         swap(rows_, other.rows_);
         swap(name, other.name);
         swap(column_name_index_map, other.column_name_index_map);
+        swap(columns_, other.columns_);
     }
 
     /// @brief Copy assignment.
@@ -216,6 +236,64 @@ class table {
         return *this;
     }
 
+    /// @brief The column-oriented copy of the rows.
+    /// @return const reference to the column store.
+    const column_store& columns() const noexcept {
+        static const column_store no_columns{};
+        return columns_ ? *columns_ : no_columns;
+    }
+
+    /// @brief Shared handle to the column store, so that a query plan can
+    /// keep the columns it was planned against.
+    /// @return shared_ptr to the column store; may be null.
+    std::shared_ptr<const column_store> column_store_ptr() const noexcept {
+        return columns_;
+    }
+
+    /// @brief A copy of this table with rows added at the end. The columns
+    /// are extended from this table's rather than built again.
+    /// @param new_rows Rows with the same columns, of the same types.
+    /// @return table
+    table appended(rows&& new_rows) const {
+        table result{*this};
+        result.rows_.reserve(rows_.size() + new_rows.size());
+        std::ranges::move(new_rows, std::back_inserter(result.rows_));
+        result.columns_ =
+            columns_ ? columns_->appended(header_fields_, result.rows_)
+                     : column_store::make(header_fields_, result.rows_);
+        return result;
+    }
+
+    /// @brief A table with the same columns and edited rows, most of which
+    /// are unchanged copies of this table's. The columns are built from this
+    /// table's where they can be; see column_store::edited().
+    /// @param new_rows All the rows of the new version.
+    /// @param source For each row, the row of this table it is a copy of,
+    /// or no_row; the rows copied are in increasing order.
+    /// @return table
+    table edited(rows&& new_rows, std::span<const std::uint32_t> source) const {
+        table result{};
+        result.header_fields_ = header_fields_;
+        result.name = name;
+        result.column_name_index_map = column_name_index_map;
+        result.rows_ = std::move(new_rows);
+        result.columns_ =
+            columns_ ? columns_->edited(header_fields_, result.rows_, source)
+                     : column_store::make(header_fields_, result.rows_);
+        return result;
+    }
+
+    /// @brief Copies the selected rows, in row order.
+    /// @param selection
+    /// @return rows
+    rows gather(const bitmap& selection) const {
+        rows result;
+        result.reserve(selection.count());
+        selection.for_each_set(
+            [this, &result](size_t r) { result.push_back(rows_[r]); });
+        return result;
+    }
+
     /// @brief Returns information about the table's header field for the given
     /// column index.
     /// @param idx
@@ -230,16 +308,11 @@ class table {
     /// @note This assumes that all the column names are different.
     const std::expected<size_t, parser::error> index_for_column_name(
         const string& col_name) const {
-        using map_t = column_name_index_map_t;
-        using value_t = column_name_index_map_t::value_type;
-        auto res = std::find_if(
-            column_name_index_map.begin(), column_name_index_map.end(),
-            [&col_name](const value_t& v) { return v.first == col_name; });
+        const auto res = column_name_index_map.find(col_name);
         if (res == column_name_index_map.end()) {
             return std::unexpected(parser::error::column_name_not_found_error);
         }
-        auto result = res->second;
-        return result;
+        return res->second;
     }
 
     // Functions to check the data type of a given column name.
@@ -288,33 +361,9 @@ class table {
     /// @param col_name
     /// @return e_cell_data_type
     e_cell_data_type column_type(const std::string& col_name) const {
-        using ecdt = e_cell_data_type;
-
-        if (is_undetermined(col_name)) {
-            return ecdt::undetermined;
-        }
-        if (is_invalid(col_name)) {
-            return ecdt::invalid;
-        }
-        if (is_boolean(col_name)) {
-            return ecdt::boolean;
-        }
-        if (is_floating(col_name)) {
-            return ecdt::floating;
-        }
-        if (is_integer(col_name)) {
-            return ecdt::integer;
-        }
-        if (is_text(col_name)) {
-            return ecdt::text;
-        }
-        if (is_geo_coordinate(col_name)) {
-            return ecdt::geo_coordinate;
-        }
-        if (is_tags(col_name)) {
-            return ecdt::tags;
-        }
-        return ecdt::undetermined;
+        const auto idx = index_for_column_name(col_name);
+        if (!idx) return e_cell_data_type::undetermined;
+        return header_field_at_index(*idx).data_type;
     }
 };
 
@@ -0,0 +1,57 @@
+#pragma once
+
+// Follows a catalog file that rows are appended to while the program runs,
+// such as by an ingestion pipeline as photos arrive. A thread waits for the
+// file to change and calls live_table::catch_up(), which adds only the new
+// lines to the table (see live_table.hpp); commands see them as soon as the
+// new table is published.
+// On Linux the file's directory is watched with inotify, so the thread wakes
+// as soon as the file is written, and a file moved or copied into place of
+// the old one is read again as a whole. Elsewhere the file's size is checked
+// every poll_interval.
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "live_table.hpp"
+
+namespace jt {
+
+/// @brief Keeps a live_table up to date with its growing file.
+class table_follower {
+    live_table& tables_;
+    std::FILE* messages_{nullptr};
+    std::jthread thread_{};
+
+    /// @brief Catches up with the file, or reads it again if it was
+    /// replaced, and says what was done.
+    /// @return false if the file was replaced but could not be read.
+    bool check(bool replaced);
+
+    /// @brief Waits for changes to the file with inotify.
+    /// @return false if the file cannot be watched that way.
+    bool watch(std::stop_token stop);
+
+    /// @brief Checks the file every poll_interval.
+    void poll(std::stop_token stop);
+
+   public:
+    /// @brief How often the file is checked where it cannot be watched.
+    static constexpr std::chrono::milliseconds poll_interval{200};
+
+    /// @brief Starts following the table's file.
+    /// @param tables A table read by reload(), so that how much of the file
+    /// it holds is known.
+    /// @param messages Where to say how many rows were added, and what went
+    /// wrong; nullptr for nowhere.
+    explicit table_follower(live_table& tables, std::FILE* messages = stderr);
+
+    table_follower(const table_follower&) = delete;
+    table_follower& operator=(const table_follower&) = delete;
+
+    /// @brief Stops following, and waits for the thread to finish.
+    ~table_follower() = default;
+};
+
+}  // namespace jt
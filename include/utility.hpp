@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cctype>
 #include <concepts>
+#include <cstdint>
 #include <cstdlib>
 #include <expected>
 #include <filesystem>
@@ -46,7 +47,12 @@ namespace jt {
 
 using std::operator""s;
 
-inline std::optional<std::string> lineread(const std::string& prompt = ""s) {
+/// @brief Reads a line from the terminal, with editing.
+/// @param prompt
+/// @param remember Whether the line is added to the history.
+/// @return The line, or nothing at end of input.
+inline std::optional<std::string> lineread(
+    const std::string& prompt = ""s, [[maybe_unused]] bool remember = true) {
     // Windows does not have Gnu Readline.
 #if defined(_WIN64)
     std::string input_line;
@@ -63,7 +69,7 @@ inline std::optional<std::string> lineread(const std::string& prompt = ""s) {
         return {};
     } else {
         std::string sbuf{buf.get()};
-        add_history(sbuf.c_str());
+        if (remember) add_history(sbuf.c_str());
         return sbuf;
     }
 #endif
@@ -490,6 +496,17 @@ constexpr bool bool_greater_equal(bool lhs, bool rhs) noexcept {
     return !bool_less(lhs, rhs);
 }
 
+/// @brief FNV-1a: a hash that is the same on every platform and in every
+/// run, for values that are compared across processes.
+constexpr std::uint64_t stable_hash(std::string_view bytes) noexcept {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char c : bytes) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
 inline string path_to_string(const std::filesystem::path& fsp) {
 #if defined(_WIN64)
     // Calculating the length of the multibyte string
@@ -0,0 +1,570 @@
+#include "aggregate.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "column_stats.hpp"
+#include "column_store.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+
+using std::string;
+using std::string_view;
+using std::unexpected;
+using std::vector;
+using ecdt = e_cell_data_type;
+
+namespace {
+/// @brief Widest range of integer group values that gets an array of
+/// accumulators rather than a hash table.
+constexpr std::int64_t direct_group_limit{std::int64_t{1} << 16};
+
+string_view name_of(aggregate_fn fn) noexcept {
+    switch (fn) {
+        case aggregate_fn::sum:
+            return "sum";
+        case aggregate_fn::avg:
+            return "avg";
+        case aggregate_fn::min:
+            return "min";
+        case aggregate_fn::max:
+            return "max";
+        default:
+            return "count";
+    }
+}
+
+plan_error unknown_column(const column_ref& ref) {
+    return plan_error{plan_error::kind::unknown_column,
+                      std::format("Column \"{}\" is not in this file.",
+                                  ref.column_name)};
+}
+
+/// @brief Where an aggregate reads its values. A column that is neither
+/// integer nor floating point only has its values counted.
+struct value_source {
+    std::span<const std::int32_t> ints{};
+    std::span<const float> floats{};
+    const bitmap* present{nullptr};
+
+    double at(size_t r) const noexcept {
+        if (!ints.empty()) return static_cast<double>(ints[r]);
+        if (!floats.empty()) return static_cast<double>(floats[r]);
+        return 0.0;
+    }
+};
+
+/// @brief How rows are assigned to groups.
+struct group_source {
+    enum class kind {
+        /// @brief Every row is in group 0.
+        single,
+
+        /// @brief The group is worked out from the row's value: dictionary
+        /// code, boolean, or integer minus base. Rows without a value go in
+        /// group value_slots.
+        direct,
+
+        /// @brief The group is looked up by the bits of the row's value in a
+        /// flat_key_map. Rows without a value go in group 0.
+        hashed
+    };
+
+    kind how{kind::single};
+    std::span<const std::int32_t> ints{};
+    std::span<const float> floats{};
+    const bitmap* bools{nullptr};
+    const bitmap* present{nullptr};
+    std::int32_t base{0};
+    size_t value_slots{0};
+
+    /// @brief Number of groups before any row is seen.
+    size_t initial_slots() const noexcept {
+        switch (how) {
+            case kind::direct:
+                return value_slots + 1;
+            default:
+                return 1;
+        }
+    }
+
+    size_t direct_slot(size_t r) const noexcept {
+        if (!present->test(r)) return value_slots;
+        if (bools) return bools->test(r) ? 1 : 0;
+        return static_cast<size_t>(static_cast<std::int64_t>(ints[r]) - base);
+    }
+
+    /// @brief The hash key for a row's value: the integer, or the float's
+    /// bits with -0 folded into 0.
+    std::uint32_t key(size_t r) const noexcept {
+        if (!ints.empty()) return static_cast<std::uint32_t>(ints[r]);
+        const float v = floats[r] == 0.0f ? 0.0f : floats[r];
+        return std::bit_cast<std::uint32_t>(v);
+    }
+};
+
+/// @brief Hash table from 32-bit keys to group numbers, with open
+/// addressing and linear probing in flat arrays.
+class flat_key_map {
+    static constexpr std::uint32_t no_slot{
+        std::numeric_limits<std::uint32_t>::max()};
+
+    vector<std::uint32_t> keys_{};
+    vector<std::uint32_t> slots_{};
+    size_t size_{0};
+
+    size_t home(std::uint32_t key) const noexcept {
+        const std::uint64_t h = key * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(h >> 32) & (keys_.size() - 1);
+    }
+
+    void grow() {
+        vector<std::uint32_t> old_keys(keys_.size() * 2);
+        vector<std::uint32_t> old_slots(keys_.size() * 2, no_slot);
+        old_keys.swap(keys_);
+        old_slots.swap(slots_);
+        for (size_t i = 0; i < old_keys.size(); ++i) {
+            if (old_slots[i] == no_slot) continue;
+            size_t at = home(old_keys[i]);
+            while (slots_[at] != no_slot) at = (at + 1) & (keys_.size() - 1);
+            keys_[at] = old_keys[i];
+            slots_[at] = old_slots[i];
+        }
+    }
+
+   public:
+    flat_key_map() : keys_(16), slots_(16, no_slot) {}
+
+    /// @brief The group for key, calling make_slot() for a new one if the
+    /// key has not been seen.
+    template <class MakeSlot>
+    size_t find_or_add(std::uint32_t key, MakeSlot&& make_slot) {
+        size_t at = home(key);
+        while (slots_[at] != no_slot) {
+            if (keys_[at] == key) return slots_[at];
+            at = (at + 1) & (keys_.size() - 1);
+        }
+        const auto slot = static_cast<std::uint32_t>(make_slot());
+        keys_[at] = key;
+        slots_[at] = slot;
+        // Keep the table at most half full, so probes stay short.
+        if (++size_ * 2 > keys_.size()) grow();
+        return slot;
+    }
+
+    /// @brief Calls fn(key, slot) for every entry.
+    template <class Fn>
+    void for_each(Fn&& fn) const {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (slots_[i] != no_slot) fn(keys_[i], slots_[i]);
+        }
+    }
+};
+
+/// @brief One thread's accumulators: a row count and, for each value
+/// source, an accumulator, per group.
+struct partial {
+    size_t width{0};
+    vector<std::uint64_t> rows{};
+    vector<aggregate_totals> totals{};
+    flat_key_map keys{};
+
+    partial(size_t sources, size_t slots)
+        : width{sources}, rows(slots), totals(slots * sources) {}
+
+    size_t add_slot() {
+        const size_t slot = rows.size();
+        rows.push_back(0);
+        totals.resize(totals.size() + width);
+        return slot;
+    }
+
+    void merge_slot(size_t to, const partial& from, size_t from_slot) {
+        rows[to] += from.rows[from_slot];
+        for (size_t j = 0; j < width; ++j) {
+            totals[to * width + j].merge(from.totals[from_slot * width + j]);
+        }
+    }
+};
+
+/// @brief Adds the selected rows in [first, last) to a partial.
+void accumulate(partial& p, const group_source& groups,
+                std::span<const value_source> sources, const bitmap& selection,
+                size_t first, size_t last) {
+    const auto words = selection.words();
+    for (size_t wi = first / bitmap::word_bits;
+         wi * bitmap::word_bits < last && wi < words.size(); ++wi) {
+        bitmap::word_t w = words[wi];
+        while (w != 0) {
+            const size_t r = wi * bitmap::word_bits +
+                             static_cast<size_t>(std::countr_zero(w));
+            w &= w - 1;
+            size_t slot = 0;
+            if (groups.how == group_source::kind::direct) {
+                slot = groups.direct_slot(r);
+            } else if (groups.how == group_source::kind::hashed &&
+                       groups.present->test(r)) {
+                slot = p.keys.find_or_add(groups.key(r),
+                                          [&p] { return p.add_slot(); });
+            }
+            ++p.rows[slot];
+            for (size_t j = 0; j < sources.size(); ++j) {
+                if (sources[j].present->test(r)) {
+                    p.totals[slot * p.width + j].add(sources[j].at(r));
+                }
+            }
+        }
+    }
+}
+
+/// @brief An int cell if v is a whole number that fits, else a float cell.
+data_cell number_cell(double v, bool whole) {
+    if (whole && v >= std::numeric_limits<int>::min() &&
+        v <= std::numeric_limits<int>::max()) {
+        return data_cell{ecdt::integer,
+                         cell_value_types{std::in_place_type<int>,
+                                          static_cast<int>(v)}};
+    }
+    return data_cell{ecdt::floating,
+                     cell_value_types{std::in_place_type<float>,
+                                      static_cast<float>(v)}};
+}
+
+data_cell empty_cell(ecdt type) { return data_cell{type, std::nullopt}; }
+
+/// @brief Whether one group value goes before another of the same column.
+bool key_less(const cell_value_types& a, const cell_value_types& b) {
+    if (a.index() != b.index()) return a.index() < b.index();
+    if (const auto* v = std::get_if<int>(&a)) return *v < std::get<int>(b);
+    if (const auto* v = std::get_if<float>(&a)) return *v < std::get<float>(b);
+    if (const auto* v = std::get_if<bool>(&a)) return *v < std::get<bool>(b);
+    if (const auto* v = std::get_if<string>(&a)) {
+        return *v < std::get<string>(b);
+    }
+    return false;
+}
+}  // namespace
+
+std::expected<aggregate_plan, plan_error> aggregate_plan::make(
+    const table& t, const query_statement& statement) {
+    aggregate_plan result{};
+    result.columns_ = t.column_store_ptr();
+
+    for (const aggregate_call& call : statement.aggregates) {
+        plan_aggregate pa{call.fn};
+        if (call.column.column_name.empty()) {
+            pa.heading = string{name_of(call.fn)};
+            pa.type = ecdt::integer;
+            result.aggregates_.push_back(std::move(pa));
+            continue;
+        }
+        const auto col_idx = t.index_for_column_name(call.column.column_name);
+        if (!col_idx) return unexpected(unknown_column(call.column));
+        pa.column = *col_idx;
+        pa.type = t.header_field_at_index(*col_idx).data_type;
+        pa.heading = std::format("{}({})", name_of(call.fn),
+                                 call.column.column_name);
+        if (call.fn != aggregate_fn::count && pa.type != ecdt::integer &&
+            pa.type != ecdt::floating) {
+            return unexpected(plan_error{
+                plan_error::kind::wrong_operator,
+                std::format("Error: {} cannot be used with column \"{}\" of "
+                            "type {}",
+                            name_of(call.fn), call.column.column_name,
+                            pa.type)});
+        }
+        result.aggregates_.push_back(std::move(pa));
+    }
+
+    if (statement.group_by) {
+        const column_ref& ref = *statement.group_by;
+        const auto col_idx = t.index_for_column_name(ref.column_name);
+        if (!col_idx) return unexpected(unknown_column(ref));
+        const ecdt type = t.header_field_at_index(*col_idx).data_type;
+        switch (type) {
+            case ecdt::integer:
+            case ecdt::floating:
+            case ecdt::text:
+            case ecdt::boolean:
+                break;
+            default:
+                return unexpected(plan_error{
+                    plan_error::kind::unsupported,
+                    std::format("Error: cannot group by column \"{}\" of "
+                                "type {}",
+                                ref.column_name, type)});
+        }
+        result.group_column_ = *col_idx;
+        result.group_name_ = ref.column_name;
+        result.group_type_ = type;
+    }
+    return result;
+}
+
+aggregate_groups aggregate_plan::run_groups(const bitmap& selection,
+                                           scheduler* sched) const {
+    static const column_store no_columns{};
+    const column_store& cs = columns_ ? *columns_ : no_columns;
+
+    // Where each aggregate with a column reads its values.
+    const bitmap no_values(selection.size());
+    vector<value_source> sources{};
+    vector<std::optional<size_t>> source_of{};
+    for (const plan_aggregate& pa : aggregates_) {
+        if (!pa.column) {
+            source_of.emplace_back();
+            continue;
+        }
+        value_source src{};
+        if (const auto* col = cs.get_if<integer_column>(*pa.column)) {
+            src = {col->values, {}, &col->present};
+        } else if (const auto* col = cs.get_if<floating_column>(*pa.column)) {
+            src = {{}, col->values, &col->present};
+        } else {
+            std::visit(
+                [&src](const auto& col) {
+                    if constexpr (requires { col.present; }) {
+                        src.present = &col.present;
+                    }
+                },
+                cs.at(*pa.column));
+            if (!src.present) src.present = &no_values;
+        }
+        source_of.emplace_back(sources.size());
+        sources.push_back(src);
+    }
+
+    // How rows are put in groups.
+    group_source groups{};
+    const vector<string>* dictionary = nullptr;
+    if (group_column_) {
+        const size_t g = *group_column_;
+        if (const auto* col = cs.get_if<text_column>(g)) {
+            groups = {group_source::kind::direct, col->codes, {}, nullptr,
+                      &col->present, 0, col->dictionary.size()};
+            dictionary = &col->dictionary;
+        } else if (const auto* col = cs.get_if<boolean_column>(g)) {
+            groups = {group_source::kind::direct, {}, {}, &col->values,
+                      &col->present, 0, 2};
+        } else if (const auto* col = cs.get_if<integer_column>(g)) {
+            groups = {group_source::kind::hashed, col->values, {}, nullptr,
+                      &col->present};
+            const auto& h = cs.stats(g).values_histogram;
+            if (!h || cs.stats(g).present_count == 0) {
+                groups.how = group_source::kind::direct;
+            } else if (const auto span = static_cast<std::int64_t>(h->max) -
+                                         static_cast<std::int64_t>(h->min);
+                       span < direct_group_limit) {
+                groups.how = group_source::kind::direct;
+                groups.base = static_cast<std::int32_t>(h->min);
+                groups.value_slots = static_cast<size_t>(span) + 1;
+            }
+        } else if (const auto* col = cs.get_if<floating_column>(g)) {
+            groups = {group_source::kind::hashed, {}, col->values, nullptr,
+                      &col->present};
+        }
+    }
+
+    // One partial per range of rows; each range is a multiple of the bitmap
+    // word size, so ranges do not share words.
+    const size_t n = selection.size();
+    size_t ranges = 1;
+    if (sched && n > morsel_rows) {
+        ranges = std::min(sched->worker_count() + 1,
+                          (n + morsel_rows - 1) / morsel_rows);
+    }
+    const size_t range_rows =
+        ((n + ranges - 1) / ranges + bitmap::word_bits - 1) /
+        bitmap::word_bits * bitmap::word_bits;
+    vector<partial> partials(ranges,
+                             partial{sources.size(), groups.initial_slots()});
+    auto run_range = [&](size_t i) {
+        const size_t first = i * range_rows;
+        accumulate(partials[i], groups, sources, selection, first,
+                   std::min(n, first + range_rows));
+    };
+    if (sched) {
+        sched->parallel_for(ranges, run_range);
+    } else {
+        run_range(0);
+    }
+
+    partial& total = partials.front();
+    for (size_t i = 1; i < partials.size(); ++i) {
+        const partial& p = partials[i];
+        if (groups.how == group_source::kind::hashed) {
+            total.merge_slot(0, p, 0);
+            p.keys.for_each([&total, &p](std::uint32_t key, size_t slot) {
+                const size_t to = total.keys.find_or_add(
+                    key, [&total] { return total.add_slot(); });
+                total.merge_slot(to, p, slot);
+            });
+        } else {
+            for (size_t slot = 0; slot < p.rows.size(); ++slot) {
+                total.merge_slot(slot, p, slot);
+            }
+        }
+    }
+
+    // The groups in output order, each with the cell for its value.
+    vector<std::pair<size_t, data_cell>> order{};
+    if (groups.how == group_source::kind::direct) {
+        for (size_t slot = 0; slot < groups.value_slots; ++slot) {
+            if (total.rows[slot] == 0) continue;
+            if (dictionary) {
+                order.emplace_back(
+                    slot, data_cell{ecdt::text,
+                                    cell_value_types{std::in_place_type<string>,
+                                                     (*dictionary)[slot]}});
+            } else if (groups.bools) {
+                order.emplace_back(
+                    slot, data_cell{ecdt::boolean,
+                                    cell_value_types{std::in_place_type<bool>,
+                                                     slot == 1}});
+            } else {
+                order.emplace_back(
+                    slot,
+                    data_cell{ecdt::integer,
+                              cell_value_types{std::in_place_type<int>,
+                                               groups.base +
+                                                   static_cast<int>(slot)}});
+            }
+        }
+        if (total.rows[groups.value_slots] > 0) {
+            order.emplace_back(groups.value_slots, empty_cell(group_type_));
+        }
+    } else if (groups.how == group_source::kind::hashed) {
+        vector<std::pair<std::uint32_t, size_t>> keyed{};
+        total.keys.for_each([&keyed](std::uint32_t key, size_t slot) {
+            keyed.emplace_back(key, slot);
+        });
+        const bool ints = !groups.ints.empty();
+        auto value_of = [ints](std::uint32_t key) {
+            return ints ? static_cast<double>(static_cast<std::int32_t>(key))
+                        : static_cast<double>(std::bit_cast<float>(key));
+        };
+        std::ranges::sort(keyed, {}, [&value_of](const auto& kv) {
+            return value_of(kv.first);
+        });
+        for (const auto& [key, slot] : keyed) {
+            order.emplace_back(
+                slot, ints ? data_cell{ecdt::integer,
+                                       cell_value_types{
+                                           std::in_place_type<int>,
+                                           static_cast<std::int32_t>(key)}}
+                           : data_cell{ecdt::floating,
+                                       cell_value_types{
+                                           std::in_place_type<float>,
+                                           std::bit_cast<float>(key)}});
+        }
+        if (total.rows[0] > 0) order.emplace_back(0, empty_cell(group_type_));
+    } else {
+        // Without groups there is always one row, even if nothing matched.
+        order.emplace_back(0, empty_cell(ecdt::undetermined));
+    }
+
+    aggregate_groups result{};
+    for (const auto& [slot, key_cell] : order) {
+        aggregate_group group{key_cell, total.rows[slot]};
+        group.totals.resize(aggregates_.size());
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            if (source_of[a]) {
+                group.totals[a] =
+                    total.totals[slot * total.width + *source_of[a]];
+            }
+        }
+        result.push_back(std::move(group));
+    }
+    return result;
+}
+
+aggregate_groups aggregate_plan::merge(
+    std::span<const aggregate_groups> parts) const {
+    // Groups in value order, with the group without a value last.
+    auto before = [](const aggregate_group& a, const aggregate_group& b) {
+        if (!a.key.value || !b.key.value) {
+            return a.key.value.has_value() && !b.key.value.has_value();
+        }
+        return key_less(*a.key.value, *b.key.value);
+    };
+    aggregate_groups result{};
+    for (const aggregate_groups& part : parts) {
+        for (const aggregate_group& g : part) {
+            const auto at = std::ranges::lower_bound(result, g, before);
+            if (at != result.end() && !before(g, *at)) {
+                at->rows += g.rows;
+                for (size_t a = 0; a < at->totals.size(); ++a) {
+                    at->totals[a].merge(g.totals[a]);
+                }
+            } else {
+                result.insert(at, g);
+            }
+        }
+    }
+    if (result.empty() && !group_column_) {
+        aggregate_group none{empty_cell(ecdt::undetermined)};
+        none.totals.resize(aggregates_.size());
+        result.push_back(std::move(none));
+    }
+    return result;
+}
+
+aggregate_result aggregate_plan::finish(const aggregate_groups& groups) const {
+    aggregate_result result{};
+    if (group_column_) result.headings.push_back(group_name_);
+    for (const plan_aggregate& pa : aggregates_) {
+        result.headings.push_back(pa.heading);
+    }
+    for (const aggregate_group& group : groups) {
+        row out{};
+        if (group_column_) out.push_back(group.key);
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            const plan_aggregate& pa = aggregates_[a];
+            if (!pa.column) {
+                out.push_back(
+                    number_cell(static_cast<double>(group.rows), true));
+                continue;
+            }
+            const aggregate_totals& acc = group.totals[a];
+            const bool whole = pa.type == ecdt::integer;
+            if (pa.fn == aggregate_fn::count) {
+                out.push_back(
+                    number_cell(static_cast<double>(acc.count), true));
+            } else if (acc.count == 0) {
+                out.push_back(empty_cell(pa.type));
+            } else if (pa.fn == aggregate_fn::sum) {
+                out.push_back(number_cell(acc.sum, whole));
+            } else if (pa.fn == aggregate_fn::avg) {
+                out.push_back(number_cell(
+                    acc.sum / static_cast<double>(acc.count), false));
+            } else if (pa.fn == aggregate_fn::min) {
+                out.push_back(number_cell(acc.min, whole));
+            } else {
+                out.push_back(number_cell(acc.max, whole));
+            }
+        }
+        result.rows.push_back(std::move(out));
+    }
+    return result;
+}
+
+}  // namespace jt
@@ -0,0 +1,161 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <numeric>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "block_filter.hpp"
+#include "clause_cache.hpp"
+#include "column_store.hpp"
+#include "projection.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::vector;
+
+query_batch query_batch::make(const table& t, const vector<string>& lines) {
+    query_batch result{};
+    result.columns_ = t.column_store_ptr();
+
+    // Where each different clause is in clauses_, before sorting.
+    std::unordered_map<clause_key, size_t, clause_key_hash> positions{};
+    size_t number = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const string text = trim(lines[i]);
+        const size_t start = text.find_first_not_of(" \t");
+        if (start == string::npos || text[start] == '#') continue;
+        ++number;
+        auto problem = [&](string message) {
+            result.problems_.push_back({number, i + 1, std::move(message)});
+        };
+
+        const auto statement = parse_query_statement(text);
+        if (!statement) {
+            problem(std::format("{} at position {}", statement.error().message,
+                                statement.error().position));
+            continue;
+        }
+        const auto kind = statement->statement_kind;
+        if (kind != query_statement::kind::query &&
+            kind != query_statement::kind::select) {
+            problem("only query and select statements can be run in a batch");
+            continue;
+        }
+        auto columns = kind == query_statement::kind::select
+                           ? projection::make(t, statement->select_columns)
+                           : projection::all(t);
+        if (!columns) {
+            problem(columns.error().message);
+            continue;
+        }
+        auto plan = query_plan::make(t, *statement);
+        if (!plan) {
+            problem(plan.error().message);
+            continue;
+        }
+
+        batch_query query{number, i + 1, text, std::move(*plan),
+                          std::move(*columns), {}};
+        for (const plan_clause& pc : query.plan.clauses()) {
+            const auto [it, added] = positions.try_emplace(
+                make_clause_key(pc), result.clauses_.size());
+            if (added) result.clauses_.push_back(pc);
+            query.clauses.push_back(it->second);
+        }
+        result.clause_uses_ += query.clauses.size();
+        result.queries_.push_back(std::move(query));
+    }
+
+    // Sort the clauses by column, so that each column's clauses are applied
+    // together, and renumber the queries' references to them.
+    vector<size_t> order(result.clauses_.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::stable_sort(order, {}, [&](size_t c) {
+        return result.clauses_[c].column;
+    });
+    vector<size_t> renumbered(order.size());
+    vector<plan_clause> sorted{};
+    sorted.reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        renumbered[order[i]] = i;
+        sorted.push_back(std::move(result.clauses_[order[i]]));
+    }
+    result.clauses_ = std::move(sorted);
+    for (batch_query& query : result.queries_) {
+        for (size_t& c : query.clauses) c = renumbered[c];
+    }
+    return result;
+}
+
+vector<bitmap> query_batch::execute(scheduler* sched) const {
+    const column_store& cs = *columns_;
+    const size_t n = cs.row_count();
+
+    // Indexed clauses are looked up now; the others are grouped by column
+    // for the scan.
+    vector<bitmap> results(clauses_.size());
+    vector<block_filter> filters(clauses_.size());
+    vector<vector<size_t>> by_column{};
+    for (size_t c = 0; c < clauses_.size(); ++c) {
+        const plan_clause& pc = clauses_[c];
+        if (pc.use_index) {
+            results[c] = lookup_clause(cs, pc);
+            continue;
+        }
+        results[c] = bitmap(n, true);
+        filters[c] = make_block_filter(cs, pc);
+        if (by_column.empty() || clauses_[by_column.back().front()].column !=
+                                     pc.column) {
+            by_column.emplace_back();
+        }
+        by_column.back().push_back(c);
+    }
+
+    // Each morsel writes only its own words of each result.
+    auto scan_morsel = [&](size_t m) {
+        const size_t first = m * morsel_rows;
+        const size_t last = std::min(n, first + morsel_rows);
+        for (const vector<size_t>& column_clauses : by_column) {
+            for (size_t begin = first; begin < last;
+                 begin += fused_block_rows) {
+                const size_t end = std::min(last, begin + fused_block_rows);
+                for (const size_t c : column_clauses) {
+                    fused_scan_rows(std::span{&filters[c], 1},
+                                    results[c].words(), begin, end);
+                }
+            }
+        }
+    };
+    const size_t morsels = (n + morsel_rows - 1) / morsel_rows;
+    if (!by_column.empty()) {
+        if (sched && morsels > 1) {
+            sched->parallel_for(morsels, scan_morsel);
+        } else {
+            for (size_t m = 0; m < morsels; ++m) scan_morsel(m);
+        }
+    }
+
+    vector<bitmap> selections{};
+    selections.reserve(queries_.size());
+    for (const batch_query& query : queries_) {
+        bitmap selection(n, true);
+        for (const size_t c : query.clauses) selection &= results[c];
+        selections.push_back(std::move(selection));
+    }
+    return selections;
+}
+
+}  // namespace jt
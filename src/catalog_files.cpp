@@ -0,0 +1,271 @@
+#include "catalog_files.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "cell.hpp"
+#include "parser.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::vector;
+
+namespace {
+namespace fs = std::filesystem;
+
+/// @brief Whether a name holds '*' or '?'.
+bool has_wildcard(std::string_view name) noexcept {
+    return name.find_first_of("*?") != std::string_view::npos;
+}
+
+/// @brief Whether a name matches a pattern, in which '*' stands for any
+/// characters and '?' for any one character.
+bool matches(std::string_view pattern, std::string_view name) noexcept {
+    size_t p = 0;
+    size_t n = 0;
+    // Where the last '*' was, and the character of name it was matched up
+    // to, to go back to if what follows it stops matching.
+    size_t star = std::string_view::npos;
+    size_t star_n = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_n = n;
+        } else if (p < pattern.size() &&
+                   (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            n = ++star_n;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+/// @brief The regular files in a directory whose names are accepted, in
+/// name order.
+template <class Accept>
+std::expected<vector<string>, string> list_files(const fs::path& directory,
+                                                 Accept&& accept) {
+    std::error_code ec{};
+    vector<string> result{};
+    for (fs::directory_iterator it{directory, ec}, end{}; !ec && it != end;
+         it.increment(ec)) {
+        std::error_code type_ec{};
+        if (!it->is_regular_file(type_ec)) continue;
+        if (accept(path_to_string(it->path().filename()))) {
+            result.push_back(path_to_string(it->path()));
+        }
+    }
+    if (ec) {
+        return std::unexpected(
+            std::format("could not read directory \"{}\": {}",
+                        path_to_string(directory), ec.message()));
+    }
+    std::ranges::sort(result);
+    return result;
+}
+}  // namespace
+
+std::expected<file_lines, string> read_lines(const string& filename,
+                                             std::uint64_t from) {
+    std::ifstream in{filename, std::ios::binary};
+    if (!in) {
+        return std::unexpected(
+            std::format("could not read CSV input file \"{}\"", filename));
+    }
+    in.seekg(static_cast<std::streamoff>(from));
+    string text{std::istreambuf_iterator<char>{in},
+                std::istreambuf_iterator<char>{}};
+    if (in.bad()) {
+        return std::unexpected(
+            std::format("could not read CSV input file \"{}\"", filename));
+    }
+    file_lines result{};
+    const size_t complete = text.rfind('\n');
+    result.end = complete == string::npos ? from : from + complete + 1;
+    result.read = from + text.size();
+    for (size_t start = 0; start < text.size();) {
+        const size_t stop = std::min(text.find('\n', start), text.size());
+        string line = text.substr(start, stop - start);
+        trim(line);
+        if (!line.empty()) {
+            result.lines.push_back(std::move(line));
+            result.unfinished = stop == text.size();
+        }
+        start = stop + 1;
+    }
+    return result;
+}
+
+bool names_one_file(const vector<string>& paths) {
+    if (paths.size() != 1) return false;
+    std::error_code ec{};
+    const fs::path path{paths.front()};
+    return !fs::is_directory(path, ec) &&
+           !has_wildcard(path_to_string(path.filename()));
+}
+
+std::expected<vector<string>, string> expand_catalog_paths(
+    const vector<string>& paths) {
+    vector<string> result{};
+    for (const string& name : paths) {
+        const fs::path path{name};
+        const string leaf = path_to_string(path.filename());
+        std::error_code ec{};
+        std::expected<vector<string>, string> found{};
+        if (fs::is_directory(path, ec)) {
+            found = list_files(path, [](const string& file) {
+                return to_lower(fs::path{file}.extension().string()) == ".csv";
+            });
+        } else if (has_wildcard(leaf)) {
+            const fs::path directory =
+                path.has_parent_path() ? path.parent_path() : fs::path{"."};
+            found = list_files(directory, [&leaf](const string& file) {
+                return matches(leaf, file);
+            });
+        } else {
+            result.push_back(name);
+            continue;
+        }
+        if (!found) return std::unexpected(found.error());
+        if (found->empty()) {
+            return std::unexpected(
+                std::format("no CSV input files in \"{}\"", name));
+        }
+        std::ranges::move(*found, std::back_inserter(result));
+    }
+    return result;
+}
+
+std::expected<table, string> combine_catalog_parts(
+    vector<catalog_part>&& parts) {
+    // Columns in the order they are first seen, and the file that decided
+    // each one's type, to name in a message.
+    parser::header_fields_t hfs{};
+    vector<const string*> typed_by{};
+    std::map<string, size_t, std::less<>> column_of{};
+    for (const catalog_part& part : parts) {
+        for (const parser::header_field& hf : part.header_fields) {
+            const auto [it, added] = column_of.try_emplace(hf.text, hfs.size());
+            if (added) {
+                hfs.emplace_back(hf.text, hf.data_type);
+                typed_by.push_back(&part.filename);
+                continue;
+            }
+            parser::header_field& known = hfs[it->second];
+            const e_cell_data_type combined = known.data_type || hf.data_type;
+            if (combined == e_cell_data_type::invalid &&
+                known.data_type != e_cell_data_type::invalid &&
+                hf.data_type != e_cell_data_type::invalid) {
+                return std::unexpected(std::format(
+                    "column \"{}\" holds {} values in \"{}\" but {} values "
+                    "in \"{}\"",
+                    hf.text, known.data_type, *typed_by[it->second],
+                    hf.data_type, part.filename));
+            }
+            if (known.data_type == e_cell_data_type::undetermined) {
+                typed_by[it->second] = &part.filename;
+            }
+            known.data_type = combined;
+        }
+    }
+    if (column_of.contains(source_column_name)) {
+        return std::unexpected(std::format(
+            "a CSV input file already has a column named \"{}\"",
+            source_column_name));
+    }
+    hfs.emplace_back(string{source_column_name}, e_cell_data_type::text);
+
+    // Each file's rows are copied into their place on a task of their own.
+    vector<size_t> first_row(parts.size() + 1, 0);
+    for (size_t p = 0; p < parts.size(); ++p) {
+        first_row[p + 1] = first_row[p] + parts[p].rows.size();
+    }
+    vector<row> rows(first_row.back());
+    const data_cell empty{
+        parser::data_field{"", e_cell_data_type::undetermined}};
+    scheduler::shared().parallel_for(parts.size(), [&](size_t p) {
+        catalog_part& part = parts[p];
+        vector<size_t> column(part.header_fields.size());
+        for (size_t c = 0; c < column.size(); ++c) {
+            column[c] = column_of.find(part.header_fields[c].text)->second;
+        }
+        const data_cell source{
+            parser::data_field{part.filename, e_cell_data_type::text}};
+        for (size_t r = 0; r < part.rows.size(); ++r) {
+            row& cells = rows[first_row[p] + r];
+            cells.assign(hfs.size(), empty);
+            // A short row leaves the columns it lacks empty.
+            const size_t count = std::min(column.size(), part.rows[r].size());
+            for (size_t c = 0; c < count; ++c) {
+                cells[column[c]] = std::move(part.rows[r][c]);
+            }
+            cells.back() = source;
+        }
+        part.rows = {};
+    });
+
+    string name{};
+    for (const catalog_part& part : parts) {
+        if (!name.empty()) name.append(", ");
+        name.append(path_to_string(fs::absolute(part.filename)));
+    }
+    table result{table{hfs, {}, std::move(name)}, std::move(rows)};
+    return result;
+}
+
+std::expected<table, string> read_catalog_files(
+    const vector<string>& filenames, vector<file_load>& loads) {
+    using clock = std::chrono::steady_clock;
+    vector<catalog_part> parts(filenames.size());
+    vector<string> errors(filenames.size());
+    loads.assign(filenames.size(), file_load{});
+    scheduler::shared().parallel_for(filenames.size(), [&](size_t i) {
+        const auto start = clock::now();
+        auto text = read_lines(filenames[i], 0);
+        if (!text) {
+            errors[i] = text.error();
+            return;
+        }
+        auto parsed = parse_lines(std::move(text->lines));
+        if (!parsed) {
+            errors[i] = std::format("could not read CSV input file \"{}\"",
+                                    filenames[i]);
+            return;
+        }
+        catalog_part& part = parts[i];
+        part.filename = filenames[i];
+        part.header_fields = std::move(parsed->header_fields);
+        part.rows =
+            data_cell::make_all_data_cells(std::move(parsed->all_data_fields));
+        loads[i] = {filenames[i], part.rows.size(), clock::now() - start};
+    });
+    for (const string& error : errors) {
+        if (!error.empty()) return std::unexpected(error);
+    }
+    return combine_catalog_parts(std::move(parts));
+}
+
+}  // namespace jt
@@ -1,56 +1,38 @@
 #include "command_line.hpp"
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <expected>
+#include <filesystem>
+#include <fstream>
+#include <optional>
 #include <ranges>
-#include <regex>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <vector>
 
+#include "aggregate.hpp"
+#include "batch.hpp"
+#include "bitmap.hpp"
+#include "catalog_files.hpp"
 #include "cell_types.hpp"
-#include "coordinates.hpp"
-#include "query.hpp"
+#include "projection.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "result_writer.hpp"
+#include "row_cursor.hpp"
+#include "scheduler.hpp"
 #include "table.hpp"
 #include "utility.hpp"
 
 namespace jt {
-using std::expected;
-using std::regex;
-using std::regex_match;
-using std::regex_replace;
-using std::regex_search;
-using std::smatch;
 using std::string;
-using std::unexpected;
 using std::vector;
 namespace ranges = std::ranges;
-namespace views = std::ranges::views;
-using ecdt = e_cell_data_type;
-
-enum class query_error { bad_format };
-
-// In this one, m[1] matches everything after the word "query" to the end of the
-// line.
-const string long_query_pattern_s{R"-(^\s*query\s*(\((.*)\))\s*$)-"};
-const regex long_query_pattern_rx{long_query_pattern_s};
-
-// Then we need to regularize any " && " strings in between the clauses,
-// so they can be split apart in the following step.
-const string and_separator_pattern_s{R"-((\)\s*&&\s*\())-"};
-const regex and_separator_pattern_rx{and_separator_pattern_s};
-
-// Query pattern that matches comparison operators.
-// If no operator is found, assume =.
-const string query_clause_pattern_s{
-    R"-(\(\s*"([^"]*)"\s+((tags|inside|=|!=|<|<=|>|>=)\s+)?(.*)\))-"};
-const regex query_clause_pattern_rx{query_clause_pattern_s};
-
-const string alt_query_clause_pattern_s{R"-(\s*\(.+\)\s*$)-"};
-
-const string new_query_pattern_s =
-    ""s + R"-(^(?:\s*query\s*)?)-" + query_clause_pattern_s;
-const regex new_query_pattern_rx{new_query_pattern_s};
 
 string row_to_string(const row& rw) {
     std::ostringstream sout{};
@@ -70,200 +52,641 @@ string row_to_string(const row& rw) {
     return sout.str();
 }
 
-const string points_in_query_s{
-    R"-(^(?:\s*query\s*)?\(\s*"(.*)"\s+(?:(("(.*)")|(\((.*)\)))\s*)?\s*inside\b\s*(.+))-"};
-const regex points_in_query_rx{points_in_query_s};
-
-// m[1] = column name.
-constexpr size_t points_in_query_column_name_idx{1};
-
-// m[2] = all the coordinates after the "in".
-constexpr size_t points_in_query_polygon_idx{7};
-
-query::comparison str_to_comparison(const string& ss) {
-    using qc = query::comparison;
-    const string s = to_lower(ss);
-
-    if (s == "=") return qc::equal_to;
-    if (s == "!=") return qc::not_equal_to;
-    if (s == ">") return qc::greater;
-    if (s == "<") return qc::less;
-    if (s == ">=") return qc::greater_equal;
-    if (s == "<=") return qc::less_equal;
-    if (s == "inside") return qc::inside;
-    if (s == "tags") return qc::tags;
-    if (s == "") return qc::equal_to;
-    return qc::invalid;
+void print_aggregate_result(std::FILE* out, const aggregate_result& result,
+                            size_t rows) {
+    string headings{};
+    for (size_t i = 0; i < result.headings.size(); ++i) {
+        if (i > 0) headings.append(",");
+        headings.append(result.headings[i]);
+    }
+    println(out, "{}", headings);
+    for (const row& rw : result.rows) {
+        println(out, "{}", row_to_string(rw));
+    }
+    println(out, "{} groups from {} rows", result.rows.size(), rows);
+}
+
+void print_facet_result(std::FILE* out, const facet_result& result) {
+    for (const facet& f : result.facets) {
+        string line = std::format("{}:", f.column_name);
+        for (size_t i = 0; i < f.top.size(); ++i) {
+            line.append(std::format("{} {} ({})", i > 0 ? "," : "",
+                                    f.top[i].value, f.top[i].rows));
+        }
+        if (f.distinct > f.top.size()) {
+            line.append(
+                std::format(", and {} more", f.distinct - f.top.size()));
+        }
+        if (f.missing > 0) {
+            line.append(std::format("; {} without a value", f.missing));
+        }
+        println(out, "{}", line);
+    }
+    println(out, "{} rows found", result.rows);
+}
+
+void print_file_loads(std::FILE* out, const vector<file_load>& loads) {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    for (const file_load& load : loads) {
+        println(out, "{} rows from \"{}\" ({:.3f} ms)", load.rows,
+                load.filename, milliseconds(load.load).count());
+    }
+}
+
+namespace {
+/// @brief Reads the number that follows an option such as --threads.
+/// @param argv
+/// @param i Index of the option; advanced past the number.
+/// @param out
+/// @return Empty, or a message saying what was wrong.
+std::expected<void, string> option_number(const vector<string>& argv,
+                                          size_t& i, size_t& out) {
+    const string& option = argv[i];
+    if (i + 1 >= argv.size()) {
+        return std::unexpected(std::format("{} needs a number", option));
+    }
+    const string& value = argv[++i];
+    const auto [end, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), out);
+    if (ec != std::errc{} || end != value.data() + value.size()) {
+        return std::unexpected(
+            std::format("{}: \"{}\" is not a number", option, value));
+    }
+    return {};
+}
+
+/// @brief Reads the value that follows an option such as --batch.
+/// @param argv
+/// @param i Index of the option; advanced past the value.
+/// @param out
+/// @return Empty, or a message saying what was wrong.
+std::expected<void, string> option_text(const vector<string>& argv,
+                                        size_t& i, string& out) {
+    const string& option = argv[i];
+    if (i + 1 >= argv.size()) {
+        return std::unexpected(std::format("{} needs a value", option));
+    }
+    out = argv[++i];
+    return {};
+}
+
+/// @brief Reads the format name that follows --format.
+/// @param argv
+/// @param i Index of the option; advanced past the name.
+/// @param out
+/// @return Empty, or a message saying what was wrong.
+std::expected<void, string> option_format(const vector<string>& argv,
+                                          size_t& i, output_format& out) {
+    const string& option = argv[i];
+    if (i + 1 >= argv.size()) {
+        return std::unexpected(
+            std::format("{} needs csv, tsv or jsonl", option));
+    }
+    const string& value = argv[++i];
+    const auto format = output_format_from_name(value);
+    if (!format) {
+        return std::unexpected(std::format(
+            "{}: \"{}\" is not csv, tsv or jsonl", option, value));
+    }
+    out = *format;
+    return {};
+}
+
+/// @brief Reads the key name that follows --shard-by.
+/// @param argv
+/// @param i Index of the option; advanced past the name.
+/// @param out
+/// @return Empty, or a message saying what was wrong.
+std::expected<void, string> option_shard_key(const vector<string>& argv,
+                                             size_t& i, shard_key& out) {
+    const string& option = argv[i];
+    if (i + 1 >= argv.size()) {
+        return std::unexpected(
+            std::format("{} needs filename or tile", option));
+    }
+    const string& value = argv[++i];
+    const auto key = shard_key_from_name(value);
+    if (!key) {
+        return std::unexpected(std::format(
+            "{}: \"{}\" is not filename or tile", option, value));
+    }
+    out = *key;
+    return {};
+}
+
+/// @brief Reads the "I/N" that follows --shard: shard I of N, counting
+/// from 0.
+/// @param argv
+/// @param i Index of the option; advanced past the value.
+/// @param out
+/// @return Empty, or a message saying what was wrong.
+std::expected<void, string> option_shard(const vector<string>& argv, size_t& i,
+                                         optional<shard_spec>& out) {
+    const string& option = argv[i];
+    if (i + 1 >= argv.size()) {
+        return std::unexpected(std::format("{} needs I/N", option));
+    }
+    const string& value = argv[++i];
+    const char* const last = value.data() + value.size();
+    shard_spec spec{};
+    auto parsed = std::from_chars(value.data(), last, spec.index);
+    bool ok = parsed.ec == std::errc{} && parsed.ptr != last &&
+              *parsed.ptr == '/';
+    if (ok) {
+        parsed = std::from_chars(parsed.ptr + 1, last, spec.count);
+        ok = parsed.ec == std::errc{} && parsed.ptr == last &&
+             spec.index < spec.count;
+    }
+    if (!ok) {
+        return std::unexpected(std::format(
+            "{}: \"{}\" is not I/N with I less than N", option, value));
+    }
+    out = spec;
+    return {};
+}
+}  // namespace
+
+std::expected<program_options, string> command_line::parse_options(
+    const vector<string>& argv) const {
+    program_options result{};
+    for (size_t i = 1; i < argv.size(); ++i) {
+        const string& arg = argv[i];
+        std::expected<void, string> ok{};
+        if (arg == "--threads") {
+            ok = option_number(argv, i, result.threads);
+        } else if (arg == "--cache-mb") {
+            ok = option_number(argv, i, result.cache_megabytes);
+        } else if (arg == "--format") {
+            ok = option_format(argv, i, result.format);
+        } else if (arg == "--page") {
+            ok = option_number(argv, i, result.page_rows);
+        } else if (arg == "--batch") {
+            ok = option_text(argv, i, result.batch_filename);
+        } else if (arg == "--out") {
+            ok = option_text(argv, i, result.out_directory);
+        } else if (arg == "--serve") {
+            ok = option_text(argv, i, result.serve_socket);
+        } else if (arg == "--shards") {
+            ok = option_number(argv, i, result.shards);
+        } else if (arg == "--shard") {
+            ok = option_shard(argv, i, result.shard);
+        } else if (arg == "--shard-by") {
+            ok = option_shard_key(argv, i, result.shard_by);
+        } else if (arg == "--shm") {
+            result.share_memory = true;
+        } else if (arg == "--follow") {
+            result.follow = true;
+        } else if (arg == "--scan") {
+            ok = option_text(argv, i, result.scan_directory);
+        } else if (arg.starts_with("--")) {
+            return std::unexpected(std::format("unknown option \"{}\"", arg));
+        } else {
+            if (result.csv_filenames.empty()) result.csv_filename = arg;
+            result.csv_filenames.push_back(arg);
+        }
+        if (!ok) return std::unexpected(ok.error());
+    }
+    if (result.shard) result.shard->key = result.shard_by;
+    return result;
 }
 
-expected_polygon_t parse_points_in_query(const string& query_line) {
-    smatch query_match;
-    const bool is_query_match =
-        regex_match(query_line, query_match, points_in_query_rx);
-    if (!is_query_match)
-        return std::unexpected(convert_error::geo_coordinate_convert_error);
-
-    // Split apart the polygon coordinates.
-    string polygon_coords_s = trim(query_match[points_in_query_polygon_idx]);
-    // Get rid of the trailing parenthesis.
-    regex polgon_terminator_rx{R"-(\s*\)\s*$)-"};
-    polygon_coords_s =
-        regex_replace(polygon_coords_s, polgon_terminator_rx, ""s);
-    // Regularize the separators.
-    regex polygon_sep_rx{R"-(\)\s*\()-"};
-    polygon_coords_s = regex_replace(polygon_coords_s, polygon_sep_rx, ") ("s);
-
-    regex coord_delimiter{R"-(["\(\)])-"};
-
-    // Parse each coordinate.
-    // something is wrong with the split.
-    auto polygon_strings = polygon_coords_s | views::split(R"-() ()-"s) |
-                           ranges::to<vector<string>>();
-    polygon_t poly_coords{};
-    size_t i{0};
-    ranges::for_each(polygon_strings.begin(), polygon_strings.end(),
-                     [&poly_coords, &coord_delimiter, &i](string& pg_s) {
-                         pg_s = regex_replace(pg_s, coord_delimiter, ""s);
-                         auto expected_coord = s_to_geo_coordinate(pg_s);
-                         if (expected_coord) {
-                             poly_coords.push_back(*expected_coord);
-                         }
-                     });
-
-    // Make sure there are at least 3 coords in the vector.
-    if (poly_coords.size() < 3)
-        return std::unexpected(convert_error::geo_coordinate_convert_error);
-
-    return poly_coords;
+int command_line::run_batch(const table& t, const string& batch_filename,
+                            const string& out_directory) const {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    namespace fs = std::filesystem;
+
+    std::ifstream in{batch_filename};
+    if (!in) {
+        println(stderr, "could not read batch file \"{}\"", batch_filename);
+        return EXIT_FAILURE;
+    }
+    vector<string> lines{};
+    for (string line; std::getline(in, line);) {
+        lines.push_back(std::move(line));
+    }
+    std::error_code ec{};
+    fs::create_directories(out_directory, ec);
+    if (ec) {
+        println(stderr, "could not create directory \"{}\": {}", out_directory,
+                ec.message());
+        return EXIT_FAILURE;
+    }
+
+    const auto plan_start = clock::now();
+    const query_batch batch = query_batch::make(t, lines);
+    for (const batch_problem& problem : batch.problems()) {
+        println(stderr, "{}:{}: {}", batch_filename, problem.line_number,
+                problem.message);
+    }
+    const auto plan_end = clock::now();
+    const vector<bitmap> selections = batch.execute();
+    const auto exec_end = clock::now();
+
+    // Files are numbered by the query's position among the statements, so
+    // that a query that failed does not change the names of the others.
+    const size_t statements =
+        batch.queries().size() + batch.problems().size();
+    const size_t width =
+        std::max<size_t>(3, std::format("{}", statements).size());
+    bool ok = batch.problems().empty();
+    for (size_t q = 0; q < batch.queries().size(); ++q) {
+        const batch_query& query = batch.queries()[q];
+        const fs::path path =
+            fs::path{out_directory} /
+            std::format("query-{:0{}}.{}", query.number, width,
+                        output_format_name(format_));
+        const string filename = path_to_string(path);
+        std::FILE* out = std::fopen(filename.c_str(), "wb");
+        if (!out) {
+            println(stderr, "could not write \"{}\"", filename);
+            ok = false;
+            continue;
+        }
+        const vector<std::uint32_t> rows =
+            query.plan.ordered_rows(selections[q]);
+        {
+            result_writer writer(query.columns, out, format_);
+            writer.write_headings();
+            for (const auto r : rows) writer.write_row(r);
+        }
+        const bool written = std::ferror(out) == 0;
+        if (std::fclose(out) != 0 || !written) {
+            println(stderr, "could not write \"{}\"", filename);
+            ok = false;
+            continue;
+        }
+        println("{}: {} rows", filename, rows.size());
+    }
+    const auto write_end = clock::now();
+
+    println(stderr,
+            "{} queries, {} clauses ({} different), planning {:.3f} ms, "
+            "execution {:.3f} ms, writing {:.3f} ms",
+            batch.queries().size(), batch.clause_uses(), batch.clauses().size(),
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(),
+            milliseconds(write_end - exec_end).count());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void command_line::describe_threads() const {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    const scheduler& sched = scheduler::shared();
+    println(out_, "{} worker threads, plus the main thread",
+            sched.worker_count());
+    const auto counters = sched.counters();
+    for (size_t i = 0; i < counters.size(); ++i) {
+        const worker_counters& c = counters[i];
+        println(out_,
+                "worker {}: {} tasks ({} stolen), busy {:.3f} ms, "
+                "idle {:.3f} ms",
+                i, c.tasks_run, c.tasks_stolen, milliseconds(c.busy).count(),
+                milliseconds(c.idle).count());
+    }
 }
 
-/// @brief Parses ANDed queries.
+void command_line::describe_cache() const {
+    const clause_cache::statistics st = cache_->stats();
+    const size_t lookups = st.hits + st.misses;
+    println(out_, "{} clause results, {:.1f} of {:.1f} MiB", st.entries,
+            static_cast<double>(st.bytes) / (1 << 20),
+            static_cast<double>(cache_->budget()) / (1 << 20));
+    println(out_, "{} hits, {} misses ({:.1f}% hit rate)", st.hits, st.misses,
+            lookups > 0 ? 100.0 * static_cast<double>(st.hits) /
+                              static_cast<double>(lookups)
+                        : 0.0);
+}
+
+/// @brief Parses, plans and runs a query, then prints the matching rows.
+/// Planning and execution times are reported with the messages.
 /// @param t
 /// @param query_line
-void command_line::do_query(table& t, const string& query_line) {
-    // First, match the long query pattern to get everything after the word
-    // "query".
-    smatch m;
-    bool success = regex_match(query_line, m, long_query_pattern_rx);
-    if (!success) {
-        println(stderr, "do_query: could not match long_query_pattern_rx");
+void command_line::do_query(const table& t, const string& query_line) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(query_line);
+    if (!statement) {
+        const query_syntax_error& err = statement.error();
+        println(err_, "could not parse query \"{}\"", query_line);
+        println(err_, "{} at position {}", err.message, err.position);
         return;
     }
+    // A select statement prints only the columns it names.
+    auto projected =
+        statement->statement_kind == query_statement::kind::select
+            ? projection::make(t, statement->select_columns)
+            : projection::all(t);
+    if (!projected) {
+        println(err_, "{}", projected.error().message);
+        println(err_,
+                "Use the \"describe\" command to see the column names and "
+                "types.");
+        return;
+    }
+    const auto plan = query_plan::make(t, *statement);
+    const auto plan_end = clock::now();
+
+    std::optional<size_t> refined_from{};
+    std::optional<row_cursor> cursor{};
+    vector<clause_key> keys{};
+    const std::uint64_t generation = t.columns().generation();
+    if (plan) {
+        const bool refine =
+            statement->statement_kind == query_statement::kind::refine;
+        const bool have_last = last_ && last_->generation == generation;
+        if (refine && !have_last) {
+            println(err_, "There is no previous query to refine.");
+            return;
+        }
 
-    // Then split up the matched string on the ")\s*&&\s*(" part.
-    // Subsitute a uniform ") && (" for any variations in spacing.
-    const string uniform_clauses{
-        regex_replace(m[1].str(), and_separator_pattern_rx, ") && ("s)};
-
-    vector<string> clauses_vec =
-        uniform_clauses | views::split(" && "s) | ranges::to<vector<string>>();
+        for (const plan_clause& pc : plan->clauses()) {
+            keys.push_back(make_clause_key(pc));
+        }
+        // A query that has all of the previous query's clauses only needs
+        // its other clauses applied to the previous result.
+        const bool extends_last =
+            have_last && ranges::all_of(last_->clauses, [&keys](const auto& k) {
+                return ranges::find(keys, k) != keys.end();
+            });
+        if (refine || extends_last) {
+            refined_from = last_->selection.count();
+            bitmap selection = plan->without(last_->clauses)
+                                   .execute_within(last_->selection);
+            for (clause_key& k : keys) {
+                if (ranges::find(last_->clauses, k) == last_->clauses.end()) {
+                    last_->clauses.push_back(std::move(k));
+                }
+            }
+            keys = std::move(last_->clauses);
+            vector<std::uint32_t> rows = plan->ordered_rows(selection);
+            cursor =
+                row_cursor::from_rows(std::move(rows), std::move(selection));
+        } else {
+            // Rows are printed as the scan finds them. A zero budget means
+            // the cache is off.
+            cursor = row_cursor::stream(*plan, &scheduler::shared(),
+                                        active_cache());
+        }
+    } else {
+        const plan_error& err = plan.error();
+        println(err_, "{}", err.message);
+        if (err.error_kind == plan_error::kind::unknown_column) {
+            println(err_,
+                    "Use the \"describe\" command to see the column names and "
+                    "types.");
+        }
+        cursor = row_cursor::from_rows({}, bitmap(t.rows_.size()));
+    }
 
-    // Then do each query, feeding the previous results in to the next one.
-    // Start out with the original input table with all the original rows.
-    // Then reduce the number of rows searched, based on the query results.
-    // The rows in the final table are the ANDed results.
-    table query_table{t};
+    // Data rows go to the output in the chosen format; the summary stays on
+    // it for CSV, and goes with the messages so as not to break TSV or JSON
+    // Lines.
+    result_writer writer(*projected, out_, format_);
+    writer.write_headings();
+    // Only a user at the terminal can be asked for the next page.
+    const size_t page_rows = interactive_ ? page_rows_ : 0;
+    std::optional<clock::time_point> first_row{};
+    clock::duration waiting{};
+    while (true) {
+        const auto rows =
+            cursor->next(page_rows > 0 ? page_rows : rows_per_batch);
+        if (rows.empty()) break;
+        for (const auto r : rows) {
+            writer.write_row(r);
+        }
+        if (!first_row) {
+            writer.flush();
+            first_row = clock::now();
+        }
+        if (page_rows > 0 && !cursor->done()) {
+            writer.flush();
+            const auto wait_start = clock::now();
+            const auto answer =
+                lineread("-- more: Enter for the next page, q to stop -- ",
+                         false);
+            waiting += clock::now() - wait_start;
+            if (!answer || to_lower(trim(*answer)) == "q") break;
+        }
+    }
+    writer.flush();
+    const size_t shown = cursor->produced();
+    const bitmap& selection = cursor->finish();
+    const auto exec_end = clock::now();
+    // A result cut short at its limit is not all of the query's rows, so
+    // there is nothing to refine.
+    if (cursor->truncated()) {
+        last_.reset();
+    } else if (plan) {
+        last_ = last_result{generation, std::move(keys), selection};
+    }
 
-    for (const auto& clause : clauses_vec) {
-        query_table = do_one_query(query_table, clause);
+    FILE* const summary = format_ == output_format::csv ? out_ : err_;
+    const size_t found = selection.count();
+    if (cursor->truncated()) {
+        println(summary, "at least {} rows found, {} shown", found, shown);
+    } else if (shown < found) {
+        println(summary, "{} rows found, {} shown", found, shown);
+    } else {
+        println(summary, "{} rows found", found);
     }
 
-    // Print out the column names.
-    bool first_field = true;
-    string column_names_output{};
-    ranges::for_each(
-        query_table.header_fields_,
-        [&first_field, &column_names_output](const parser::header_field& hf) {
-            if (!first_field) {
-                column_names_output.append(",");
-            }
-            first_field = false;
-            column_names_output.append(hf.text);
-        });
-    println("{}", column_names_output);
-
-    const auto& results = query_table.rows_;
-
-    // print the rows.
-    bool first_row = true;
-    ranges::for_each(results, [](const row& rw) {
-        string row_str = row_to_string(rw);
-        println("{}", row_str);
-    });
-    println("{} rows found", results.size());
+    println(err_, "planning {:.3f} ms, first row {}, execution {:.3f} ms{}",
+            milliseconds(plan_end - plan_start).count(),
+            first_row ? std::format("{:.3f} ms",
+                                    milliseconds(*first_row - plan_end).count())
+                      : "none"s,
+            milliseconds(exec_end - plan_end - waiting).count(),
+            refined_from
+                ? std::format(", refined from {} rows", *refined_from)
+                : string{});
 }
 
-/// @brief Take a query string and a set of current results and run the query on
-/// those results.
-/// @param query_table
-/// @param query_clause
-/// @return A copy of the table with only the result rows in it.
-table command_line::_do_one_query(table&& query_table,
-                                  const string& query_clause) {
-    table::rows result_rows{};
-
-    smatch m;
-
-    const bool possible_points_in_polygon_query =
-        regex_match(query_clause, m, points_in_query_rx);
-    // If it is a point-in-polygon query, handle it specially.
-    if (possible_points_in_polygon_query) {
-        const auto possible_polygon = parse_points_in_query(query_clause);
-        if (possible_polygon) {
-            const auto& polygn = *possible_polygon;
-            const string column_name = m[points_in_query_column_name_idx];
-            query q(query_table, column_name);
-            result_rows = q.point_in_polygon_match(polygn);
+void command_line::do_page(const string& page_line) {
+    static const regex page_rx{R"(^\s*page\s+(\d+)\s*$)", regex::icase};
+    static const regex show_rx{R"(^\s*page\s*$)", regex::icase};
+    std::smatch match{};
+    if (std::regex_match(page_line, match, page_rx)) {
+        const string digits = match[1].str();
+        size_t rows = 0;
+        const auto [end, ec] = std::from_chars(
+            digits.data(), digits.data() + digits.size(), rows);
+        if (ec != std::errc{}) {
+            println(err_, "page: \"{}\" is too large", digits);
+            return;
         }
+        page_rows_ = rows;
+    } else if (!std::regex_match(page_line, show_rx)) {
+        println(err_, "page needs a number of rows, or 0 to stop paging");
+        return;
+    }
+    if (page_rows_ == 0) {
+        println(out_, "Query results are printed all at once.");
     } else {
-        result_rows = parse_non_poly_query(query_table, query_clause);
+        println(out_, "Query results are printed {} rows at a time.",
+                page_rows_);
     }
-    query_table.rows_ = result_rows;
+}
 
-    return query_table;
+void command_line::do_reload(live_table& tables) {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    constexpr double mebibyte = 1 << 20;
+
+    const auto stats = tables.reload();
+    if (!stats) {
+        println(err_, "{}; still using the data read before", stats.error());
+        return;
+    }
+    if (stats->diffed) {
+        println(out_,
+                "Reloaded {} rows from \"{}\", {} changed ({} added, {} "
+                "removed, {} updated)",
+                stats->rows, tables.filename(),
+                stats->inserted + stats->deleted + stats->updated,
+                stats->inserted, stats->deleted, stats->updated);
+    } else if (!stats->files.empty()) {
+        println(out_, "Reloaded {} rows from {} files", stats->rows,
+                stats->files.size());
+        print_file_loads(err_, stats->files);
+    } else {
+        println(out_, "Reloaded {} rows from \"{}\"", stats->rows,
+                tables.filename());
+    }
+    println(err_,
+            "loading {:.3f} ms, swap {:.3f} ms, {} readers of the old data, "
+            "peak memory {:.1f} MiB (was {:.1f} MiB)",
+            milliseconds(stats->load).count(),
+            milliseconds(stats->swap).count(), stats->old_readers,
+            static_cast<double>(stats->peak_bytes_after) / mebibyte,
+            static_cast<double>(stats->peak_bytes_before) / mebibyte);
 }
 
-/// @brief Take a query string and a set of current results and run the query on
-/// those results.
+/// @brief Parses, plans and runs a count statement. No rows are formatted,
+/// and a single indexed clause is counted from its index.
 /// @param t
-/// @param query_clause
-/// @return A copy of the table with only the result rows in it.
-table command_line::_do_one_query(const table& t, const string& query_clause) {
-    table::rows result_rows{};
+/// @param count_line
+void command_line::do_count(const table& t, const string& count_line) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(count_line);
+    if (!statement) {
+        const query_syntax_error& err = statement.error();
+        println(err_, "could not parse query \"{}\"", count_line);
+        println(err_, "{} at position {}", err.message, err.position);
+        return;
+    }
+    const auto plan = query_plan::make(t, *statement);
+    const auto plan_end = clock::now();
+    if (!plan) {
+        println(err_, "{}", plan.error().message);
+        return;
+    }
+    const size_t found = plan->count(&scheduler::shared(), active_cache());
+    const auto exec_end = clock::now();
+    println(out_, "{} rows found", found);
+
+    println(err_, "planning {:.3f} ms, execution {:.3f} ms",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count());
+}
+
+/// @brief Parses, plans and runs an aggregate statement, and prints the
+/// groups as rows.
+/// @param t
+/// @param aggregate_line
+void command_line::do_aggregate(const table& t,
+                                const string& aggregate_line) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(aggregate_line);
+    if (!statement) {
+        const query_syntax_error& err = statement.error();
+        println(err_, "could not parse query \"{}\"", aggregate_line);
+        println(err_, "{} at position {}", err.message, err.position);
+        return;
+    }
+    const auto plan = query_plan::make(t, *statement);
+    if (!plan) {
+        println(err_, "{}", plan.error().message);
+        return;
+    }
+    const auto aggregates = aggregate_plan::make(t, *statement);
+    if (!aggregates) {
+        println(err_, "{}", aggregates.error().message);
+        return;
+    }
+    const auto plan_end = clock::now();
 
-    smatch m;
+    const bitmap selection =
+        plan->execute(execution_mode::fused, &scheduler::shared(),
+                      active_cache());
+    const aggregate_result result =
+        aggregates->run(selection, &scheduler::shared());
+    const auto exec_end = clock::now();
 
-    table query_table{t};
+    print_aggregate_result(out_, result, selection.count());
 
-    return _do_one_query(table{t}, query_clause);
+    println(err_, "planning {:.3f} ms, execution {:.3f} ms",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count());
 }
 
-jt::table::rows command_line::parse_non_poly_query(table& t,
-                                                   const string& query_line) {
-    jt::table::rows results;
-    smatch m;
-
-    // m[1] is the column name.
-    // m[3] is the operator (may be empty).
-    // m[4] is the query value.
-    bool matched = regex_search(query_line, m, new_query_pattern_rx);
-    if (!matched) {
-        // if (m.empty()) {
-        println(stderr, "could not parse query \"{}\"", query_line);
-        return results;
-        // Will need to change this when handling more complex queries.
-    }
-
-    const string column_name = m[1].str();
-    // m[4] for string values; m[5] for integers.
-    const string query_value_s = m[4].str().empty() ? m[5].str() : m[4].str();
-
-    auto op = m[3];
-    const query::comparison comp = str_to_comparison(op.str());
-
-    ecdt col_type = t.column_type(column_name);
-    query q(t, column_name, comp);
-    results = q.execute(query_value_s);
-    return results;
+/// @brief Parses, plans and runs a facets statement, and prints each
+/// column's most common values with their counts. Results are reused for a
+/// repeated statement while the query result cache is on.
+/// @param t
+/// @param facets_line
+void command_line::do_facets(const table& t, const string& facets_line) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(facets_line);
+    if (!statement) {
+        const query_syntax_error& err = statement.error();
+        println(err_, "could not parse query \"{}\"", facets_line);
+        println(err_, "{} at position {}", err.message, err.position);
+        return;
+    }
+    const auto plan = query_plan::make(t, *statement);
+    if (!plan) {
+        println(err_, "{}", plan.error().message);
+        return;
+    }
+    const auto facets = facet_plan::make(t, *statement);
+    if (!facets) {
+        println(err_, "{}", facets.error().message);
+        return;
+    }
+    const auto plan_end = clock::now();
+
+    const bool caching = cache_->budget() > 0;
+    const std::uint64_t generation = t.columns().generation();
+    const string key = facets->cache_key(*plan);
+    const facet_result* cached =
+        caching ? facets_.find(generation, key) : nullptr;
+    facet_result computed{};
+    if (!cached) {
+        const bitmap selection =
+            plan->execute(execution_mode::fused, &scheduler::shared(),
+                          caching ? cache_.get() : nullptr);
+        computed = facets->run(selection, &scheduler::shared());
+        if (caching) facets_.insert(generation, key, computed);
+    }
+    const facet_result& result = cached ? *cached : computed;
+    const auto exec_end = clock::now();
+
+    print_facet_result(out_, result);
+
+    println(err_, "planning {:.3f} ms, execution {:.3f} ms{}",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(),
+            cached ? ", from cache" : "");
 }
 }  // namespace jt
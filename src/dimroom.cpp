@@ -1,15 +1,107 @@
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
+#include <expected>
+#include <format>
 #include <optional>
 #include <print>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "catalog_files.hpp"
 #include "command_line.hpp"
+#include "image_scan.hpp"
+#include "live_table.hpp"
+#include "parser.hpp"
+#include "query_server.hpp"
+#include "scheduler.hpp"
+#include "shard.hpp"
+#include "shared_catalog.hpp"
 #include "table.hpp"
+#include "table_follower.hpp"
 
 using std::string;
 using std::vector;
 
+namespace {
+/// @brief Makes the table of a directory of images, and says how many were
+/// found and how quickly.
+/// @param directory
+jt::live_table::loader scan_loader(const string& directory) {
+    return [directory]() -> std::expected<jt::table, string> {
+        using milliseconds = std::chrono::duration<double, std::milli>;
+        jt::scan_stats stats{};
+        auto scanned = jt::scan_images(directory, stats);
+        if (scanned) {
+            const double seconds =
+                std::chrono::duration<double>(stats.time).count();
+            std::println(stderr,
+                         "{} images of {} files in {} directories of \"{}\" "
+                         "({:.3f} ms, {:.0f} files/s)",
+                         stats.images, stats.files, stats.directories,
+                         directory, milliseconds(stats.time).count(),
+                         seconds > 0 ? stats.files / seconds : 0.0);
+        }
+        return scanned;
+    };
+}
+}  // namespace
+
+#if !defined(_WIN64)
+namespace {
+/// @brief The server to stop when the program is interrupted.
+jt::query_server* volatile running_server{nullptr};
+
+void stop_server(int) {
+    if (running_server) running_server->stop();
+}
+
+/// @brief Takes a file's table from shared memory, or reads the file and
+/// publishes the table there for the next process.
+/// @param filename
+/// @param held Set to this process's attachment, which keeps the image
+/// while the program runs.
+/// @return The table, or nothing if the file could not be read.
+std::optional<jt::table> read_shared_table(
+    const string& filename, std::optional<jt::shared_catalog>& held) {
+    using namespace jt;
+    using std::println;
+    const auto name = shared_catalog::name_for(filename);
+    if (name) {
+        if (auto attached = shared_catalog::attach(*name)) {
+            table t = attached->read_table();
+            println(stderr, "using the shared copy of \"{}\", {} processes",
+                    filename, attached->holders());
+            held = std::move(*attached);
+            return t;
+        }
+    }
+    command_handler ch;
+    auto table_exp = ch.read_csv_file(filename);
+    if (!table_exp) return std::nullopt;
+    if (!name) {
+        println(stderr, "not shared: {}", name.error());
+        return std::move(*table_exp);
+    }
+    if (auto published = shared_catalog::publish(*table_exp, *name)) {
+        println(stderr, "shared \"{}\" as {}, {} bytes", filename,
+                published->name(), published->image_bytes());
+        held = std::move(*published);
+    } else {
+        println(stderr, "not shared: {}", published.error());
+    }
+    return std::move(*table_exp);
+}
+}  // namespace
+#endif
+
 int main(int argc, char** argv) {
     using namespace jt;
     using std::println;
@@ -17,23 +109,184 @@ int main(int argc, char** argv) {
     command_line cl;
 
     vector<string> argv_sv(argv, argv + argc);
-    auto filename_exp = cl.get_csv_filename(argc, argv_sv);
-    if (!filename_exp) {
+    const auto options = cl.parse_options(argv_sv);
+    if (!options) {
+        println(stderr, "{}: {}", argv_sv[0], options.error());
+        return EXIT_FAILURE;
+    }
+    const bool scanning = !options->scan_directory.empty();
+    if (scanning && !options->csv_filenames.empty()) {
+        println(stderr, "{}: --scan takes the place of a CSV filename",
+                argv_sv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!scanning && options->csv_filename.empty()) {
         println(
             stderr,
             "{}: please specify a CSV filename (like ../test/data/sample.csv)",
             argv_sv[0]);
         return EXIT_FAILURE;
     }
-
-    auto filename = *filename_exp;
-    command_handler ch;
-    auto table_exp = ch.read_csv_file(filename);
-    if (!table_exp) {
-        println(stderr, "could not read CSV input file \"{}\"", filename);
+    // A catalog split across files, or scanned, is read by this process
+    // alone.
+    const bool several_files =
+        !scanning && !names_one_file(options->csv_filenames);
+    if ((several_files || scanning) &&
+        (options->shards > 0 || options->shard || options->share_memory ||
+         options->follow)) {
+        println(stderr,
+                "{}: --shards, --shm and --follow need a single CSV file",
+                argv_sv[0]);
         return EXIT_FAILURE;
     }
+    if (options->follow &&
+        (!options->batch_filename.empty() || options->share_memory)) {
+        println(stderr, "{}: --follow cannot be used with --batch or --shm",
+                argv_sv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options->shards > 0) {
+#if defined(_WIN64)
+        println(stderr, "{}: --shards needs Unix domain sockets", argv_sv[0]);
+        return EXIT_FAILURE;
+#else
+        if (!options->batch_filename.empty() ||
+            !options->serve_socket.empty() || options->shard) {
+            println(stderr,
+                    "{}: --shards cannot be used with --batch, --serve or "
+                    "--shard",
+                    argv_sv[0]);
+            return EXIT_FAILURE;
+        }
+        // The workers share the machine's hardware threads.
+        const size_t threads =
+            options->threads > 0
+                ? options->threads
+                : std::max<size_t>(1, std::thread::hardware_concurrency() /
+                                          options->shards);
+        vector<string> worker_options{
+            "--threads", std::format("{}", threads), "--cache-mb",
+            std::format("{}", options->cache_megabytes)};
+        // The workers read the file once between them.
+        if (options->share_memory) worker_options.push_back("--shm");
+        if (options->follow) worker_options.push_back("--follow");
+#if defined(__linux__)
+        const string program{"/proc/self/exe"};
+#else
+        const string program{argv_sv[0]};
+#endif
+        shard_workers workers{};
+        if (const auto ok =
+                workers.start(program, worker_options, options->csv_filename,
+                              options->shards, options->shard_by);
+            !ok) {
+            println(stderr, "{}: {}", argv_sv[0], ok.error());
+            return EXIT_FAILURE;
+        }
+        auto coordinator =
+            shard_coordinator::connect(workers.sockets(), options->format);
+        if (!coordinator) {
+            println(stderr, "{}: {}", argv_sv[0], coordinator.error());
+            return EXIT_FAILURE;
+        }
+        return coordinator->read_eval_print();
+#endif
+    }
+#if defined(__linux__)
+    // A worker stops with the coordinator that started it.
+    if (options->shard) ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+
+    // Must come before anything uses the shared scheduler.
+    scheduler::set_shared_threads(options->threads);
+    cl.set_cache_budget(options->cache_megabytes << 20);
+    cl.set_output_format(options->format);
+    cl.set_page_rows(options->page_rows);
 
-    table tbl = *table_exp;
-    return cl.read_eval_print(tbl);
+    const string filename = options->csv_filename;
+
+    // A worker keeps only its shard, also of what "reload" reads, and drops
+    // the other rows before building its table.
+    live_table::row_filter keep{};
+    if (options->shard) {
+        keep = [spec = *options->shard](const parser::header_fields_t& hfs,
+                                        parser::all_data_fields_t& rows) {
+            keep_shard_fields(hfs, rows, spec);
+        };
+    }
+
+    // Commands read snapshots of the table, which "reload" replaces.
+    std::optional<live_table> tables{};
+    std::optional<table_follower> follower{};
+#if !defined(_WIN64)
+    std::optional<shared_catalog> shared{};
+    if (options->share_memory) {
+        std::optional<table> table_exp = read_shared_table(filename, shared);
+        if (!table_exp) {
+            println(stderr, "could not read CSV input file \"{}\"", filename);
+            return EXIT_FAILURE;
+        }
+        // The shared copy holds every row; a worker copies its own.
+        if (options->shard) {
+            *table_exp = make_shard(*table_exp, *options->shard);
+        }
+        tables.emplace(filename, std::move(*table_exp), keep);
+    } else
+#endif
+    {
+        // Read by the live table, so that it knows where the file's lines
+        // end for --follow, and what they were for "reload".
+        if (scanning) {
+            tables.emplace(options->scan_directory,
+                           scan_loader(options->scan_directory));
+        } else if (several_files) {
+            tables.emplace(options->csv_filenames, table{});
+        } else {
+            tables.emplace(filename, table{}, keep);
+        }
+        const auto loaded = tables->reload();
+        if (!loaded) {
+            println(stderr, "{}", loaded.error());
+            return EXIT_FAILURE;
+        }
+        if (!loaded->files.empty()) {
+            print_file_loads(stderr, loaded->files);
+            println(stderr, "{} rows from {} files ({:.3f} ms)", loaded->rows,
+                    loaded->files.size(),
+                    std::chrono::duration<double, std::milli>(loaded->load)
+                        .count());
+        }
+    }
+    if (options->follow) {
+        // A worker's rows are counted by the coordinator.
+        follower.emplace(*tables, options->shard ? nullptr : stderr);
+    }
+    if (!options->batch_filename.empty()) {
+        return cl.run_batch(*tables->snapshot(), options->batch_filename,
+                            options->out_directory);
+    }
+    if (!options->serve_socket.empty()) {
+#if defined(_WIN64)
+        println(stderr, "{}: --serve needs Unix domain sockets", argv_sv[0]);
+        return EXIT_FAILURE;
+#else
+        query_server server(*tables, options->format,
+                            options->cache_megabytes << 20);
+        if (const auto ok = server.listen(options->serve_socket); !ok) {
+            println(stderr, "{}: {}", argv_sv[0], ok.error());
+            return EXIT_FAILURE;
+        }
+        running_server = &server;
+        std::signal(SIGINT, stop_server);
+        std::signal(SIGTERM, stop_server);
+        if (!options->shard) {
+            println(stderr, "serving \"{}\" on {}", tables->filename(),
+                    options->serve_socket);
+        }
+        server.run();
+        running_server = nullptr;
+        return EXIT_SUCCESS;
+#endif
+    }
+    return cl.read_eval_print(*tables);
 }
@@ -0,0 +1,91 @@
+// A thin client for `dimroom --serve`: sends commands to the server's socket
+// and prints the answers, as if they had been typed at dimroom's prompt.
+//
+//     dimroom-client SOCKET            prompts for commands
+//     dimroom-client SOCKET COMMAND    runs one command, for scripts
+
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <print>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN64)
+#include <unistd.h>
+
+#include <csignal>
+
+#include "query_socket.hpp"
+#endif
+#include "dimroomConfig.h"
+#include "utility.hpp"
+
+using std::string;
+using std::vector;
+
+int main(int argc, char** argv) {
+    using namespace jt;
+    using std::println;
+
+    const vector<string> args(argv, argv + argc);
+#if defined(_WIN64)
+    println(stderr, "{}: needs Unix domain sockets", args[0]);
+    return EXIT_FAILURE;
+#else
+    if (args.size() < 2) {
+        println(stderr, "usage: {} SOCKET [COMMAND]", args[0]);
+        return EXIT_FAILURE;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    const auto fd = connect_to_server(args[1]);
+    if (!fd) {
+        println(stderr, "{}: {}", args[0], fd.error());
+        return EXIT_FAILURE;
+    }
+
+    // Sends a command and prints the answer; false if the server has gone.
+    auto send = [&](const string& command) {
+        if (!write_frame(*fd, command)) return false;
+        const auto out = read_frame(*fd);
+        const auto err = out ? read_frame(*fd) : std::nullopt;
+        if (!err) return false;
+        std::fwrite(out->data(), 1, out->size(), stdout);
+        std::fflush(stdout);
+        std::fwrite(err->data(), 1, err->size(), stderr);
+        return true;
+    };
+
+    int status = EXIT_SUCCESS;
+    if (args.size() > 2) {
+        // The rest of the arguments are one command.
+        string command{args[2]};
+        for (size_t i = 3; i < args.size(); ++i) {
+            command.append(" ").append(args[i]);
+        }
+        if (!send(command)) status = EXIT_FAILURE;
+    } else {
+        const string prompt_str =
+            std::format("dimroom-{}.{}@{}> ", dimroom_VERSION_MAJOR,
+                        dimroom_VERSION_MINOR, args[1]);
+        while (auto line_input = lineread(prompt_str)) {
+            string input_line{*line_input};
+            trim(input_line);
+            if (input_line.empty()) continue;
+            if (!send(input_line)) {
+                status = EXIT_FAILURE;
+                break;
+            }
+            // The server closes the connection after these.
+            const string lower = to_lower(string{input_line});
+            if (lower.starts_with("quit") || lower.starts_with("exit")) break;
+        }
+    }
+    if (status != EXIT_SUCCESS) {
+        println(stderr, "{}: lost the connection to the server", args[0]);
+    }
+    ::close(*fd);
+    return status;
+#endif
+}
@@ -0,0 +1,262 @@
+#include "facets.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <map>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "cell_types.hpp"
+#include "clause_cache.hpp"
+#include "column_store.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+
+using std::string;
+using std::unexpected;
+using std::vector;
+using ecdt = e_cell_data_type;
+
+namespace {
+bool can_facet(ecdt type) noexcept {
+    return type == ecdt::text || type == ecdt::boolean || type == ecdt::tags;
+}
+
+/// @brief Where one column's counts come from. Counts for the column's
+/// values are at [offset, offset + values); rows without a value are counted
+/// at offset + values.
+struct facet_source {
+    std::span<const std::int32_t> codes{};
+    const tags_column* tags{nullptr};
+    const bitmap* bools{nullptr};
+    const bitmap* present{nullptr};
+    const vector<string>* dictionary{nullptr};
+    size_t offset{0};
+    size_t values{0};
+};
+
+/// @brief Adds the selected rows in [first, last) to counts.
+void count_rows(vector<std::uint64_t>& counts,
+                std::span<const facet_source> sources, const bitmap& selection,
+                size_t first, size_t last) {
+    const auto words = selection.words();
+    for (size_t wi = first / bitmap::word_bits;
+         wi * bitmap::word_bits < last && wi < words.size(); ++wi) {
+        bitmap::word_t w = words[wi];
+        while (w != 0) {
+            const size_t r = wi * bitmap::word_bits +
+                             static_cast<size_t>(std::countr_zero(w));
+            w &= w - 1;
+            for (const facet_source& src : sources) {
+                if (!src.present->test(r)) {
+                    ++counts[src.offset + src.values];
+                } else if (src.tags) {
+                    for (auto i = src.tags->offsets[r];
+                         i < src.tags->offsets[r + 1]; ++i) {
+                        ++counts[src.offset + src.tags->tag_ids[i]];
+                    }
+                } else if (src.bools) {
+                    ++counts[src.offset + (src.bools->test(r) ? 1 : 0)];
+                } else {
+                    ++counts[src.offset + static_cast<size_t>(src.codes[r])];
+                }
+            }
+        }
+    }
+}
+}  // namespace
+
+std::expected<facet_plan, plan_error> facet_plan::make(
+    const table& t, const query_statement& statement) {
+    facet_plan result{};
+    result.columns_ = t.column_store_ptr();
+    result.top_ = statement.limit.value_or(default_top);
+
+    if (statement.facet_columns.empty()) {
+        for (size_t i = 0; i < t.header_fields_.size(); ++i) {
+            const auto& hf = t.header_field_at_index(i);
+            if (can_facet(hf.data_type)) {
+                result.facet_columns_.push_back({hf.text, i, hf.data_type});
+            }
+        }
+        return result;
+    }
+
+    for (const column_ref& ref : statement.facet_columns) {
+        const auto col_idx = t.index_for_column_name(ref.column_name);
+        if (!col_idx) {
+            return unexpected(plan_error{
+                plan_error::kind::unknown_column,
+                std::format("Column \"{}\" is not in this file.",
+                            ref.column_name)});
+        }
+        const ecdt type = t.header_field_at_index(*col_idx).data_type;
+        if (!can_facet(type)) {
+            return unexpected(plan_error{
+                plan_error::kind::unsupported,
+                std::format("Error: cannot count the values of column \"{}\" "
+                            "of type {}; use aggregate with group by",
+                            ref.column_name, type)});
+        }
+        result.facet_columns_.push_back({ref.column_name, *col_idx, type});
+    }
+    return result;
+}
+
+facet_result facet_plan::run(const bitmap& selection, scheduler* sched) const {
+    static const column_store no_columns{};
+    const column_store& cs = columns_ ? *columns_ : no_columns;
+
+    const bitmap none(selection.size());
+    vector<facet_source> sources{};
+    size_t width = 0;
+    for (const facet_column& fc : facet_columns_) {
+        facet_source src{};
+        if (const auto* col = cs.get_if<text_column>(fc.column)) {
+            src.codes = col->codes;
+            src.present = &col->present;
+            src.dictionary = &col->dictionary;
+            src.values = col->dictionary.size();
+        } else if (const auto* col = cs.get_if<tags_column>(fc.column)) {
+            src.tags = col;
+            src.present = &col->present;
+            src.dictionary = &col->dictionary;
+            src.values = col->dictionary.size();
+        } else if (const auto* col = cs.get_if<boolean_column>(fc.column)) {
+            src.bools = &col->values;
+            src.present = &col->present;
+            src.values = 2;
+        } else {
+            // A column with no values at all: every row is missing.
+            src.present = &none;
+        }
+        src.offset = width;
+        width += src.values + 1;
+        sources.push_back(src);
+    }
+
+    // One array of counts per range of rows; ranges are whole bitmap words.
+    const size_t n = selection.size();
+    size_t ranges = 1;
+    if (sched && n > morsel_rows) {
+        ranges = std::min(sched->worker_count() + 1,
+                          (n + morsel_rows - 1) / morsel_rows);
+    }
+    const size_t range_rows =
+        ((n + ranges - 1) / ranges + bitmap::word_bits - 1) /
+        bitmap::word_bits * bitmap::word_bits;
+    vector<vector<std::uint64_t>> partials(ranges,
+                                           vector<std::uint64_t>(width));
+    auto run_range = [&](size_t i) {
+        const size_t first = i * range_rows;
+        count_rows(partials[i], sources, selection, first,
+                   std::min(n, first + range_rows));
+    };
+    if (sched) {
+        sched->parallel_for(ranges, run_range);
+    } else {
+        run_range(0);
+    }
+    vector<std::uint64_t>& counts = partials.front();
+    for (size_t i = 1; i < partials.size(); ++i) {
+        for (size_t c = 0; c < width; ++c) counts[c] += partials[i][c];
+    }
+
+    facet_result result{selection.count()};
+    for (size_t f = 0; f < sources.size(); ++f) {
+        const facet_source& src = sources[f];
+        facet out{facet_columns_[f].column_name};
+        out.missing = counts[src.offset + src.values];
+
+        vector<size_t> found{};
+        for (size_t v = 0; v < src.values; ++v) {
+            if (counts[src.offset + v] > 0) found.push_back(v);
+        }
+        out.distinct = found.size();
+        const size_t shown = std::min(top_, found.size());
+        // Codes are in value order, so ties stay in value order.
+        std::ranges::partial_sort(
+            found, found.begin() + static_cast<std::ptrdiff_t>(shown),
+            [&counts, &src](size_t a, size_t b) {
+                const auto ca = counts[src.offset + a];
+                const auto cb = counts[src.offset + b];
+                return ca != cb ? ca > cb : a < b;
+            });
+        for (size_t i = 0; i < shown; ++i) {
+            const size_t v = found[i];
+            string value = src.dictionary
+                               ? (*src.dictionary)[v]
+                               : cell_value_types_value_as_string(
+                                     cell_value_types{std::in_place_type<bool>,
+                                                      v == 1});
+            out.top.push_back({std::move(value),
+                               static_cast<size_t>(counts[src.offset + v])});
+        }
+        result.facets.push_back(std::move(out));
+    }
+    return result;
+}
+
+facet_result facet_plan::merge(std::span<const facet_result> parts) const {
+    facet_result result{};
+    for (const facet_result& part : parts) result.rows += part.rows;
+    for (size_t f = 0; f < facet_columns_.size(); ++f) {
+        facet out{facet_columns_[f].column_name};
+        // Values are compared as strings, which is the order of the
+        // dictionaries they came from.
+        std::map<string, size_t> counts{};
+        for (const facet_result& part : parts) {
+            if (f >= part.facets.size()) continue;
+            out.missing += part.facets[f].missing;
+            for (const facet_count& fc : part.facets[f].top) {
+                counts[fc.value] += fc.rows;
+            }
+        }
+        vector<facet_count> found{};
+        for (auto& [value, rows] : counts) found.push_back({value, rows});
+        out.distinct = found.size();
+        const size_t shown = std::min(top_, found.size());
+        std::ranges::partial_sort(
+            found, found.begin() + static_cast<std::ptrdiff_t>(shown),
+            [](const facet_count& a, const facet_count& b) {
+                return a.rows != b.rows ? a.rows > b.rows : a.value < b.value;
+            });
+        found.resize(shown);
+        out.top = std::move(found);
+        result.facets.push_back(std::move(out));
+    }
+    return result;
+}
+
+string facet_plan::cache_key(const query_plan& plan) const {
+    vector<string> clauses{};
+    for (const plan_clause& pc : plan.clauses()) {
+        const clause_key key = make_clause_key(pc);
+        clauses.push_back(std::format("{}:{}:{}:", key.column,
+                                      static_cast<int>(key.op),
+                                      key.value.size()) +
+                          key.value);
+    }
+    // The clauses are ANDed, so their order does not matter.
+    std::ranges::sort(clauses);
+    string result{};
+    for (const string& c : clauses) result.append(c);
+    result.append(std::format("|{}|", top_));
+    for (const facet_column& fc : facet_columns_) {
+        result.append(std::format("{},", fc.column));
+    }
+    return result;
+}
+
+}  // namespace jt
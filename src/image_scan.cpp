@@ -0,0 +1,685 @@
+#include "image_scan.hpp"
+
+#if !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "coordinates.hpp"
+#include "parser.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::vector;
+
+namespace {
+namespace fs = std::filesystem;
+
+/// @brief Bytes read from a file at a time. Enough for the segments before
+/// the frame header of most JPEG files, and the IFDs of an Exif header.
+constexpr size_t window_bytes{16 * 1024};
+
+/// @brief Entries beyond which an IFD is taken to be damaged.
+constexpr size_t max_ifd_entries{512};
+
+/// @brief JPEG segments or PNG chunks beyond which a header is taken to be
+/// damaged.
+constexpr size_t max_segments{256};
+
+/// @brief Files read on a task.
+constexpr size_t chunk_files{64};
+
+/// @brief Reads bytes of a file, or of memory, at any offset. A file is
+/// read through a window, so that the parts of a header that are close
+/// together cost one pread().
+class byte_source {
+    std::span<const unsigned char> memory_{};
+#if defined(_WIN64)
+    std::ifstream file_{};
+#else
+    int fd_{-1};
+#endif
+    bool from_file_{false};
+    std::uint64_t size_{0};
+    vector<unsigned char> window_{};
+    std::uint64_t window_start_{0};
+    size_t window_size_{0};
+
+    /// @brief Reads the window at offset, at least count bytes long.
+    bool fill(std::uint64_t offset, size_t count) {
+        window_.resize(std::max(window_bytes, count));
+        const size_t wanted = static_cast<size_t>(
+            std::min<std::uint64_t>(window_.size(), size_ - offset));
+        size_t got = 0;
+#if defined(_WIN64)
+        file_.clear();
+        file_.seekg(static_cast<std::streamoff>(offset));
+        file_.read(reinterpret_cast<char*>(window_.data()),
+                   static_cast<std::streamsize>(wanted));
+        got = static_cast<size_t>(file_.gcount());
+#else
+        while (got < wanted) {
+            const ssize_t n = ::pread(fd_, window_.data() + got, wanted - got,
+                                      static_cast<off_t>(offset + got));
+            if (n <= 0) break;
+            got += static_cast<size_t>(n);
+        }
+#endif
+        window_start_ = offset;
+        window_size_ = got;
+        return got >= count;
+    }
+
+   public:
+    /// @brief Reads from memory.
+    /// @param bytes
+    /// @param size Size of the whole file, of which bytes may be the start.
+    byte_source(std::span<const unsigned char> bytes, std::uint64_t size)
+        : memory_{bytes}, size_{size} {}
+
+    /// @brief Reads from a file.
+    explicit byte_source(const string& filename) {
+#if defined(_WIN64)
+        file_.open(filename, std::ios::binary);
+        std::error_code ec{};
+        size_ = fs::file_size(filename, ec);
+        from_file_ = file_.is_open() && !ec;
+#else
+        fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        if (fd_ >= 0 && ::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<std::uint64_t>(st.st_size);
+            from_file_ = true;
+        }
+#endif
+    }
+
+    ~byte_source() {
+#if !defined(_WIN64)
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    byte_source(const byte_source&) = delete;
+    byte_source& operator=(const byte_source&) = delete;
+
+    /// @brief Whether a file was opened, or memory given.
+    bool is_open() const noexcept {
+        return from_file_ || memory_.data() != nullptr;
+    }
+
+    std::uint64_t size() const noexcept { return size_; }
+
+    /// @brief Copies count bytes at offset.
+    /// @return false if they are not all in the file.
+    bool read(std::uint64_t offset, unsigned char* out, size_t count) {
+        if (offset > size_ || count > size_ - offset) return false;
+        if (!from_file_) {
+            if (offset + count > memory_.size()) return false;
+            std::memcpy(out, memory_.data() + offset, count);
+            return true;
+        }
+        if (offset < window_start_ ||
+            offset + count > window_start_ + window_size_) {
+            if (!fill(offset, count)) return false;
+        }
+        std::memcpy(out, window_.data() + (offset - window_start_), count);
+        return true;
+    }
+
+    /// @brief An unsigned number of 1 to 4 bytes at offset.
+    std::optional<std::uint32_t> number(std::uint64_t offset, size_t bytes,
+                                        bool big_endian) {
+        unsigned char b[4]{};
+        if (!read(offset, b, bytes)) return std::nullopt;
+        std::uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            value = (value << 8) | b[big_endian ? i : bytes - 1 - i];
+        }
+        return value;
+    }
+};
+
+/// @brief A TIFF structure, a TIFF file or the Exif data in a JPEG or PNG
+/// file, whose offsets are counted from its header at base.
+struct tiff_view {
+    byte_source& in;
+    std::uint64_t base{0};
+    bool big_endian{false};
+
+    std::optional<std::uint32_t> u16(std::uint64_t at) const {
+        return in.number(base + at, 2, big_endian);
+    }
+
+    std::optional<std::uint32_t> u32(std::uint64_t at) const {
+        return in.number(base + at, 4, big_endian);
+    }
+};
+
+/// @brief An entry of an IFD.
+struct ifd_entry {
+    std::uint32_t tag{0};
+    std::uint32_t type{0};
+    std::uint32_t count{0};
+
+    /// @brief Offset of the value, or of the offset of the value if it
+    /// does not fit in four bytes.
+    std::uint64_t value_at{0};
+};
+
+enum tiff_type : std::uint32_t {
+    tiff_ascii = 2,
+    tiff_short = 3,
+    tiff_long = 4,
+    tiff_rational = 5
+};
+
+/// @brief Calls fn for each entry of the IFD at offset.
+/// @return false if the IFD cannot be read.
+template <class Fn>
+bool for_each_entry(const tiff_view& tiff, std::uint32_t offset, Fn&& fn) {
+    const auto count = tiff.u16(offset);
+    if (!count || *count > max_ifd_entries) return false;
+    for (std::uint32_t i = 0; i < *count; ++i) {
+        const std::uint64_t at = offset + 2 + std::uint64_t{12} * i;
+        const auto tag = tiff.u16(at);
+        const auto type = tiff.u16(at + 2);
+        const auto values = tiff.u32(at + 4);
+        if (!tag || !type || !values) return false;
+        fn(ifd_entry{*tag, *type, *values, at + 8});
+    }
+    return true;
+}
+
+/// @brief The value of a SHORT or LONG entry.
+std::optional<std::uint32_t> entry_number(const tiff_view& tiff,
+                                          const ifd_entry& e) {
+    if (e.count < 1) return std::nullopt;
+    if (e.type == tiff_short) return tiff.u16(e.value_at);
+    if (e.type == tiff_long) return tiff.u32(e.value_at);
+    return std::nullopt;
+}
+
+/// @brief One of the values of a RATIONAL entry.
+std::optional<double> entry_rational(const tiff_view& tiff, const ifd_entry& e,
+                                     std::uint32_t index) {
+    if (e.type != tiff_rational || index >= e.count) return std::nullopt;
+    const auto offset = tiff.u32(e.value_at);
+    if (!offset) return std::nullopt;
+    const std::uint64_t at = *offset + std::uint64_t{8} * index;
+    const auto numerator = tiff.u32(at);
+    const auto denominator = tiff.u32(at + 4);
+    if (!numerator || !denominator || *denominator == 0) return std::nullopt;
+    return static_cast<double>(*numerator) / *denominator;
+}
+
+/// @brief The text of an ASCII entry, up to its first NUL.
+string entry_text(const tiff_view& tiff, const ifd_entry& e) {
+    if (e.type != tiff_ascii || e.count == 0) return {};
+    // Long enough for a date.
+    const size_t length = std::min<size_t>(e.count, 32);
+    std::uint64_t at = e.value_at;
+    if (e.count > 4) {
+        const auto offset = tiff.u32(e.value_at);
+        if (!offset) return {};
+        at = *offset;
+    }
+    string text(length, '\0');
+    if (!tiff.in.read(tiff.base + at,
+                      reinterpret_cast<unsigned char*>(text.data()), length)) {
+        return {};
+    }
+    text.resize(std::strlen(text.c_str()));
+    return text;
+}
+
+/// @brief Degrees, minutes and seconds as degrees.
+std::optional<double> entry_degrees(const tiff_view& tiff, const ifd_entry& e) {
+    const auto d = entry_rational(tiff, e, 0);
+    const auto m = entry_rational(tiff, e, 1);
+    const auto s = entry_rational(tiff, e, 2);
+    if (!d || !m || !s) return std::nullopt;
+    return *d + *m / 60 + *s / 3600;
+}
+
+/// @brief What the IFDs of a TIFF structure say.
+struct tiff_fields {
+    std::optional<std::uint32_t> width{};
+    std::optional<std::uint32_t> height{};
+    std::optional<std::uint32_t> pixel_x{};
+    std::optional<std::uint32_t> pixel_y{};
+    std::optional<double> x_resolution{};
+    std::optional<std::uint32_t> resolution_unit{};
+    string date_time{};
+    string date_original{};
+    string latitude_ref{};
+    string longitude_ref{};
+    std::optional<double> latitude{};
+    std::optional<double> longitude{};
+};
+
+/// @brief Reads the first IFD of a TIFF structure, and its Exif and GPS
+/// IFDs.
+/// @return false if it is not a TIFF structure.
+bool read_tiff(byte_source& in, std::uint64_t base, tiff_fields& out) {
+    unsigned char head[4]{};
+    if (!in.read(base, head, 4)) return false;
+    tiff_view tiff{in, base};
+    if (head[0] == 'I' && head[1] == 'I' && head[2] == 42 && head[3] == 0) {
+        tiff.big_endian = false;
+    } else if (head[0] == 'M' && head[1] == 'M' && head[2] == 0 &&
+               head[3] == 42) {
+        tiff.big_endian = true;
+    } else {
+        return false;
+    }
+    const auto first = tiff.u32(4);
+    if (!first) return false;
+
+    std::optional<std::uint32_t> exif{};
+    std::optional<std::uint32_t> gps{};
+    for_each_entry(tiff, *first, [&](const ifd_entry& e) {
+        switch (e.tag) {
+            case 0x0100: out.width = entry_number(tiff, e); break;
+            case 0x0101: out.height = entry_number(tiff, e); break;
+            case 0x011A: out.x_resolution = entry_rational(tiff, e, 0); break;
+            case 0x0128: out.resolution_unit = entry_number(tiff, e); break;
+            case 0x0132: out.date_time = entry_text(tiff, e); break;
+            case 0x8769: exif = entry_number(tiff, e); break;
+            case 0x8825: gps = entry_number(tiff, e); break;
+        }
+    });
+    if (exif) {
+        for_each_entry(tiff, *exif, [&](const ifd_entry& e) {
+            switch (e.tag) {
+                case 0x9003: out.date_original = entry_text(tiff, e); break;
+                case 0xA002: out.pixel_x = entry_number(tiff, e); break;
+                case 0xA003: out.pixel_y = entry_number(tiff, e); break;
+            }
+        });
+    }
+    if (gps) {
+        for_each_entry(tiff, *gps, [&](const ifd_entry& e) {
+            switch (e.tag) {
+                case 1: out.latitude_ref = entry_text(tiff, e); break;
+                case 2: out.latitude = entry_degrees(tiff, e); break;
+                case 3: out.longitude_ref = entry_text(tiff, e); break;
+                case 4: out.longitude = entry_degrees(tiff, e); break;
+            }
+        });
+    }
+    return true;
+}
+
+/// @brief An Exif date, "YYYY:MM:DD HH:MM:SS", as "YYYY-MM-DD HH:MM:SS";
+/// empty if it is not one, such as the blank date some cameras write.
+string exif_date(const string& text) {
+    if (text.size() < 19 || text[4] != ':' || text[7] != ':' ||
+        text.starts_with("0000")) {
+        return {};
+    }
+    string result = text.substr(0, 19);
+    for (const size_t i : {0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18}) {
+        if (result[i] < '0' || result[i] > '9') return {};
+    }
+    result[4] = '-';
+    result[7] = '-';
+    return result;
+}
+
+/// @brief Dots per inch, from a resolution and its TIFF unit: 2 for inches,
+/// 3 for centimetres.
+std::optional<std::uint32_t> dots_per_inch(double resolution,
+                                           std::uint32_t unit) {
+    if (unit == 3) resolution *= 2.54;
+    if ((unit != 2 && unit != 3) || resolution < 1 || resolution > 1e6) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint32_t>(std::lround(resolution));
+}
+
+/// @brief Rounds to the five decimals a coordinate has in a CSV file.
+float five_decimals(double degrees) {
+    return static_cast<float>(std::round(degrees * 1e5) / 1e5);
+}
+
+/// @brief Adds what the IFDs say to what the rest of the header said; the
+/// size in pixels only if it was not known.
+void add_tiff_fields(const tiff_fields& f, image_info& info) {
+    if (!info.width || !info.height) {
+        info.width = f.width ? f.width : f.pixel_x;
+        info.height = f.height ? f.height : f.pixel_y;
+    }
+    if (f.x_resolution) {
+        if (const auto dpi = dots_per_inch(*f.x_resolution,
+                                           f.resolution_unit.value_or(2))) {
+            info.dpi = dpi;
+        }
+    }
+    info.taken = exif_date(f.date_original);
+    if (info.taken.empty()) info.taken = exif_date(f.date_time);
+    if (f.latitude && f.longitude) {
+        const double latitude =
+            f.latitude_ref == "S" ? -*f.latitude : *f.latitude;
+        const double longitude =
+            f.longitude_ref == "W" ? -*f.longitude : *f.longitude;
+        if (coordinate::is_valid(static_cast<float>(latitude),
+                                 static_cast<float>(longitude))) {
+            info.location =
+                coordinate{coordinate::format::decimal,
+                           five_decimals(latitude), five_decimals(longitude)};
+        }
+    }
+}
+
+/// @brief Reads the segments of a JPEG file up to its frame header.
+void read_jpeg(byte_source& in, image_info& info) {
+    std::uint64_t at = 2;
+    std::optional<std::uint32_t> jfif_dpi{};
+    tiff_fields exif{};
+    bool has_exif = false;
+    for (size_t segment = 0; segment < max_segments; ++segment) {
+        unsigned char head[4]{};
+        if (!in.read(at, head, 4) || head[0] != 0xFF) break;
+        const unsigned char marker = head[1];
+        // Fill bytes, and markers without a length.
+        if (marker == 0xFF) {
+            ++at;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            at += 2;
+            continue;
+        }
+        // The image data, or its end, comes after the frame header.
+        if (marker == 0xDA || marker == 0xD9) break;
+        const std::uint32_t length = (std::uint32_t{head[2]} << 8) | head[3];
+        if (length < 2) break;
+        const std::uint64_t payload = at + 4;
+        if (marker == 0xE0) {
+            // JFIF: units, then the horizontal density.
+            unsigned char jfif[10]{};
+            if (length >= 12 && in.read(payload, jfif, 10) &&
+                std::memcmp(jfif, "JFIF\0", 5) == 0) {
+                const std::uint32_t density =
+                    (std::uint32_t{jfif[8]} << 8) | jfif[9];
+                // Units 1 are inches, 2 centimetres, as TIFF's 2 and 3.
+                if (jfif[7] == 1 || jfif[7] == 2) {
+                    jfif_dpi = dots_per_inch(density, jfif[7] + 1u);
+                }
+            }
+        } else if (marker == 0xE1 && !has_exif) {
+            unsigned char name[6]{};
+            if (length >= 8 && in.read(payload, name, 6) &&
+                std::memcmp(name, "Exif\0\0", 6) == 0) {
+                has_exif = read_tiff(in, payload + 6, exif);
+            }
+        } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+                   marker != 0xC8 && marker != 0xCC) {
+            // Start of frame: precision, then height and width.
+            info.height = in.number(payload + 1, 2, true);
+            info.width = in.number(payload + 3, 2, true);
+            break;
+        }
+        at = payload + length - 2;
+    }
+    info.dpi = jfif_dpi;
+    if (has_exif) add_tiff_fields(exif, info);
+}
+
+/// @brief Reads the chunks of a PNG file up to its image data.
+void read_png(byte_source& in, image_info& info) {
+    std::uint64_t at = 8;
+    for (size_t chunk = 0; chunk < max_segments; ++chunk) {
+        unsigned char head[8]{};
+        if (!in.read(at, head, 8)) break;
+        const std::uint32_t length = (std::uint32_t{head[0]} << 24) |
+                                     (std::uint32_t{head[1]} << 16) |
+                                     (std::uint32_t{head[2]} << 8) | head[3];
+        const std::string_view type{reinterpret_cast<const char*>(head + 4),
+                                    4};
+        const std::uint64_t data = at + 8;
+        if (type == "IDAT" || type == "IEND") break;
+        if (type == "IHDR" && length >= 8) {
+            info.width = in.number(data, 4, true);
+            info.height = in.number(data + 4, 4, true);
+        } else if (type == "pHYs" && length >= 9) {
+            // Pixels per unit, where unit 1 is the metre.
+            unsigned char unit = 0;
+            const auto per_unit = in.number(data, 4, true);
+            if (per_unit && in.read(data + 8, &unit, 1) && unit == 1) {
+                info.dpi = dots_per_inch(*per_unit * 0.0254, 2);
+            }
+        } else if (type == "eXIf") {
+            tiff_fields exif{};
+            if (read_tiff(in, data, exif)) add_tiff_fields(exif, info);
+        }
+        // The data and its CRC.
+        at = data + std::uint64_t{length} + 4;
+    }
+}
+
+/// @brief Reads the header of an image.
+std::optional<image_info> read_image(byte_source& in) {
+    unsigned char magic[8]{};
+    if (!in.read(0, magic, std::min<std::uint64_t>(8, in.size()))) {
+        return std::nullopt;
+    }
+    image_info info{};
+    info.bytes = in.size();
+    if (magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) {
+        info.type = "jpeg";
+        read_jpeg(in, info);
+    } else if (std::memcmp(magic, "\x89PNG\r\n\x1A\n", 8) == 0) {
+        info.type = "png";
+        read_png(in, info);
+    } else {
+        tiff_fields fields{};
+        if (!read_tiff(in, 0, fields)) return std::nullopt;
+        info.type = "tiff";
+        add_tiff_fields(fields, info);
+    }
+    return info;
+}
+
+/// @brief Whether a file's name has the extension of an image that can be
+/// read.
+bool is_image_name(const fs::path& path) {
+    const string extension = to_lower(path_to_string(path.extension()));
+    return extension == ".jpg" || extension == ".jpeg" ||
+           extension == ".jpe" || extension == ".tif" ||
+           extension == ".tiff" || extension == ".png";
+}
+
+/// @brief Lists the image files of a directory tree, a task for each
+/// directory. Symbolic links to directories are not followed, so that a
+/// link cannot lead the walk round in a circle.
+class tree_walk {
+    task_group group_{scheduler::shared()};
+    std::mutex files_mutex_{};
+    vector<string> files_{};
+    std::atomic<size_t> directories_{0};
+
+    void visit(const fs::path& directory) {
+        directories_.fetch_add(1, std::memory_order_relaxed);
+        vector<string> found{};
+        std::error_code ec{};
+        for (fs::directory_iterator
+                 it{directory, fs::directory_options::skip_permission_denied,
+                    ec},
+             end{};
+             !ec && it != end; it.increment(ec)) {
+            std::error_code type_ec{};
+            if (!it->is_symlink(type_ec) && it->is_directory(type_ec)) {
+                group_.run([this, sub = it->path()] { visit(sub); });
+            } else if (it->is_regular_file(type_ec) &&
+                       is_image_name(it->path())) {
+                found.push_back(path_to_string(it->path()));
+            }
+        }
+        if (found.empty()) return;
+        std::lock_guard lock{files_mutex_};
+        std::ranges::move(found, std::back_inserter(files_));
+    }
+
+   public:
+    /// @brief Lists the image files under root.
+    /// @param root
+    /// @param directories Set to the directories visited.
+    vector<string> run(const fs::path& root, size_t& directories) {
+        visit(root);
+        group_.wait();
+        directories = directories_.load();
+        return std::move(files_);
+    }
+};
+
+/// @brief A cell holding a value of a column's type.
+template <class T>
+data_cell value_cell(e_cell_data_type type, T value) {
+    cell_value_types v = std::move(value);
+    return data_cell{type, cell_value_type{std::move(v)}};
+}
+
+/// @brief A cell without a value, as an empty field of a CSV file gives.
+data_cell empty_cell() {
+    return data_cell{e_cell_data_type::undetermined, cell_value_type{}};
+}
+
+/// @brief A cell of a column's type holding a number, or an empty one.
+data_cell number_cell(const std::optional<std::uint32_t>& value) {
+    if (!value) return empty_cell();
+    return value_cell(e_cell_data_type::integer, static_cast<int>(*value));
+}
+
+/// @brief A text cell, or an empty one.
+data_cell text_cell(string value) {
+    if (value.empty()) return empty_cell();
+    return value_cell(e_cell_data_type::text, std::move(value));
+}
+
+/// @brief The columns of a scan, with the types of their values.
+const vector<parser::header_field>& scan_columns() {
+    static const vector<parser::header_field> columns{
+        {"Filename", e_cell_data_type::text},
+        {"Path", e_cell_data_type::text},
+        {"Type", e_cell_data_type::text},
+        {"Image Size (MB)", e_cell_data_type::floating},
+        {"Image X", e_cell_data_type::integer},
+        {"Image Y", e_cell_data_type::integer},
+        {"DPI", e_cell_data_type::integer},
+        {"(Center) Coordinate", e_cell_data_type::geo_coordinate},
+        {"Date Taken", e_cell_data_type::text}};
+    return columns;
+}
+
+/// @brief The row of an image.
+row image_row(const string& filename, image_info&& info) {
+    row cells{};
+    cells.reserve(scan_columns().size());
+    cells.push_back(text_cell(path_to_string(fs::path{filename}.filename())));
+    cells.push_back(text_cell(filename));
+    cells.push_back(text_cell(std::move(info.type)));
+    // Megabytes to two decimals, as catalogs show them.
+    const double megabytes = static_cast<double>(info.bytes) / 1e6;
+    cells.push_back(value_cell(e_cell_data_type::floating,
+                               static_cast<float>(std::round(megabytes * 100) /
+                                                  100)));
+    cells.push_back(number_cell(info.width));
+    cells.push_back(number_cell(info.height));
+    cells.push_back(number_cell(info.dpi));
+    cells.push_back(info.location ? value_cell(e_cell_data_type::geo_coordinate,
+                                               *info.location)
+                                  : empty_cell());
+    cells.push_back(text_cell(std::move(info.taken)));
+    return cells;
+}
+}  // namespace
+
+std::optional<image_info> read_image_info(std::span<const unsigned char> bytes,
+                                          std::uint64_t file_bytes) {
+    byte_source in{bytes, file_bytes};
+    return read_image(in);
+}
+
+std::optional<image_info> read_image_file(const string& filename) {
+    byte_source in{filename};
+    if (!in.is_open()) return std::nullopt;
+    return read_image(in);
+}
+
+std::expected<table, string> scan_images(const string& directory,
+                                         scan_stats& stats) {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    stats = scan_stats{};
+    std::error_code ec{};
+    if (!fs::is_directory(directory, ec)) {
+        return std::unexpected(
+            std::format("could not read image directory \"{}\"", directory));
+    }
+    vector<string> files = tree_walk{}.run(directory, stats.directories);
+    std::ranges::sort(files);
+    stats.files = files.size();
+
+    vector<std::optional<image_info>> infos(files.size());
+    const size_t chunks = (files.size() + chunk_files - 1) / chunk_files;
+    scheduler::shared().parallel_for(chunks, [&](size_t chunk) {
+        const size_t end = std::min(files.size(), (chunk + 1) * chunk_files);
+        for (size_t i = chunk * chunk_files; i < end; ++i) {
+            infos[i] = read_image_file(files[i]);
+        }
+    });
+
+    vector<row> rows{};
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (infos[i]) rows.push_back(image_row(files[i], std::move(*infos[i])));
+    }
+    stats.images = rows.size();
+
+    // As reading a CSV file would find, a column without values has no
+    // type.
+    parser::header_fields_t hfs{};
+    for (size_t c = 0; c < scan_columns().size(); ++c) {
+        const bool has_value = std::ranges::any_of(
+            rows, [c](const row& cells) { return cells[c].value.has_value(); });
+        hfs.emplace_back(scan_columns()[c].text,
+                         has_value ? scan_columns()[c].data_type
+                                   : e_cell_data_type::undetermined);
+    }
+    table result{
+        table{hfs, {}, path_to_string(fs::absolute(directory, ec))},
+        std::move(rows)};
+    stats.time = clock::now() - start;
+    return result;
+}
+
+}  // namespace jt
@@ -0,0 +1,308 @@
+#include "live_table.hpp"
+
+#if !defined(_WIN64)
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catalog_files.hpp"
+#include "column_index.hpp"
+#include "parser.hpp"
+#include "row_diff.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace jt {
+
+using std::string;
+using std::vector;
+
+namespace {
+/// @brief Lines per task when hashing or copying rows.
+constexpr size_t chunk_rows{4096};
+
+/// @brief Lines inserted and deleted beyond which reload() reads the whole
+/// file rather than applying the changes. Finding the changes costs time
+/// and memory that grow with their number squared, and past this many it
+/// saves little.
+constexpr size_t max_diff_edits{2048};
+
+/// @brief Hashes each line, in parallel.
+vector<std::uint64_t> hash_lines(const vector<string>& lines) {
+    vector<std::uint64_t> hashes(lines.size());
+    const size_t chunks = (lines.size() + chunk_rows - 1) / chunk_rows;
+    scheduler::shared().parallel_for(chunks, [&](size_t chunk) {
+        const size_t end = std::min(lines.size(), (chunk + 1) * chunk_rows);
+        for (size_t i = chunk * chunk_rows; i < end; ++i) {
+            hashes[i] = line_hash(lines[i]);
+        }
+    });
+    return hashes;
+}
+
+/// @brief Whether a row has the columns of a table, with values of their
+/// types or empty, as parsing the whole file would decide.
+bool fits_columns(const parser::header_fields_t& hfs,
+                  const parser::data_fields_t& dfs) {
+    if (dfs.size() != hfs.size()) return false;
+    for (size_t c = 0; c < hfs.size(); ++c) {
+        if ((hfs[c].data_type || dfs[c].data_type) != hfs[c].data_type) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+size_t peak_resident_bytes() noexcept {
+#if defined(_WIN64)
+    return 0;
+#else
+    rusage usage{};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    const auto peak = static_cast<size_t>(usage.ru_maxrss);
+#if defined(__APPLE__)
+    return peak;
+#else
+    // Linux reports kilobytes.
+    return peak * 1024;
+#endif
+#endif
+}
+
+live_table::live_table(string filename, table t, row_filter keep)
+    : filename_{std::move(filename)},
+      keep_{std::move(keep)},
+      current_{std::make_shared<const table>(std::move(t))} {}
+
+live_table::live_table(vector<string> sources, table t)
+    : sources_{std::move(sources)},
+      current_{std::make_shared<const table>(std::move(t))} {
+    for (const string& source : sources_) {
+        if (!filename_.empty()) filename_.append(", ");
+        filename_.append(source);
+    }
+}
+
+live_table::live_table(string name, loader load)
+    : filename_{std::move(name)},
+      load_{std::move(load)},
+      current_{std::make_shared<const table>()} {}
+
+std::shared_ptr<const table> live_table::snapshot() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return current_.load(std::memory_order_acquire);
+#else
+    std::lock_guard lock{current_mutex_};
+    return current_;
+#endif
+}
+
+std::shared_ptr<const table> live_table::replace(table t) {
+    auto next = std::make_shared<const table>(std::move(t));
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return current_.exchange(std::move(next), std::memory_order_acq_rel);
+#else
+    std::lock_guard lock{current_mutex_};
+    std::swap(current_, next);
+    return next;
+#endif
+}
+
+void live_table::publish(table t,
+                         std::chrono::steady_clock::time_point load_start,
+                         reload_stats& stats) {
+    using clock = std::chrono::steady_clock;
+    const auto swap_start = clock::now();
+    std::shared_ptr<const table> old = replace(std::move(t));
+    stats.swap = clock::now() - swap_start;
+    stats.load = swap_start - load_start;
+    // Less the one held here, which is released on return.
+    stats.old_readers = old ? static_cast<size_t>(old.use_count()) - 1 : 0;
+    old.reset();
+    stats.peak_bytes_after = peak_resident_bytes();
+}
+
+std::expected<reload_stats, string> live_table::reload() {
+    std::lock_guard reloading{reload_mutex_};
+    return reload_locked();
+}
+
+std::expected<reload_stats, string> live_table::reload_locked() {
+    using clock = std::chrono::steady_clock;
+    reload_stats stats{};
+    stats.peak_bytes_before = peak_resident_bytes();
+    const auto load_start = clock::now();
+    if (load_) {
+        auto loaded = load_();
+        if (!loaded) return std::unexpected(loaded.error());
+        stats.rows = loaded->rows_.size();
+        publish(std::move(*loaded), load_start, stats);
+        return stats;
+    }
+    if (!sources_.empty()) {
+        // The sources are listed again, as files may have been added to a
+        // directory since.
+        const auto files = expand_catalog_paths(sources_);
+        if (!files) return std::unexpected(files.error());
+        auto loaded = read_catalog_files(*files, stats.files);
+        if (!loaded) return std::unexpected(loaded.error());
+        stats.rows = loaded->rows_.size();
+        publish(std::move(*loaded), load_start, stats);
+        return stats;
+    }
+    auto text = read_lines(filename_, 0);
+    if (!text) return std::unexpected(text.error());
+
+    // A table with a row filter does not have a row for each line.
+    std::optional<vector<std::uint64_t>> hashes{};
+    if (!keep_) hashes = hash_lines(text->lines);
+    if (hashes && line_hashes_ && !hashes->empty() &&
+        !line_hashes_->empty() && hashes->front() == line_hashes_->front()) {
+        if (auto changed = edited(text->lines, *hashes, stats)) {
+            stats.rows = changed->rows_.size();
+            publish(std::move(*changed), load_start, stats);
+            bytes_read_ = text->unfinished ? text->read : text->end;
+            unfinished_line_ = text->unfinished;
+            line_hashes_ = std::move(hashes);
+            return stats;
+        }
+    }
+
+    auto parsed = parse_lines(std::move(text->lines));
+    if (!parsed) {
+        return std::unexpected(
+            std::format("could not read CSV input file \"{}\"", filename_));
+    }
+    if (keep_) keep_(parsed->header_fields, parsed->all_data_fields);
+    table loaded{*parsed};
+    loaded.name = path_to_string(std::filesystem::absolute(filename_));
+    stats.rows = loaded.rows_.size();
+    publish(std::move(loaded), load_start, stats);
+    bytes_read_ = text->unfinished ? text->read : text->end;
+    unfinished_line_ = text->unfinished;
+    line_hashes_ = std::move(hashes);
+    return stats;
+}
+
+std::optional<table> live_table::edited(const vector<string>& lines,
+                                        std::span<const std::uint64_t> hashes,
+                                        reload_stats& stats) const {
+    static_assert(line_diff::no_line == no_row);
+    const std::shared_ptr<const table> current = snapshot();
+    const auto diff =
+        diff_lines(std::span<const std::uint64_t>{*line_hashes_}.subspan(1),
+                   hashes.subspan(1), max_diff_edits);
+    if (!diff) return std::nullopt;
+
+    // The changed lines are parsed first, as one that does not fit the
+    // columns means reading the whole file anyway.
+    const parser::header_fields_t& hfs = current->header_fields_;
+    vector<row> new_rows(diff->source.size());
+    for (size_t r = 0; r < new_rows.size(); ++r) {
+        if (diff->source[r] != line_diff::no_line) continue;
+        auto dfs = parser::parse_data_row(lines[r + 1]);
+        if (!dfs || !fits_columns(hfs, *dfs)) return std::nullopt;
+        new_rows[r] = data_cell::make_data_cells(std::move(*dfs));
+    }
+    const size_t chunks = (new_rows.size() + chunk_rows - 1) / chunk_rows;
+    scheduler::shared().parallel_for(chunks, [&](size_t chunk) {
+        const size_t end = std::min(new_rows.size(), (chunk + 1) * chunk_rows);
+        for (size_t r = chunk * chunk_rows; r < end; ++r) {
+            if (const auto from = diff->source[r]; from != line_diff::no_line) {
+                new_rows[r] = current->rows_[from];
+            }
+        }
+    });
+    // With the rows that had the only values of a column's type gone, the
+    // column's type is no longer what reading the file would find.
+    for (size_t c = 0; c < hfs.size(); ++c) {
+        if (hfs[c].data_type == e_cell_data_type::undetermined) continue;
+        if (std::ranges::none_of(new_rows, [&](const row& cells) {
+                return cells[c].data_type == hfs[c].data_type;
+            })) {
+            return std::nullopt;
+        }
+    }
+
+    stats.diffed = true;
+    stats.inserted = diff->inserted;
+    stats.deleted = diff->deleted;
+    stats.updated = diff->updated;
+    return current->edited(std::move(new_rows), diff->source);
+}
+
+std::expected<reload_stats, string> live_table::catch_up() {
+    using clock = std::chrono::steady_clock;
+    std::lock_guard reloading{reload_mutex_};
+    if (!sources_.empty() || load_) return reload_locked();
+
+    std::error_code ec{};
+    const std::uint64_t size = std::filesystem::file_size(filename_, ec);
+    if (ec) {
+        return std::unexpected(
+            std::format("could not read CSV input file \"{}\"", filename_));
+    }
+    // A shorter file was rewritten, not appended to.
+    if (!bytes_read_ || size < *bytes_read_) return reload_locked();
+
+    const std::shared_ptr<const table> current = snapshot();
+    reload_stats stats{};
+    stats.whole_file = false;
+    stats.rows = current->rows_.size();
+    if (size == *bytes_read_) return stats;
+    // The last row may have been read before the rest of its line was
+    // written.
+    if (unfinished_line_) return reload_locked();
+
+    stats.peak_bytes_before = peak_resident_bytes();
+    const auto load_start = clock::now();
+    auto text = read_lines(filename_, *bytes_read_);
+    if (!text) return std::unexpected(text.error());
+    if (text->unfinished) text->lines.pop_back();
+    if (text->lines.empty()) {
+        bytes_read_ = text->end;
+        return stats;
+    }
+
+    // Only the new rows' types are checked. One that does not fit a column
+    // changes the column's type, which means reading the whole file.
+    const parser::header_fields_t& hfs = current->header_fields_;
+    parser::all_data_fields_t new_fields{};
+    new_fields.reserve(text->lines.size());
+    for (const string& line : text->lines) {
+        auto dfs = parser::parse_data_row(line);
+        if (!dfs || !fits_columns(hfs, *dfs)) return reload_locked();
+        new_fields.push_back(std::move(*dfs));
+    }
+    if (keep_) keep_(hfs, new_fields);
+    vector<row> new_rows =
+        data_cell::make_all_data_cells(std::move(new_fields));
+    if (line_hashes_) {
+        for (const string& line : text->lines) {
+            line_hashes_->push_back(line_hash(line));
+        }
+    }
+    table next = current->appended(std::move(new_rows));
+    stats.appended = next.rows_.size() - stats.rows;
+    stats.rows = next.rows_.size();
+    publish(std::move(next), load_start, stats);
+    bytes_read_ = text->end;
+    return stats;
+}
+
+}  // namespace jt
@@ -5,8 +5,12 @@
 #include <regex>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <variant>
 
+#include "column_store.hpp"
 #include "contains.hpp"
+#include "predicate.hpp"
 #include "table.hpp"
 #include "utility.hpp"
 
@@ -92,233 +96,107 @@ table::rows query::execute(const string& query_value_s) {
     return results;
 }
 
-// General template for getting the comparison function.
-template <typename T>
-comparison_fn_t<T> get_comparison_function(query::comparison c) {
-    comparison_fn_t<T> result;
-    switch (c) {
-        case query::comparison::equal_to:
-            result = std::equal_to<T>{};
-            break;
-
-        case query::comparison::greater:
-            result = std::greater<T>{};
-            break;
-
-        case query::comparison::greater_equal:
-            result = std::greater_equal<T>{};
-            break;
-
-        case query::comparison::less:
-            result = std::less<T>{};
-            break;
-
-        case query::comparison::less_equal:
-            result = std::less_equal<T>{};
-            break;
-
-        case query::comparison::not_equal_to:
-            result = std::not_equal_to<T>{};
-            break;
-
-        default:
-            result = std::equal_to<T>{};
-            break;
-    }
-
-    return result;
-}
-
-// bool is a special case.
-// Assume false < true.
-// Assume nothing is greater than true.
-// Assume nothing is less than false.
-// Bool comparison functions are found in utility.hpp.
-template <>
-comparison_fn_t<bool> get_comparison_function<bool>(query::comparison c) {
-    comparison_fn_t<bool> result;
-    switch (c) {
-        case query::comparison::equal_to:
-            result = jt::bool_equal_to;
-            break;
-
-        case query::comparison::greater:
-            result = jt::bool_greater;
-            break;
-
-        case query::comparison::greater_equal:
-            result = jt::bool_greater_equal;
-            break;
-
-        case query::comparison::less:
-            result = jt::bool_less;
-            break;
-
-        case query::comparison::less_equal:
-            result = jt::bool_less_equal;
-            break;
-
-        case query::comparison::not_equal_to:
-            result = jt::bool_not_equal_to;
-            break;
-
-        default:
-            result = jt::bool_equal_to;
-            break;
+namespace {
+/// @brief Decides, once per clause, whether an empty cell matches.
+/// Empty text cells are treated as empty strings and empty boolean cells as
+/// false. An empty numeric cell is not equal to anything.
+/// @tparam T
+/// @tparam Op
+/// @param query_value
+/// @return bool
+template <typename T, comparison_op Op>
+bool empty_cell_matches(const T& query_value) {
+    if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
+        return Op == comparison_op::not_equal_to;
+    } else {
+        return predicate<T, Op>{}(T{}, query_value);
     }
-
-    return result;
 }
 
-// float is a special case.
-// Floating point numbers have to be compared for closeness, not equality.
-// They are considered close if they are within 0.00001 of each other.
-// is_close function is found in utility.hpp.
-template <>
-comparison_fn_t<float> get_comparison_function<float>(query::comparison c) {
-    comparison_fn_t<float> result;
-    switch (c) {
-        case query::comparison::equal_to:
-            result = [](float lhs, float rhs) -> bool {
-                return jt::is_close(lhs, rhs);
-            };
-            break;
-
-        case query::comparison::greater:
-            result = std::greater<float>{};
-            break;
-
-        case query::comparison::greater_equal:
-            result = [](float lhs, float rhs) -> bool {
-                return jt::is_close(lhs, rhs) || (lhs >= rhs);
-            };
-            break;
-
-        case query::comparison::less:
-            result = std::less<float>{};
-            break;
-
-        case query::comparison::less_equal:
-            result = [](float lhs, float rhs) -> bool {
-                return jt::is_close(lhs, rhs) || (lhs <= rhs);
-            };
-            break;
-
-        case query::comparison::not_equal_to:
-            result = [](float lhs, float rhs) -> bool {
-                return !is_close(lhs, rhs);
-            };
-            break;
-
-        default:
-            result = [](float lhs, float rhs) -> bool {
-                return jt::is_close(lhs, rhs);
-            };
-            break;
-    }
+/// @brief Row-scan kernels for one column value type.
+/// @tparam T
+template <typename T>
+struct row_scan {
+    /// @brief The scan loop for one comparison operator.
+    /// @tparam Op
+    template <comparison_op Op>
+    struct kernel {
+        static table::rows run(const table::rows& targets, size_t col_idx,
+                               const T& query_value) {
+            constexpr predicate<T, Op> pred{};
+            const bool empty_match = empty_cell_matches<T, Op>(query_value);
+
+            table::rows result;
+            for (const row& rw : targets) {
+                const cell_value_type& cvt = rw[col_idx].value;
+                if (!cvt) {
+                    if (empty_match) result.push_back(rw);
+                    continue;
+                }
+                const T* v = std::get_if<T>(&*cvt);
+                if (v && pred(*v, query_value)) result.push_back(rw);
+            }
+            return result;
+        }
+    };
 
-    return result;
-}
+    static constexpr auto dispatch_table = make_dispatch_table<kernel>();
+};
+}  // namespace
 
-auto query::vw_string_match(const string& query_value,
-                            ranges::ref_view<table::rows> targets) {
+template <typename T>
+table::rows query::scalar_match(const T& query_value,
+                                const table::rows& targets) const {
     const auto col_idx = t.index_for_column_name(column_name);
-    std::function<bool(string, string)> comparitor =
-        get_comparison_function<string>(comp);
-
-    auto result =
-        targets | views::filter([&query_value, col_idx, comparitor](auto dcs) {
-            if (!col_idx) return false;
-            const cell_value_type cvt = dcs[*col_idx].value;
-            // Empty cells are treated as empty strings.
-            const string s = (cvt) ? std::get<string>(*cvt) : string{};
-            return comparitor(s, query_value);
-        });
+    if (!col_idx) return table::rows{};
 
-    return result;
+    const auto scan = row_scan<T>::dispatch_table[dispatch_index(comp)];
+    return scan(targets, *col_idx, query_value);
 }
 
-auto query::vw_integer_match(int query_value,
-                             ranges::ref_view<table::rows> targets) {
+bitmap query::integer_select(int query_value) const {
     const auto col_idx = t.index_for_column_name(column_name);
-    std::function<bool(int, int)> comparitor =
-        get_comparison_function<int>(comp);
-    auto this_comp = comp;
-
-    auto result = targets | views::filter([query_value, col_idx, comparitor,
-                                           this_comp](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type& cvt = rw[*col_idx].value;
-                      if (!cvt) {
-                          // An empty cell is not equal to anything.
-                          return (this_comp == comparison::not_equal_to);
-                      }
-                      const int i = std::get<int>(*cvt);
-                      return comparitor(i, query_value);
-                  });
-    return result;
+    const column_store& cs = t.columns();
+    if (!col_idx) return bitmap(cs.row_count());
+    const auto* col = cs.get_if<integer_column>(*col_idx);
+    if (!col) return bitmap(cs.row_count());
+    return select_integer(*col, comp, query_value);
 }
 
-auto query::vw_boolean_match(bool query_value,
-                             ranges::ref_view<table::rows> targets) {
+bitmap query::floating_select(float query_value) const {
     const auto col_idx = t.index_for_column_name(column_name);
-    std::function<bool(bool, bool)> comparitor =
-        get_comparison_function<bool>(comp);
-
-    auto result = targets | views::filter([query_value, col_idx,
-                                           comparitor](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type cvt = rw[*col_idx].value;
-                      // Assume that a cell with no value counts as false.
-                      const bool b = (cvt) ? std::get<bool>(*cvt) : false;
-                      return comparitor(b, query_value);
-                  });
-    return result;
+    const column_store& cs = t.columns();
+    if (!col_idx) return bitmap(cs.row_count());
+    const auto* col = cs.get_if<floating_column>(*col_idx);
+    if (!col) return bitmap(cs.row_count());
+    return select_floating(*col, comp, query_value);
 }
 
-auto query::vw_floating_match(float query_value,
-                              ranges::ref_view<table::rows> targets) {
+bitmap query::boolean_select(bool query_value) const {
     const auto col_idx = t.index_for_column_name(column_name);
-    std::function<bool(float, float)> comparitor =
-        get_comparison_function<float>(comp);
-    auto this_comp = comp;
-
-    auto result = targets | views::filter([query_value, col_idx, comparitor,
-                                           this_comp](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type cvt = rw[*col_idx].value;
-                      if (!cvt) {
-                          // An empty cell is not equal to anything.
-                          return (this_comp == comparison::not_equal_to);
-                      }
-                      const float f = std::get<float>(*cvt);
-                      return comparitor(f, query_value);
-                  });
-    return result;
+    const column_store& cs = t.columns();
+    if (!col_idx) return bitmap(cs.row_count());
+    const auto* col = cs.get_if<boolean_column>(*col_idx);
+    if (!col) return bitmap(cs.row_count());
+    return select_boolean(*col, comp, query_value);
 }
 
-auto query::vw_geo_query_match(const coordinate& coord,
-                               ranges::ref_view<table::rows> targets) {
-    const auto col_idx = t.index_for_column_name(column_name);
-
+auto query::vw_geo_query_match(const coordinate& coord, size_t col_idx,
+                               const table::rows& targets) const {
     auto result = targets | views::filter([&coord, col_idx](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type cvt = rw[*col_idx].value;
+                      const cell_value_type& cvt = rw[col_idx].value;
                       if (!cvt) return false;
-                      const coordinate cr = std::get<coordinate>(*cvt);
+                      const coordinate& cr = std::get<coordinate>(*cvt);
                       return (is_close(cr.latitude, coord.latitude) &&
                               is_close(cr.longitude, coord.longitude));
                   });
     return result;
 }
 
-auto query::vw_tags_match(const vector<string>& tags,
-                          ranges::ref_view<table::rows> targets) {
-    const auto col_idx = t.index_for_column_name(column_name);
-
+auto query::vw_tags_match(const vector<string>& tags, size_t col_idx,
+                          const table::rows& targets) const {
     auto result = targets | views::filter([&tags, col_idx](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type cvt = rw[*col_idx].value;
+                      const cell_value_type& cvt = rw[col_idx].value;
                       if (!cvt) return false;
                       const vector<string>& vs = std::get<vector<string>>(*cvt);
                       for (const auto& s1 : tags) {
@@ -331,13 +209,10 @@ auto query::vw_tags_match(const vector<string>& tags,
     return result;
 }
 
-auto query::vw_point_in_polygon_match(const polygon_t& polygn,
-                                      ranges::ref_view<table::rows> targets) {
-    const auto col_idx = t.index_for_column_name(column_name);
-
+auto query::vw_point_in_polygon_match(const polygon_t& polygn, size_t col_idx,
+                                      const table::rows& targets) const {
     auto result = targets | views::filter([&polygn, col_idx](const row& rw) {
-                      if (!col_idx) return false;
-                      const cell_value_type cvt = rw[*col_idx].value;
+                      const cell_value_type& cvt = rw[col_idx].value;
                       if (!cvt) return false;
                       const coordinate& coord = std::get<coordinate>(*cvt);
                       return point_in_polygon(coord, polygn);
@@ -348,24 +223,17 @@ auto query::vw_point_in_polygon_match(const polygon_t& polygn,
 
 table::rows query::string_match(const string& query_value,
                                 table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
-
+    const table::rows& targets = rows_to_query ? *rows_to_query : t.rows_;
     const string q_value = dequote(query_value);
-
-    auto string_match_view = vw_string_match(q_value, targets_vw);
-    auto result = ranges::to<table::rows>(string_match_view);
-    return result;
+    return scalar_match(q_value, targets);
 }
 
 table::rows query::integer_match(int query_value,
                                  table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
-
-    auto integer_match_view = vw_integer_match(query_value, targets_vw);
-    auto result = ranges::to<table::rows>(integer_match_view);
-    return result;
+    if (!rows_to_query) {
+        return t.gather(integer_select(query_value));
+    }
+    return scalar_match(query_value, *rows_to_query);
 }
 
 table::rows query::integer_match(const string& query_value,
@@ -377,12 +245,10 @@ table::rows query::integer_match(const string& query_value,
 
 table::rows query::boolean_match(bool query_value,
                                  table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
-
-    auto boolean_match_view = vw_boolean_match(query_value, targets_vw);
-    auto result = ranges::to<table::rows>(boolean_match_view);
-    return result;
+    if (!rows_to_query) {
+        return t.gather(boolean_select(query_value));
+    }
+    return scalar_match(query_value, *rows_to_query);
 }
 
 table::rows query::boolean_match(const string& query_value,
@@ -399,12 +265,10 @@ table::rows query::boolean_match(const string& query_value,
 
 table::rows query::floating_match(float query_value,
                                   table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
-
-    auto floating_match_view = vw_floating_match(query_value, targets_vw);
-    auto result = ranges::to<table::rows>(floating_match_view);
-    return result;
+    if (!rows_to_query) {
+        return t.gather(floating_select(query_value));
+    }
+    return scalar_match(query_value, *rows_to_query);
 }
 
 table::rows query::floating_match(const string& query_value,
@@ -416,10 +280,12 @@ table::rows query::floating_match(const string& query_value,
 
 table::rows query::geo_coordinate_match(const coordinate& coord,
                                         table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
+    const table::rows& targets = rows_to_query ? *rows_to_query : t.rows_;
+    const auto col_idx = t.index_for_column_name(column_name);
+    if (!col_idx) return table::rows{};
 
-    auto geo_coordinate_match_view = vw_geo_query_match(coord, targets_vw);
+    auto geo_coordinate_match_view =
+        vw_geo_query_match(coord, *col_idx, targets);
     auto result = ranges::to<table::rows>(geo_coordinate_match_view);
     return result;
 }
@@ -450,19 +316,23 @@ table::rows query::tags_match(const string& tags_string,
 
 table::rows query::tags_match(const vector<string>& tags,
                               table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
-    auto tags_match_view = vw_tags_match(tags, targets);
+    const table::rows& targets = rows_to_query ? *rows_to_query : t.rows_;
+    const auto col_idx = t.index_for_column_name(column_name);
+    if (!col_idx) return table::rows{};
+
+    auto tags_match_view = vw_tags_match(tags, *col_idx, targets);
     auto result = ranges::to<table::rows>(tags_match_view);
     return result;
 }
 
 table::rows query::point_in_polygon_match(const polygon_t& polygn,
                                           table::opt_rows rows_to_query) {
-    table::rows targets = rows_to_query ? *rows_to_query : t.rows_;
-    auto targets_vw = views::all(targets);
+    const table::rows& targets = rows_to_query ? *rows_to_query : t.rows_;
+    const auto col_idx = t.index_for_column_name(column_name);
+    if (!col_idx) return table::rows{};
+
     auto point_in_polygon_match_view =
-        vw_point_in_polygon_match(polygn, targets);
+        vw_point_in_polygon_match(polygn, *col_idx, targets);
     auto result = ranges::to<table::rows>(point_in_polygon_match_view);
     return result;
 }
@@ -0,0 +1,536 @@
+#include "query_ast.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <expected>
+#include <format>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "predicate.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::string_view;
+using std::unexpected;
+using std::vector;
+
+namespace {
+bool is_space(char c) noexcept {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+/// @brief Characters that end a bare word.
+bool ends_word(string_view source, size_t i) noexcept {
+    const char c = source[i];
+    if (is_space(c)) return true;
+    switch (c) {
+        case '(':
+        case ')':
+        case ',':
+        case '"':
+        case '=':
+        case '<':
+        case '>':
+            return true;
+        case '!':
+            return i + 1 < source.size() && source[i + 1] == '=';
+        case '&':
+            return i + 1 < source.size() && source[i + 1] == '&';
+        default:
+            return false;
+    }
+}
+
+comparison_op comparison_for(string_view s) noexcept {
+    if (s == "=") return comparison_op::equal_to;
+    if (s == "!=") return comparison_op::not_equal_to;
+    if (s == "<") return comparison_op::less;
+    if (s == "<=") return comparison_op::less_equal;
+    if (s == ">") return comparison_op::greater;
+    if (s == ">=") return comparison_op::greater_equal;
+    return comparison_op::invalid;
+}
+
+/// @brief Recursive-descent parser over the token list.
+class query_parser {
+    string_view source_;
+    const vector<token>& tokens_;
+    size_t pos_{0};
+
+   public:
+    query_parser(string_view source, const vector<token>& tokens) noexcept
+        : source_{source}, tokens_{tokens} {}
+
+    const token& peek() const noexcept { return tokens_[pos_]; }
+
+    const token& next() noexcept {
+        const token& tok = tokens_[pos_];
+        if (tok.kind != token_kind::end) ++pos_;
+        return tok;
+    }
+
+    bool at(token_kind kind) const noexcept { return peek().kind == kind; }
+
+    /// @brief True if the next token is the given bare word, ignoring case.
+    bool at_word(string_view word) const {
+        return at(token_kind::word) && to_lower(peek().text) == word;
+    }
+
+    query_syntax_error error_here(const string& message) const {
+        return query_syntax_error{message, peek().begin};
+    }
+
+    std::expected<query_statement, query_syntax_error> statement() {
+        if (at_word("aggregate")) return aggregate_statement();
+        if (at_word("facets")) return facets_statement();
+        if (at_word("select")) return select_statement();
+
+        query_statement result{};
+        if (at_word("query")) {
+            result.statement_kind = query_statement::kind::query;
+        } else if (at_word("refine")) {
+            result.statement_kind = query_statement::kind::refine;
+        } else if (at_word("count")) {
+            result.statement_kind = query_statement::kind::count;
+        } else {
+            return unexpected(
+                error_here("expected \"query\", \"refine\", \"count\", "
+                           "\"select\", \"aggregate\" or \"facets\""));
+        }
+        const string keyword = to_lower(next().text);
+        auto clauses = conjunction();
+        if (!clauses) return unexpected(clauses.error());
+        result.where = std::move(*clauses);
+        if (auto ok = order_and_limit(result); !ok) {
+            return unexpected(ok.error());
+        }
+
+        if (!at(token_kind::end)) {
+            return unexpected(error_here(std::format(
+                "unexpected \"{}\" after {}", peek().text, keyword)));
+        }
+        return result;
+    }
+
+    std::expected<query_statement, query_syntax_error> select_statement() {
+        next();
+        query_statement result{};
+        result.statement_kind = query_statement::kind::select;
+        while (true) {
+            auto column = column_name();
+            if (!column) return unexpected(column.error());
+            result.select_columns.push_back(std::move(*column));
+            if (!at(token_kind::comma)) break;
+            next();
+        }
+        if (at_word("where")) {
+            next();
+            auto clauses = conjunction();
+            if (!clauses) return unexpected(clauses.error());
+            result.where = std::move(*clauses);
+        }
+        if (auto ok = order_and_limit(result); !ok) {
+            return unexpected(ok.error());
+        }
+
+        if (!at(token_kind::end)) {
+            return unexpected(error_here(
+                std::format("unexpected \"{}\" after select", peek().text)));
+        }
+        return result;
+    }
+
+    /// @brief Parses the optional "order by" and "limit" that may end a
+    /// statement.
+    std::expected<void, query_syntax_error> order_and_limit(
+        query_statement& result) {
+        if (at_word("order")) {
+            auto order = order_by();
+            if (!order) return unexpected(order.error());
+            result.order_by = std::move(*order);
+        }
+        if (at_word("limit")) {
+            auto rows = number_after();
+            if (!rows) return unexpected(rows.error());
+            result.limit = *rows;
+        }
+        return {};
+    }
+
+    std::expected<query_statement, query_syntax_error> aggregate_statement() {
+        next();
+        query_statement result{};
+        result.statement_kind = query_statement::kind::aggregate;
+        while (true) {
+            auto call = aggregate();
+            if (!call) return unexpected(call.error());
+            result.aggregates.push_back(std::move(*call));
+            if (!at(token_kind::comma)) break;
+            next();
+        }
+
+        if (at_word("group")) {
+            next();
+            if (!at_word("by")) {
+                return unexpected(
+                    error_here("expected \"by\" after \"group\""));
+            }
+            next();
+            auto column = column_name();
+            if (!column) return unexpected(column.error());
+            result.group_by = std::move(*column);
+        }
+        if (at_word("where")) {
+            next();
+            auto clauses = conjunction();
+            if (!clauses) return unexpected(clauses.error());
+            result.where = std::move(*clauses);
+        }
+
+        if (!at(token_kind::end)) {
+            return unexpected(error_here(std::format(
+                "unexpected \"{}\" after aggregate", peek().text)));
+        }
+        return result;
+    }
+
+    std::expected<query_statement, query_syntax_error> facets_statement() {
+        next();
+        query_statement result{};
+        result.statement_kind = query_statement::kind::facets;
+        auto clauses = conjunction();
+        if (!clauses) return unexpected(clauses.error());
+        result.where = std::move(*clauses);
+
+        if (at_word("by")) {
+            next();
+            while (true) {
+                auto column = column_name();
+                if (!column) return unexpected(column.error());
+                result.facet_columns.push_back(std::move(*column));
+                if (!at(token_kind::comma)) break;
+                next();
+            }
+        }
+        if (at_word("top")) {
+            auto values = number_after();
+            if (!values) return unexpected(values.error());
+            result.limit = *values;
+        }
+
+        if (!at(token_kind::end)) {
+            return unexpected(error_here(
+                std::format("unexpected \"{}\" after facets", peek().text)));
+        }
+        return result;
+    }
+
+    std::expected<aggregate_call, query_syntax_error> aggregate() {
+        aggregate_call result{};
+        if (at_word("count")) {
+            result.fn = aggregate_fn::count;
+        } else if (at_word("sum")) {
+            result.fn = aggregate_fn::sum;
+        } else if (at_word("avg")) {
+            result.fn = aggregate_fn::avg;
+        } else if (at_word("min")) {
+            result.fn = aggregate_fn::min;
+        } else if (at_word("max")) {
+            result.fn = aggregate_fn::max;
+        } else {
+            return unexpected(error_here(
+                "expected \"count\", \"sum\", \"avg\", \"min\" or \"max\""));
+        }
+        const string name = to_lower(next().text);
+
+        // Only count can be used without a column.
+        if (result.fn == aggregate_fn::count && !at(token_kind::left_paren)) {
+            return result;
+        }
+        if (!at(token_kind::left_paren)) {
+            return unexpected(
+                error_here(std::format("expected \"(\" after {}", name)));
+        }
+        next();
+        auto column = column_name();
+        if (!column) return unexpected(column.error());
+        result.column = std::move(*column);
+        if (!at(token_kind::right_paren)) {
+            return unexpected(error_here(std::format(
+                "expected \")\" to end {}(\"{}\")", name,
+                result.column.column_name)));
+        }
+        next();
+        return result;
+    }
+
+    std::expected<column_ref, query_syntax_error> column_name() {
+        column_ref result{};
+        result.position = peek().begin;
+        if (!at(token_kind::quoted)) {
+            return unexpected(
+                error_here("expected a column name in double quotes"));
+        }
+        result.column_name = next().text;
+        return result;
+    }
+
+    std::expected<vector<query_clause>, query_syntax_error> conjunction() {
+        vector<query_clause> result{};
+        while (true) {
+            auto c = clause();
+            if (!c) return unexpected(c.error());
+            result.push_back(std::move(*c));
+            if (!at(token_kind::and_op)) break;
+            next();
+        }
+        return result;
+    }
+
+    std::expected<order_clause, query_syntax_error> order_by() {
+        next();
+        if (!at_word("by")) {
+            return unexpected(error_here("expected \"by\" after \"order\""));
+        }
+        next();
+        auto column = column_name();
+        if (!column) return unexpected(column.error());
+        order_clause result{column->column_name, false, column->position};
+        if (at_word("desc")) {
+            next();
+            result.descending = true;
+        } else if (at_word("asc")) {
+            next();
+        }
+        return result;
+    }
+
+    /// @brief Skips a keyword such as "limit" and reads the number after it.
+    std::expected<size_t, query_syntax_error> number_after() {
+        const string keyword = to_lower(next().text);
+        size_t number = 0;
+        const string& text = peek().text;
+        const auto [end, ec] =
+            std::from_chars(text.data(), text.data() + text.size(), number);
+        if (!at(token_kind::word) || ec != std::errc{} ||
+            end != text.data() + text.size()) {
+            return unexpected(error_here(
+                std::format("expected a number after \"{}\"", keyword)));
+        }
+        next();
+        return number;
+    }
+
+    std::expected<query_clause, query_syntax_error> clause() {
+        query_clause result{};
+        result.position = peek().begin;
+        if (!at(token_kind::left_paren)) {
+            return unexpected(error_here("expected \"(\" to start a clause"));
+        }
+        next();
+
+        if (!at(token_kind::quoted)) {
+            return unexpected(
+                error_here("expected a column name in double quotes"));
+        }
+        result.column_name = next().text;
+
+        if (at(token_kind::comparison)) {
+            result.op = comparison_for(next().text);
+        } else if (at_word("inside")) {
+            next();
+            result.op = comparison_op::inside;
+        } else if (at_word("tags")) {
+            next();
+            result.op = comparison_op::tags;
+        }
+
+        std::expected<void, query_syntax_error> value_ok{};
+        if (result.op == comparison_op::inside) {
+            value_ok = points(result.values);
+        } else if (result.op == comparison_op::tags) {
+            value_ok = tag_list(result.values);
+        } else {
+            value_ok = scalar_value(result.value);
+        }
+        if (!value_ok) return unexpected(value_ok.error());
+
+        if (!at(token_kind::right_paren)) {
+            return unexpected(error_here("expected \")\" to end the clause"));
+        }
+        next();
+        return result;
+    }
+
+    /// @brief Skips a balanced group starting at "(" and returns its source
+    /// text, including the parentheses.
+    std::expected<string, query_syntax_error> group() {
+        const size_t begin = peek().begin;
+        int depth = 0;
+        do {
+            const token& tok = next();
+            if (tok.kind == token_kind::end) {
+                return unexpected(
+                    query_syntax_error{"unbalanced parentheses", begin});
+            }
+            if (tok.kind == token_kind::left_paren) ++depth;
+            if (tok.kind == token_kind::right_paren) --depth;
+        } while (depth > 0);
+        const size_t end = tokens_[pos_ - 1].end;
+        return string{source_.substr(begin, end - begin)};
+    }
+
+    /// @brief Source text of the tokens up to (not including) the next ")",
+    /// or the next "," if stop_at_comma is set.
+    string raw_text_until(bool stop_at_comma) {
+        const size_t begin = peek().begin;
+        size_t end = begin;
+        while (!at(token_kind::end) && !at(token_kind::right_paren) &&
+               !(stop_at_comma && at(token_kind::comma))) {
+            end = next().end;
+        }
+        return trim_spaces(source_.substr(begin, end - begin));
+    }
+
+    static string trim_spaces(string_view sv) {
+        while (!sv.empty() && is_space(sv.front())) sv.remove_prefix(1);
+        while (!sv.empty() && is_space(sv.back())) sv.remove_suffix(1);
+        return string{sv};
+    }
+
+    std::expected<void, query_syntax_error> scalar_value(string& value) {
+        // A quoted value may be empty; a bare one may not.
+        const bool quoted = at(token_kind::quoted);
+        if (quoted) {
+            value = next().text;
+        } else if (at(token_kind::left_paren)) {
+            auto g = group();
+            if (!g) return unexpected(g.error());
+            value = *g;
+        } else {
+            value = raw_text_until(false);
+        }
+        if (value.empty() && !quoted) {
+            return unexpected(error_here("expected a value"));
+        }
+        return {};
+    }
+
+    std::expected<void, query_syntax_error> points(vector<string>& values) {
+        while (at(token_kind::left_paren) || at(token_kind::quoted)) {
+            if (at(token_kind::quoted)) {
+                values.push_back(next().text);
+                continue;
+            }
+            auto g = group();
+            if (!g) return unexpected(g.error());
+            values.push_back(*g);
+        }
+        if (values.size() < 3) {
+            return unexpected(
+                error_here("\"inside\" needs a polygon of at least 3 points"));
+        }
+        return {};
+    }
+
+    std::expected<void, query_syntax_error> tag_list(vector<string>& values) {
+        while (true) {
+            if (at(token_kind::quoted)) {
+                values.push_back(next().text);
+            } else {
+                string tag = raw_text_until(true);
+                if (tag.empty()) {
+                    return unexpected(error_here("expected a tag"));
+                }
+                values.push_back(std::move(tag));
+            }
+            if (!at(token_kind::comma)) break;
+            next();
+        }
+        return {};
+    }
+};
+}  // namespace
+
+std::expected<vector<token>, query_syntax_error> tokenize_query(
+    string_view source) {
+    vector<token> result{};
+    size_t i = 0;
+    while (i < source.size()) {
+        const char c = source[i];
+        if (is_space(c)) {
+            ++i;
+            continue;
+        }
+
+        const size_t begin = i;
+        switch (c) {
+            case '(':
+                result.push_back({token_kind::left_paren, "(", begin, ++i});
+                continue;
+            case ')':
+                result.push_back({token_kind::right_paren, ")", begin, ++i});
+                continue;
+            case ',':
+                result.push_back({token_kind::comma, ",", begin, ++i});
+                continue;
+            case '"': {
+                const size_t close = source.find('"', i + 1);
+                if (close == string_view::npos) {
+                    return unexpected(
+                        query_syntax_error{"unterminated quoted string", i});
+                }
+                result.push_back(
+                    {token_kind::quoted,
+                     string{source.substr(i + 1, close - i - 1)}, begin,
+                     close + 1});
+                i = close + 1;
+                continue;
+            }
+            default:
+                break;
+        }
+
+        if (c == '&' && i + 1 < source.size() && source[i + 1] == '&') {
+            i += 2;
+            result.push_back({token_kind::and_op, "&&", begin, i});
+            continue;
+        }
+
+        if (c == '=' || c == '<' || c == '>' ||
+            (c == '!' && i + 1 < source.size() && source[i + 1] == '=')) {
+            ++i;
+            if (i < source.size() && source[i] == '=' && c != '=') ++i;
+            result.push_back({token_kind::comparison,
+                              string{source.substr(begin, i - begin)}, begin,
+                              i});
+            continue;
+        }
+
+        while (i < source.size() && !ends_word(source, i)) ++i;
+        if (i == begin) {
+            return unexpected(query_syntax_error{
+                std::format("unexpected character '{}'", c), begin});
+        }
+        result.push_back({token_kind::word,
+                          string{source.substr(begin, i - begin)}, begin, i});
+    }
+    result.push_back({token_kind::end, "", source.size(), source.size()});
+    return result;
+}
+
+std::expected<query_statement, query_syntax_error> parse_query_statement(
+    string_view source) {
+    const auto tokens = tokenize_query(source);
+    if (!tokens) return unexpected(tokens.error());
+    query_parser parser{source, *tokens};
+    return parser.statement();
+}
+
+}  // namespace jt
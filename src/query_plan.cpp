@@ -0,0 +1,929 @@
+#include "query_plan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "block_filter.hpp"
+#include "cell_types.hpp"
+#include "clause_cache.hpp"
+#include "column_index.hpp"
+#include "column_stats.hpp"
+#include "column_store.hpp"
+#include "coordinates.hpp"
+#include "predicate.hpp"
+#include "query_ast.hpp"
+#include "row_order.hpp"
+#include "table.hpp"
+#include "scheduler.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::unexpected;
+using std::vector;
+using ecdt = e_cell_data_type;
+
+namespace {
+plan_error bad_value(const query_clause& qc, ecdt expected_type) {
+    return plan_error{
+        plan_error::kind::bad_value,
+        std::format("Error: input {} for column {} was not of type {}",
+                    qc.value, qc.column_name, expected_type)};
+}
+
+plan_error wrong_operator(const query_clause& qc, ecdt col_type) {
+    return plan_error{
+        plan_error::kind::wrong_operator,
+        std::format("Error: that operator cannot be used with column \"{}\" "
+                    "of type {}",
+                    qc.column_name, col_type)};
+}
+
+/// @brief Reads one point, written as "(lat, long)", "lat, long" or in
+/// degrees and minutes.
+std::expected<coordinate, convert_error> parse_point(const string& s) {
+    if (auto coord = s_to_geo_coordinate(s)) return coord;
+    string bare{s};
+    std::erase_if(bare,
+                  [](char c) { return c == '"' || c == '(' || c == ')'; });
+    trim(bare);
+    return s_to_geo_coordinate(bare);
+}
+
+/// @brief Splits "a, b, c" into tags, removing spaces and double quotes.
+vector<string> split_tags(const string& s) {
+    vector<string> result{};
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t end = s.find(',', begin);
+        if (end == string::npos) end = s.size();
+        string tag = dequote(trim(s.substr(begin, end - begin)));
+        if (!tag.empty()) result.push_back(std::move(tag));
+        begin = end + 1;
+    }
+    return result;
+}
+
+// Rough costs, in nanoseconds per row, used to order clauses and to choose
+// between an index and a scan. Only their relative sizes matter.
+
+/// @brief Comparing one value with a vectorized kernel.
+constexpr double kernel_cost{0.6};
+
+/// @brief Combining precomputed boolean bits.
+constexpr double bits_cost{0.05};
+
+/// @brief Walking one row's tag list.
+constexpr double tags_cost{5.0};
+
+/// @brief One point-in-polygon crossing test, per polygon edge.
+constexpr double edge_cost{1.5};
+
+/// @brief Setting the bit for one row id taken from an index.
+constexpr double posting_cost{2.0};
+
+double scan_cost_for(const plan_clause& pc) {
+    switch (pc.type) {
+        case ecdt::boolean:
+            return bits_cost;
+        case ecdt::tags:
+            return tags_cost;
+        case ecdt::geo_coordinate:
+            if (const auto* polygn = std::get_if<polygon_t>(&pc.value)) {
+                // Four kernel passes for the bounding box; the crossing test
+                // is only paid for rows inside the box, but that is not
+                // known here, so charge a fraction of it.
+                return 4 * kernel_cost +
+                       0.25 * edge_cost * static_cast<double>(polygn->size());
+            }
+            return 2 * kernel_cost;
+        default:
+            return kernel_cost;
+    }
+}
+
+bool has_index(const column_store& cs, const plan_clause& pc) {
+    switch (pc.type) {
+        case ecdt::integer:
+            return cs.get_index_if<sorted_index<std::int32_t>>(pc.column) !=
+                   nullptr;
+        case ecdt::floating:
+            return cs.get_index_if<sorted_index<float>>(pc.column) != nullptr;
+        case ecdt::text:
+        case ecdt::tags:
+            return cs.get_index_if<posting_lists>(pc.column) != nullptr;
+        default:
+            return false;
+    }
+}
+
+/// @brief Orders the clauses for execution. Indexed clauses come first, the
+/// smallest first, since each produces its matches directly. Scanned clauses
+/// follow, ordered by the cost of scanning a row divided by the fraction of
+/// rows the clause removes, so a cheap clause that removes many rows goes
+/// before an expensive one or one that removes few.
+void order_clauses(vector<plan_clause>& clauses, double row_count) {
+    auto rank = [row_count](const plan_clause& pc) {
+        if (pc.use_index) return pc.estimated_rows;
+        const double removed =
+            row_count > 0 ? 1.0 - pc.estimated_rows / row_count : 1.0;
+        return pc.scan_cost / std::max(removed, 1e-6);
+    };
+    std::ranges::stable_sort(clauses, [&rank](const plan_clause& lhs,
+                                              const plan_clause& rhs) {
+        if (lhs.use_index != rhs.use_index) return lhs.use_index;
+        return rank(lhs) < rank(rhs);
+    });
+}
+
+template <typename T>
+plan_clause::value_t converted(const std::expected<T, convert_error>& v) {
+    return v ? plan_clause::value_t{*v} : plan_clause::value_t{};
+}
+
+/// @brief Converts a clause's value to the type of its column.
+std::expected<plan_clause, plan_error> plan_one(const table& t,
+                                                const query_clause& qc) {
+    const auto col_idx = t.index_for_column_name(qc.column_name);
+    if (!col_idx) {
+        return unexpected(plan_error{
+            plan_error::kind::unknown_column,
+            std::format("Column \"{}\" is not in this file.",
+                        qc.column_name)});
+    }
+
+    plan_clause result{qc.column_name, *col_idx,
+                       t.header_field_at_index(*col_idx).data_type, qc.op};
+
+    if (qc.op == comparison_op::inside) {
+        if (result.type != ecdt::geo_coordinate) {
+            return unexpected(wrong_operator(qc, result.type));
+        }
+        polygon_t polygn{};
+        for (const string& s : qc.values) {
+            const auto point = parse_point(s);
+            if (!point) {
+                return unexpected(plan_error{
+                    plan_error::kind::bad_value,
+                    std::format("Error: {} is not a geo-coordinate", s)});
+            }
+            polygn.push_back(*point);
+        }
+        result.value = std::move(polygn);
+        return result;
+    }
+
+    if (qc.op == comparison_op::tags || result.type == ecdt::tags) {
+        if (result.type != ecdt::tags) {
+            return unexpected(wrong_operator(qc, result.type));
+        }
+        // A tags column compared with "=" takes a comma-separated list.
+        result.value =
+            qc.op == comparison_op::tags ? qc.values : split_tags(qc.value);
+        result.op = comparison_op::tags;
+        return result;
+    }
+
+    switch (result.type) {
+        case ecdt::text:
+            result.value = qc.value;
+            break;
+        case ecdt::integer:
+            result.value = converted(s_to_integer(qc.value));
+            break;
+        case ecdt::floating:
+            result.value = converted(s_to_floating(qc.value));
+            break;
+        case ecdt::boolean:
+            result.value = converted(s_to_boolean(qc.value));
+            break;
+        case ecdt::geo_coordinate:
+            if (qc.op != comparison_op::equal_to &&
+                qc.op != comparison_op::not_equal_to) {
+                return unexpected(wrong_operator(qc, result.type));
+            }
+            result.value = converted(parse_point(qc.value));
+            break;
+        default:
+            return unexpected(plan_error{
+                plan_error::kind::unsupported,
+                std::format("Queries not yet supported for type {}",
+                            result.type)});
+    }
+    if (std::holds_alternative<std::monostate>(result.value)) {
+        return unexpected(bad_value(qc, result.type));
+    }
+    return result;
+}
+
+/// @brief Appends the bytes of a value to a key.
+template <typename T>
+void append_bytes(string& key, const T& v) {
+    key.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+/// @brief Appends a float so that equal values append equal bytes.
+void append_float(string& key, float v) {
+    append_bytes(key, v == 0.0f ? 0.0f : v);
+}
+
+/// @brief Calls scan(first, last) for the rows of each morsel of a table of
+/// n rows, on the scheduler's threads if there is more than one morsel.
+template <class Scan>
+void for_each_morsel(size_t n, scheduler* sched, const Scan& scan) {
+    const size_t morsels = (n + morsel_rows - 1) / morsel_rows;
+    auto scan_morsel = [&](size_t m) {
+        const size_t first = m * morsel_rows;
+        scan(first, std::min(n, first + morsel_rows));
+    };
+    if (!sched || morsels <= 1) {
+        for (size_t m = 0; m < morsels; ++m) scan_morsel(m);
+        return;
+    }
+    sched->parallel_for(morsels, scan_morsel);
+}
+
+/// @brief Runs the clauses with a cache. Results in the cache are used
+/// first, since they cost nothing, then indexed clauses are looked up and
+/// cached. The scanned clauses left are run in one pass, each into a result
+/// of its own that is cached; or, if few rows are left, fused over just
+/// those rows and not cached.
+bitmap execute_with_cache(const column_store& cs,
+                          const vector<plan_clause>& clauses,
+                          clause_cache& cache, scheduler* sched) {
+    const size_t n = cs.row_count();
+    const std::uint64_t generation = cs.generation();
+    bitmap result(n, true);
+
+    vector<plan_clause> scanned{};
+    vector<clause_key> keys{};
+    for (const plan_clause& pc : clauses) {
+        clause_key key = make_clause_key(pc);
+        if (const auto hit = cache.find(generation, key)) {
+            result &= *hit;
+        } else if (pc.use_index) {
+            auto selection = std::make_shared<bitmap>(lookup_clause(cs, pc));
+            result &= *selection;
+            cache.insert(generation, key, std::move(selection));
+        } else {
+            scanned.push_back(pc);
+            keys.push_back(std::move(key));
+        }
+    }
+    if (scanned.empty() || result.none()) return result;
+    if (is_sparse(result)) {
+        return fused_scan(cs, scanned, std::move(result), sched);
+    }
+
+    vector<block_filter> filters{};
+    filters.reserve(scanned.size());
+    for (const plan_clause& pc : scanned) {
+        filters.push_back(make_block_filter(cs, pc));
+    }
+    vector<bitmap> own(scanned.size(), bitmap(n, true));
+    const std::span<bitmap::word_t> words = result.words();
+    for_each_morsel(n, sched, [&](size_t first, size_t last) {
+        fused_scan_rows_each(filters, own, words, first, last);
+    });
+    for (size_t c = 0; c < own.size(); ++c) {
+        cache.insert(generation, keys[c],
+                     std::make_shared<bitmap>(std::move(own[c])));
+    }
+    return result;
+}
+
+/// @brief Resolves the column of an "order by".
+std::expected<plan_order, plan_error> plan_sort(const table& t,
+                                                const order_clause& oc) {
+    const auto col_idx = t.index_for_column_name(oc.column_name);
+    if (!col_idx) {
+        return unexpected(plan_error{
+            plan_error::kind::unknown_column,
+            std::format("Column \"{}\" is not in this file.",
+                        oc.column_name)});
+    }
+    const ecdt type = t.header_field_at_index(*col_idx).data_type;
+    switch (type) {
+        case ecdt::integer:
+        case ecdt::floating:
+        case ecdt::text:
+        case ecdt::boolean:
+            return plan_order{oc.column_name, *col_idx, type, oc.descending};
+        default:
+            return unexpected(plan_error{
+                plan_error::kind::unsupported,
+                std::format("Error: cannot order by column \"{}\" of type {}",
+                            oc.column_name, type)});
+    }
+}
+
+/// @brief Whether to find the first wanted rows by walking the sort
+/// column's index rather than with a heap over every match. The walk visits
+/// about wanted * rows / matches index entries, if the matches are spread
+/// evenly; the heap visits every match, at a cost of log(wanted) each.
+bool prefer_index_walk(size_t rows, size_t matches, size_t wanted) {
+    if (wanted == 0 || matches == 0) return false;
+    const double walk = static_cast<double>(wanted) *
+                        static_cast<double>(rows) /
+                        static_cast<double>(matches);
+    const double heap = static_cast<double>(matches) *
+                        std::log2(static_cast<double>(wanted) + 1.0);
+    return walk < heap;
+}
+
+/// @brief Testing one row against a clause: its filter runs over the word of
+/// rows that holds it.
+constexpr double row_test_cost{bitmap::word_bits * kernel_cost};
+
+/// @brief Whether to find a limited plan's first rows by walking the sort
+/// column's index and testing each row, rather than by running the clauses
+/// and picking from their result. The matches are estimated as if the
+/// clauses were independent; the walk tests about wanted * rows / matches
+/// rows, if the matches are spread evenly.
+bool prefer_row_tests(const vector<plan_clause>& clauses, size_t rows,
+                      size_t wanted) {
+    if (rows == 0) return false;
+    const auto n = static_cast<double>(rows);
+    double matches = n;
+    double scan = 0.0;
+    for (const plan_clause& pc : clauses) {
+        matches *= std::min(pc.estimated_rows / n, 1.0);
+        scan += pc.use_index ? pc.estimated_rows * posting_cost
+                             : n * pc.scan_cost;
+    }
+    if (matches < 1.0) return false;
+    const double tested =
+        std::min(n, static_cast<double>(wanted) * n / matches);
+    const double walk =
+        tested * static_cast<double>(std::max<size_t>(clauses.size(), 1)) *
+        row_test_cost;
+    const double heap = matches * std::log2(static_cast<double>(wanted) + 1.0);
+    return walk < scan + heap;
+}
+
+/// @brief Tests single rows against a plan's clauses, for walking an index.
+class row_tester {
+    vector<block_filter> filters_{};
+    size_t rows_{0};
+
+   public:
+    /// @brief Refers to cs and to clauses, which must outlive it.
+    row_tester(const column_store& cs, const vector<plan_clause>& clauses)
+        : rows_{cs.row_count()} {
+        filters_.reserve(clauses.size());
+        for (const plan_clause& pc : clauses) {
+            filters_.push_back(make_block_filter(cs, pc));
+        }
+    }
+
+    /// @brief Whether row r satisfies every clause.
+    bool operator()(std::uint32_t r) const {
+        const size_t first = r / bitmap::word_bits * bitmap::word_bits;
+        std::array<bitmap::word_t, 3> words{
+            bitmap::word_t{1} << (r - first), 0, 0};
+        const std::span<bitmap::word_t> all{words};
+        row_block block{first, std::min(rows_, first + bitmap::word_bits),
+                        all.subspan(0, 1), all.subspan(1, 1),
+                        all.subspan(2, 1)};
+        for (const block_filter& filter : filters_) {
+            apply_filter(filter, block);
+            if (block.none()) return false;
+        }
+        return true;
+    }
+};
+
+/// @brief rows_in_index_order() over the sort column's index.
+/// @return Nothing if the column has no index.
+template <class Selection>
+std::optional<vector<std::uint32_t>> index_order(const column_store& cs,
+                                                 const plan_order& order,
+                                                 const Selection& selection,
+                                                 size_t wanted) {
+    const size_t col_idx = order.column;
+    const bool desc = order.descending;
+    if (const auto* col = cs.get_if<integer_column>(col_idx)) {
+        const auto* idx = cs.get_index_if<sorted_index<std::int32_t>>(col_idx);
+        if (idx) {
+            return rows_in_index_order(*col, *idx, selection, desc, wanted);
+        }
+    } else if (const auto* col = cs.get_if<floating_column>(col_idx)) {
+        const auto* idx = cs.get_index_if<sorted_index<float>>(col_idx);
+        if (idx) {
+            return rows_in_index_order(*col, *idx, selection, desc, wanted);
+        }
+    } else if (const auto* col = cs.get_if<text_column>(col_idx)) {
+        const auto* idx = cs.get_index_if<posting_lists>(col_idx);
+        if (idx) {
+            return rows_in_index_order(*col, *idx, selection, desc, wanted);
+        }
+    }
+    return std::nullopt;
+}
+
+/// @brief top_rows() ordering by a column's values.
+template <class Values>
+vector<std::uint32_t> top_by(const bitmap& selection, size_t wanted,
+                             const Values& values, const bitmap& present,
+                             bool descending) {
+    return top_rows(selection, wanted,
+                    row_order<Values>{&values, &present, descending});
+}
+}  // namespace
+
+clause_key make_clause_key(const plan_clause& clause) {
+    clause_key result{clause.column, clause.op};
+    string& key = result.value;
+    key.push_back(static_cast<char>(clause.value.index()));
+    std::visit(
+        [&key](const auto& v) {
+            using V = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<V, int> || std::is_same_v<V, bool>) {
+                append_bytes(key, v);
+            } else if constexpr (std::is_same_v<V, float>) {
+                append_float(key, v);
+            } else if constexpr (std::is_same_v<V, string>) {
+                key.append(v);
+            } else if constexpr (std::is_same_v<V, coordinate>) {
+                append_float(key, v.latitude);
+                append_float(key, v.longitude);
+            } else if constexpr (std::is_same_v<V, vector<string>>) {
+                // Any order of the same tags selects the same rows.
+                vector<string> tags{v};
+                std::ranges::sort(tags);
+                const auto dups = std::ranges::unique(tags);
+                tags.erase(dups.begin(), dups.end());
+                for (const string& tag : tags) {
+                    append_bytes(key, tag.size());
+                    key.append(tag);
+                }
+            } else if constexpr (std::is_same_v<V, polygon_t>) {
+                for (const coordinate& point : v) {
+                    append_float(key, point.latitude);
+                    append_float(key, point.longitude);
+                }
+            }
+        },
+        clause.value);
+    return result;
+}
+
+std::expected<query_plan, plan_error> query_plan::make(
+    const table& t, const query_statement& statement) {
+    query_plan result{};
+    result.columns_ = t.column_store_ptr();
+    const column_store& cs = t.columns();
+    const auto n = static_cast<double>(cs.row_count());
+
+    result.clauses_.reserve(statement.where.size());
+    for (const query_clause& qc : statement.where) {
+        auto pc = plan_one(t, qc);
+        if (!pc) return unexpected(pc.error());
+        pc->estimated_rows = estimate_rows(cs, *pc);
+        pc->scan_cost = scan_cost_for(*pc);
+        pc->use_index = has_index(cs, *pc) &&
+                        pc->estimated_rows * posting_cost < n * pc->scan_cost;
+        result.clauses_.push_back(std::move(*pc));
+    }
+    order_clauses(result.clauses_, n);
+
+    if (statement.order_by) {
+        auto order = plan_sort(t, *statement.order_by);
+        if (!order) return unexpected(order.error());
+        result.order_ = std::move(*order);
+    }
+    result.limit_ = statement.limit;
+    return result;
+}
+
+const column_store& query_plan::store() const noexcept {
+    static const column_store no_columns{};
+    return columns_ ? *columns_ : no_columns;
+}
+
+bitmap query_plan::execute(execution_mode mode, scheduler* sched,
+                           clause_cache* cache) const {
+    const column_store& cs = store();
+    if (cache) return execute_with_cache(cs, clauses_, *cache, sched);
+    return run(bitmap(cs.row_count(), true), false, mode, sched);
+}
+
+size_t query_plan::count(scheduler* sched, clause_cache* cache) const {
+    const column_store& cs = store();
+    std::optional<size_t> n{};
+    if (clauses_.size() == 1) n = count_from_index(cs, clauses_.front());
+    if (!n) n = execute(execution_mode::fused, sched, cache).count();
+    return limit_ ? std::min(*n, *limit_) : *n;
+}
+
+vector<std::uint32_t> query_plan::ordered_rows(const bitmap& selection) const {
+    const size_t matches = selection.count();
+    const size_t wanted = std::min(limit_.value_or(matches), matches);
+    if (!order_) return first_rows(selection, wanted);
+
+    const column_store& cs = store();
+    const size_t col_idx = order_->column;
+    const bool desc = order_->descending;
+    if (prefer_index_walk(cs.row_count(), matches, wanted)) {
+        if (auto rows = index_order(cs, *order_, selection, wanted)) {
+            return std::move(*rows);
+        }
+    }
+
+    if (const auto* col = cs.get_if<integer_column>(col_idx)) {
+        const std::span<const std::int32_t> values{col->values};
+        return top_by(selection, wanted, values, col->present, desc);
+    }
+    if (const auto* col = cs.get_if<floating_column>(col_idx)) {
+        const std::span<const float> values{col->values};
+        return top_by(selection, wanted, values, col->present, desc);
+    }
+    if (const auto* col = cs.get_if<text_column>(col_idx)) {
+        // The dictionary is sorted, so codes compare as their strings do.
+        const std::span<const std::int32_t> codes{col->codes};
+        return top_by(selection, wanted, codes, col->present, desc);
+    }
+    if (const auto* col = cs.get_if<boolean_column>(col_idx)) {
+        return top_by(selection, wanted, col->values, col->present, desc);
+    }
+    return first_rows(selection, wanted);
+}
+
+std::optional<vector<std::uint32_t>> query_plan::walk_index() const {
+    if (!order_ || !limit_) return std::nullopt;
+    const column_store& cs = store();
+    if (!prefer_row_tests(clauses_, cs.row_count(), *limit_)) {
+        return std::nullopt;
+    }
+    return index_order(cs, *order_, row_tester{cs, clauses_}, *limit_);
+}
+
+bitmap query_plan::execute_within(bitmap candidates, scheduler* sched) const {
+    return run(std::move(candidates), true, execution_mode::fused, sched);
+}
+
+query_plan query_plan::without(const vector<clause_key>& keys) const {
+    query_plan result{};
+    result.columns_ = columns_;
+    result.order_ = order_;
+    result.limit_ = limit_;
+    for (const plan_clause& pc : clauses_) {
+        if (std::ranges::find(keys, make_clause_key(pc)) == keys.end()) {
+            result.clauses_.push_back(pc);
+        }
+    }
+    return result;
+}
+
+bitmap query_plan::run(bitmap result, bool restricted, execution_mode mode,
+                       scheduler* sched) const {
+    const column_store& cs = store();
+    if (result.none()) return result;
+
+    // Indexed clauses come first in clauses_.
+    const auto scanned =
+        std::ranges::find_if_not(clauses_, &plan_clause::use_index);
+    for (auto it = clauses_.begin(); it != scanned; ++it) {
+        result &= lookup_clause(cs, *it);
+        restricted = true;
+        if (result.none()) return result;
+    }
+
+    if (mode == execution_mode::fused) {
+        return fused_scan(cs, std::span{scanned, clauses_.end()},
+                          std::move(result), sched);
+    }
+    for (auto it = scanned; it != clauses_.end(); ++it) {
+        // Later scans only look at the rows earlier clauses kept.
+        result = evaluate_clause(cs, *it, restricted ? &result : nullptr);
+        restricted = true;
+        if (result.none()) break;
+    }
+    return result;
+}
+
+block_filter make_block_filter(const column_store& cs,
+                               const plan_clause& clause) {
+    using co = comparison_op;
+    const size_t col_idx = clause.column;
+    const co op = clause.op;
+    const auto& value = clause.value;
+
+    if (const auto* col = cs.get_if<integer_column>(col_idx)) {
+        if (const int* v = std::get_if<int>(&value)) {
+            return int32_filter{col->values, op, *v, &col->present};
+        }
+    } else if (const auto* col = cs.get_if<floating_column>(col_idx)) {
+        if (const float* v = std::get_if<float>(&value)) {
+            return float_filter{col->values, op, *v, &col->present};
+        }
+    } else if (const auto* col = cs.get_if<boolean_column>(col_idx)) {
+        if (const bool* v = std::get_if<bool>(&value)) {
+            const auto compare = bool_compare_table[dispatch_index(op)];
+            return boolean_filter{&col->values, compare(true, *v),
+                                  compare(false, *v)};
+        }
+    } else if (const auto* col = cs.get_if<text_column>(col_idx)) {
+        if (const string* v = std::get_if<string>(&value)) {
+            // As in select_text(): compare dictionary codes.
+            const auto it = std::ranges::lower_bound(col->dictionary, *v);
+            const auto code =
+                static_cast<std::int32_t>(it - col->dictionary.begin());
+            const bool found = it != col->dictionary.end() && *it == *v;
+            co code_op = op;
+            if (!found) {
+                switch (op) {
+                    case co::equal_to:
+                        return constant_filter{false};
+                    case co::not_equal_to:
+                        return constant_filter{true};
+                    case co::less_equal:
+                        code_op = co::less;
+                        break;
+                    case co::greater:
+                        code_op = co::greater_equal;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            return int32_filter{col->codes, code_op, code, nullptr};
+        }
+    } else if (const auto* col = cs.get_if<coordinate_column>(col_idx)) {
+        if (const coordinate* v = std::get_if<coordinate>(&value)) {
+            return coordinate_filter{col, *v, op == co::not_equal_to};
+        }
+        if (const polygon_t* v = std::get_if<polygon_t>(&value)) {
+            if (v->size() < 3) return constant_filter{false};
+            const auto lats =
+                std::ranges::minmax(*v, {}, &coordinate::latitude);
+            const auto longs =
+                std::ranges::minmax(*v, {}, &coordinate::longitude);
+            return inside_filter{col,
+                                 *v,
+                                 lats.min.latitude,
+                                 lats.max.latitude,
+                                 longs.min.longitude,
+                                 longs.max.longitude};
+        }
+    } else if (const auto* col = cs.get_if<tags_column>(col_idx)) {
+        if (const auto* v = std::get_if<vector<string>>(&value)) {
+            tags_filter result{col, vector<bool>(col->dictionary.size())};
+            bool any_wanted = false;
+            for (const string& tag : *v) {
+                const auto it = std::ranges::lower_bound(col->dictionary, tag);
+                if (it != col->dictionary.end() && *it == tag) {
+                    result.wanted[static_cast<size_t>(
+                        it - col->dictionary.begin())] = true;
+                    any_wanted = true;
+                }
+            }
+            if (!any_wanted) return constant_filter{false};
+            return result;
+        }
+    }
+    return constant_filter{false};
+}
+
+void fused_scan_rows(std::span<const block_filter> filters,
+                     std::span<bitmap::word_t> words, size_t first,
+                     size_t last) {
+    constexpr size_t block_words = bitmap::words_for(fused_block_rows);
+    std::array<bitmap::word_t, 2 * block_words> work{};
+    for (size_t begin = first; begin < last; begin += fused_block_rows) {
+        const size_t end = std::min(last, begin + fused_block_rows);
+        const size_t count = bitmap::words_for(end - begin);
+        row_block block{begin, end,
+                        words.subspan(begin / bitmap::word_bits, count),
+                        std::span{work}.first(count),
+                        std::span{work}.subspan(block_words, count)};
+        for (const block_filter& filter : filters) {
+            // Short-circuit: once no row in the block is left, the remaining
+            // clauses have nothing to do.
+            if (block.none()) break;
+            apply_filter(filter, block);
+        }
+    }
+}
+
+void fused_scan_rows_each(std::span<const block_filter> filters,
+                          std::span<bitmap> own,
+                          std::span<bitmap::word_t> words, size_t first,
+                          size_t last) {
+    for (size_t begin = first; begin < last; begin += fused_block_rows) {
+        const size_t end = std::min(last, begin + fused_block_rows);
+        const size_t first_word = begin / bitmap::word_bits;
+        const size_t last_word = first_word + bitmap::words_for(end - begin);
+        for (size_t c = 0; c < filters.size(); ++c) {
+            const std::span<bitmap::word_t> own_words = own[c].words();
+            fused_scan_rows(filters.subspan(c, 1), own_words, begin, end);
+            for (size_t w = first_word; w < last_word; ++w) {
+                words[w] &= own_words[w];
+            }
+        }
+    }
+}
+
+bitmap fused_scan(const column_store& cs, std::span<const plan_clause> clauses,
+                  bitmap candidates, scheduler* sched) {
+    if (clauses.empty()) return candidates;
+
+    vector<block_filter> filters{};
+    filters.reserve(clauses.size());
+    for (const plan_clause& pc : clauses) {
+        filters.push_back(make_block_filter(cs, pc));
+    }
+
+    const std::span<bitmap::word_t> words = candidates.words();
+    for_each_morsel(cs.row_count(), sched, [&](size_t first, size_t last) {
+        fused_scan_rows(filters, words, first, last);
+    });
+    return candidates;
+}
+
+double estimate_rows(const column_store& cs, const plan_clause& clause) {
+    const column_stats& st = cs.stats(clause.column);
+    const auto n = static_cast<double>(st.row_count);
+    const auto absent = static_cast<double>(st.row_count - st.present_count);
+    const comparison_op op = clause.op;
+    const bool negate = op == comparison_op::not_equal_to;
+    const auto& value = clause.value;
+
+    auto from_histogram = [&](double v) {
+        if (!st.values_histogram) return n;
+        return st.values_histogram->estimate(op, v) + (negate ? absent : 0.0);
+    };
+
+    if (const int* v = std::get_if<int>(&value)) {
+        return from_histogram(static_cast<double>(*v));
+    }
+    if (const float* v = std::get_if<float>(&value)) {
+        return from_histogram(static_cast<double>(*v));
+    }
+    if (const bool* v = std::get_if<bool>(&value)) {
+        const auto* col = cs.get_if<boolean_column>(clause.column);
+        if (!col) return n;
+        return static_cast<double>(select_boolean(*col, op, *v).count());
+    }
+    if (const string* v = std::get_if<string>(&value)) {
+        const auto* col = cs.get_if<text_column>(clause.column);
+        const auto* idx = cs.get_index_if<posting_lists>(clause.column);
+        if (!col || !idx) return n;
+        const auto [first, last] = code_range(
+            col->dictionary, negate ? comparison_op::equal_to : op, *v);
+        const auto matches = static_cast<double>(idx->count(first, last));
+        return negate ? n - matches : matches;
+    }
+    if (const auto* v = std::get_if<vector<string>>(&value)) {
+        const auto* col = cs.get_if<tags_column>(clause.column);
+        const auto* idx = cs.get_index_if<posting_lists>(clause.column);
+        if (!col || !idx) return n;
+        double matches = 0.0;
+        for (const string& tag : *v) {
+            const auto [first, last] =
+                code_range(col->dictionary, comparison_op::equal_to, tag);
+            matches += static_cast<double>(idx->count(first, last));
+        }
+        return std::min(n, matches);
+    }
+    if (std::holds_alternative<coordinate>(value)) {
+        // Assume coordinates are mostly different from each other.
+        const double matches = st.present_count > 0 ? 1.0 : 0.0;
+        return negate ? n - matches : matches;
+    }
+    if (const polygon_t* v = std::get_if<polygon_t>(&value)) {
+        if (!st.bounds || v->empty()) return 0.0;
+        // Fraction of the column's bounding box covered by the polygon's.
+        const geo_bounds& b = *st.bounds;
+        const auto lats = std::ranges::minmax(*v, {}, &coordinate::latitude);
+        const auto longs =
+            std::ranges::minmax(*v, {}, &coordinate::longitude);
+        auto overlap = [](double lo, double hi, double col_lo,
+                          double col_hi) {
+            if (col_hi <= col_lo) {
+                return (lo <= col_lo && col_lo <= hi) ? 1.0 : 0.0;
+            }
+            const double covered = std::min(hi, col_hi) - std::max(lo, col_lo);
+            return std::clamp(covered / (col_hi - col_lo), 0.0, 1.0);
+        };
+        return static_cast<double>(st.present_count) *
+               overlap(lats.min.latitude, lats.max.latitude, b.latitude_min,
+                       b.latitude_max) *
+               overlap(longs.min.longitude, longs.max.longitude,
+                       b.longitude_min, b.longitude_max);
+    }
+    return n;
+}
+
+bitmap lookup_clause(const column_store& cs, const plan_clause& clause) {
+    const size_t col_idx = clause.column;
+    const comparison_op op = clause.op;
+    const auto& value = clause.value;
+
+    if (const int* v = std::get_if<int>(&value)) {
+        const auto* col = cs.get_if<integer_column>(col_idx);
+        const auto* idx = cs.get_index_if<sorted_index<std::int32_t>>(col_idx);
+        if (col && idx) return index_lookup(*col, *idx, op, *v);
+    } else if (const float* v = std::get_if<float>(&value)) {
+        const auto* col = cs.get_if<floating_column>(col_idx);
+        const auto* idx = cs.get_index_if<sorted_index<float>>(col_idx);
+        if (col && idx) return index_lookup(*col, *idx, op, *v);
+    } else if (const string* v = std::get_if<string>(&value)) {
+        const auto* col = cs.get_if<text_column>(col_idx);
+        const auto* idx = cs.get_index_if<posting_lists>(col_idx);
+        if (col && idx) return index_lookup(*col, *idx, op, *v);
+    } else if (const auto* v = std::get_if<vector<string>>(&value)) {
+        const auto* col = cs.get_if<tags_column>(col_idx);
+        const auto* idx = cs.get_index_if<posting_lists>(col_idx);
+        if (col && idx) return index_lookup(*col, *idx, *v);
+    }
+    return evaluate_clause(cs, clause);
+}
+
+std::optional<size_t> count_from_index(const column_store& cs,
+                                       const plan_clause& clause) {
+    const size_t col_idx = clause.column;
+    const comparison_op op = clause.op;
+    const auto& value = clause.value;
+
+    if (const int* v = std::get_if<int>(&value)) {
+        const auto* col = cs.get_if<integer_column>(col_idx);
+        const auto* idx = cs.get_index_if<sorted_index<std::int32_t>>(col_idx);
+        if (col && idx) return index_count(*col, *idx, op, *v);
+    } else if (const float* v = std::get_if<float>(&value)) {
+        const auto* col = cs.get_if<floating_column>(col_idx);
+        const auto* idx = cs.get_index_if<sorted_index<float>>(col_idx);
+        if (col && idx) return index_count(*col, *idx, op, *v);
+    } else if (const string* v = std::get_if<string>(&value)) {
+        const auto* col = cs.get_if<text_column>(col_idx);
+        const auto* idx = cs.get_index_if<posting_lists>(col_idx);
+        if (col && idx) return index_count(*col, *idx, op, *v);
+    } else if (const auto* v = std::get_if<vector<string>>(&value)) {
+        // A row can have several of the tags, so only a single tag's
+        // posting list is a count of rows.
+        const auto* col = cs.get_if<tags_column>(col_idx);
+        const auto* idx = cs.get_index_if<posting_lists>(col_idx);
+        if (col && idx &&
+            std::ranges::all_of(*v, [&v](const string& tag) {
+                return tag == v->front();
+            })) {
+            if (v->empty()) return size_t{0};
+            const auto [first, last] = code_range(
+                col->dictionary, comparison_op::equal_to, v->front());
+            return idx->count(first, last);
+        }
+    }
+    return std::nullopt;
+}
+
+bitmap evaluate_clause(const column_store& cs, const plan_clause& clause,
+                       const bitmap* candidates) {
+    const size_t col_idx = clause.column;
+    const comparison_op op = clause.op;
+    const auto& value = clause.value;
+
+    if (const auto* col = cs.get_if<integer_column>(col_idx)) {
+        if (const int* v = std::get_if<int>(&value)) {
+            return select_integer(*col, op, *v, candidates);
+        }
+    } else if (const auto* col = cs.get_if<floating_column>(col_idx)) {
+        if (const float* v = std::get_if<float>(&value)) {
+            return select_floating(*col, op, *v, candidates);
+        }
+    } else if (const auto* col = cs.get_if<boolean_column>(col_idx)) {
+        if (const bool* v = std::get_if<bool>(&value)) {
+            return select_boolean(*col, op, *v, candidates);
+        }
+    } else if (const auto* col = cs.get_if<text_column>(col_idx)) {
+        if (const string* v = std::get_if<string>(&value)) {
+            return select_text(*col, op, *v, candidates);
+        }
+    } else if (const auto* col = cs.get_if<coordinate_column>(col_idx)) {
+        if (const coordinate* v = std::get_if<coordinate>(&value)) {
+            return select_coordinate(*col, op, *v, candidates);
+        }
+        if (const polygon_t* v = std::get_if<polygon_t>(&value)) {
+            return select_inside(*col, *v, candidates);
+        }
+    } else if (const auto* col = cs.get_if<tags_column>(col_idx)) {
+        if (const auto* v = std::get_if<vector<string>>(&value)) {
+            return select_tags(*col, *v, candidates);
+        }
+    }
+    return bitmap(cs.row_count());
+}
+
+}  // namespace jt
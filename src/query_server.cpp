@@ -0,0 +1,213 @@
+#include "query_server.hpp"
+
+#if !defined(_WIN64)
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "clause_cache.hpp"
+#include "command_line.hpp"
+#include "live_table.hpp"
+#include "query_socket.hpp"
+#include "result_writer.hpp"
+#include "shard.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::string_view;
+
+namespace {
+/// @brief A FILE that writes to memory, for collecting a command's output.
+class memory_file {
+    char* buffer_{nullptr};
+    size_t size_{0};
+    std::FILE* file_{nullptr};
+
+   public:
+    memory_file() : file_{::open_memstream(&buffer_, &size_)} {}
+
+    memory_file(const memory_file&) = delete;
+    memory_file& operator=(const memory_file&) = delete;
+
+    ~memory_file() {
+        if (file_) std::fclose(file_);
+        std::free(buffer_);
+    }
+
+    /// @brief The FILE to write to, or nullptr if it could not be made.
+    std::FILE* file() const noexcept { return file_; }
+
+    /// @brief Closes the FILE and returns what was written to it.
+    string_view close() {
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+        return buffer_ ? string_view{buffer_, size_} : string_view{};
+    }
+};
+}  // namespace
+
+query_server::query_server(live_table& tables, output_format format,
+                           size_t cache_bytes)
+    : tables_{tables},
+      format_{format},
+      cache_{std::make_shared<clause_cache>(cache_bytes)} {}
+
+query_server::~query_server() {
+    stop();
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        ::unlink(path_.c_str());
+    }
+    for (const int fd : wake_fds_) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+std::expected<void, string> query_server::listen(const string& path) {
+    sockaddr_un address{};
+    if (auto ok = socket_address(path, address); !ok) {
+        return std::unexpected(ok.error());
+    }
+    if (::pipe(wake_fds_) != 0) {
+        return std::unexpected(
+            std::format("could not make a pipe: {}", std::strerror(errno)));
+    }
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        return std::unexpected(
+            std::format("could not make a socket: {}", std::strerror(errno)));
+    }
+    // A socket left by a server that did not shut down cleanly would make
+    // bind() fail.
+    ::unlink(path.c_str());
+    if (::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address),
+               sizeof address) != 0 ||
+        ::listen(listen_fd_, SOMAXCONN) != 0) {
+        const int error = errno;
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return std::unexpected(std::format("could not listen on \"{}\": {}",
+                                           path, std::strerror(error)));
+    }
+    path_ = path;
+    return {};
+}
+
+void query_server::run() {
+    // A client that goes away while being answered must not end the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    while (!stopping_.load()) {
+        pollfd fds[2]{{listen_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (stopping_.load() || (fds[1].revents & POLLIN)) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        const int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        reap_finished();
+        std::lock_guard lock{mutex_};
+        connection& c = connections_.emplace_back();
+        c.fd = fd;
+        c.thread = std::jthread([this, &c] {
+            serve_connection(c.fd);
+            // Closed under the lock, so that run() never shuts down a
+            // descriptor that has been closed and perhaps reused.
+            std::lock_guard lock{mutex_};
+            ::close(c.fd);
+            c.finished = true;
+        });
+    }
+
+    // Wake the connections' threads, which are waiting for commands or
+    // sending results, and wait for them.
+    std::list<connection> closing{};
+    {
+        std::lock_guard lock{mutex_};
+        for (connection& c : connections_) {
+            if (!c.finished) ::shutdown(c.fd, SHUT_RDWR);
+        }
+        closing.splice(closing.end(), connections_);
+    }
+    closing.clear();
+}
+
+void query_server::stop() noexcept {
+    stopping_.store(true);
+    if (wake_fds_[1] >= 0) {
+        const char byte = 0;
+        [[maybe_unused]] const ssize_t n = ::write(wake_fds_[1], &byte, 1);
+    }
+}
+
+void query_server::reap_finished() {
+    std::list<connection> finished{};
+    {
+        std::lock_guard lock{mutex_};
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            const auto next = std::next(it);
+            if (it->finished) {
+                finished.splice(finished.end(), connections_, it);
+            }
+            it = next;
+        }
+    }
+    // Joined here, outside the lock.
+    finished.clear();
+}
+
+void query_server::serve_connection(int fd) {
+    command_line session{};
+    session.share_cache(cache_);
+    session.set_output_format(format_);
+
+    while (const auto command = read_frame(fd, max_command_bytes)) {
+        string line = trim(*command);
+        if (is_shard_request(line)) {
+            // From a coordinator; answered outside the session.
+            const shard_answer answer = answer_shard_request(
+                tables_, line, cache_->budget() > 0 ? cache_.get() : nullptr);
+            if (!write_frame(fd, answer.out) || !write_frame(fd, answer.err)) {
+                break;
+            }
+            continue;
+        }
+        memory_file out{};
+        memory_file err{};
+        if (!out.file() || !err.file()) break;
+        session.set_output(out.file(), err.file(), false);
+        const bool more = session.run_command(tables_, line);
+        const string_view out_text = out.close();
+        const string_view err_text = err.close();
+        if (!write_frame(fd, out_text) || !write_frame(fd, err_text) ||
+            !more) {
+            break;
+        }
+    }
+}
+
+}  // namespace jt
+
+#endif
@@ -0,0 +1,251 @@
+#include "result_writer.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "column_store.hpp"
+#include "columns.hpp"
+#include "coordinates.hpp"
+#include "projection.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::string;
+using std::string_view;
+
+namespace {
+/// @brief Appends a number as std::to_chars writes it. Floats get six
+/// significant digits, as a stream prints them by default.
+template <class T>
+void append_number(string& out, T value) {
+    char digits[32];
+    std::to_chars_result result{};
+    if constexpr (std::is_floating_point_v<T>) {
+        result = std::to_chars(std::begin(digits), std::end(digits), value,
+                               std::chars_format::general, 6);
+    } else {
+        result = std::to_chars(std::begin(digits), std::end(digits), value);
+    }
+    out.append(digits, result.ptr);
+}
+
+bool needs_csv_quotes(string_view text) noexcept {
+    return text.find_first_of(",\"\r\n") != string_view::npos;
+}
+
+/// @brief Appends text as the body of a JSON string.
+void append_json_escaped(string& out, string_view text) {
+    for (const char c : text) {
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    std::format_to(std::back_inserter(out), "\\u{:04x}",
+                                   static_cast<unsigned>(c));
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+}
+
+/// @brief A cell that the column store does not keep, such as a coordinate,
+/// formatted from the row.
+std::optional<string> cell_text(const vector<row>& rws, size_t col_idx,
+                                size_t r) {
+    if (r >= rws.size() || col_idx >= rws[r].size()) return std::nullopt;
+    const cell_value_type& cvt = rws[r][col_idx].value;
+    if (!cvt) return std::nullopt;
+    if (const coordinate* c = std::get_if<coordinate>(&*cvt)) {
+        return std::format("{}", *c);
+    }
+    return cell_value_types_value_as_string(*cvt);
+}
+}  // namespace
+
+std::optional<output_format> output_format_from_name(string_view name) {
+    const string lower = to_lower(string{name});
+    if (lower == "csv") return output_format::csv;
+    if (lower == "tsv") return output_format::tsv;
+    if (lower == "jsonl") return output_format::jsonl;
+    return std::nullopt;
+}
+
+string_view output_format_name(output_format format) noexcept {
+    switch (format) {
+        case output_format::tsv:
+            return "tsv";
+        case output_format::jsonl:
+            return "jsonl";
+        default:
+            return "csv";
+    }
+}
+
+result_writer::result_writer(const projection& columns, std::FILE* out,
+                             output_format format)
+    : columns_{columns}, out_{out}, format_{format} {
+    buffer_.reserve(chunk_bytes * 2);
+    for (const auto& pc : columns_.columns()) {
+        sources_.push_back(&columns_.store().at(pc.column));
+        if (format_ == output_format::jsonl) {
+            string key{"\""};
+            append_json_escaped(key, pc.column_name);
+            key.append("\":");
+            keys_.push_back(std::move(key));
+        }
+    }
+}
+
+void result_writer::append_text(string_view text) {
+    switch (format_) {
+        case output_format::csv:
+            if (!needs_csv_quotes(text)) {
+                buffer_.append(text);
+                return;
+            }
+            buffer_.push_back('"');
+            for (const char c : text) {
+                if (c == '"') buffer_.push_back('"');
+                buffer_.push_back(c);
+            }
+            buffer_.push_back('"');
+            return;
+
+        case output_format::tsv:
+            for (const char c : text) {
+                switch (c) {
+                    case '\t': buffer_.append("\\t"); break;
+                    case '\n': buffer_.append("\\n"); break;
+                    case '\r': buffer_.append("\\r"); break;
+                    case '\\': buffer_.append("\\\\"); break;
+                    default: buffer_.push_back(c);
+                }
+            }
+            return;
+
+        case output_format::jsonl:
+            buffer_.push_back('"');
+            append_json_escaped(buffer_, text);
+            buffer_.push_back('"');
+            return;
+    }
+}
+
+void result_writer::append_cell(size_t i, size_t r) {
+    const bool json = format_ == output_format::jsonl;
+    const auto missing = [this, json] {
+        if (json) buffer_.append("null");
+    };
+    std::visit(
+        [&](const auto& col) {
+            using C = std::decay_t<decltype(col)>;
+            if constexpr (std::is_same_v<C, integer_column> ||
+                          std::is_same_v<C, floating_column>) {
+                if (!col.present.test(r)) return missing();
+                const auto v = col.values[r];
+                if constexpr (std::is_same_v<C, floating_column>) {
+                    // JSON has no infinities or NaNs.
+                    if (json && !std::isfinite(v)) return missing();
+                }
+                append_number(buffer_, v);
+            } else if constexpr (std::is_same_v<C, boolean_column>) {
+                if (!col.present.test(r)) return missing();
+                const bool v = col.values.test(r);
+                buffer_.append(json ? (v ? "true" : "false") : (v ? "1" : "0"));
+            } else if constexpr (std::is_same_v<C, text_column>) {
+                if (!col.present.test(r)) return missing();
+                append_text(col.dictionary[static_cast<size_t>(col.codes[r])]);
+            } else if constexpr (std::is_same_v<C, tags_column>) {
+                if (!col.present.test(r)) return missing();
+                const auto first = col.offsets[r];
+                const auto last = col.offsets[r + 1];
+                if (json) {
+                    buffer_.push_back('[');
+                    for (auto t = first; t < last; ++t) {
+                        if (t > first) buffer_.push_back(',');
+                        append_text(col.dictionary[col.tag_ids[t]]);
+                    }
+                    buffer_.push_back(']');
+                    return;
+                }
+                // In CSV the list is quoted, as the tags were read.
+                const bool csv = format_ == output_format::csv;
+                scratch_.assign(csv ? "\"" : "");
+                for (auto t = first; t < last; ++t) {
+                    if (t > first) scratch_.append(", ");
+                    scratch_.append(col.dictionary[col.tag_ids[t]]);
+                }
+                if (csv) scratch_.push_back('"');
+                append_text(scratch_);
+            } else {
+                const auto text =
+                    cell_text(columns_.rows(), columns_.columns()[i].column, r);
+                if (!text) return missing();
+                append_text(*text);
+            }
+        },
+        *sources_[i]);
+}
+
+void result_writer::end_line() {
+    buffer_.push_back('\n');
+    if (out_ && buffer_.size() >= chunk_bytes) flush();
+}
+
+void result_writer::write_headings() {
+    if (format_ == output_format::jsonl) return;
+    const char separator = format_ == output_format::tsv ? '\t' : ',';
+    const auto& projected = columns_.columns();
+    for (size_t i = 0; i < projected.size(); ++i) {
+        if (i > 0) buffer_.push_back(separator);
+        append_text(projected[i].column_name);
+    }
+    end_line();
+}
+
+void result_writer::write_row(size_t r) {
+    if (format_ == output_format::jsonl) {
+        buffer_.push_back('{');
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            if (i > 0) buffer_.push_back(',');
+            buffer_.append(keys_[i]);
+            append_cell(i, r);
+        }
+        buffer_.push_back('}');
+    } else {
+        const char separator = format_ == output_format::tsv ? '\t' : ',';
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            if (i > 0) buffer_.push_back(separator);
+            append_cell(i, r);
+        }
+    }
+    end_line();
+}
+
+void result_writer::flush() {
+    if (buffer_.empty() || !out_) return;
+    std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+    std::fflush(out_);
+    buffer_.clear();
+}
+
+}  // namespace jt
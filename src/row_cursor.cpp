@@ -0,0 +1,189 @@
+#include "row_cursor.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "block_filter.hpp"
+#include "clause_cache.hpp"
+#include "column_store.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+
+namespace jt {
+
+row_cursor row_cursor::stream(const query_plan& plan, scheduler* sched,
+                              clause_cache* cache) {
+    if (plan.order()) {
+        if (auto rows = plan.walk_index()) {
+            const bool truncated = rows->size() == *plan.limit();
+            bitmap selection = bitmap::from_ids(plan.row_count(), *rows);
+            row_cursor result =
+                from_rows(std::move(*rows), std::move(selection));
+            result.truncated_ = truncated;
+            return result;
+        }
+        bitmap selection =
+            plan.execute(execution_mode::fused, sched, cache);
+        vector<std::uint32_t> rows = plan.ordered_rows(selection);
+        return from_rows(std::move(rows), std::move(selection));
+    }
+
+    row_cursor result{};
+    result.plan_ = plan;
+    result.sched_ = sched;
+    result.cache_ = cache;
+    result.limit_ = plan.limit();
+    const column_store& cs = result.plan_.store();
+    const size_t n = cs.row_count();
+    result.generation_ = cs.generation();
+    result.selection_ = bitmap(n, true);
+
+    // Indexed clauses, and clauses already in the cache, are applied before
+    // any scanning; the others are applied a morsel at a time.
+    for (const plan_clause& pc : result.plan_.clauses_) {
+        if (cache) {
+            clause_key key = make_clause_key(pc);
+            if (const auto hit = cache->find(result.generation_, key)) {
+                result.selection_ &= *hit;
+            } else if (pc.use_index) {
+                auto selection =
+                    std::make_shared<bitmap>(lookup_clause(cs, pc));
+                result.selection_ &= *selection;
+                cache->insert(result.generation_, key, std::move(selection));
+            } else {
+                result.miss_keys_.push_back(std::move(key));
+                result.filters_.push_back(make_block_filter(cs, pc));
+            }
+        } else if (pc.use_index) {
+            result.selection_ &= lookup_clause(cs, pc);
+        } else {
+            result.filters_.push_back(make_block_filter(cs, pc));
+        }
+    }
+
+    if (!result.miss_keys_.empty()) {
+        if (is_sparse(result.selection_)) {
+            result.miss_keys_.clear();
+        } else {
+            result.miss_selections_.assign(result.miss_keys_.size(),
+                                           bitmap(n, true));
+        }
+    }
+
+    result.morsels_ = (n + morsel_rows - 1) / morsel_rows;
+    if (result.morsels_ == 0) result.complete();
+    return result;
+}
+
+row_cursor row_cursor::from_rows(vector<std::uint32_t> rows,
+                                 bitmap selection) {
+    row_cursor result{};
+    result.rows_ = std::move(rows);
+    result.selection_ = std::move(selection);
+    return result;
+}
+
+void row_cursor::scan_batch(size_t morsels, bool collect) {
+    const size_t n = selection_.size();
+    const size_t first_morsel = next_morsel_;
+    const size_t last_morsel = std::min(morsels_, first_morsel + morsels);
+    const std::span<bitmap::word_t> words = selection_.words();
+
+    auto scan_morsel = [&](size_t i) {
+        const size_t m = first_morsel + i;
+        const size_t first = m * morsel_rows;
+        const size_t last = std::min(n, first + morsel_rows);
+        if (miss_selections_.empty()) {
+            fused_scan_rows(filters_, words, first, last);
+        } else {
+            fused_scan_rows_each(filters_, miss_selections_, words, first,
+                                 last);
+        }
+    };
+    if (sched_ && last_morsel - first_morsel > 1) {
+        sched_->parallel_for(last_morsel - first_morsel, scan_morsel);
+    } else {
+        for (size_t i = 0; i < last_morsel - first_morsel; ++i) scan_morsel(i);
+    }
+    next_morsel_ = last_morsel;
+
+    if (collect) {
+        rows_.erase(rows_.begin(),
+                    rows_.begin() + static_cast<std::ptrdiff_t>(next_row_));
+        next_row_ = 0;
+        const size_t first_word =
+            first_morsel * morsel_rows / bitmap::word_bits;
+        const size_t last_word =
+            bitmap::words_for(std::min(n, last_morsel * morsel_rows));
+        for (size_t w = first_word; w < last_word; ++w) {
+            for (bitmap::word_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                rows_.push_back(static_cast<std::uint32_t>(
+                    w * bitmap::word_bits +
+                    static_cast<size_t>(std::countr_zero(bits))));
+            }
+        }
+    }
+    if (next_morsel_ == morsels_) complete();
+}
+
+void row_cursor::complete() {
+    if (!cache_) return;
+    for (size_t c = 0; c < miss_selections_.size(); ++c) {
+        auto selection =
+            std::make_shared<bitmap>(std::move(miss_selections_[c]));
+        cache_->insert(generation_, miss_keys_[c], std::move(selection));
+    }
+    miss_keys_.clear();
+    miss_selections_.clear();
+}
+
+std::span<const std::uint32_t> row_cursor::next(size_t max_rows) {
+    if (limit_) max_rows = std::min(max_rows, *limit_ - produced_);
+    if (max_rows == 0) return {};
+
+    const size_t widest = max_batch_morsels_per_thread *
+                          (sched_ ? sched_->worker_count() + 1 : 1);
+    while (next_row_ == rows_.size() && next_morsel_ < morsels_) {
+        scan_batch(batch_morsels_, true);
+        batch_morsels_ = std::min(widest, batch_morsels_ * 2);
+    }
+
+    const size_t count = std::min(max_rows, rows_.size() - next_row_);
+    const std::span<const std::uint32_t> result{rows_.data() + next_row_,
+                                                count};
+    next_row_ += count;
+    produced_ += count;
+    return result;
+}
+
+const bitmap& row_cursor::finish() {
+    if (next_morsel_ < morsels_ && limit_ && produced_ >= *limit_) {
+        // Stop here: the unscanned morsels' rows are dropped rather than
+        // tested, and the clause results are incomplete, so not cached.
+        const std::span<bitmap::word_t> words = selection_.words();
+        const size_t first_word =
+            next_morsel_ * morsel_rows / bitmap::word_bits;
+        std::ranges::fill(words.subspan(first_word), bitmap::word_t{0});
+        miss_keys_.clear();
+        miss_selections_.clear();
+        next_morsel_ = morsels_;
+        truncated_ = true;
+    }
+    if (next_morsel_ < morsels_) scan_batch(morsels_ - next_morsel_, false);
+    next_row_ = rows_.size();
+    return selection_;
+}
+
+bool row_cursor::done() const noexcept {
+    if (limit_ && produced_ >= *limit_) return true;
+    return next_row_ == rows_.size() && next_morsel_ == morsels_;
+}
+
+}  // namespace jt
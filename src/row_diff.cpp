@@ -0,0 +1,213 @@
+#include "row_diff.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace jt {
+
+namespace {
+constexpr std::uint64_t prime1{0x9E3779B185EBCA87ULL};
+constexpr std::uint64_t prime2{0xC2B2AE3D27D4EB4FULL};
+constexpr std::uint64_t prime3{0x165667B19E3779F9ULL};
+constexpr std::uint64_t prime4{0x85EBCA77C2B2AE63ULL};
+constexpr std::uint64_t prime5{0x27D4EB2F165667C5ULL};
+
+std::uint64_t read64(const char* p) noexcept {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+std::uint32_t read32(const char* p) noexcept {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+std::uint64_t mix(std::uint64_t acc, std::uint64_t input) noexcept {
+    acc += input * prime2;
+    return std::rotl(acc, 31) * prime1;
+}
+
+std::uint64_t merge(std::uint64_t acc, std::uint64_t lane) noexcept {
+    acc ^= mix(0, lane);
+    return acc * prime1 + prime4;
+}
+
+/// @brief Counts a run of deleted and inserted lines between two unchanged
+/// ones; as many as can be paired are updates.
+void count_run(line_diff& diff, size_t deleted, size_t inserted) noexcept {
+    const size_t updated = std::min(deleted, inserted);
+    diff.updated += updated;
+    diff.deleted += deleted - updated;
+    diff.inserted += inserted - updated;
+}
+}  // namespace
+
+std::uint64_t line_hash(std::string_view line) noexcept {
+    const char* p = line.data();
+    const char* const end = p + line.size();
+    std::uint64_t h{};
+    if (line.size() >= 32) {
+        std::uint64_t v1 = prime1 + prime2;
+        std::uint64_t v2 = prime2;
+        std::uint64_t v3 = 0;
+        std::uint64_t v4 = 0 - prime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = mix(v1, read64(p));
+            v2 = mix(v2, read64(p + 8));
+            v3 = mix(v3, read64(p + 16));
+            v4 = mix(v4, read64(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+            std::rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = prime5;
+    }
+    h += line.size();
+    for (; end - p >= 8; p += 8) {
+        h ^= mix(0, read64(p));
+        h = std::rotl(h, 27) * prime1 + prime4;
+    }
+    if (end - p >= 4) {
+        h ^= std::uint64_t{read32(p)} * prime1;
+        h = std::rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= std::uint64_t{static_cast<unsigned char>(*p)} * prime5;
+        h = std::rotl(h, 11) * prime1;
+    }
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::optional<line_diff> diff_lines(std::span<const std::uint64_t> old_lines,
+                                    std::span<const std::uint64_t> new_lines,
+                                    size_t max_edits) {
+    line_diff result{};
+    result.source.assign(new_lines.size(), line_diff::no_line);
+
+    // The unchanged lines at the start and the end.
+    size_t prefix = 0;
+    while (prefix < old_lines.size() && prefix < new_lines.size() &&
+           old_lines[prefix] == new_lines[prefix]) {
+        result.source[prefix] = static_cast<std::uint32_t>(prefix);
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < old_lines.size() - prefix &&
+           suffix < new_lines.size() - prefix &&
+           old_lines[old_lines.size() - 1 - suffix] ==
+               new_lines[new_lines.size() - 1 - suffix]) {
+        result.source[new_lines.size() - 1 - suffix] =
+            static_cast<std::uint32_t>(old_lines.size() - 1 - suffix);
+        ++suffix;
+    }
+    const auto a =
+        old_lines.subspan(prefix, old_lines.size() - prefix - suffix);
+    const auto b =
+        new_lines.subspan(prefix, new_lines.size() - prefix - suffix);
+    const auto n = static_cast<std::ptrdiff_t>(a.size());
+    const auto m = static_cast<std::ptrdiff_t>(b.size());
+
+    // rounds[d] holds, for each diagonal k = x - y from -d to d in steps of
+    // two, the furthest x that d deletions and insertions reach; diagonal k
+    // is at (k + d) / 2.
+    vector<vector<std::ptrdiff_t>> rounds{};
+    const auto limit =
+        std::min<std::ptrdiff_t>(n + m, static_cast<std::ptrdiff_t>(max_edits));
+    std::ptrdiff_t edits = -1;
+    for (std::ptrdiff_t d = 0; d <= limit && edits < 0; ++d) {
+        vector<std::ptrdiff_t> reach(static_cast<size_t>(d) + 1);
+        for (std::ptrdiff_t k = -d; k <= d; k += 2) {
+            std::ptrdiff_t x = 0;
+            if (d > 0) {
+                const vector<std::ptrdiff_t>& before = rounds.back();
+                auto at = [&before, d](std::ptrdiff_t kk) {
+                    return before[static_cast<size_t>((kk + d - 1) / 2)];
+                };
+                x = (k == -d || (k != d && at(k - 1) < at(k + 1)))
+                        ? at(k + 1)
+                        : at(k - 1) + 1;
+            }
+            std::ptrdiff_t y = x - k;
+            while (x < n && y < m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            reach[static_cast<size_t>((k + d) / 2)] = x;
+            if (x >= n && y >= m) edits = d;
+        }
+        rounds.push_back(std::move(reach));
+    }
+    if (edits < 0) return std::nullopt;
+
+    // Back from the end, marking the lines on the diagonals as unchanged.
+    auto keep = [&](std::ptrdiff_t x, std::ptrdiff_t y) {
+        result.source[prefix + static_cast<size_t>(y)] =
+            static_cast<std::uint32_t>(prefix + static_cast<size_t>(x));
+    };
+    std::ptrdiff_t x = n;
+    std::ptrdiff_t y = m;
+    for (std::ptrdiff_t d = edits; d > 0; --d) {
+        const vector<std::ptrdiff_t>& before =
+            rounds[static_cast<size_t>(d - 1)];
+        auto at = [&before, d](std::ptrdiff_t kk) {
+            return before[static_cast<size_t>((kk + d - 1) / 2)];
+        };
+        const std::ptrdiff_t k = x - y;
+        const std::ptrdiff_t prev_k =
+            (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        const std::ptrdiff_t prev_x = at(prev_k);
+        const std::ptrdiff_t prev_y = prev_x - prev_k;
+        while (x > prev_x && y > prev_y) {
+            --x;
+            --y;
+            keep(x, y);
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+    while (x > 0 && y > 0) {
+        --x;
+        --y;
+        keep(x, y);
+    }
+
+    std::ptrdiff_t last_kept = -1;
+    size_t inserted = 0;
+    for (const std::uint32_t from : result.source) {
+        if (from == line_diff::no_line) {
+            ++inserted;
+            continue;
+        }
+        count_run(result, static_cast<size_t>(from - last_kept - 1),
+                  inserted);
+        last_kept = from;
+        inserted = 0;
+    }
+    count_run(result,
+              static_cast<size_t>(static_cast<std::ptrdiff_t>(
+                                      old_lines.size()) -
+                                  last_kept - 1),
+              inserted);
+    return result;
+}
+
+}  // namespace jt
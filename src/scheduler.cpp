@@ -0,0 +1,166 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace jt {
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+/// @brief Threads requested for the shared scheduler; 0 means one per
+/// hardware thread.
+std::atomic<size_t> shared_threads{0};
+
+/// @brief Set once the shared scheduler has been made.
+std::atomic<bool> shared_started{false};
+
+std::int64_t elapsed_ns(clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                since)
+        .count();
+}
+}  // namespace
+
+scheduler::scheduler(size_t worker_count) {
+    const size_t queue_count = std::max<size_t>(worker_count, 1);
+    queues_.reserve(queue_count);
+    for (size_t i = 0; i < queue_count; ++i) {
+        queues_.push_back(std::make_unique<worker_queue>());
+    }
+    stats_.reserve(worker_count);
+    threads_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        stats_.push_back(std::make_unique<worker_stats>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        threads_.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+scheduler::~scheduler() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_) t.join();
+    // With no workers, anything submitted runs here.
+    while (run_one()) {
+    }
+}
+
+void scheduler::submit(task t) {
+    const size_t q = next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                     queues_.size();
+    // Counted before it is queued, so that a worker that takes it at once
+    // does not bring the count below zero.
+    {
+        std::lock_guard lock(sleep_mutex_);
+        pending_.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard lock(queues_[q]->mutex);
+        queues_[q]->tasks.push_back(std::move(t));
+    }
+    wake_.notify_one();
+}
+
+bool scheduler::run_one() {
+    bool stolen = false;
+    if (auto t = take(0, stolen)) {
+        (*t)();
+        return true;
+    }
+    return false;
+}
+
+std::optional<scheduler::task> scheduler::take(size_t home, bool& stolen) {
+    const size_t n = queues_.size();
+    for (size_t k = 0; k < n; ++k) {
+        worker_queue& q = *queues_[(home + k) % n];
+        std::lock_guard lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        task result{};
+        if (k == 0) {
+            result = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            result = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        stolen = k != 0;
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        return result;
+    }
+    return std::nullopt;
+}
+
+void scheduler::worker_loop(size_t index) {
+    worker_stats& stats = *stats_[index];
+    while (true) {
+        bool stolen = false;
+        if (auto t = take(index, stolen)) {
+            const auto start = clock::now();
+            (*t)();
+            stats.busy_ns.fetch_add(elapsed_ns(start),
+                                    std::memory_order_relaxed);
+            stats.tasks_run.fetch_add(1, std::memory_order_relaxed);
+            if (stolen) {
+                stats.tasks_stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+        const auto start = clock::now();
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || pending_.load(std::memory_order_acquire) > 0;
+        });
+        stats.idle_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+        if (stopping_ && pending_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+vector<worker_counters> scheduler::counters() const {
+    vector<worker_counters> result{};
+    result.reserve(stats_.size());
+    for (const auto& s : stats_) {
+        result.push_back(worker_counters{
+            s->tasks_run.load(std::memory_order_relaxed),
+            s->tasks_stolen.load(std::memory_order_relaxed),
+            std::chrono::nanoseconds{
+                s->busy_ns.load(std::memory_order_relaxed)},
+            std::chrono::nanoseconds{
+                s->idle_ns.load(std::memory_order_relaxed)}});
+    }
+    return result;
+}
+
+scheduler& scheduler::shared() {
+    static scheduler instance{[] {
+        shared_started.store(true);
+        size_t threads = shared_threads.load();
+        if (threads == 0) {
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        // The calling thread works too, so it needs one worker fewer.
+        return threads - 1;
+    }()};
+    return instance;
+}
+
+bool scheduler::set_shared_threads(size_t threads) {
+    if (shared_started.load()) return false;
+    shared_threads.store(threads);
+    return true;
+}
+
+}  // namespace jt
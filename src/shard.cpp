@@ -0,0 +1,1020 @@
+#include "shard.hpp"
+
+#if !defined(_WIN64)
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <print>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "aggregate.hpp"
+#include "bitmap.hpp"
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "cell_types_formatter.hpp"
+#include "column_store.hpp"
+#include "command_line.hpp"
+#include "coordinates.hpp"
+#include "dimroomConfig.h"
+#include "facets.hpp"
+#include "parser.hpp"
+#include "projection.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "query_socket.hpp"
+#include "scheduler.hpp"
+#include "utility.hpp"
+
+#if !defined(_WIN64)
+extern char** environ;
+#endif
+
+namespace jt {
+
+using std::println;
+using std::string;
+using std::string_view;
+using std::vector;
+using ecdt = e_cell_data_type;
+
+namespace {
+/// @brief Size of the squares that --shard-by tile groups rows by, in
+/// degrees of latitude and longitude.
+constexpr float tile_degrees{10.0f};
+
+/// @brief The columns that decide which shard a row goes to.
+struct shard_columns {
+    size_t name{0};
+    std::optional<size_t> coordinates{};
+};
+
+/// @brief The "Filename" column, or the first; and for shard_key::tile the
+/// first coordinate column, if there is one.
+shard_columns find_shard_columns(const parser::header_fields_t& hfs,
+                                 const shard_spec& spec) {
+    shard_columns result{};
+    for (size_t c = 0; c < hfs.size(); ++c) {
+        if (hfs[c].text == "Filename") {
+            result.name = c;
+            break;
+        }
+    }
+    if (spec.key == shard_key::tile) {
+        for (size_t c = 0; c < hfs.size() && !result.coordinates; ++c) {
+            if (hfs[c].data_type == ecdt::geo_coordinate) {
+                result.coordinates = c;
+            }
+        }
+    }
+    return result;
+}
+
+/// @brief Whether a row goes to a shard, given its cells in the columns
+/// that decide it; either may be missing.
+bool in_shard(const data_cell* coords, const data_cell* name,
+              const shard_spec& spec) {
+    std::uint64_t h = 0;
+    const coordinate* at = coords && coords->value
+                               ? std::get_if<coordinate>(&*coords->value)
+                               : nullptr;
+    if (at) {
+        const auto lat =
+            static_cast<long>(std::floor(at->latitude / tile_degrees));
+        const auto lon =
+            static_cast<long>(std::floor(at->longitude / tile_degrees));
+        h = stable_hash(std::format("{},{}", lat, lon));
+    } else if (name && name->value) {
+        h = stable_hash(cell_value_types_value_as_string(*name->value));
+    } else {
+        h = stable_hash("");
+    }
+    return h % spec.count == spec.index;
+}
+
+template <class T>
+std::optional<T> parse_number(string_view text) {
+    T value{};
+    const auto [end, ec] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+/// @brief Reads the fields of a record in turn. Reading past the end, or a
+/// field that is not the number expected, marks the record as malformed.
+class field_reader {
+    const vector<string>& fields_;
+    size_t next_{0};
+    bool ok_{true};
+
+   public:
+    explicit field_reader(const vector<string>& fields) : fields_{fields} {}
+
+    bool ok() const noexcept { return ok_; }
+    bool at_end() const noexcept { return next_ >= fields_.size(); }
+    void fail() noexcept { ok_ = false; }
+
+    const string& text() {
+        static const string none{};
+        if (at_end()) {
+            ok_ = false;
+            return none;
+        }
+        return fields_[next_++];
+    }
+
+    template <class T>
+    T number() {
+        const auto value = parse_number<T>(text());
+        if (!value) ok_ = false;
+        return value.value_or(T{});
+    }
+};
+
+void append_number(string& record, auto value) {
+    append_field(record, std::format("{}", value));
+}
+
+/// @brief A row's value in the column a result is sorted by, as bytes that
+/// compare in the same order as the values do; empty for a row without a
+/// value. Numbers are written big-endian with their sign bit flipped (and
+/// the other bits of negative floats inverted), and text as itself, since
+/// the dictionary is sorted by the same comparison.
+string sort_key(const column_store& cs, size_t column, size_t r) {
+    auto big_endian = [](std::uint32_t u) {
+        string key(5, 'v');
+        for (size_t i = 0; i < 4; ++i) {
+            key[1 + i] = static_cast<char>((u >> (24 - 8 * i)) & 0xff);
+        }
+        return key;
+    };
+    if (const auto* col = cs.get_if<integer_column>(column)) {
+        if (!col->present.test(r)) return {};
+        return big_endian(static_cast<std::uint32_t>(col->values[r]) ^
+                          0x80000000u);
+    }
+    if (const auto* col = cs.get_if<floating_column>(column)) {
+        if (!col->present.test(r)) return {};
+        // -0 and 0 are equal, as the single process compares them.
+        const float v = col->values[r] == 0.0f ? 0.0f : col->values[r];
+        const auto bits = std::bit_cast<std::uint32_t>(v);
+        return big_endian((bits & 0x80000000u) ? ~bits : bits | 0x80000000u);
+    }
+    if (const auto* col = cs.get_if<boolean_column>(column)) {
+        if (!col->present.test(r)) return {};
+        return col->values.test(r) ? "v1" : "v0";
+    }
+    if (const auto* col = cs.get_if<text_column>(column)) {
+        if (!col->present.test(r)) return {};
+        return "v" + col->dictionary[static_cast<size_t>(col->codes[r])];
+    }
+    return {};
+}
+
+/// @brief Writes an aggregate group's value: its type, whether it has a
+/// value, and the value.
+void append_cell(string& record, const data_cell& cell) {
+    append_number(record, static_cast<size_t>(cell.data_type));
+    append_field(record, cell.value ? "1" : "0");
+    string text{};
+    if (cell.value) {
+        const cell_value_types& v = *cell.value;
+        if (const auto* i = std::get_if<int>(&v)) {
+            text = std::format("{}", *i);
+        } else if (const auto* f = std::get_if<float>(&v)) {
+            // Shortest form that reads back as the same float.
+            text = std::format("{}", *f);
+        } else if (const auto* b = std::get_if<bool>(&v)) {
+            text = *b ? "1" : "0";
+        } else if (const auto* s = std::get_if<string>(&v)) {
+            text = *s;
+        }
+    }
+    append_field(record, text);
+}
+
+data_cell read_cell(field_reader& in) {
+    const auto type = static_cast<ecdt>(in.number<size_t>());
+    const bool present = in.text() == "1";
+    const string& text = in.text();
+    if (!present) return data_cell{type, std::nullopt};
+    switch (type) {
+        case ecdt::integer: {
+            const auto v = parse_number<int>(text);
+            if (!v) in.fail();
+            return data_cell{type, cell_value_types{std::in_place_type<int>,
+                                                    v.value_or(0)}};
+        }
+        case ecdt::floating: {
+            const auto v = parse_number<float>(text);
+            if (!v) in.fail();
+            return data_cell{type, cell_value_types{std::in_place_type<float>,
+                                                    v.value_or(0.0f)}};
+        }
+        case ecdt::boolean:
+            return data_cell{type, cell_value_types{std::in_place_type<bool>,
+                                                    text == "1"}};
+        default:
+            return data_cell{type, cell_value_types{std::in_place_type<string>,
+                                                    text}};
+    }
+}
+
+string encode_groups(const aggregate_groups& groups, size_t aggregates) {
+    string record{};
+    append_number(record, groups.size());
+    append_number(record, aggregates);
+    for (const aggregate_group& g : groups) {
+        append_cell(record, g.key);
+        append_number(record, g.rows);
+        for (const aggregate_totals& t : g.totals) {
+            append_number(record, t.count);
+            append_number(record, t.sum);
+            append_number(record, t.min);
+            append_number(record, t.max);
+        }
+    }
+    return record;
+}
+
+std::optional<aggregate_groups> decode_groups(const vector<string>& fields) {
+    field_reader in{fields};
+    const auto groups = in.number<size_t>();
+    const auto aggregates = in.number<size_t>();
+    aggregate_groups result{};
+    for (size_t g = 0; g < groups && in.ok(); ++g) {
+        aggregate_group group{read_cell(in)};
+        group.rows = in.number<std::uint64_t>();
+        group.totals.resize(aggregates);
+        for (aggregate_totals& t : group.totals) {
+            t.count = in.number<std::uint64_t>();
+            t.sum = in.number<double>();
+            t.min = in.number<double>();
+            t.max = in.number<double>();
+        }
+        result.push_back(std::move(group));
+    }
+    if (!in.ok() || !in.at_end()) return std::nullopt;
+    return result;
+}
+
+string encode_facets(const facet_result& result) {
+    string record{};
+    append_number(record, result.rows);
+    append_number(record, result.facets.size());
+    for (const facet& f : result.facets) {
+        append_field(record, f.column_name);
+        append_number(record, f.distinct);
+        append_number(record, f.missing);
+        append_number(record, f.top.size());
+        for (const facet_count& fc : f.top) {
+            append_field(record, fc.value);
+            append_number(record, fc.rows);
+        }
+    }
+    return record;
+}
+
+std::optional<facet_result> decode_facets(const vector<string>& fields) {
+    field_reader in{fields};
+    facet_result result{in.number<size_t>()};
+    const auto facets = in.number<size_t>();
+    for (size_t i = 0; i < facets && in.ok(); ++i) {
+        facet f{in.text()};
+        f.distinct = in.number<size_t>();
+        f.missing = in.number<size_t>();
+        const auto values = in.number<size_t>();
+        for (size_t v = 0; v < values && in.ok(); ++v) {
+            string value = in.text();
+            f.top.push_back({std::move(value), in.number<size_t>()});
+        }
+        result.facets.push_back(std::move(f));
+    }
+    if (!in.ok() || !in.at_end()) return std::nullopt;
+    return result;
+}
+
+string syntax_error_text(string_view line, const query_syntax_error& err) {
+    return std::format("could not parse query \"{}\"\n{} at position {}\n",
+                       line, err.message, err.position);
+}
+
+const char* const describe_hint =
+    "Use the \"describe\" command to see the column names and types.";
+}  // namespace
+
+std::optional<shard_key> shard_key_from_name(string_view name) {
+    if (name == "filename") return shard_key::filename;
+    if (name == "tile") return shard_key::tile;
+    return std::nullopt;
+}
+
+string_view shard_key_name(shard_key key) noexcept {
+    return key == shard_key::tile ? "tile" : "filename";
+}
+
+table make_shard(const table& t, const shard_spec& spec) {
+    const shard_columns cols = find_shard_columns(t.header_fields_, spec);
+    auto cell = [](const row& rw, std::optional<size_t> c) {
+        return c && *c < rw.size() ? &rw[*c] : nullptr;
+    };
+    table::rows kept{};
+    for (const row& rw : t.rows_) {
+        if (in_shard(cell(rw, cols.coordinates), cell(rw, cols.name), spec)) {
+            kept.push_back(rw);
+        }
+    }
+    return table(t, kept);
+}
+
+void keep_shard_fields(const parser::header_fields_t& hfs,
+                       parser::all_data_fields_t& rows,
+                       const shard_spec& spec) {
+    const shard_columns cols = find_shard_columns(hfs, spec);
+    // Only the cells that decide the shard are made.
+    auto cell = [](const parser::data_fields_t& dfs,
+                   std::optional<size_t> c) -> std::optional<data_cell> {
+        if (!c || *c >= dfs.size()) return std::nullopt;
+        return data_cell{dfs[*c]};
+    };
+    std::erase_if(rows, [&](const parser::data_fields_t& dfs) {
+        const auto coords = cell(dfs, cols.coordinates);
+        const auto name = cell(dfs, cols.name);
+        return !in_shard(coords ? &*coords : nullptr, name ? &*name : nullptr,
+                         spec);
+    });
+}
+
+void append_field(string& record, string_view field) {
+    record.append(std::format("{}:", field.size()));
+    record.append(field);
+}
+
+std::optional<vector<string>> split_fields(string_view record) {
+    vector<string> fields{};
+    while (!record.empty()) {
+        const size_t colon = record.find(':');
+        if (colon == string_view::npos) return std::nullopt;
+        const auto length = parse_number<size_t>(record.substr(0, colon));
+        if (!length || *length > record.size() - colon - 1) {
+            return std::nullopt;
+        }
+        fields.emplace_back(record.substr(colon + 1, *length));
+        record.remove_prefix(colon + 1 + *length);
+    }
+    return fields;
+}
+
+shard_answer answer_shard_request(live_table& tables, string_view command,
+                                  clause_cache* cache) {
+    command.remove_prefix(string_view{"shard:"}.size());
+    const size_t space = command.find(' ');
+    const string_view verb = command.substr(0, space);
+    string_view rest =
+        space == string_view::npos ? string_view{} : command.substr(space + 1);
+
+    shard_answer answer{};
+    if (verb == "reload") {
+        const auto stats = tables.reload();
+        if (!stats) {
+            answer.err = std::format("{}; still using the data read before\n",
+                                     stats.error());
+            return answer;
+        }
+        append_number(answer.out, stats->rows);
+        append_field(answer.out, tables.filename());
+        return answer;
+    }
+
+    // The whole request uses one version of the shard.
+    const std::shared_ptr<const table> snapshot = tables.snapshot();
+    const table& t = *snapshot;
+    if (verb == "schema") {
+        for (const parser::header_field& hf : t.header_fields_) {
+            append_field(answer.out, hf.text);
+            append_number(answer.out, static_cast<size_t>(hf.data_type));
+        }
+        return answer;
+    }
+
+    output_format format{output_format::csv};
+    if (verb == "rows") {
+        const size_t format_end = rest.find(' ');
+        const auto named = output_format_from_name(rest.substr(0, format_end));
+        if (!named || format_end == string_view::npos) {
+            answer.err = "shard request without an output format\n";
+            return answer;
+        }
+        format = *named;
+        rest.remove_prefix(format_end + 1);
+    } else if (verb != "count" && verb != "aggregate" && verb != "facets") {
+        answer.err = std::format("unknown shard request \"{}\"\n", verb);
+        return answer;
+    }
+
+    auto statement = parse_query_statement(rest);
+    if (!statement) {
+        answer.err = syntax_error_text(rest, statement.error());
+        return answer;
+    }
+    if (verb == "facets") {
+        // Every value is needed to add up the counts of all the shards.
+        statement->limit = std::numeric_limits<size_t>::max();
+    }
+    const auto plan = query_plan::make(t, *statement);
+    if (!plan) {
+        answer.err = plan.error().message + "\n";
+        return answer;
+    }
+    scheduler* const sched = &scheduler::shared();
+
+    if (verb == "count") {
+        append_number(answer.out, plan->count(sched, cache));
+    } else if (verb == "rows") {
+        const auto projected =
+            statement->statement_kind == query_statement::kind::select
+                ? projection::make(t, statement->select_columns)
+                : projection::all(t);
+        if (!projected) {
+            answer.err = projected.error().message + "\n";
+            return answer;
+        }
+        const bitmap selection =
+            plan->execute(execution_mode::fused, sched, cache);
+        append_number(answer.out, selection.count());
+        // Only this shard's first K rows can be among the first K of all.
+        result_writer writer(*projected, nullptr, format);
+        for (const auto r : plan->ordered_rows(selection)) {
+            if (plan->order()) {
+                append_field(answer.out,
+                             sort_key(t.columns(), plan->order()->column, r));
+            }
+            writer.write_row(r);
+            append_field(answer.out, writer.take_text());
+        }
+    } else if (verb == "aggregate") {
+        const auto aggregates = aggregate_plan::make(t, *statement);
+        if (!aggregates) {
+            answer.err = aggregates.error().message + "\n";
+            return answer;
+        }
+        const bitmap selection =
+            plan->execute(execution_mode::fused, sched, cache);
+        answer.out = encode_groups(aggregates->run_groups(selection, sched),
+                                   aggregates->aggregates().size());
+    } else {
+        const auto facets = facet_plan::make(t, *statement);
+        if (!facets) {
+            answer.err = facets.error().message + "\n";
+            return answer;
+        }
+        const bitmap selection =
+            plan->execute(execution_mode::fused, sched, cache);
+        answer.out = encode_facets(facets->run(selection, sched));
+    }
+    return answer;
+}
+
+#if !defined(_WIN64)
+
+shard_workers::~shard_workers() {
+    for (const pid_t pid : pids_) ::kill(pid, SIGTERM);
+    for (const pid_t pid : pids_) {
+        while (::waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+    if (!directory_.empty()) {
+        std::error_code ec{};
+        std::filesystem::remove_all(directory_, ec);
+    }
+}
+
+std::expected<void, string> shard_workers::start(const string& program,
+                                                 const vector<string>& options,
+                                                 const string& csv_filename,
+                                                 size_t count, shard_key key) {
+    namespace fs = std::filesystem;
+    std::error_code ec{};
+    const fs::path directory =
+        fs::temp_directory_path(ec) / std::format("dimroom-{}", ::getpid());
+    fs::create_directories(directory, ec);
+    if (ec) {
+        return std::unexpected(std::format(
+            "could not create directory \"{}\": {}",
+            path_to_string(directory), ec.message()));
+    }
+    directory_ = path_to_string(directory);
+
+    for (size_t i = 0; i < count; ++i) {
+        const string socket =
+            path_to_string(directory / std::format("shard-{}.sock", i));
+        vector<string> args{program,
+                            "--serve",
+                            socket,
+                            "--shard",
+                            std::format("{}/{}", i, count),
+                            "--shard-by",
+                            string{shard_key_name(key)}};
+        args.insert(args.end(), options.begin(), options.end());
+        args.push_back(csv_filename);
+        vector<char*> argv{};
+        for (string& arg : args) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+
+        pid_t pid = 0;
+        if (const int error = ::posix_spawnp(&pid, program.c_str(), nullptr,
+                                             nullptr, argv.data(), environ);
+            error != 0) {
+            return std::unexpected(std::format(
+                "could not start shard {}: {}", i, std::strerror(error)));
+        }
+        pids_.push_back(pid);
+        sockets_.push_back(socket);
+    }
+
+    // Each worker listens once it has read the file and kept its shard.
+    for (size_t i = 0; i < count; ++i) {
+        while (true) {
+            if (const auto fd = connect_to_server(sockets_[i])) {
+                ::close(*fd);
+                break;
+            }
+            if (::waitpid(pids_[i], nullptr, WNOHANG) == pids_[i]) {
+                pids_[i] = pids_.back();
+                pids_.pop_back();
+                return std::unexpected(
+                    std::format("shard {} stopped before it was ready", i));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    return {};
+}
+
+shard_coordinator::shard_coordinator(shard_coordinator&& other) noexcept
+    : fds_{std::exchange(other.fds_, {})},
+      schema_{std::move(other.schema_)},
+      format_{other.format_},
+      lost_{other.lost_} {}
+
+shard_coordinator& shard_coordinator::operator=(
+    shard_coordinator&& other) noexcept {
+    if (this != &other) {
+        for (const int fd : fds_) ::close(fd);
+        fds_ = std::exchange(other.fds_, {});
+        schema_ = std::move(other.schema_);
+        format_ = other.format_;
+        lost_ = other.lost_;
+    }
+    return *this;
+}
+
+shard_coordinator::~shard_coordinator() {
+    for (const int fd : fds_) ::close(fd);
+}
+
+std::expected<shard_coordinator, string> shard_coordinator::connect(
+    const vector<string>& sockets, output_format format) {
+    shard_coordinator result{};
+    result.format_ = format;
+    for (const string& path : sockets) {
+        auto fd = connect_to_server(path);
+        if (!fd) return std::unexpected(fd.error());
+        result.fds_.push_back(*fd);
+    }
+    if (auto ok = result.read_schema(); !ok) {
+        return std::unexpected(ok.error());
+    }
+    return result;
+}
+
+std::optional<vector<shard_coordinator::reply>> shard_coordinator::ask_all(
+    string_view request, std::FILE* err) {
+    // Every shard is asked before any answer is read, so they all work at
+    // once.
+    for (size_t i = 0; i < fds_.size(); ++i) {
+        if (!write_frame(fds_[i], request)) {
+            println(err, "lost the connection to shard {}", i);
+            lost_ = true;
+            return std::nullopt;
+        }
+    }
+    vector<reply> replies(fds_.size());
+    for (size_t i = 0; i < fds_.size(); ++i) {
+        auto out = read_frame(fds_[i]);
+        auto messages = out ? read_frame(fds_[i]) : std::nullopt;
+        if (!messages) {
+            println(err, "lost the connection to shard {}", i);
+            lost_ = true;
+            return std::nullopt;
+        }
+        replies[i] = {std::move(*out), std::move(*messages)};
+    }
+    // The shards plan the same statement against the same columns, so they
+    // mostly have the same things to say.
+    vector<string_view> said{};
+    for (const reply& r : replies) {
+        if (r.err.empty() || std::ranges::find(said, r.err) != said.end()) {
+            continue;
+        }
+        said.push_back(r.err);
+        std::fwrite(r.err.data(), 1, r.err.size(), err);
+    }
+    return replies;
+}
+
+std::expected<void, string> shard_coordinator::read_schema() {
+    if (fds_.empty()) return std::unexpected("there are no shards"s);
+    if (!write_frame(fds_.front(), "shard:schema")) {
+        return std::unexpected("lost the connection to shard 0"s);
+    }
+    const auto out = read_frame(fds_.front());
+    const auto messages = out ? read_frame(fds_.front()) : std::nullopt;
+    const auto fields = messages ? split_fields(*out) : std::nullopt;
+    if (!fields) {
+        return std::unexpected("shard 0 did not describe its columns"s);
+    }
+    parser::header_fields_t header_fields{};
+    field_reader in{*fields};
+    while (!in.at_end() && in.ok()) {
+        string name = in.text();
+        header_fields.emplace_back(name,
+                                   static_cast<ecdt>(in.number<size_t>()));
+    }
+    if (!in.ok()) {
+        return std::unexpected("shard 0 did not describe its columns"s);
+    }
+    schema_ = table(header_fields, table::rows{});
+    return {};
+}
+
+void shard_coordinator::do_rows(const string& line, std::FILE* out,
+                                std::FILE* err) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(line);
+    if (!statement) {
+        std::fputs(syntax_error_text(line, statement.error()).c_str(), err);
+        return;
+    }
+    if (statement->statement_kind == query_statement::kind::refine) {
+        println(err,
+                "refine is not available with shards; repeat the query with "
+                "the added clauses");
+        return;
+    }
+    const auto projected =
+        statement->statement_kind == query_statement::kind::select
+            ? projection::make(schema_, statement->select_columns)
+            : projection::all(schema_);
+    if (!projected) {
+        println(err, "{}", projected.error().message);
+        println(err, "{}", describe_hint);
+        return;
+    }
+    std::FILE* const summary = format_ == output_format::csv ? out : err;
+    const auto plan = query_plan::make(schema_, *statement);
+    if (!plan) {
+        const plan_error& e = plan.error();
+        println(err, "{}", e.message);
+        if (e.error_kind == plan_error::kind::unknown_column) {
+            println(err, "{}", describe_hint);
+        }
+        result_writer writer(*projected, out, format_);
+        writer.write_headings();
+        writer.flush();
+        println(summary, "0 rows found");
+        return;
+    }
+    const auto plan_end = clock::now();
+
+    const auto replies = ask_all(
+        std::format("shard:rows {} {}", output_format_name(format_), line),
+        err);
+    if (!replies) return;
+
+    struct found_row {
+        string key{};
+        string text{};
+    };
+    vector<found_row> rows{};
+    size_t found = 0;
+    const bool keyed = plan->order().has_value();
+    for (const reply& r : *replies) {
+        const auto fields = split_fields(r.out);
+        if (!fields || fields->empty()) continue;
+        field_reader in{*fields};
+        found += in.number<size_t>();
+        while (!in.at_end() && in.ok()) {
+            found_row fr{};
+            if (keyed) fr.key = in.text();
+            fr.text = in.text();
+            rows.push_back(std::move(fr));
+        }
+    }
+    if (keyed) {
+        // Rows with a value come first, whichever the direction; equal
+        // values keep their shard's order.
+        const bool desc = plan->order()->descending;
+        std::ranges::stable_sort(
+            rows, [desc](const found_row& a, const found_row& b) {
+                if (a.key.empty() || b.key.empty()) {
+                    return !a.key.empty() && b.key.empty();
+                }
+                return desc ? b.key < a.key : a.key < b.key;
+            });
+    }
+    if (plan->limit() && rows.size() > *plan->limit()) {
+        rows.resize(*plan->limit());
+    }
+    const auto exec_end = clock::now();
+
+    result_writer writer(*projected, out, format_);
+    writer.write_headings();
+    writer.flush();
+    for (const found_row& fr : rows) {
+        std::fwrite(fr.text.data(), 1, fr.text.size(), out);
+    }
+    if (rows.size() < found) {
+        println(summary, "{} rows found, {} shown", found, rows.size());
+    } else {
+        println(summary, "{} rows found", found);
+    }
+    println(err, "planning {:.3f} ms, execution {:.3f} ms, {} shards",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(), fds_.size());
+}
+
+void shard_coordinator::do_count(const string& line, std::FILE* out,
+                                 std::FILE* err) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(line);
+    if (!statement) {
+        std::fputs(syntax_error_text(line, statement.error()).c_str(), err);
+        return;
+    }
+    const auto plan = query_plan::make(schema_, *statement);
+    if (!plan) {
+        println(err, "{}", plan.error().message);
+        return;
+    }
+    const auto plan_end = clock::now();
+    const auto replies = ask_all(std::format("shard:count {}", line), err);
+    if (!replies) return;
+    size_t found = 0;
+    for (const reply& r : *replies) {
+        const auto fields = split_fields(r.out);
+        if (!fields || fields->empty()) continue;
+        found += parse_number<size_t>(fields->front()).value_or(0);
+    }
+    if (plan->limit()) found = std::min(found, *plan->limit());
+    const auto exec_end = clock::now();
+    println(out, "{} rows found", found);
+
+    println(err, "planning {:.3f} ms, execution {:.3f} ms, {} shards",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(), fds_.size());
+}
+
+void shard_coordinator::do_aggregate(const string& line, std::FILE* out,
+                                     std::FILE* err) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(line);
+    if (!statement) {
+        std::fputs(syntax_error_text(line, statement.error()).c_str(), err);
+        return;
+    }
+    const auto plan = query_plan::make(schema_, *statement);
+    if (!plan) {
+        println(err, "{}", plan.error().message);
+        return;
+    }
+    const auto aggregates = aggregate_plan::make(schema_, *statement);
+    if (!aggregates) {
+        println(err, "{}", aggregates.error().message);
+        return;
+    }
+    const auto plan_end = clock::now();
+    const auto replies = ask_all(std::format("shard:aggregate {}", line), err);
+    if (!replies) return;
+    vector<aggregate_groups> parts{};
+    for (size_t i = 0; i < replies->size(); ++i) {
+        const auto fields = split_fields((*replies)[i].out);
+        auto groups = fields ? decode_groups(*fields) : std::nullopt;
+        if (!groups) {
+            println(err, "shard {} did not return its groups", i);
+            return;
+        }
+        parts.push_back(std::move(*groups));
+    }
+    const aggregate_groups merged = aggregates->merge(parts);
+    size_t rows = 0;
+    for (const aggregate_group& g : merged) rows += g.rows;
+    const aggregate_result result = aggregates->finish(merged);
+    const auto exec_end = clock::now();
+    print_aggregate_result(out, result, rows);
+
+    println(err, "planning {:.3f} ms, execution {:.3f} ms, {} shards",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(), fds_.size());
+}
+
+void shard_coordinator::do_facets(const string& line, std::FILE* out,
+                                  std::FILE* err) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto plan_start = clock::now();
+    const auto statement = parse_query_statement(line);
+    if (!statement) {
+        std::fputs(syntax_error_text(line, statement.error()).c_str(), err);
+        return;
+    }
+    const auto plan = query_plan::make(schema_, *statement);
+    if (!plan) {
+        println(err, "{}", plan.error().message);
+        return;
+    }
+    const auto facets = facet_plan::make(schema_, *statement);
+    if (!facets) {
+        println(err, "{}", facets.error().message);
+        return;
+    }
+    const auto plan_end = clock::now();
+    const auto replies = ask_all(std::format("shard:facets {}", line), err);
+    if (!replies) return;
+    vector<facet_result> parts{};
+    for (size_t i = 0; i < replies->size(); ++i) {
+        const auto fields = split_fields((*replies)[i].out);
+        auto counts = fields ? decode_facets(*fields) : std::nullopt;
+        if (!counts) {
+            println(err, "shard {} did not return its counts", i);
+            return;
+        }
+        parts.push_back(std::move(*counts));
+    }
+    const facet_result result = facets->merge(parts);
+    const auto exec_end = clock::now();
+    print_facet_result(out, result);
+
+    println(err, "planning {:.3f} ms, execution {:.3f} ms, {} shards",
+            milliseconds(plan_end - plan_start).count(),
+            milliseconds(exec_end - plan_end).count(), fds_.size());
+}
+
+void shard_coordinator::do_reload(std::FILE* out, std::FILE* err) {
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto start = clock::now();
+    const auto replies = ask_all("shard:reload", err);
+    if (!replies) return;
+    size_t rows = 0;
+    size_t reloaded = 0;
+    string filename{};
+    for (const reply& r : *replies) {
+        const auto fields = split_fields(r.out);
+        if (!fields || fields->size() != 2) continue;
+        rows += parse_number<size_t>((*fields)[0]).value_or(0);
+        filename = (*fields)[1];
+        ++reloaded;
+    }
+    if (reloaded < replies->size()) {
+        println(err, "{} of {} shards reloaded", reloaded, replies->size());
+    } else {
+        println(out, "Reloaded {} rows from \"{}\" into {} shards", rows,
+                filename, replies->size());
+    }
+    // The file's columns may have changed.
+    if (auto ok = read_schema(); !ok) println(err, "{}", ok.error());
+    println(err, "reload {:.3f} ms",
+            milliseconds(clock::now() - start).count());
+}
+
+void shard_coordinator::do_each(const string& line, std::FILE* out,
+                                std::FILE* err) {
+    const auto replies = ask_all(line, err);
+    if (!replies) return;
+    for (size_t i = 0; i < replies->size(); ++i) {
+        println(out, "shard {}:", i);
+        const string& text = (*replies)[i].out;
+        std::fwrite(text.data(), 1, text.size(), out);
+    }
+}
+
+bool shard_coordinator::run_command(const string& input_line, std::FILE* out,
+                                    std::FILE* err) {
+    using std::regex;
+    static const regex quit_cmd_rx{R"(^\s*(quit|exit)\b.*)", regex::icase};
+    static const regex help_cmd_rx{R"(^\s*help\b.*)", regex::icase};
+    static const regex describe_cmd_rx{R"(^\s*describe\b.*)", regex::icase};
+    static const regex query_cmd_rx{R"(^\s*(query|refine)\b\s+\(.*)",
+                                    regex::icase};
+    static const regex select_cmd_rx{R"(^\s*select\b\s+".*)", regex::icase};
+    static const regex count_cmd_rx{R"(^\s*count\b\s+\(.*)", regex::icase};
+    static const regex aggregate_cmd_rx{R"(^\s*aggregate\b.*)", regex::icase};
+    static const regex facets_cmd_rx{R"(^\s*facets\b\s+\(.*)", regex::icase};
+    static const regex reload_cmd_rx{R"(^\s*reload\s*$)", regex::icase};
+    static const regex each_cmd_rx{R"(^\s*(threads|cache)\b.*)",
+                                   regex::icase};
+    static const regex page_cmd_rx{R"(^\s*page\b.*)", regex::icase};
+    static const vector<string> help_strings{
+        "\"describe\" - describe the table",
+        "\"query (...) && (...) order by \"column name\" [asc|desc] limit N\" "
+        "- do a query on every shard",
+        "\"select \"column name\", ... where (...)\" - query, printing only "
+        "the named columns",
+        "\"count (...)\" - count the matching rows on every shard",
+        "\"aggregate count, avg(\"column name\") group by \"column name\" "
+        "where (...)\" - summarize the matching rows of every shard",
+        "\"facets (...) by \"column name\", ... top N\" - count the values "
+        "of several columns",
+        "\"reload\" - have every shard read the file again",
+        "\"threads\" - show what each shard's worker threads have done",
+        "\"cache\" - show how well each shard's query result cache is doing",
+        "\"quit\" - stop the shards and end program",
+        "\"help\" - print help message"};
+
+    if (std::regex_match(input_line, quit_cmd_rx)) {
+        return false;
+    }
+    if (std::regex_match(input_line, help_cmd_rx)) {
+        for (const string& s : help_strings) println(err, "{}", s);
+    } else if (std::regex_match(input_line, describe_cmd_rx)) {
+        for (const parser::header_field& hf : schema_.header_fields_) {
+            println(out, "Column Name: \"{}\"; Column Type : {}", hf.text,
+                    hf.data_type);
+        }
+    } else if (std::regex_match(input_line, query_cmd_rx) ||
+               std::regex_match(input_line, select_cmd_rx)) {
+        do_rows(input_line, out, err);
+    } else if (std::regex_match(input_line, count_cmd_rx)) {
+        do_count(input_line, out, err);
+    } else if (std::regex_match(input_line, aggregate_cmd_rx)) {
+        do_aggregate(input_line, out, err);
+    } else if (std::regex_match(input_line, facets_cmd_rx)) {
+        do_facets(input_line, out, err);
+    } else if (std::regex_match(input_line, reload_cmd_rx)) {
+        do_reload(out, err);
+    } else if (std::regex_match(input_line, each_cmd_rx)) {
+        do_each(input_line, out, err);
+    } else if (std::regex_match(input_line, page_cmd_rx)) {
+        println(err, "page is not available with shards");
+    } else {
+        println(out, "command line \"{}\" not understood", input_line);
+    }
+    return !lost_;
+}
+
+int shard_coordinator::read_eval_print() {
+    println(stderr, "Welcome to DimRoom, with {} shards", fds_.size());
+    println(stderr, "Enter the command \"help\" for help.");
+    const string prompt_str = std::format(
+        "dimroom-{}.{}> ", dimroom_VERSION_MAJOR, dimroom_VERSION_MINOR);
+    while (auto line_input = lineread(prompt_str)) {
+        string input_line{*line_input};
+        trim(input_line);
+        if (!run_command(input_line)) break;
+    }
+    println("Goodbye.");
+    return lost_ ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
+
+}  // namespace jt
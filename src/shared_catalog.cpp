@@ -0,0 +1,458 @@
+#include "shared_catalog.hpp"
+
+#if !defined(_WIN64)
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "cell.hpp"
+#include "cell_types.hpp"
+#include "coordinates.hpp"
+#include "parser.hpp"
+#include "scheduler.hpp"
+#include "utility.hpp"
+
+namespace jt {
+using std::string;
+using std::string_view;
+using std::vector;
+using ecdt = e_cell_data_type;
+
+/// @brief The start of the shared memory object. Its fields are written by
+/// the publisher before state is set to ready, and not changed after, except
+/// for the holders.
+struct shared_catalog::control {
+    char magic[8]{};
+    std::uint32_t version{0};
+    std::uint32_t control_bytes{0};
+    std::uint64_t image_bytes{0};
+    std::uint64_t rows{0};
+    /// @brief Where the row offsets and the cells start, in the image.
+    std::uint64_t offsets_at{0};
+    std::uint64_t cells_at{0};
+    std::atomic<std::uint32_t> state{0};
+    /// @brief Process ids of the processes attached; 0 for a free slot.
+    std::atomic<std::int32_t> holders[max_holders]{};
+};
+
+namespace {
+constexpr char image_magic[8] = {'D', 'I', 'M', 'R', 'O', 'O', 'M', '\0'};
+
+/// @brief Changes whenever the layout of the image does.
+constexpr std::uint32_t image_version{1};
+
+constexpr std::uint32_t state_writing{0};
+constexpr std::uint32_t state_ready{1};
+
+/// @brief How long to wait for another process to finish publishing.
+constexpr auto publish_wait = std::chrono::seconds(30);
+
+/// @brief Value kind of a cell without a value.
+constexpr std::uint8_t no_value{0xff};
+
+/// @brief Rows decoded per task when rebuilding a table.
+constexpr size_t decode_chunk_rows{4096};
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free &&
+                  std::atomic<std::int32_t>::is_always_lock_free,
+              "the control page is shared between processes");
+
+size_t round_up(size_t n, size_t to) noexcept { return (n + to - 1) / to * to; }
+
+/// @brief Whether a process is still running.
+bool alive(std::int32_t pid) noexcept {
+    return ::kill(pid, 0) == 0 || errno == EPERM;
+}
+
+template <class T>
+void put(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+void put_text(string& out, string_view text) {
+    put(out, static_cast<std::uint32_t>(text.size()));
+    out.append(text);
+}
+
+/// @brief Reads the image in the order it was written.
+class image_reader {
+    const std::byte* at_;
+
+   public:
+    explicit image_reader(const std::byte* at) noexcept : at_{at} {}
+
+    template <class T>
+    T get() noexcept {
+        T value{};
+        std::memcpy(&value, at_, sizeof value);
+        at_ += sizeof value;
+        return value;
+    }
+
+    string text() {
+        const auto size = get<std::uint32_t>();
+        string result(reinterpret_cast<const char*>(at_), size);
+        at_ += size;
+        return result;
+    }
+};
+
+/// @brief Writes a cell: its type, which alternative its value holds, and
+/// the value.
+void put_cell(string& out, const data_cell& cell) {
+    put(out, static_cast<std::uint8_t>(cell.data_type));
+    if (!cell.value) {
+        put(out, no_value);
+        return;
+    }
+    const cell_value_types& v = *cell.value;
+    put(out, static_cast<std::uint8_t>(v.index()));
+    if (const auto* f = std::get_if<float>(&v)) {
+        put(out, *f);
+    } else if (const auto* b = std::get_if<bool>(&v)) {
+        put(out, static_cast<std::uint8_t>(*b));
+    } else if (const auto* i = std::get_if<int>(&v)) {
+        put(out, static_cast<std::int32_t>(*i));
+    } else if (const auto* s = std::get_if<string>(&v)) {
+        put_text(out, *s);
+    } else if (const auto* c = std::get_if<coordinate>(&v)) {
+        put(out, static_cast<std::uint8_t>(c->coordinate_format));
+        put(out, c->latitude);
+        put(out, c->longitude);
+    } else if (const auto* tags = std::get_if<vector<string>>(&v)) {
+        put(out, static_cast<std::uint32_t>(tags->size()));
+        for (const string& tag : *tags) put_text(out, tag);
+    }
+}
+
+data_cell get_cell(image_reader& in) {
+    const auto type = static_cast<ecdt>(in.get<std::uint8_t>());
+    const auto kind = in.get<std::uint8_t>();
+    switch (kind) {
+        case 2:
+            return data_cell{type, cell_value_types{std::in_place_index<2>,
+                                                    in.get<float>()}};
+        case 3:
+            return data_cell{
+                type, cell_value_types{std::in_place_index<3>,
+                                       in.get<std::uint8_t>() != 0}};
+        case 4:
+            return data_cell{
+                type, cell_value_types{std::in_place_index<4>,
+                                       static_cast<int>(
+                                           in.get<std::int32_t>())}};
+        case 5:
+            return data_cell{type,
+                             cell_value_types{std::in_place_index<5>,
+                                              in.text()}};
+        case 6: {
+            const auto format =
+                static_cast<coordinate::format>(in.get<std::uint8_t>());
+            const auto latitude = in.get<float>();
+            const auto longitude = in.get<float>();
+            return data_cell{type, cell_value_types{std::in_place_index<6>,
+                                                    coordinate{format, latitude,
+                                                               longitude}}};
+        }
+        case 7: {
+            vector<string> tags(in.get<std::uint32_t>());
+            for (string& tag : tags) tag = in.text();
+            return data_cell{type, cell_value_types{std::in_place_index<7>,
+                                                    std::move(tags)}};
+        }
+        case 0:
+            return data_cell{type, cell_value_types{std::in_place_index<0>}};
+        case 1:
+            return data_cell{type, cell_value_types{std::in_place_index<1>}};
+        default:
+            return data_cell{type, std::nullopt};
+    }
+}
+}  // namespace
+
+shared_catalog::shared_catalog(shared_catalog&& other) noexcept
+    : name_{std::move(other.name_)},
+      control_{std::exchange(other.control_, nullptr)},
+      image_{std::exchange(other.image_, nullptr)},
+      mapped_bytes_{std::exchange(other.mapped_bytes_, 0)},
+      slot_{other.slot_} {}
+
+shared_catalog& shared_catalog::operator=(shared_catalog&& other) noexcept {
+    if (this != &other) {
+        detach();
+        name_ = std::move(other.name_);
+        control_ = std::exchange(other.control_, nullptr);
+        image_ = std::exchange(other.image_, nullptr);
+        mapped_bytes_ = std::exchange(other.mapped_bytes_, 0);
+        slot_ = other.slot_;
+    }
+    return *this;
+}
+
+void shared_catalog::detach() noexcept {
+    if (!control_) return;
+    control_->holders[slot_].store(0);
+    bool last = true;
+    for (const auto& holder : control_->holders) {
+        const std::int32_t pid = holder.load();
+        if (pid != 0 && alive(pid)) {
+            last = false;
+            break;
+        }
+    }
+    if (last) ::shm_unlink(name_.c_str());
+    ::munmap(control_, mapped_bytes_);
+    control_ = nullptr;
+    image_ = nullptr;
+    mapped_bytes_ = 0;
+}
+
+std::expected<string, string> shared_catalog::name_for(
+    const string& csv_filename) {
+    namespace fs = std::filesystem;
+    std::error_code ec{};
+    const fs::path path = fs::absolute(csv_filename, ec);
+    const auto size = ec ? 0 : fs::file_size(path, ec);
+    const auto modified = ec ? fs::file_time_type{}
+                             : fs::last_write_time(path, ec);
+    if (ec) {
+        return std::unexpected(std::format("could not examine \"{}\": {}",
+                                           csv_filename, ec.message()));
+    }
+    // Short enough for every system's limit on the length of the name.
+    return std::format(
+        "/dimroom-{:016x}",
+        stable_hash(std::format("{}\n{}\n{}", path_to_string(path), size,
+                                modified.time_since_epoch().count())));
+}
+
+std::expected<shared_catalog, string> shared_catalog::publish(
+    const table& t, const string& name) {
+    string image{};
+    put_text(image, t.name);
+    put(image, static_cast<std::uint32_t>(t.header_fields_.size()));
+    for (const parser::header_field& hf : t.header_fields_) {
+        put(image, static_cast<std::uint8_t>(hf.data_type));
+        put_text(image, hf.text);
+    }
+    image.resize(round_up(image.size(), sizeof(std::uint64_t)));
+    const size_t offsets_at = image.size();
+    const size_t rows = t.rows_.size();
+    image.resize(offsets_at + (rows + 1) * sizeof(std::uint64_t));
+    const size_t cells_at = image.size();
+    for (size_t r = 0; r < rows; ++r) {
+        const std::uint64_t offset = image.size() - cells_at;
+        std::memcpy(image.data() + offsets_at + r * sizeof offset, &offset,
+                    sizeof offset);
+        put(image, static_cast<std::uint32_t>(t.rows_[r].size()));
+        for (const data_cell& cell : t.rows_[r]) put_cell(image, cell);
+    }
+    const std::uint64_t end = image.size() - cells_at;
+    std::memcpy(image.data() + offsets_at + rows * sizeof end, &end,
+                sizeof end);
+
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        if (errno == EEXIST) return attach(name);
+        return std::unexpected(std::format(
+            "could not create shared memory \"{}\": {}", name,
+            std::strerror(errno)));
+    }
+    const auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t control_bytes = round_up(sizeof(control), page);
+    const size_t total = control_bytes + image.size();
+    void* mapped = ::ftruncate(fd, static_cast<off_t>(total)) == 0
+                       ? ::mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, 0)
+                       : MAP_FAILED;
+    if (mapped == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return std::unexpected(std::format(
+            "could not size shared memory \"{}\": {}", name,
+            std::strerror(error)));
+    }
+    ::close(fd);
+
+    shared_catalog result{};
+    result.name_ = name;
+    result.control_ = new (mapped) control{};
+    result.image_ = static_cast<const std::byte*>(mapped) + control_bytes;
+    result.mapped_bytes_ = total;
+    result.slot_ = 0;
+    control& c = *result.control_;
+    c.holders[0].store(static_cast<std::int32_t>(::getpid()));
+    std::memcpy(c.magic, image_magic, sizeof image_magic);
+    c.version = image_version;
+    c.control_bytes = static_cast<std::uint32_t>(control_bytes);
+    c.image_bytes = image.size();
+    c.rows = rows;
+    c.offsets_at = offsets_at;
+    c.cells_at = cells_at;
+    std::memcpy(static_cast<std::byte*>(mapped) + control_bytes, image.data(),
+                image.size());
+    ::mprotect(static_cast<std::byte*>(mapped) + control_bytes, image.size(),
+               PROT_READ);
+    c.state.store(state_ready, std::memory_order_release);
+    return result;
+}
+
+std::expected<shared_catalog, string> shared_catalog::attach(
+    const string& name) {
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return std::unexpected(std::format(
+            "no shared memory \"{}\": {}", name, std::strerror(errno)));
+    }
+    auto result = map(name, fd);
+    ::close(fd);
+    return result;
+}
+
+std::expected<shared_catalog, string> shared_catalog::map(const string& name,
+                                                          int fd) {
+    using clock = std::chrono::steady_clock;
+    const auto give_up = clock::now() + publish_wait;
+    auto pause = [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    };
+
+    // The publisher sizes the object just after creating it.
+    struct stat st{};
+    while (::fstat(fd, &st) == 0 &&
+           static_cast<size_t>(st.st_size) < sizeof(control) &&
+           clock::now() < give_up) {
+        pause();
+    }
+    const auto total = static_cast<size_t>(st.st_size);
+    if (total < sizeof(control)) {
+        return std::unexpected(
+            std::format("shared memory \"{}\" was never written", name));
+    }
+    void* mapped =
+        ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        return std::unexpected(std::format(
+            "could not map shared memory \"{}\": {}", name,
+            std::strerror(errno)));
+    }
+    auto* c = static_cast<control*>(mapped);
+    auto fail = [&](string message) {
+        ::munmap(mapped, total);
+        return std::unexpected(std::move(message));
+    };
+    while (c->state.load(std::memory_order_acquire) == state_writing &&
+           clock::now() < give_up) {
+        pause();
+    }
+    if (c->state.load(std::memory_order_acquire) != state_ready) {
+        return fail(std::format("shared memory \"{}\" was never finished",
+                                name));
+    }
+    if (std::memcmp(c->magic, image_magic, sizeof image_magic) != 0 ||
+        c->version != image_version ||
+        c->control_bytes + c->image_bytes != total) {
+        return fail(std::format(
+            "shared memory \"{}\" was written by another version of dimroom",
+            name));
+    }
+
+    // Take a free slot, or the slot of a process that has ended.
+    const auto pid = static_cast<std::int32_t>(::getpid());
+    size_t slot = max_holders;
+    for (size_t i = 0; i < max_holders && slot == max_holders; ++i) {
+        std::int32_t held = c->holders[i].load();
+        if ((held == 0 || !alive(held)) &&
+            c->holders[i].compare_exchange_strong(held, pid)) {
+            slot = i;
+        }
+    }
+    if (slot == max_holders) {
+        return fail(std::format(
+            "shared memory \"{}\" already has {} processes attached", name,
+            max_holders));
+    }
+    ::mprotect(static_cast<std::byte*>(mapped) + c->control_bytes,
+               total - c->control_bytes, PROT_READ);
+
+    shared_catalog result{};
+    result.name_ = name;
+    result.control_ = c;
+    result.image_ = static_cast<const std::byte*>(mapped) + c->control_bytes;
+    result.mapped_bytes_ = total;
+    result.slot_ = slot;
+    return result;
+}
+
+table shared_catalog::read_table() const {
+    image_reader in{image_};
+    string name = in.text();
+    parser::header_fields_t header_fields{};
+    const auto columns = in.get<std::uint32_t>();
+    for (std::uint32_t i = 0; i < columns; ++i) {
+        const auto type = static_cast<ecdt>(in.get<std::uint8_t>());
+        header_fields.emplace_back(in.text(), type);
+    }
+
+    const size_t rows = control_->rows;
+    const std::byte* const offsets = image_ + control_->offsets_at;
+    const std::byte* const cells = image_ + control_->cells_at;
+    table::rows result(rows);
+    const size_t chunks = (rows + decode_chunk_rows - 1) / decode_chunk_rows;
+    scheduler::shared().parallel_for(chunks, [&](size_t chunk) {
+        const size_t first = chunk * decode_chunk_rows;
+        std::uint64_t offset = 0;
+        std::memcpy(&offset, offsets + first * sizeof offset, sizeof offset);
+        image_reader row_in{cells + offset};
+        for (size_t r = first; r < std::min(rows, first + decode_chunk_rows);
+             ++r) {
+            row& rw = result[r];
+            const auto size = row_in.get<std::uint32_t>();
+            rw.reserve(size);
+            for (std::uint32_t i = 0; i < size; ++i) {
+                rw.push_back(get_cell(row_in));
+            }
+        }
+    });
+    return table(table(header_fields, table::rows{}, std::move(name)),
+                 std::move(result));
+}
+
+size_t shared_catalog::holders() const noexcept {
+    if (!control_) return 0;
+    return static_cast<size_t>(std::ranges::count_if(
+        control_->holders, [](const auto& holder) {
+            const std::int32_t pid = holder.load();
+            return pid != 0 && alive(pid);
+        }));
+}
+
+size_t shared_catalog::image_bytes() const noexcept {
+    return control_ ? control_->image_bytes : 0;
+}
+
+}  // namespace jt
+
+#endif
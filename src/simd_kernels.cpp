@@ -0,0 +1,261 @@
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "bitmap.hpp"
+#include "predicate.hpp"
+#include "utility.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DIMROOM_X86_64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows AVX2 intrinsics in any function.
+#define DIMROOM_TARGET_AVX2
+#else
+#define DIMROOM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace jt {
+
+namespace {
+using word_t = bitmap::word_t;
+constexpr size_t word_bits = bitmap::word_bits;
+
+/// @brief Tolerance used for floating point equality; see is_close().
+constexpr float float_epsilon = epsilon<float>();
+
+/// @brief Scalar comparison of one value, matching the AVX2 lanes exactly.
+/// Floating point equality is an interval compare, like the AVX2 kernel.
+template <comparison_op Op, typename T>
+inline bool scalar_compare(T x, T v, T lo, T hi) noexcept {
+    if constexpr (std::is_same_v<T, float>) {
+        if constexpr (Op == comparison_op::not_equal_to) {
+            return !(x >= lo && x <= hi);
+        } else if constexpr (Op == comparison_op::greater) {
+            return x > v;
+        } else if constexpr (Op == comparison_op::greater_equal) {
+            return x >= lo;
+        } else if constexpr (Op == comparison_op::less) {
+            return x < v;
+        } else if constexpr (Op == comparison_op::less_equal) {
+            return x <= hi;
+        } else {
+            return x >= lo && x <= hi;
+        }
+    } else {
+        return predicate<T, Op>{}(x, v);
+    }
+}
+
+/// @brief Scalar kernel; also used for the tail of the AVX2 kernels.
+template <typename T>
+struct scalar_kernel {
+    template <comparison_op Op>
+    struct kernel {
+        static void run(const T* values, size_t first, size_t last, T v,
+                        word_t* out) noexcept {
+            T lo = v;
+            T hi = v;
+            if constexpr (std::is_same_v<T, float>) {
+                lo = v - float_epsilon;
+                hi = v + float_epsilon;
+            }
+            // Build each word in a register and store it once.
+            word_t w = 0;
+            for (size_t i = first; i < last; ++i) {
+                const word_t bit = scalar_compare<Op>(values[i], v, lo, hi);
+                w |= bit << (i % word_bits);
+                if (i % word_bits == word_bits - 1 || i + 1 == last) {
+                    out[i / word_bits] |= w;
+                    w = 0;
+                }
+            }
+        }
+    };
+
+    static constexpr auto dispatch_table = make_dispatch_table<kernel>();
+};
+
+#if defined(DIMROOM_X86_64)
+
+/// @brief Compares 8 integers; returns one bit per lane.
+template <comparison_op Op>
+DIMROOM_TARGET_AVX2 inline word_t compare8_int32(__m256i x,
+                                                 __m256i v) noexcept {
+    __m256i m;
+    bool invert = false;
+    if constexpr (Op == comparison_op::not_equal_to) {
+        m = _mm256_cmpeq_epi32(x, v);
+        invert = true;
+    } else if constexpr (Op == comparison_op::greater) {
+        m = _mm256_cmpgt_epi32(x, v);
+    } else if constexpr (Op == comparison_op::greater_equal) {
+        m = _mm256_cmpgt_epi32(v, x);
+        invert = true;
+    } else if constexpr (Op == comparison_op::less) {
+        m = _mm256_cmpgt_epi32(v, x);
+    } else if constexpr (Op == comparison_op::less_equal) {
+        m = _mm256_cmpgt_epi32(x, v);
+        invert = true;
+    } else {
+        m = _mm256_cmpeq_epi32(x, v);
+    }
+    const auto bits = static_cast<word_t>(
+        static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m))));
+    return invert ? (~bits & 0xff) : bits;
+}
+
+/// @brief Compares 8 floats; returns one bit per lane.
+template <comparison_op Op>
+DIMROOM_TARGET_AVX2 inline word_t compare8_float(__m256 x, __m256 v,
+                                                 __m256 lo,
+                                                 __m256 hi) noexcept {
+    __m256 m;
+    bool invert = false;
+    if constexpr (Op == comparison_op::not_equal_to) {
+        m = _mm256_and_ps(_mm256_cmp_ps(x, lo, _CMP_GE_OQ),
+                          _mm256_cmp_ps(x, hi, _CMP_LE_OQ));
+        invert = true;
+    } else if constexpr (Op == comparison_op::greater) {
+        m = _mm256_cmp_ps(x, v, _CMP_GT_OQ);
+    } else if constexpr (Op == comparison_op::greater_equal) {
+        m = _mm256_cmp_ps(x, lo, _CMP_GE_OQ);
+    } else if constexpr (Op == comparison_op::less) {
+        m = _mm256_cmp_ps(x, v, _CMP_LT_OQ);
+    } else if constexpr (Op == comparison_op::less_equal) {
+        m = _mm256_cmp_ps(x, hi, _CMP_LE_OQ);
+    } else {
+        m = _mm256_and_ps(_mm256_cmp_ps(x, lo, _CMP_GE_OQ),
+                          _mm256_cmp_ps(x, hi, _CMP_LE_OQ));
+    }
+    const auto bits =
+        static_cast<word_t>(static_cast<unsigned>(_mm256_movemask_ps(m)));
+    return invert ? (~bits & 0xff) : bits;
+}
+
+/// @brief AVX2 kernel over whole 64-row words; the tail is done by the
+/// scalar kernel.
+template <comparison_op Op>
+struct avx2_int32_kernel {
+    DIMROOM_TARGET_AVX2 static void run(const std::int32_t* values,
+                                        size_t first, size_t last,
+                                        std::int32_t v, word_t* out) noexcept {
+        const __m256i vv = _mm256_set1_epi32(v);
+        size_t i = first;
+        for (; i + word_bits <= last; i += word_bits) {
+            word_t w = 0;
+            for (size_t lane = 0; lane < word_bits; lane += 8) {
+                const __m256i x = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(values + i + lane));
+                w |= compare8_int32<Op>(x, vv) << lane;
+            }
+            out[i / word_bits] = w;
+        }
+        scalar_kernel<std::int32_t>::kernel<Op>::run(values, i, last, v, out);
+    }
+};
+
+template <comparison_op Op>
+struct avx2_float_kernel {
+    DIMROOM_TARGET_AVX2 static void run(const float* values, size_t first,
+                                        size_t last, float v,
+                                        word_t* out) noexcept {
+        const __m256 vv = _mm256_set1_ps(v);
+        const __m256 lo = _mm256_set1_ps(v - float_epsilon);
+        const __m256 hi = _mm256_set1_ps(v + float_epsilon);
+        size_t i = first;
+        for (; i + word_bits <= last; i += word_bits) {
+            word_t w = 0;
+            for (size_t lane = 0; lane < word_bits; lane += 8) {
+                const __m256 x = _mm256_loadu_ps(values + i + lane);
+                w |= compare8_float<Op>(x, vv, lo, hi) << lane;
+            }
+            out[i / word_bits] = w;
+        }
+        scalar_kernel<float>::kernel<Op>::run(values, i, last, v, out);
+    }
+};
+
+constexpr auto avx2_int32_table = make_dispatch_table<avx2_int32_kernel>();
+constexpr auto avx2_float_table = make_dispatch_table<avx2_float_kernel>();
+
+bool cpu_has_avx2() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4]{};
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!(osxsave && avx)) return false;
+    // The OS must save the YMM registers.
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+std::atomic<simd_level> current_level{detected_simd_level()};
+}  // namespace
+
+simd_level detected_simd_level() noexcept {
+#if defined(DIMROOM_X86_64)
+    static const simd_level level =
+        cpu_has_avx2() ? simd_level::avx2 : simd_level::scalar;
+    return level;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+simd_level active_simd_level() noexcept {
+    return current_level.load(std::memory_order_relaxed);
+}
+
+void set_simd_level(simd_level level) noexcept {
+    if (level == simd_level::avx2 && detected_simd_level() != simd_level::avx2)
+        return;
+    current_level.store(level, std::memory_order_relaxed);
+}
+
+void compare_int32(std::span<const std::int32_t> values, comparison_op op,
+                   std::int32_t query_value,
+                   std::span<bitmap::word_t> out) noexcept {
+    std::ranges::fill(out, word_t{0});
+    const size_t idx = dispatch_index(op);
+#if defined(DIMROOM_X86_64)
+    if (active_simd_level() == simd_level::avx2) {
+        avx2_int32_table[idx](values.data(), 0, values.size(), query_value,
+                              out.data());
+        return;
+    }
+#endif
+    scalar_kernel<std::int32_t>::dispatch_table[idx](
+        values.data(), 0, values.size(), query_value, out.data());
+}
+
+void compare_float(std::span<const float> values, comparison_op op,
+                   float query_value, std::span<bitmap::word_t> out) noexcept {
+    std::ranges::fill(out, word_t{0});
+    const size_t idx = dispatch_index(op);
+#if defined(DIMROOM_X86_64)
+    if (active_simd_level() == simd_level::avx2) {
+        avx2_float_table[idx](values.data(), 0, values.size(), query_value,
+                              out.data());
+        return;
+    }
+#endif
+    scalar_kernel<float>::dispatch_table[idx](values.data(), 0, values.size(),
+                                              query_value, out.data());
+}
+
+}  // namespace jt
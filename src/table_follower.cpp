@@ -0,0 +1,133 @@
+#include "table_follower.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <print>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include "live_table.hpp"
+#include "utility.hpp"
+
+namespace jt {
+
+using std::println;
+using std::string;
+
+table_follower::table_follower(live_table& tables, std::FILE* messages)
+    : tables_{tables}, messages_{messages} {
+    thread_ = std::jthread([this](std::stop_token stop) {
+        if (!watch(stop)) poll(stop);
+    });
+}
+
+bool table_follower::check(bool replaced) {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    const auto stats = replaced ? tables_.reload() : tables_.catch_up();
+    if (!stats) {
+        if (messages_) {
+            println(messages_, "{}; still using the data read before",
+                    stats.error());
+        }
+        return !replaced;
+    }
+    if (!messages_) return true;
+    if (stats->whole_file) {
+        println(messages_, "Reloaded {} rows from \"{}\" ({:.3f} ms)",
+                stats->rows, tables_.filename(),
+                milliseconds(stats->load + stats->swap).count());
+    } else if (stats->appended > 0) {
+        println(messages_,
+                "Appended {} rows from \"{}\", {} in all ({:.3f} ms)",
+                stats->appended, tables_.filename(), stats->rows,
+                milliseconds(stats->load + stats->swap).count());
+    }
+    return true;
+}
+
+bool table_follower::watch(std::stop_token stop) {
+#if defined(__linux__)
+    namespace fs = std::filesystem;
+    const fs::path path = fs::absolute(tables_.filename());
+    const string leaf = path_to_string(path.filename());
+
+    const int notes = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notes < 0) return false;
+    // The directory is watched rather than the file, so that a new file
+    // moved or copied into its place is seen too.
+    if (::inotify_add_watch(notes, path_to_string(path.parent_path()).c_str(),
+                            IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE |
+                                IN_MOVED_TO) < 0) {
+        ::close(notes);
+        return false;
+    }
+    int wake[2]{-1, -1};
+    if (::pipe2(wake, O_CLOEXEC) != 0) {
+        ::close(notes);
+        return false;
+    }
+    {
+        const std::stop_callback on_stop{stop, [&wake] {
+                                             const char byte = 0;
+                                             (void)::write(wake[1], &byte, 1);
+                                         }};
+        // Lines written before the watch started.
+        check(false);
+        bool replaced = false;
+        alignas(inotify_event) char buffer[4096];
+        while (!stop.stop_requested()) {
+            pollfd fds[2]{{notes, POLLIN, 0}, {wake[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) continue;
+            if (fds[1].revents != 0) break;
+            bool changed = false;
+            ssize_t n = 0;
+            while ((n = ::read(notes, buffer, sizeof buffer)) > 0) {
+                for (char* p = buffer; p < buffer + n;) {
+                    const auto* event = reinterpret_cast<inotify_event*>(p);
+                    if (event->len > 0 && leaf == event->name) {
+                        changed = true;
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                            replaced = true;
+                        }
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            // A replacement that could not be read yet, such as an empty
+            // file just created, is read again at the next change.
+            if (changed) replaced = !check(replaced);
+        }
+    }
+    ::close(wake[0]);
+    ::close(wake[1]);
+    ::close(notes);
+    return true;
+#else
+    (void)stop;
+    return false;
+#endif
+}
+
+void table_follower::poll(std::stop_token stop) {
+    std::mutex waiting{};
+    std::condition_variable_any wake{};
+    while (!stop.stop_requested()) {
+        check(false);
+        std::unique_lock lock{waiting};
+        wake.wait_for(lock, stop, poll_interval, [] { return false; });
+    }
+}
+
+}  // namespace jt
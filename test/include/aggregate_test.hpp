@@ -0,0 +1,149 @@
+#pragma once
+
+#include <format>
+#include <string>
+#include <vector>
+
+#include "aggregate.hpp"
+#include "bitmap.hpp"
+#include "google_test_fixture.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct aggregate_test_fixture : google_test_fixture {
+    /// @brief Runs an aggregate statement; returns the headings line and
+    /// then one line per group, with the cells separated by commas.
+    vector<string> aggregate(const table& t, const string& line,
+                             scheduler* sched = nullptr) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value()) << line;
+        if (!statement) return {};
+        const auto plan = query_plan::make(t, *statement);
+        const auto aggregates = aggregate_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value() && aggregates.has_value()) << line;
+        if (!plan || !aggregates) return {};
+        const aggregate_result result =
+            aggregates->run(plan->execute(), sched);
+
+        vector<string> lines{};
+        string headings{};
+        for (const string& h : result.headings) {
+            headings.append(headings.empty() ? "" : ",").append(h);
+        }
+        lines.push_back(headings);
+        for (const row& rw : result.rows) {
+            string cells{};
+            for (size_t i = 0; i < rw.size(); ++i) {
+                if (i > 0) cells.append(",");
+                if (rw[i].value) {
+                    cells.append(
+                        cell_value_types_value_as_string(*rw[i].value));
+                }
+            }
+            lines.push_back(cells);
+        }
+        return lines;
+    }
+};
+}  // namespace
+
+TEST_F(aggregate_test_fixture, ParseAggregate) {
+    const auto statement = parse_query_statement(
+        R"-(aggregate count, avg("Image Size (MB)") group by "Type" where ("DPI" > 80))-");
+    ASSERT_TRUE(statement.has_value());
+    EXPECT_EQ(statement->statement_kind, query_statement::kind::aggregate);
+    ASSERT_EQ(statement->aggregates.size(), 2);
+    EXPECT_EQ(statement->aggregates[0].fn, aggregate_fn::count);
+    EXPECT_TRUE(statement->aggregates[0].column.column_name.empty());
+    EXPECT_EQ(statement->aggregates[1].fn, aggregate_fn::avg);
+    EXPECT_EQ(statement->aggregates[1].column.column_name, "Image Size (MB)");
+    ASSERT_TRUE(statement->group_by.has_value());
+    EXPECT_EQ(statement->group_by->column_name, "Type");
+    EXPECT_EQ(statement->where.size(), 1);
+
+    EXPECT_TRUE(parse_query_statement(R"-(aggregate count)-").has_value());
+    EXPECT_FALSE(parse_query_statement(R"-(aggregate avg)-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(aggregate median("DPI"))-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(aggregate count group "Type")-").has_value());
+}
+
+TEST_F(aggregate_test_fixture, AggregateAllRows) {
+    const table t = make_sample_table();
+    EXPECT_EQ(aggregate(t, R"-(aggregate count, sum("DPI"), min("Image Size (MB)"), count("Continent"))-"),
+              (vector<string>{
+                  "count,sum(DPI),min(Image Size (MB)),count(Continent)",
+                  "5,2040,5.6,2"}));
+
+    // Nothing matched: one row, with nothing to take the minimum of.
+    EXPECT_EQ(aggregate(t, R"-(aggregate count, min("DPI") where ("DPI" > 5000))-"),
+              (vector<string>{"count,min(DPI)", "0,"}));
+}
+
+TEST_F(aggregate_test_fixture, AggregateByGroup) {
+    const table t = make_sample_table();
+    EXPECT_EQ(aggregate(t, R"-(aggregate count, avg("Image Size (MB)"), max("DPI") group by "Type")-"),
+              (vector<string>{"Type,count,avg(Image Size (MB)),max(DPI)",
+                              "jpeg,2,16,600", "png,2,9.425,96",
+                              "tiff,1,30.6,1200"}));
+
+    // Rows without a value form the last group.
+    EXPECT_EQ(aggregate(t, R"-(aggregate count group by "Favorite")-"),
+              (vector<string>{"Favorite,count", "1,2", ",3"}));
+
+    EXPECT_EQ(aggregate(t, R"-(aggregate count group by "DPI" where ("Type" != tiff))-"),
+              (vector<string>{"DPI,count", "72,2", "96,1", "600,1"}));
+}
+
+TEST_F(aggregate_test_fixture, ParallelAggregateMatchesSequential) {
+    vector<string> lines{"Id,Score,Ratio,Flag"};
+    for (size_t i = 0; i < 3 * morsel_rows; ++i) {
+        lines.push_back(std::format("{},{},{}.{},{}", i * 100, (i * 37) % 101,
+                                    i % 7, i % 10, i % 3 == 0 ? "Yes" : "No"));
+    }
+    auto input_ = parse_lines(lines);
+    ASSERT_TRUE(input_.has_value());
+    const table t(*input_);
+
+    scheduler sched{3};
+    for (const char* line : {
+             // Score has a narrow range, so its groups are an array; Ratio
+             // and the widely spread Id are hashed.
+             R"-(aggregate count, sum("Ratio") group by "Score")-",
+             R"-(aggregate count, min("Score"), max("Id") group by "Ratio")-",
+             R"-(aggregate count, avg("Score") group by "Id" where ("Id" < 20000))-",
+             R"-(aggregate count, sum("Id") group by "Flag" where ("Score" > 50))-",
+         }) {
+        const auto sequential = aggregate(t, line);
+        EXPECT_EQ(aggregate(t, line, &sched), sequential) << line;
+    }
+
+    const auto by_score =
+        aggregate(t, R"-(aggregate count group by "Score")-", &sched);
+    EXPECT_EQ(by_score.size(), 1 + 101);
+}
+
+TEST_F(aggregate_test_fixture, AggregateErrors) {
+    const table t = make_sample_table();
+    auto error_kind = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = aggregate_plan::make(t, *statement);
+        EXPECT_FALSE(plan.has_value());
+        return plan ? plan_error::kind::unsupported : plan.error().error_kind;
+    };
+    EXPECT_EQ(error_kind(R"-(aggregate avg("Type"))-"),
+              plan_error::kind::wrong_operator);
+    EXPECT_EQ(error_kind(R"-(aggregate count group by "User Tags")-"),
+              plan_error::kind::unsupported);
+    EXPECT_EQ(error_kind(R"-(aggregate max("Flavour"))-"),
+              plan_error::kind::unknown_column);
+}
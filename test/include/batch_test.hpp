@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "bitmap.hpp"
+#include "command_line.hpp"
+#include "google_test_fixture.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct batch_test_fixture : google_test_fixture {
+    /// @brief Reads a whole file.
+    vector<string> read_lines(const std::filesystem::path& path) {
+        std::ifstream in{path};
+        vector<string> lines{};
+        for (string line; std::getline(in, line);) lines.push_back(line);
+        return lines;
+    }
+};
+}  // namespace
+
+TEST_F(batch_test_fixture, SharedClauses) {
+    const table t = make_sample_table();
+    const query_batch batch = query_batch::make(
+        t, {"# Nightly searches", R"-(query ("Type" = png))-", "  ",
+            R"-(query ("Type" = png) && ("DPI" > 80))-",
+            R"-(select "Filename" where ("DPI" > 80) && ("Type" = png))-"});
+    EXPECT_TRUE(batch.problems().empty());
+    ASSERT_EQ(batch.queries().size(), 3);
+    EXPECT_EQ(batch.queries()[1].number, 2);
+    EXPECT_EQ(batch.queries()[1].line_number, 4);
+    EXPECT_EQ(batch.clause_uses(), 5);
+    EXPECT_EQ(batch.clauses().size(), 2);
+    EXPECT_EQ(batch.queries()[2].columns.columns().size(), 1);
+}
+
+TEST_F(batch_test_fixture, ExecuteMatchesEachPlan) {
+    // Several morsels, the last one partial.
+    const table t = make_numbered_table(3 * morsel_rows + 100);
+    const vector<string> lines{
+        R"-(query ("Score" > 50) && ("Flag" = Yes))-",
+        R"-(query ("Score" > 50) && ("Name" != name4))-",
+        R"-(query ("Score" <= 20) && ("Id" >= 10000))-",
+        R"-(select "Id" where ("Flag" = No) order by "Score" desc limit 5)-",
+        R"-(select "Name")-"};
+    const query_batch batch = query_batch::make(t, lines);
+    ASSERT_EQ(batch.queries().size(), lines.size());
+    EXPECT_EQ(batch.clauses().size(), 6);
+
+    scheduler sched{4};
+    for (scheduler* s : {static_cast<scheduler*>(nullptr), &sched}) {
+        const vector<bitmap> selections = batch.execute(s);
+        ASSERT_EQ(selections.size(), lines.size());
+        for (size_t q = 0; q < lines.size(); ++q) {
+            EXPECT_EQ(selections[q], batch.queries()[q].plan.execute())
+                << lines[q];
+        }
+    }
+}
+
+TEST_F(batch_test_fixture, Problems) {
+    const table t = make_sample_table();
+    const query_batch batch = query_batch::make(
+        t, {R"-(query ("Type" = png))-", R"-(query ("Type" = png)-",
+            R"-(count ("Type" = png))-", R"-(query ("Flavour" = sweet))-",
+            R"-(query ("DPI" > 80))-"});
+    ASSERT_EQ(batch.queries().size(), 2);
+    EXPECT_EQ(batch.queries()[1].number, 5);
+    ASSERT_EQ(batch.problems().size(), 3);
+    EXPECT_EQ(batch.problems()[0].line_number, 2);
+    EXPECT_EQ(batch.problems()[1].line_number, 3);
+    EXPECT_EQ(batch.problems()[2].line_number, 4);
+}
+
+TEST_F(batch_test_fixture, RunBatchWritesFiles) {
+    namespace fs = std::filesystem;
+    const table t = make_sample_table();
+    const fs::path dir = fs::temp_directory_path() / "dimroom_batch_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const fs::path queries = dir / "queries.txt";
+    {
+        std::ofstream out{queries};
+        out << R"-(select "Filename", "DPI" where ("Type" = png))-" << '\n'
+            << R"-(query ("Flavour" = sweet))-" << '\n'
+            << R"-(select "Filename" where ("DPI" > 100) order by "DPI")-"
+            << '\n';
+    }
+
+    const command_line cl{};
+    const fs::path results = dir / "results";
+    EXPECT_EQ(cl.run_batch(t, queries.string(), results.string()),
+              EXIT_FAILURE);
+    EXPECT_EQ(read_lines(results / "query-001.csv"),
+              (vector<string>{"Filename,DPI", "Iceland.png,72",
+                              "Italy.png,96"}));
+    EXPECT_FALSE(fs::exists(results / "query-002.csv"));
+    EXPECT_EQ(read_lines(results / "query-003.csv"),
+              (vector<string>{"Filename", "Japan.jpeg", "Calgary.tif"}));
+    fs::remove_all(dir);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "catalog_files.hpp"
+#include "google_test_fixture.hpp"
+#include "live_table.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+namespace fs = std::filesystem;
+
+struct catalog_files_test_fixture : google_test_fixture {
+    const fs::path dir =
+        fs::temp_directory_path() / "dimroom_catalog_files_test";
+
+    void SetUp() override {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    /// @brief Writes lines to a file in dir.
+    /// @return The file's path.
+    string write_file(const string& name, const vector<string>& lines) {
+        const string path = (dir / name).string();
+        std::ofstream out{path};
+        for (const string& line : lines) out << line << '\n';
+        return path;
+    }
+
+    /// @brief The index of a table's column.
+    static size_t column(const table& t, const string& name) {
+        for (size_t c = 0; c < t.header_fields_.size(); ++c) {
+            if (t.header_fields_[c].text == name) return c;
+        }
+        return t.header_fields_.size();
+    }
+
+    /// @brief A cell's value as text, or "" if it is empty.
+    static string text(const table& t, size_t r, const string& name) {
+        const data_cell& cell = t.rows_[r][column(t, name)];
+        return cell.value ? cell_value_types_value_as_string(*cell.value) : "";
+    }
+};
+}  // namespace
+
+TEST_F(catalog_files_test_fixture, ExpandCatalogPaths) {
+    const string b = write_file("b.CSV", {"Filename"});
+    const string a = write_file("a.csv", {"Filename"});
+    const string notes = write_file("notes.txt", {"Filename"});
+    const string folder = dir.string();
+
+    EXPECT_EQ(expand_catalog_paths({folder}), (vector<string>{a, b}));
+    EXPECT_EQ(expand_catalog_paths({(dir / "*.txt").string(), a}),
+              (vector<string>{notes, a}));
+    EXPECT_EQ(expand_catalog_paths({(dir / "?.*").string()}),
+              (vector<string>{a, b}));
+    EXPECT_EQ(expand_catalog_paths({"missing.csv"}),
+              (vector<string>{"missing.csv"}));
+    EXPECT_FALSE(
+        expand_catalog_paths({(dir / "*.jpg").string()}).has_value());
+
+    EXPECT_TRUE(names_one_file({a}));
+    EXPECT_FALSE(names_one_file({folder}));
+    EXPECT_FALSE(names_one_file({(dir / "*.csv").string()}));
+    EXPECT_FALSE(names_one_file({a, b}));
+}
+
+TEST_F(catalog_files_test_fixture, ReadCatalogFiles) {
+    // "Bit color" is empty in the first file, and holds numbers in the
+    // second, whose columns are in another order and are fewer.
+    const string first =
+        write_file("2023.csv", {sample_csv_rows[0], sample_csv_rows[1],
+                                sample_csv_rows[2]});
+    const string second = write_file(
+        "2024.csv", {"Bit color,Filename,Favorite", "24,Kyoto.jpg,Yes"});
+
+    vector<file_load> loads{};
+    const auto t = read_catalog_files({first, second}, loads);
+    ASSERT_TRUE(t.has_value());
+    ASSERT_EQ(loads.size(), 2);
+    EXPECT_EQ(loads[0].filename, first);
+    EXPECT_EQ(loads[0].rows, 2);
+    EXPECT_EQ(loads[1].rows, 1);
+
+    ASSERT_EQ(t->header_fields_.size(), 14);
+    EXPECT_EQ(t->header_fields_.back().text, source_column_name);
+    EXPECT_EQ(t->header_fields_[column(*t, "Bit color")].data_type,
+              e_cell_data_type::integer);
+    EXPECT_EQ(t->header_fields_[column(*t, "DPI")].data_type,
+              e_cell_data_type::integer);
+
+    ASSERT_EQ(t->rows_.size(), 3);
+    EXPECT_EQ(text(*t, 0, "Filename"), "Iceland.png");
+    EXPECT_EQ(text(*t, 0, string{source_column_name}), first);
+    EXPECT_EQ(text(*t, 2, "Filename"), "Kyoto.jpg");
+    EXPECT_EQ(text(*t, 2, "Bit color"), "24");
+    EXPECT_EQ(text(*t, 2, "DPI"), "");
+    EXPECT_EQ(text(*t, 2, string{source_column_name}), second);
+    EXPECT_EQ(t->columns().column_count(), 14);
+}
+
+TEST_F(catalog_files_test_fixture, ReadCatalogFilesTypeConflict) {
+    const string first =
+        write_file("2023.csv", {sample_csv_rows[0], sample_csv_rows[1],
+                                sample_csv_rows[2]});
+    const string second =
+        write_file("2024.csv", {"Filename,DPI", "Kyoto.jpg,high"});
+    vector<file_load> loads{};
+    EXPECT_FALSE(read_catalog_files({first, second}, loads).has_value());
+    EXPECT_FALSE(read_catalog_files({first, (dir / "missing.csv").string()},
+                                    loads)
+                     .has_value());
+}
+
+TEST_F(catalog_files_test_fixture, ReloadCatalogDirectory) {
+    write_file("2023.csv",
+               {sample_csv_rows[0], sample_csv_rows[1], sample_csv_rows[2]});
+    live_table tables{vector<string>{dir.string()}, table{}};
+    const auto loaded = tables.reload();
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->rows, 2);
+    EXPECT_EQ(loaded->files.size(), 1);
+
+    // A file added to the directory is read by the next reload.
+    write_file("2024.csv", {sample_csv_rows[0], sample_csv_rows[5]});
+    const auto again = tables.reload();
+    ASSERT_TRUE(again.has_value());
+    EXPECT_EQ(again->rows, 3);
+    EXPECT_EQ(again->files.size(), 2);
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 3);
+}
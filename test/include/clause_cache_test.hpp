@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "bitmap.hpp"
+#include "clause_cache.hpp"
+#include "google_test_fixture.hpp"
+#include "predicate.hpp"
+
+namespace {
+using std::string;
+using namespace jt;
+
+struct clause_cache_test_fixture : google_test_fixture {
+    static std::shared_ptr<const bitmap> selection(size_t row) {
+        auto result = std::make_shared<bitmap>(100000);
+        result->set(row);
+        return result;
+    }
+};
+}  // namespace
+
+TEST_F(clause_cache_test_fixture, FindWhatWasInserted) {
+    clause_cache cache{};
+    const clause_key key{2, comparison_op::greater, "x"};
+    EXPECT_EQ(cache.find(1, key), nullptr);
+    cache.insert(1, key, selection(7));
+    const auto hit = cache.find(1, key);
+    ASSERT_NE(hit, nullptr);
+    EXPECT_TRUE(hit->test(7));
+    EXPECT_EQ(cache.find(1, clause_key{2, comparison_op::less, "x"}), nullptr);
+    EXPECT_EQ(cache.stats().hits, 1);
+    EXPECT_EQ(cache.stats().misses, 2);
+}
+
+TEST_F(clause_cache_test_fixture, NewGenerationEmptiesCache) {
+    clause_cache cache{};
+    const clause_key key{0, comparison_op::equal_to, "a"};
+    cache.insert(1, key, selection(1));
+    EXPECT_EQ(cache.find(2, key), nullptr);
+    EXPECT_EQ(cache.stats().entries, 0);
+}
+
+TEST_F(clause_cache_test_fixture, LeastRecentlyUsedIsDropped) {
+    // Room for two results, but not three.
+    const size_t one = selection(0)->word_count() * sizeof(bitmap::word_t);
+    clause_cache cache{2 * one + 2 * 256};
+    const clause_key a{0, comparison_op::equal_to, "a"};
+    const clause_key b{0, comparison_op::equal_to, "b"};
+    const clause_key c{0, comparison_op::equal_to, "c"};
+    cache.insert(1, a, selection(1));
+    cache.insert(1, b, selection(2));
+    EXPECT_NE(cache.find(1, a), nullptr);  // a is now the most recent
+    cache.insert(1, c, selection(3));
+    EXPECT_NE(cache.find(1, a), nullptr);
+    EXPECT_EQ(cache.find(1, b), nullptr);
+    EXPECT_NE(cache.find(1, c), nullptr);
+
+    cache.set_budget(0);
+    EXPECT_EQ(cache.stats().entries, 0);
+    cache.insert(1, a, selection(1));
+    EXPECT_EQ(cache.find(1, a), nullptr);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "column_store.hpp"
+#include "google_test_fixture.hpp"
+#include "query.hpp"
+#include "simd_kernels.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct column_store_test_fixture : google_test_fixture {};
+}  // namespace
+
+TEST_F(column_store_test_fixture, BitmapSetCountIds) {
+    bitmap bm(130);
+    bm.set(0);
+    bm.set(64);
+    bm.set(129);
+    EXPECT_EQ(bm.count(), 3);
+    EXPECT_EQ(bm.to_ids(), (vector<std::uint32_t>{0, 64, 129}));
+    bm.flip();
+    EXPECT_EQ(bm.count(), 127);
+    EXPECT_FALSE(bm.test(64));
+}
+
+TEST_F(column_store_test_fixture, KernelsScalarMatchesAvx2) {
+    vector<std::int32_t> ints;
+    vector<float> floats;
+    for (int i = 0; i < 1000; ++i) {
+        ints.push_back((i * 37) % 101 - 50);
+        floats.push_back(static_cast<float>((i * 37) % 101 - 50) / 4.0f);
+    }
+    const comparison_op ops[] = {
+        comparison_op::equal_to, comparison_op::not_equal_to,
+        comparison_op::less,     comparison_op::less_equal,
+        comparison_op::greater,  comparison_op::greater_equal};
+    for (const auto op : ops) {
+        bitmap scalar_ints(ints.size());
+        bitmap scalar_floats(floats.size());
+        set_simd_level(simd_level::scalar);
+        compare_int32(ints, op, 3, scalar_ints.words());
+        compare_float(floats, op, 0.75f, scalar_floats.words());
+
+        bitmap best_ints(ints.size());
+        bitmap best_floats(floats.size());
+        set_simd_level(detected_simd_level());
+        compare_int32(ints, op, 3, best_ints.words());
+        compare_float(floats, op, 0.75f, best_floats.words());
+
+        EXPECT_EQ(scalar_ints, best_ints);
+        EXPECT_EQ(scalar_floats, best_floats);
+    }
+}
+
+TEST_F(column_store_test_fixture, IntegerSelect) {
+    table test_table = make_sample_table();
+    query q(test_table, "Image X");
+    const bitmap result = q.integer_select(600);
+    EXPECT_EQ(result.count(), 4);
+    EXPECT_FALSE(result.test(4));
+}
+
+TEST_F(column_store_test_fixture, FloatingSelectIsClose) {
+    table test_table = make_sample_table();
+    query q(test_table, "Image Size (MB)");
+    const bitmap result = q.floating_select(26.4f);
+    EXPECT_EQ(result.to_ids(), (vector<std::uint32_t>{2}));
+}
+
+TEST_F(column_store_test_fixture, BooleanSelectEmptyCellsAreFalse) {
+    table test_table = make_sample_table();
+    query q(test_table, "Favorite", query::comparison::not_equal_to);
+    const bitmap result = q.boolean_select(true);
+    EXPECT_EQ(result.to_ids(), (vector<std::uint32_t>{0, 2, 4}));
+}
+
+TEST_F(column_store_test_fixture, IntegerSelectNotEqualIncludesEmptyCells) {
+    table test_table = make_sample_table();
+    query q(test_table, "Bit color", query::comparison::not_equal_to);
+    const bitmap result = q.integer_select(32);
+    EXPECT_EQ(result.to_ids(), (vector<std::uint32_t>{0, 1, 2, 4}));
+}
+
+TEST_F(column_store_test_fixture, IndexLookupMatchesScan) {
+    const table test_table = make_sample_table();
+    const column_store& cs = test_table.columns();
+    const size_t dpi = *test_table.index_for_column_name("DPI");
+    const size_t filename = *test_table.index_for_column_name("Filename");
+    const auto* ints = cs.get_if<integer_column>(dpi);
+    const auto* int_idx = cs.get_index_if<sorted_index<std::int32_t>>(dpi);
+    const auto* text = cs.get_if<text_column>(filename);
+    const auto* text_idx = cs.get_index_if<posting_lists>(filename);
+    ASSERT_NE(ints, nullptr);
+    ASSERT_NE(int_idx, nullptr);
+    ASSERT_NE(text, nullptr);
+    ASSERT_NE(text_idx, nullptr);
+
+    const comparison_op ops[] = {
+        comparison_op::equal_to, comparison_op::not_equal_to,
+        comparison_op::less,     comparison_op::less_equal,
+        comparison_op::greater,  comparison_op::greater_equal};
+    for (const auto op : ops) {
+        for (const int v : {0, 72, 96, 100, 1200, 5000}) {
+            EXPECT_EQ(index_lookup(*ints, *int_idx, op, v),
+                      select_integer(*ints, op, v));
+        }
+        for (const string v : {"", "Italy.png", "Japan", "Zurich.gif"}) {
+            EXPECT_EQ(index_lookup(*text, *text_idx, op, v),
+                      select_text(*text, op, v));
+        }
+    }
+}
+
+TEST_F(column_store_test_fixture, ColumnStatistics) {
+    const table test_table = make_sample_table();
+    const column_store& cs = test_table.columns();
+    const column_stats& dpi =
+        cs.stats(*test_table.index_for_column_name("DPI"));
+    EXPECT_EQ(dpi.row_count, 5);
+    EXPECT_EQ(dpi.present_count, 5);
+    EXPECT_EQ(dpi.distinct_count, 4);
+    ASSERT_TRUE(dpi.values_histogram.has_value());
+    EXPECT_DOUBLE_EQ(dpi.values_histogram->estimate(comparison_op::equal_to,
+                                                    72.0),
+                     2.0);
+    EXPECT_DOUBLE_EQ(dpi.values_histogram->estimate(
+                         comparison_op::greater_equal, 1200.0),
+                     1.0);
+
+    const column_stats& coords =
+        cs.stats(*test_table.index_for_column_name("(Center) Coordinate"));
+    EXPECT_EQ(coords.present_count, 3);
+    ASSERT_TRUE(coords.bounds.has_value());
+    EXPECT_FLOAT_EQ(coords.bounds->latitude_min, 36.0f);
+}
+
+TEST_F(column_store_test_fixture, SelectOnlyExaminesCandidates) {
+    const table test_table = make_sample_table();
+    const column_store& cs = test_table.columns();
+    const auto* col =
+        cs.get_if<integer_column>(*test_table.index_for_column_name("DPI"));
+    ASSERT_NE(col, nullptr);
+    const bitmap candidates =
+        bitmap::from_ids(5, vector<std::uint32_t>{1, 2, 4});
+    const bitmap result =
+        select_integer(*col, comparison_op::less, 100, &candidates);
+    EXPECT_EQ(result.to_ids(), (vector<std::uint32_t>{1, 4}));
+}
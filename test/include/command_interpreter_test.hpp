@@ -32,3 +32,65 @@ TEST_F(command_interpreter_fixture, GetFilenameGetCSVFilenameString) {
     const auto filename = *ofilename;
     EXPECT_TRUE(filename == argv[1]);
 }
+
+TEST_F(command_interpreter_fixture, ParseOptions) {
+    command_line cli{};
+    const auto options =
+        cli.parse_options({"dimroom", "--threads", "6", "./data/sample.csv"});
+    ASSERT_TRUE(options.has_value());
+    EXPECT_EQ(options->threads, 6);
+    EXPECT_EQ(options->csv_filename, "./data/sample.csv");
+
+    const auto defaults = cli.parse_options({"dimroom", "./data/sample.csv"});
+    ASSERT_TRUE(defaults.has_value());
+    EXPECT_EQ(defaults->threads, 0);
+
+    EXPECT_FALSE(cli.parse_options({"dimroom", "--threads"}).has_value());
+    EXPECT_FALSE(cli.parse_options({"dimroom", "--threads", "many", "x.csv"})
+                     .has_value());
+    EXPECT_FALSE(cli.parse_options({"dimroom", "--fast", "x.csv"}).has_value());
+
+    const auto jsonl =
+        cli.parse_options({"dimroom", "--format", "JSONL", "x.csv"});
+    ASSERT_TRUE(jsonl.has_value());
+    EXPECT_EQ(jsonl->format, output_format::jsonl);
+    EXPECT_EQ(defaults->format, output_format::csv);
+    EXPECT_FALSE(
+        cli.parse_options({"dimroom", "--format", "xml", "x.csv"}).has_value());
+    EXPECT_FALSE(cli.parse_options({"dimroom", "--format"}).has_value());
+
+    const auto paged = cli.parse_options({"dimroom", "--page", "20", "x.csv"});
+    ASSERT_TRUE(paged.has_value());
+    EXPECT_EQ(paged->page_rows, 20);
+    EXPECT_EQ(defaults->page_rows, 0);
+    EXPECT_FALSE(
+        cli.parse_options({"dimroom", "--page", "some", "x.csv"}).has_value());
+
+    const auto batch = cli.parse_options(
+        {"dimroom", "x.csv", "--batch", "queries.txt", "--out", "results"});
+    ASSERT_TRUE(batch.has_value());
+    EXPECT_EQ(batch->csv_filename, "x.csv");
+    EXPECT_EQ(batch->csv_filenames, vector<string>{"x.csv"});
+    EXPECT_EQ(batch->batch_filename, "queries.txt");
+    EXPECT_EQ(batch->out_directory, "results");
+    EXPECT_EQ(defaults->out_directory, ".");
+    EXPECT_FALSE(cli.parse_options({"dimroom", "x.csv", "--out"}).has_value());
+
+    const auto serve = cli.parse_options(
+        {"dimroom", "--serve", "/run/dimroom.sock", "x.csv"});
+    ASSERT_TRUE(serve.has_value());
+    EXPECT_EQ(serve->serve_socket, "/run/dimroom.sock");
+    EXPECT_TRUE(defaults->serve_socket.empty());
+
+    const auto several =
+        cli.parse_options({"dimroom", "2023.csv", "--threads", "2", "2024/"});
+    ASSERT_TRUE(several.has_value());
+    EXPECT_EQ(several->csv_filename, "2023.csv");
+    EXPECT_EQ(several->csv_filenames,
+              (vector<string>{"2023.csv", "2024/"}));
+
+    const auto scan = cli.parse_options({"dimroom", "--scan", "Pictures/"});
+    ASSERT_TRUE(scan.has_value());
+    EXPECT_EQ(scan->scan_directory, "Pictures/");
+    EXPECT_TRUE(scan->csv_filenames.empty());
+}
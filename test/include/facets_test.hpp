@@ -0,0 +1,170 @@
+#pragma once
+
+#include <format>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "facets.hpp"
+#include "google_test_fixture.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct facets_test_fixture : google_test_fixture {
+    /// @brief Runs a facets statement; returns one line per column, such as
+    /// "Type: jpeg 2, png 2 / 3 distinct, 0 missing".
+    vector<string> facets(const table& t, const string& line,
+                          scheduler* sched = nullptr) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value()) << line;
+        if (!statement) return {};
+        const auto plan = query_plan::make(t, *statement);
+        const auto facets = facet_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value() && facets.has_value()) << line;
+        if (!plan || !facets) return {};
+        const facet_result result = facets->run(plan->execute(), sched);
+
+        vector<string> lines{};
+        for (const facet& f : result.facets) {
+            string counts{};
+            for (const facet_count& c : f.top) {
+                counts.append(counts.empty() ? "" : ", ")
+                    .append(std::format("{} {}", c.value, c.rows));
+            }
+            lines.push_back(std::format("{}: {} / {} distinct, {} missing",
+                                        f.column_name, counts, f.distinct,
+                                        f.missing));
+        }
+        return lines;
+    }
+};
+}  // namespace
+
+TEST_F(facets_test_fixture, ParseFacets) {
+    const auto statement = parse_query_statement(
+        R"-(facets ("DPI" > 80) by "Type", "User Tags" top 3)-");
+    ASSERT_TRUE(statement.has_value());
+    EXPECT_EQ(statement->statement_kind, query_statement::kind::facets);
+    EXPECT_EQ(statement->where.size(), 1);
+    ASSERT_EQ(statement->facet_columns.size(), 2);
+    EXPECT_EQ(statement->facet_columns[0].column_name, "Type");
+    EXPECT_EQ(statement->facet_columns[1].column_name, "User Tags");
+    EXPECT_EQ(statement->limit, 3);
+
+    const auto all_columns = parse_query_statement(R"-(facets ("DPI" > 80))-");
+    ASSERT_TRUE(all_columns.has_value());
+    EXPECT_TRUE(all_columns->facet_columns.empty());
+    EXPECT_FALSE(all_columns->limit.has_value());
+
+    EXPECT_FALSE(
+        parse_query_statement(R"-(facets ("DPI" > 80) by)-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(facets ("DPI" > 80) by "Type",)-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(facets ("DPI" > 80) top)-").has_value());
+}
+
+TEST_F(facets_test_fixture, FacetCounts) {
+    const table t = make_sample_table();
+    EXPECT_EQ(facets(t, R"-(facets ("DPI" > 0) by "Type", "User Tags", "Favorite")-"),
+              (vector<string>{
+                  "Type: jpeg 2, png 2, tiff 1 / 3 distinct, 0 missing",
+                  "User Tags: Dusk 2, Fog 1, Johnson 1, Mt Fuji 1, Urban 1, "
+                  "Volcano 1 / 6 distinct, 2 missing",
+                  "Favorite: 1 2 / 1 distinct, 3 missing"}));
+
+    // Only the most common values are returned, ties in value order.
+    EXPECT_EQ(facets(t, R"-(facets ("DPI" > 0) by "User Tags", "Type" top 2)-"),
+              (vector<string>{
+                  "User Tags: Dusk 2, Fog 1 / 6 distinct, 2 missing",
+                  "Type: jpeg 2, png 2 / 3 distinct, 0 missing"}));
+
+    EXPECT_EQ(facets(t, R"-(facets ("Type" = png) by "Type", "Continent")-"),
+              (vector<string>{"Type: png 2 / 1 distinct, 0 missing",
+                              "Continent: Europe 1 / 1 distinct, 1 missing"}));
+
+    // With no columns named, every text, boolean and tags column is counted.
+    EXPECT_EQ(facets(t, R"-(facets ("DPI" > 5000))-").size(), 7);
+}
+
+TEST_F(facets_test_fixture, ParallelFacetsMatchSequential) {
+    vector<string> lines{"Id,Kind,Flag,Tags"};
+    for (size_t i = 0; i < 3 * morsel_rows; ++i) {
+        lines.push_back(std::format(
+            "{},k{},{},\"\"\"t{}, u{}\"\"\"", i, (i * 37) % 101,
+            i % 3 == 0 ? "Yes" : (i % 3 == 1 ? "No" : ""), i % 5, i % 11));
+    }
+    auto input_ = parse_lines(lines);
+    ASSERT_TRUE(input_.has_value());
+    const table t(*input_);
+
+    scheduler sched{3};
+    for (const char* line : {
+             R"-(facets ("Id" >= 0) by "Kind", "Flag", "Tags" top 200)-",
+             R"-(facets ("Id" < 20000) by "Tags", "Kind" top 4)-",
+             R"-(facets ("Flag" = Yes))-",
+         }) {
+        const auto sequential = facets(t, line);
+        EXPECT_FALSE(sequential.empty()) << line;
+        EXPECT_EQ(facets(t, line, &sched), sequential) << line;
+    }
+}
+
+TEST_F(facets_test_fixture, FacetCache) {
+    const table t = make_sample_table();
+    const auto first = parse_query_statement(
+        R"-(facets ("DPI" > 80) && ("Type" != tiff) by "Type")-");
+    const auto reordered = parse_query_statement(
+        R"-(facets ("Type" != tiff) && ("DPI" > 80) by "Type")-");
+    const auto other_columns = parse_query_statement(
+        R"-(facets ("DPI" > 80) && ("Type" != tiff) by "Continent")-");
+    ASSERT_TRUE(first && reordered && other_columns);
+
+    auto key_for = [&t](const query_statement& statement) {
+        const auto plan = query_plan::make(t, statement);
+        const auto facets = facet_plan::make(t, statement);
+        EXPECT_TRUE(plan && facets);
+        return facets->cache_key(*plan);
+    };
+    const string key = key_for(*first);
+    EXPECT_EQ(key_for(*reordered), key);
+    EXPECT_NE(key_for(*other_columns), key);
+
+    facet_cache cache{2};
+    EXPECT_EQ(cache.find(1, key), nullptr);
+    cache.insert(1, key, facet_result{4});
+    ASSERT_NE(cache.find(1, key), nullptr);
+    EXPECT_EQ(cache.find(1, key)->rows, 4);
+
+    cache.insert(1, "b", facet_result{});
+    cache.insert(1, "c", facet_result{});
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.find(1, key), nullptr);
+
+    // A new generation of the data empties the cache.
+    EXPECT_EQ(cache.find(2, "c"), nullptr);
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(facets_test_fixture, FacetErrors) {
+    const table t = make_sample_table();
+    auto error_kind = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = facet_plan::make(t, *statement);
+        EXPECT_FALSE(plan.has_value());
+        return plan ? plan_error::kind::wrong_operator
+                    : plan.error().error_kind;
+    };
+    EXPECT_EQ(error_kind(R"-(facets ("DPI" > 0) by "DPI")-"),
+              plan_error::kind::unsupported);
+    EXPECT_EQ(error_kind(R"-(facets ("DPI" > 0) by "Type", "Flavour")-"),
+              plan_error::kind::unknown_column);
+}
@@ -5,12 +5,16 @@
  */
 
 #include <cfloat>
+#include <cstddef>
+#include <format>
 #include <ranges>
 #include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "dimroomConfig.h"
+#include "parser.hpp"
+#include "table.hpp"
 
 namespace {
     using std::string;
@@ -97,5 +101,29 @@ struct google_test_fixture : testing::Test {
         R"(Calgary.tif,tiff,30.6,600,800,1200,"51.05011, -114.08529",Yes,,32,Y,Flames,"""Urban, Dusk""")",
         R"(Edmonton.jpg,jpeg,5.6,900,400,72,"53.55014, -113.46871",,,,,Oilers,)"};
 
+    /// @brief The table that sample_csv_rows parse to.
+    jt::table make_sample_table() const {
+        auto input_ = jt::parse_lines(sample_csv_rows);
+        EXPECT_TRUE(input_.has_value());
+        const jt::parser::header_and_data input = *input_;
+        return jt::table(
+            input.header_fields,
+            jt::data_cell::make_all_data_cells(input.all_data_fields));
+    }
+
+    /// @brief A table of generated rows, with integer, floating point,
+    /// boolean and text columns, as long as a test needs.
+    jt::table make_numbered_table(std::size_t rows) const {
+        vector<string> lines{"Id,Score,Ratio,Flag,Name"};
+        for (std::size_t i = 0; i < rows; ++i) {
+            lines.push_back(std::format("{},{},{}.{},{},name{}", i,
+                                        (i * 37) % 101, i % 7, i % 10,
+                                        i % 3 == 0 ? "Yes" : "No", i % 13));
+        }
+        auto input_ = jt::parse_lines(lines);
+        EXPECT_TRUE(input_.has_value());
+        return jt::table(*input_);
+    }
+
     const string csv_input_file{dimroom_PROJECT_HOME "/test/data/sample.csv"};
 };
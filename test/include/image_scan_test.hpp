@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "image_scan.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+namespace fs = std::filesystem;
+
+struct image_scan_test_fixture : google_test_fixture {
+    using bytes = vector<unsigned char>;
+
+    const fs::path dir = fs::temp_directory_path() / "dimroom_image_scan_test";
+
+    void SetUp() override {
+        fs::remove_all(dir);
+        fs::create_directories(dir / "2024");
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    /// @brief Writes an unsigned number at an offset, growing b to hold it.
+    static void put(bytes& b, size_t at, std::uint32_t value, size_t size,
+                    bool big_endian) {
+        if (b.size() < at + size) b.resize(at + size);
+        for (size_t i = 0; i < size; ++i) {
+            const size_t shift = 8 * (big_endian ? size - 1 - i : i);
+            b[at + i] = static_cast<unsigned char>(value >> shift);
+        }
+    }
+
+    /// @brief A TIFF structure whose first IFD has a resolution of 118 dots
+    /// per centimetre, and points to an Exif IFD with the date the photo
+    /// was taken and its size, and a GPS IFD placing it in Calgary.
+    static bytes exif(bool big_endian) {
+        bytes t{};
+        put(t, 0, big_endian ? 0x4D4D : 0x4949, 2, true);
+        put(t, 2, 42, 2, big_endian);
+        put(t, 4, 8, 4, big_endian);
+        size_t at = 0;
+        auto entry = [&](std::uint32_t tag, std::uint32_t type,
+                         std::uint32_t count, std::uint32_t value) {
+            put(t, at, tag, 2, big_endian);
+            put(t, at + 2, type, 2, big_endian);
+            put(t, at + 4, count, 4, big_endian);
+            put(t, at + 8, 0, 4, big_endian);
+            put(t, at + 8, value, type == 3 ? 2 : 4, big_endian);
+            at += 12;
+        };
+        auto ifd = [&](size_t offset, std::uint32_t entries) {
+            put(t, offset, entries, 2, big_endian);
+            put(t, offset + 2 + 12 * entries, 0, 4, big_endian);
+            at = offset + 2;
+        };
+        auto text = [&](size_t offset, const char* s) {
+            t.resize(std::max(t.size(), offset + std::strlen(s) + 1));
+            std::memcpy(t.data() + offset, s, std::strlen(s) + 1);
+        };
+        auto rationals = [&](size_t offset, vector<std::uint32_t> values) {
+            for (size_t i = 0; i < values.size(); ++i) {
+                put(t, offset + 8 * i, values[i], 4, big_endian);
+                put(t, offset + 8 * i + 4, 1, 4, big_endian);
+            }
+        };
+        ifd(8, 4);
+        entry(0x011A, 5, 1, 200);
+        entry(0x0128, 3, 1, 3);
+        entry(0x8769, 4, 1, 64);
+        entry(0x8825, 4, 1, 110);
+        ifd(64, 3);
+        entry(0x9003, 2, 20, 208);
+        entry(0xA002, 3, 1, 4000);
+        entry(0xA003, 4, 1, 3000);
+        ifd(110, 4);
+        entry(1, 2, 2, 0);
+        t[at - 4] = 'N';
+        entry(2, 5, 3, 240);
+        entry(3, 2, 2, 0);
+        t[at - 4] = 'W';
+        entry(4, 5, 3, 264);
+        rationals(200, {118});
+        text(208, "2023:05:01 12:34:56");
+        rationals(240, {51, 3, 0});
+        rationals(264, {114, 5, 0});
+        return t;
+    }
+
+    /// @brief A JPEG file with a JFIF segment saying 72 dots per inch, an
+    /// Exif segment if asked for, and a frame of 1200 by 800 pixels.
+    static bytes jpeg(bool with_exif) {
+        bytes j{0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0,
+                1,    1,    1,    0,    72, 0, 72, 0, 0};
+        if (with_exif) {
+            const bytes tiff = exif(true);
+            const size_t at = j.size();
+            put(j, at, 0xFFE1, 2, true);
+            put(j, at + 2, static_cast<std::uint32_t>(tiff.size() + 8), 2,
+                true);
+            const char name[6]{'E', 'x', 'i', 'f', 0, 0};
+            j.insert(j.end(), name, name + 6);
+            j.insert(j.end(), tiff.begin(), tiff.end());
+        }
+        const bytes frame{0xFF, 0xC0, 0, 11, 8, 0x03, 0x20, 0x04, 0xB0, 1,
+                          1,    0x11, 0, 0xFF, 0xDA, 0, 2};
+        j.insert(j.end(), frame.begin(), frame.end());
+        j.resize(j.size() + 1000, 0x55);
+        return j;
+    }
+
+    /// @brief A PNG file of 1920 by 1080 pixels at 72 dots per inch.
+    static bytes png() {
+        bytes p{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        auto chunk = [&p](const char* type, const bytes& data) {
+            const size_t at = p.size();
+            put(p, at, static_cast<std::uint32_t>(data.size()), 4, true);
+            p.insert(p.end(), type, type + 4);
+            p.insert(p.end(), data.begin(), data.end());
+            p.resize(p.size() + 4);
+        };
+        bytes header{};
+        put(header, 0, 1920, 4, true);
+        put(header, 4, 1080, 4, true);
+        header.resize(13, 8);
+        chunk("IHDR", header);
+        bytes physical{};
+        put(physical, 0, 2835, 4, true);
+        put(physical, 4, 2835, 4, true);
+        physical.push_back(1);
+        chunk("pHYs", physical);
+        chunk("IDAT", bytes(20, 0));
+        chunk("IEND", {});
+        return p;
+    }
+
+    void write_file(const fs::path& path, const bytes& b) {
+        std::ofstream out{path, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(b.data()),
+                  static_cast<std::streamsize>(b.size()));
+    }
+};
+}  // namespace
+
+TEST_F(image_scan_test_fixture, ReadImageInfo) {
+    for (const bool big_endian : {false, true}) {
+        const bytes tiff = exif(big_endian);
+        const auto info = read_image_info(tiff, tiff.size());
+        ASSERT_TRUE(info.has_value());
+        EXPECT_EQ(info->type, "tiff");
+        // A TIFF file without a size in its first IFD takes the Exif one.
+        EXPECT_EQ(info->width, 4000);
+        EXPECT_EQ(info->height, 3000);
+        EXPECT_EQ(info->dpi, 300);
+        EXPECT_EQ(info->taken, "2023-05-01 12:34:56");
+        ASSERT_TRUE(info->location.has_value());
+        EXPECT_NEAR(info->location->latitude, 51.05, 1e-4);
+        EXPECT_NEAR(info->location->longitude, -114.08333, 1e-4);
+    }
+
+    // The frame's size is the image's, whatever the Exif data says.
+    const bytes with_exif = jpeg(true);
+    const auto photo = read_image_info(with_exif, with_exif.size());
+    ASSERT_TRUE(photo.has_value());
+    EXPECT_EQ(photo->type, "jpeg");
+    EXPECT_EQ(photo->width, 1200);
+    EXPECT_EQ(photo->height, 800);
+    EXPECT_EQ(photo->dpi, 300);
+    EXPECT_TRUE(photo->location.has_value());
+
+    const bytes plain = jpeg(false);
+    const auto bare = read_image_info(plain, plain.size());
+    ASSERT_TRUE(bare.has_value());
+    EXPECT_EQ(bare->width, 1200);
+    EXPECT_EQ(bare->dpi, 72);
+    EXPECT_FALSE(bare->location.has_value());
+    EXPECT_TRUE(bare->taken.empty());
+
+    const bytes picture = png();
+    const auto drawing = read_image_info(picture, picture.size());
+    ASSERT_TRUE(drawing.has_value());
+    EXPECT_EQ(drawing->type, "png");
+    EXPECT_EQ(drawing->width, 1920);
+    EXPECT_EQ(drawing->height, 1080);
+    EXPECT_EQ(drawing->dpi, 72);
+
+    const bytes text{'h', 'e', 'l', 'l', 'o'};
+    EXPECT_FALSE(read_image_info(text, text.size()).has_value());
+    // A header cut short gives what it has.
+    const auto cut = read_image_info(bytes(with_exif.begin(),
+                                           with_exif.begin() + 40),
+                                     with_exif.size());
+    ASSERT_TRUE(cut.has_value());
+    EXPECT_FALSE(cut->width.has_value());
+}
+
+TEST_F(image_scan_test_fixture, ScanImages) {
+    write_file(dir / "calgary.jpg", jpeg(true));
+    write_file(dir / "2024" / "banff.JPEG", jpeg(false));
+    write_file(dir / "2024" / "map.png", png());
+    write_file(dir / "2024" / "notes.txt", {'h', 'i'});
+    write_file(dir / "2024" / "broken.jpg", {'n', 'o'});
+
+    scan_stats stats{};
+    const auto t = scan_images(dir.string(), stats);
+    ASSERT_TRUE(t.has_value());
+    EXPECT_EQ(stats.directories, 2);
+    EXPECT_EQ(stats.files, 4);
+    EXPECT_EQ(stats.images, 3);
+
+    ASSERT_EQ(t->rows_.size(), 3);
+    ASSERT_EQ(t->header_fields_.size(), 9);
+    EXPECT_EQ(t->header_fields_[0].text, "Filename");
+    EXPECT_EQ(t->header_fields_[3].data_type, e_cell_data_type::floating);
+    EXPECT_EQ(t->header_fields_[7].text, "(Center) Coordinate");
+    EXPECT_EQ(t->header_fields_[7].data_type, e_cell_data_type::geo_coordinate);
+
+    // In order of their paths.
+    const vector<string> names{"banff.JPEG", "map.png", "calgary.jpg"};
+    for (size_t r = 0; r < names.size(); ++r) {
+        ASSERT_TRUE(t->rows_[r][0].value.has_value());
+        EXPECT_EQ(cell_value_types_value_as_string(*t->rows_[r][0].value),
+                  names[r]);
+    }
+    EXPECT_EQ(cell_value_types_value_as_string(*t->rows_[1][2].value), "png");
+    EXPECT_FALSE(t->rows_[0][7].value.has_value());
+    EXPECT_TRUE(t->rows_[2][7].value.has_value());
+    EXPECT_EQ(t->columns().column_count(), 9);
+
+    EXPECT_FALSE(scan_images((dir / "missing").string(), stats).has_value());
+}
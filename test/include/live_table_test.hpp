@@ -0,0 +1,344 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "column_store.hpp"
+#include "live_table.hpp"
+#include "table.hpp"
+#include "table_follower.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+namespace fs = std::filesystem;
+
+struct live_table_test_fixture : google_test_fixture {
+    const fs::path dir = fs::temp_directory_path() / "dimroom_live_table_test";
+    const string csv = (dir / "catalog.csv").string();
+
+    void SetUp() override {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    /// @brief Writes the header and the first rows of the sample file.
+    void write_rows(size_t rows) {
+        std::ofstream out{csv};
+        for (size_t i = 0; i <= rows; ++i) out << sample_csv_rows[i] << '\n';
+    }
+
+    /// @brief Adds text to the end of the file.
+    void append(const string& text) {
+        std::ofstream out{csv, std::ios::app};
+        out << text;
+    }
+
+    /// @brief Writes the header and the given lines.
+    void write_lines(const vector<string>& lines) {
+        std::ofstream out{csv};
+        out << sample_csv_rows[0] << '\n';
+        for (const string& line : lines) out << line << '\n';
+    }
+
+    /// @brief Checks that a table has the columns and indexes that reading
+    /// the whole file builds.
+    void expect_as_read(const table& t) {
+        const table whole = read_table();
+        const column_store& now = t.columns();
+        const column_store& all = whole.columns();
+        EXPECT_EQ(t.header_fields_, whole.header_fields_);
+        EXPECT_EQ(now.row_count(), all.row_count());
+        const size_t filename = 0, size = 2, dpi = 5, tags = 12;
+        ASSERT_NE(now.get_index_if<sorted_index<std::int32_t>>(dpi), nullptr);
+        EXPECT_EQ(now.get_index_if<sorted_index<std::int32_t>>(dpi)->order,
+                  all.get_index_if<sorted_index<std::int32_t>>(dpi)->order);
+        ASSERT_NE(now.get_index_if<sorted_index<float>>(size), nullptr);
+        EXPECT_EQ(now.get_index_if<sorted_index<float>>(size)->order,
+                  all.get_index_if<sorted_index<float>>(size)->order);
+        ASSERT_NE(now.get_if<text_column>(filename), nullptr);
+        EXPECT_EQ(now.get_if<text_column>(filename)->dictionary,
+                  all.get_if<text_column>(filename)->dictionary);
+        EXPECT_EQ(now.get_if<text_column>(filename)->codes,
+                  all.get_if<text_column>(filename)->codes);
+        for (const size_t c : {filename, tags}) {
+            ASSERT_NE(now.get_index_if<posting_lists>(c), nullptr);
+            EXPECT_EQ(now.get_index_if<posting_lists>(c)->offsets,
+                      all.get_index_if<posting_lists>(c)->offsets);
+            EXPECT_EQ(now.get_index_if<posting_lists>(c)->rows,
+                      all.get_index_if<posting_lists>(c)->rows);
+        }
+        for (size_t c = 0; c < all.column_count(); ++c) {
+            EXPECT_EQ(now.stats(c).present_count, all.stats(c).present_count);
+            EXPECT_EQ(now.stats(c).distinct_count,
+                      all.stats(c).distinct_count);
+        }
+    }
+
+    table read_table() {
+        auto loaded = table::make_table_from_file(csv);
+        EXPECT_TRUE(loaded.has_value());
+        return std::move(*loaded);
+    }
+};
+}  // namespace
+
+TEST_F(live_table_test_fixture, SnapshotOutlivesReplace) {
+    write_rows(5);
+    live_table tables{csv, read_table()};
+    const std::shared_ptr<const table> before = tables.snapshot();
+    EXPECT_EQ(before->rows_.size(), 5);
+
+    write_rows(3);
+    const std::shared_ptr<const table> old = tables.replace(read_table());
+    EXPECT_EQ(old, before);
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 3);
+    EXPECT_NE(tables.snapshot()->columns().generation(),
+              before->columns().generation());
+    // The old version is still whole.
+    EXPECT_EQ(before->rows_.size(), 5);
+    EXPECT_EQ(before->columns().row_count(), 5);
+}
+
+TEST_F(live_table_test_fixture, Reload) {
+    write_rows(2);
+    live_table tables{csv, read_table()};
+    std::weak_ptr<const table> first = tables.snapshot();
+
+    write_rows(4);
+    const auto stats = tables.reload();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_EQ(stats->rows, 4);
+    EXPECT_EQ(stats->old_readers, 0);
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 4);
+    // Nothing held the old version, so it has been freed.
+    EXPECT_TRUE(first.expired());
+
+    const std::shared_ptr<const table> held = tables.snapshot();
+    write_rows(5);
+    const auto again = tables.reload();
+    ASSERT_TRUE(again.has_value());
+    EXPECT_EQ(again->old_readers, 1);
+    EXPECT_EQ(held->rows_.size(), 4);
+    EXPECT_GE(again->peak_bytes_after, again->peak_bytes_before);
+}
+
+TEST_F(live_table_test_fixture, FailedReloadKeepsTable) {
+    write_rows(3);
+    live_table tables{csv, read_table()};
+    const auto before = tables.snapshot();
+    fs::remove(csv);
+    EXPECT_FALSE(tables.reload().has_value());
+    EXPECT_EQ(tables.snapshot(), before);
+}
+
+TEST_F(live_table_test_fixture, ReadersDuringReloads) {
+    write_rows(5);
+    live_table tables{csv, read_table()};
+    std::atomic<bool> done{false};
+    std::atomic<size_t> bad{0};
+    vector<std::jthread> readers{};
+    for (size_t i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                const auto snapshot = tables.snapshot();
+                if (snapshot->rows_.size() != 5 ||
+                    snapshot->columns().row_count() != 5) {
+                    ++bad;
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < 20; ++i) {
+        EXPECT_TRUE(tables.reload().has_value());
+    }
+    done.store(true);
+    readers.clear();
+    EXPECT_EQ(bad.load(), 0);
+}
+
+TEST_F(live_table_test_fixture, CatchUp) {
+    write_rows(3);
+    live_table tables{csv, table{}};
+    ASSERT_TRUE(tables.reload().has_value());
+    const auto nothing = tables.catch_up();
+    ASSERT_TRUE(nothing.has_value());
+    EXPECT_FALSE(nothing->whole_file);
+    EXPECT_EQ(nothing->appended, 0);
+    EXPECT_EQ(nothing->rows, 3);
+
+    // The new rows only hold values the table has already, so every column
+    // is extended; the last line is not finished yet.
+    const auto before = tables.snapshot();
+    append(sample_csv_rows[2] + "\n\n" + sample_csv_rows[1]);
+    const auto stats = tables.catch_up();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_FALSE(stats->whole_file);
+    EXPECT_EQ(stats->appended, 1);
+    EXPECT_EQ(stats->rows, 4);
+    append("\n");
+    const auto finished = tables.catch_up();
+    ASSERT_TRUE(finished.has_value());
+    EXPECT_EQ(finished->appended, 1);
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 5);
+    EXPECT_EQ(before->rows_.size(), 3);
+
+    EXPECT_NE(tables.snapshot()->columns().generation(),
+              before->columns().generation());
+    // The columns and indexes are the ones reading the whole file builds.
+    expect_as_read(*tables.snapshot());
+}
+
+TEST_F(live_table_test_fixture, RowFilter) {
+    write_rows(3);
+    // Keeps every row but Italy's, the only one with a "Favorite".
+    auto keep = [](const parser::header_fields_t&,
+                   parser::all_data_fields_t& rows) {
+        std::erase_if(rows, [](const parser::data_fields_t& dfs) {
+            return dfs[0].text == "Italy.png";
+        });
+    };
+    live_table tables{csv, table{}, keep};
+    ASSERT_TRUE(tables.reload().has_value());
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 2);
+    // The columns keep the types that the whole file gives them.
+    EXPECT_EQ(tables.snapshot()->header_fields_, read_table().header_fields_);
+
+    append(sample_csv_rows[2] + "\n" + sample_csv_rows[5] + "\n");
+    const auto stats = tables.catch_up();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_FALSE(stats->whole_file);
+    EXPECT_EQ(stats->appended, 1);
+    EXPECT_EQ(stats->rows, 3);
+}
+
+TEST_F(live_table_test_fixture, CatchUpAfterUnfinishedLine) {
+    // A file whose last line has no line break keeps that line as a row.
+    write_rows(2);
+    append(sample_csv_rows[3]);
+    live_table tables{csv, table{}};
+    const auto loaded = tables.reload();
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->rows, 3);
+
+    // Finishing it, and adding another, gives the rows of the whole file.
+    append("\n" + sample_csv_rows[1] + "\n");
+    const auto stats = tables.catch_up();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_EQ(stats->rows, 4);
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 4);
+    expect_as_read(*tables.snapshot());
+}
+
+TEST_F(live_table_test_fixture, CatchUpReadsWholeFile) {
+    write_rows(3);
+    live_table tables{csv, table{}};
+    ASSERT_TRUE(tables.reload().has_value());
+
+    // "Bit color" is empty in the first rows, so a number in it changes the
+    // column's type.
+    append(sample_csv_rows[4] + "\n");
+    const auto retyped = tables.catch_up();
+    ASSERT_TRUE(retyped.has_value());
+    EXPECT_TRUE(retyped->whole_file);
+    EXPECT_EQ(retyped->rows, 4);
+    EXPECT_EQ(tables.snapshot()->header_fields_, read_table().header_fields_);
+
+    // A shorter file was rewritten.
+    write_rows(2);
+    const auto shorter = tables.catch_up();
+    ASSERT_TRUE(shorter.has_value());
+    EXPECT_TRUE(shorter->whole_file);
+    EXPECT_EQ(shorter->rows, 2);
+
+    // So is a table that reload() did not read.
+    live_table given{csv, read_table()};
+    const auto unknown = given.catch_up();
+    ASSERT_TRUE(unknown.has_value());
+    EXPECT_TRUE(unknown->whole_file);
+}
+
+TEST_F(live_table_test_fixture, FollowerAddsRows) {
+    write_rows(3);
+    live_table tables{csv, table{}};
+    ASSERT_TRUE(tables.reload().has_value());
+    table_follower follower{tables, nullptr};
+    append(sample_csv_rows[4] + "\n" + sample_csv_rows[5] + "\n");
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (tables.snapshot()->rows_.size() < 5 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    EXPECT_EQ(tables.snapshot()->rows_.size(), 5);
+}
+
+TEST_F(live_table_test_fixture, ReloadAppliesChanges) {
+    write_rows(5);
+    live_table tables{csv, table{}};
+    ASSERT_TRUE(tables.reload().has_value());
+    const auto before = tables.snapshot();
+
+    // Italy's DPI is edited, Japan is removed, and a copy of the original
+    // Italy row is added at the end.
+    string italy = sample_csv_rows[2];
+    italy.replace(italy.find(",96,"), 4, ",150,");
+    write_lines({sample_csv_rows[1], italy, sample_csv_rows[4],
+                 sample_csv_rows[5], sample_csv_rows[2]});
+    const auto stats = tables.reload();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_TRUE(stats->diffed);
+    EXPECT_EQ(stats->rows, 5);
+    EXPECT_EQ(stats->updated, 1);
+    EXPECT_EQ(stats->deleted, 1);
+    EXPECT_EQ(stats->inserted, 1);
+    EXPECT_EQ(before->rows_.size(), 5);
+    expect_as_read(*tables.snapshot());
+
+    // Nothing changed.
+    const auto same = tables.reload();
+    ASSERT_TRUE(same.has_value());
+    EXPECT_TRUE(same->diffed);
+    EXPECT_EQ(same->inserted + same->deleted + same->updated, 0);
+    expect_as_read(*tables.snapshot());
+}
+
+TEST_F(live_table_test_fixture, ReloadReadsWholeFileForNewTypes) {
+    write_rows(5);
+    live_table tables{csv, table{}};
+    ASSERT_TRUE(tables.reload().has_value());
+
+    // Calgary has the only value in "Alpha"; without it the column has no
+    // type.
+    string calgary = sample_csv_rows[4];
+    calgary.replace(calgary.find(",Y,"), 3, ",,");
+    write_lines({sample_csv_rows[1], sample_csv_rows[2], sample_csv_rows[3],
+                 calgary, sample_csv_rows[5]});
+    const auto stats = tables.reload();
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_FALSE(stats->diffed);
+    EXPECT_EQ(tables.snapshot()->header_fields_, read_table().header_fields_);
+
+    // A different header is a different file.
+    {
+        std::ofstream out{csv};
+        out << "Filename,Type\nIceland.png,png\n";
+    }
+    const auto other = tables.reload();
+    ASSERT_TRUE(other.has_value());
+    EXPECT_FALSE(other->diffed);
+    EXPECT_EQ(tables.snapshot()->header_fields_.size(), 2);
+}
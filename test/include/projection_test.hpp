@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "projection.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "result_writer.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct projection_test_fixture : google_test_fixture {
+    /// @brief Runs a select statement; returns the headings line and then
+    /// one line per row found.
+    vector<string> select(const table& t, const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value()) << line;
+        if (!statement) return {};
+        const auto plan = query_plan::make(t, *statement);
+        const auto columns = projection::make(t, statement->select_columns);
+        EXPECT_TRUE(plan.has_value() && columns.has_value()) << line;
+        if (!plan || !columns) return {};
+
+        const auto shown = plan->ordered_rows(plan->execute());
+        std::FILE* out = std::tmpfile();
+        {
+            result_writer writer(*columns, out);
+            writer.write_headings();
+            for (const auto r : shown) writer.write_row(r);
+        }
+        std::rewind(out);
+        vector<string> lines{};
+        char line_buffer[256];
+        while (std::fgets(line_buffer, sizeof line_buffer, out)) {
+            string line{line_buffer};
+            if (line.ends_with('\n')) line.pop_back();
+            lines.push_back(std::move(line));
+        }
+        std::fclose(out);
+        return lines;
+    }
+};
+}  // namespace
+
+TEST_F(projection_test_fixture, ParseSelect) {
+    const auto statement = parse_query_statement(
+        R"-(select "Filename", "DPI" where ("DPI" > 80) order by "DPI" desc limit 2)-");
+    ASSERT_TRUE(statement.has_value());
+    EXPECT_EQ(statement->statement_kind, query_statement::kind::select);
+    ASSERT_EQ(statement->select_columns.size(), 2);
+    EXPECT_EQ(statement->select_columns[0].column_name, "Filename");
+    EXPECT_EQ(statement->select_columns[1].column_name, "DPI");
+    EXPECT_EQ(statement->where.size(), 1);
+    ASSERT_TRUE(statement->order_by.has_value());
+    EXPECT_TRUE(statement->order_by->descending);
+    EXPECT_EQ(statement->limit, 2);
+
+    const auto every_row = parse_query_statement(R"-(select "Filename")-");
+    ASSERT_TRUE(every_row.has_value());
+    EXPECT_TRUE(every_row->where.empty());
+
+    EXPECT_FALSE(parse_query_statement(R"-(select)-").has_value());
+    EXPECT_FALSE(parse_query_statement(R"-(select "Filename",)-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(select "Filename" ("DPI" > 80))-").has_value());
+}
+
+TEST_F(projection_test_fixture, SelectPrintsNamedColumns) {
+    const table t = make_sample_table();
+    EXPECT_EQ(select(t, R"-(select "Filename", "DPI", "Favorite" where ("Type" = png))-"),
+              (vector<string>{"Filename,DPI,Favorite", "Iceland.png,72,",
+                              "Italy.png,96,1"}));
+
+    EXPECT_EQ(select(t, R"-(select "Image Size (MB)", "Filename" where ("DPI" > 100) order by "DPI" desc)-"),
+              (vector<string>{"Image Size (MB),Filename", "30.6,Calgary.tif",
+                              "26.4,Japan.jpeg"}));
+
+    EXPECT_EQ(select(t, R"-(select "Filename" limit 2)-"),
+              (vector<string>{"Filename", "Iceland.png", "Italy.png"}));
+}
+
+TEST_F(projection_test_fixture, SelectUnknownColumn) {
+    const table t = make_sample_table();
+    const auto statement =
+        parse_query_statement(R"-(select "Filename", "Flavour")-");
+    ASSERT_TRUE(statement.has_value());
+    const auto columns = projection::make(t, statement->select_columns);
+    ASSERT_FALSE(columns.has_value());
+    EXPECT_EQ(columns.error().error_kind, plan_error::kind::unknown_column);
+}
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "google_test_fixture.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "row_order.hpp"
+#include "table.hpp"
+#include "scheduler.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct query_plan_test_fixture : google_test_fixture {
+    /// @brief Parses, plans and runs a query; returns the matching row ids.
+    vector<std::uint32_t> run(const table& t, const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        if (!statement) return {};
+        const auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        if (!plan) return {};
+        return plan->execute().to_ids();
+    }
+};
+}  // namespace
+
+TEST_F(query_plan_test_fixture, TokenizeClause) {
+    const auto tokens = tokenize_query(R"-(query ("DPI">=96) && ("Type" png))-");
+    ASSERT_TRUE(tokens.has_value());
+    const vector<token_kind> expected{
+        token_kind::word,       token_kind::left_paren, token_kind::quoted,
+        token_kind::comparison, token_kind::word,       token_kind::right_paren,
+        token_kind::and_op,     token_kind::left_paren, token_kind::quoted,
+        token_kind::word,       token_kind::right_paren, token_kind::end};
+    ASSERT_EQ(tokens->size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ((*tokens)[i].kind, expected[i]);
+    }
+    EXPECT_EQ((*tokens)[2].text, "DPI");
+    EXPECT_EQ((*tokens)[3].text, ">=");
+}
+
+TEST_F(query_plan_test_fixture, ParseAndedClauses) {
+    const auto statement = parse_query_statement(
+        R"-(query ("Type" = "png") && ("Image Size (MB)" > 10.0))-");
+    ASSERT_TRUE(statement.has_value());
+    ASSERT_EQ(statement->where.size(), 2);
+    EXPECT_EQ(statement->where[0].column_name, "Type");
+    EXPECT_EQ(statement->where[0].op, comparison_op::equal_to);
+    EXPECT_EQ(statement->where[0].value, "png");
+    EXPECT_EQ(statement->where[1].column_name, "Image Size (MB)");
+    EXPECT_EQ(statement->where[1].op, comparison_op::greater);
+    EXPECT_EQ(statement->where[1].value, "10.0");
+}
+
+TEST_F(query_plan_test_fixture, ParseValues) {
+    const auto coord = parse_query_statement(
+        R"-(query ("(Center) Coordinate" (36° 00' N, 138° 00' E)))-");
+    ASSERT_TRUE(coord.has_value());
+    EXPECT_EQ(coord->where[0].op, comparison_op::equal_to);
+    EXPECT_EQ(coord->where[0].value, "(36° 00' N, 138° 00' E)");
+
+    const auto tags =
+        parse_query_statement(R"-(query ("User Tags" tags "Dusk", Mt Fuji))-");
+    ASSERT_TRUE(tags.has_value());
+    EXPECT_EQ(tags->where[0].op, comparison_op::tags);
+    EXPECT_EQ(tags->where[0].values, (vector<string>{"Dusk", "Mt Fuji"}));
+
+    const auto inside = parse_query_statement(
+        R"-(query ("(Center) Coordinate" inside (50.0, -115.0) (55.0, -115.0) (55.0, -113.0)))-");
+    ASSERT_TRUE(inside.has_value());
+    EXPECT_EQ(inside->where[0].op, comparison_op::inside);
+    EXPECT_EQ(inside->where[0].values.size(), 3);
+}
+
+TEST_F(query_plan_test_fixture, ParseErrors) {
+    const auto unclosed = parse_query_statement(R"-(query ("DPI" > 72)-");
+    EXPECT_FALSE(unclosed.has_value());
+
+    const auto unquoted = parse_query_statement(R"-(query (DPI > 72))-");
+    ASSERT_FALSE(unquoted.has_value());
+    EXPECT_EQ(unquoted.error().position, 7);
+
+    const auto short_polygon = parse_query_statement(
+        R"-(query ("(Center) Coordinate" inside (50.0, -115.0) (55.0, -115.0)))-");
+    EXPECT_FALSE(short_polygon.has_value());
+}
+
+TEST_F(query_plan_test_fixture, ExecuteAndedClauses) {
+    const table t = make_sample_table();
+    EXPECT_EQ(run(t, R"-(query ("Type" = jpeg) && ("DPI" > 100))-"),
+              (vector<std::uint32_t>{2}));
+    EXPECT_EQ(run(t, R"-(query ("Favorite" = Yes))-"),
+              (vector<std::uint32_t>{1, 3}));
+    EXPECT_EQ(run(t, R"-(query ("Image Size (MB)" >= 10.5))-"),
+              (vector<std::uint32_t>{1, 2, 3}));
+}
+
+TEST_F(query_plan_test_fixture, ExecuteTextComparisons) {
+    const table t = make_sample_table();
+    EXPECT_EQ(run(t, R"-(query ("Filename" < "Italy.png"))-"),
+              (vector<std::uint32_t>{0, 3, 4}));
+    EXPECT_EQ(run(t, R"-(query ("Filename" <= "Italy.png"))-"),
+              (vector<std::uint32_t>{0, 1, 3, 4}));
+    EXPECT_EQ(run(t, R"-(query ("Type" != "gif"))-"),
+              (vector<std::uint32_t>{0, 1, 2, 3, 4}));
+    EXPECT_EQ(run(t, R"-(query ("Hockey Team" = ""))-"),
+              (vector<std::uint32_t>{1, 2}));
+}
+
+TEST_F(query_plan_test_fixture, ExecuteCoordinatesAndTags) {
+    const table t = make_sample_table();
+    EXPECT_EQ(
+        run(t,
+            R"-(query ("(Center) Coordinate" inside (50.0, -115.0) (55.0, -115.0) (55.0, -113.0) (50.0, -113.0)))-"),
+        (vector<std::uint32_t>{3, 4}));
+    EXPECT_EQ(run(t, R"-(query ("(Center) Coordinate" = (51.05011, -114.08529)))-"),
+              (vector<std::uint32_t>{3}));
+    EXPECT_EQ(run(t, R"-(query ("User Tags" tags Dusk))-"),
+              (vector<std::uint32_t>{0, 3}));
+    EXPECT_EQ(run(t, R"-(query ("User Tags" = Fog, Volcano))-"),
+              (vector<std::uint32_t>{0, 2}));
+}
+
+TEST_F(query_plan_test_fixture, PlanIsReusable) {
+    const table t = make_sample_table();
+    const auto statement = parse_query_statement(R"-(query ("DPI" <= 96))-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(t, *statement);
+    ASSERT_TRUE(plan.has_value());
+    EXPECT_EQ(plan->clauses().size(), 1);
+    EXPECT_EQ(plan->clauses()[0].type, e_cell_data_type::integer);
+    const bitmap first = plan->execute();
+    EXPECT_EQ(first, plan->execute());
+    EXPECT_EQ(first.to_ids(), (vector<std::uint32_t>{0, 1, 4}));
+}
+
+TEST_F(query_plan_test_fixture, PlanErrors) {
+    const table t = make_sample_table();
+
+    const auto missing = parse_query_statement(R"-(query ("Nope" = 1))-");
+    ASSERT_TRUE(missing.has_value());
+    const auto missing_plan = query_plan::make(t, *missing);
+    ASSERT_FALSE(missing_plan.has_value());
+    EXPECT_EQ(missing_plan.error().error_kind,
+              plan_error::kind::unknown_column);
+
+    const auto bad = parse_query_statement(R"-(query ("DPI" = lots))-");
+    ASSERT_TRUE(bad.has_value());
+    const auto bad_plan = query_plan::make(t, *bad);
+    ASSERT_FALSE(bad_plan.has_value());
+    EXPECT_EQ(bad_plan.error().error_kind, plan_error::kind::bad_value);
+
+    const auto wrong = parse_query_statement(
+        R"-(query ("DPI" inside (50.0, -115.0) (55.0, -115.0) (55.0, -113.0)))-");
+    ASSERT_TRUE(wrong.has_value());
+    const auto wrong_plan = query_plan::make(t, *wrong);
+    ASSERT_FALSE(wrong_plan.has_value());
+    EXPECT_EQ(wrong_plan.error().error_kind, plan_error::kind::wrong_operator);
+}
+
+TEST_F(query_plan_test_fixture, IndexedClausesRunFirst) {
+    const table t = make_sample_table();
+    const auto statement = parse_query_statement(
+        R"-(query ("Image X" = 600) && ("Filename" = "Calgary.tif"))-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(t, *statement);
+    ASSERT_TRUE(plan.has_value());
+    ASSERT_EQ(plan->clauses().size(), 2);
+    EXPECT_EQ(plan->clauses()[0].column_name, "Filename");
+    EXPECT_TRUE(plan->clauses()[0].use_index);
+    EXPECT_DOUBLE_EQ(plan->clauses()[0].estimated_rows, 1.0);
+    EXPECT_FALSE(plan->clauses()[1].use_index);
+    EXPECT_EQ(plan->execute().to_ids(), (vector<std::uint32_t>{3}));
+}
+
+TEST_F(query_plan_test_fixture, SelectiveScansRunFirst) {
+    const table t = make_sample_table();
+    const auto statement =
+        parse_query_statement(R"-(query ("DPI" > 0) && ("Favorite" = yes))-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(t, *statement);
+    ASSERT_TRUE(plan.has_value());
+    ASSERT_EQ(plan->clauses().size(), 2);
+    EXPECT_EQ(plan->clauses()[0].column_name, "Favorite");
+    EXPECT_EQ(plan->clauses()[1].column_name, "DPI");
+    EXPECT_EQ(plan->execute().to_ids(), (vector<std::uint32_t>{1, 3}));
+}
+
+TEST_F(query_plan_test_fixture, FusedMatchesClauseAtATime) {
+    // Enough rows for several fused blocks, with a partial block at the end.
+    const table t = make_numbered_table(3 * fused_block_rows + 100);
+
+    const string queries[] = {
+        R"-(query ("Score" > 50) && ("Flag" = Yes))-",
+        R"-(query ("Score" <= 20) && ("Ratio" >= 3.5) && ("Name" != name4))-",
+        R"-(query ("Id" >= 5000) && ("Score" = 7) && ("Ratio" < 6.0) && ("Flag" = No))-",
+        R"-(query ("Name" < name3) && ("Score" != 0) && ("Id" < 12000))-",
+        R"-(query ("Score" > 200) && ("Flag" = Yes))-"};
+    for (const string& q : queries) {
+        const auto statement = parse_query_statement(q);
+        ASSERT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        ASSERT_TRUE(plan.has_value());
+        EXPECT_EQ(plan->execute(execution_mode::fused),
+                  plan->execute(execution_mode::clause_at_a_time))
+            << q;
+    }
+
+    const table sample = make_sample_table();
+    const auto statement = parse_query_statement(
+        R"-(query ("User Tags" tags Dusk, Fog) && ("Image Size (MB)" > 8.0) && ("(Center) Coordinate" != (51.05011, -114.08529)))-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(sample, *statement);
+    ASSERT_TRUE(plan.has_value());
+    EXPECT_EQ(plan->execute(execution_mode::fused).to_ids(),
+              (vector<std::uint32_t>{0, 2}));
+    EXPECT_EQ(plan->execute(execution_mode::clause_at_a_time).to_ids(),
+              (vector<std::uint32_t>{0, 2}));
+}
+
+TEST_F(query_plan_test_fixture, ParallelScanMatchesSequential) {
+    // Several morsels, the last one partial.
+    const table t = make_numbered_table(3 * morsel_rows + 1000);
+    scheduler sched{4};
+    const string queries[] = {
+        R"-(query ("Score" > 50) && ("Flag" = Yes))-",
+        R"-(query ("Score" <= 20) && ("Ratio" >= 3.5) && ("Name" != name4))-",
+        R"-(query ("Id" >= 40000) && ("Score" < 30))-"};
+    for (const string& q : queries) {
+        const auto statement = parse_query_statement(q);
+        ASSERT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        ASSERT_TRUE(plan.has_value());
+        const bitmap sequential = plan->execute(execution_mode::fused, nullptr);
+        EXPECT_EQ(plan->execute(execution_mode::fused, &sched), sequential)
+            << q;
+        EXPECT_EQ(plan->execute(execution_mode::clause_at_a_time), sequential)
+            << q;
+    }
+}
+
+TEST_F(query_plan_test_fixture, CachedClausesAreReused) {
+    const table t = make_sample_table();
+    clause_cache cache{};
+    auto run_cached = [&](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        const bitmap cached =
+            plan->execute(execution_mode::fused, nullptr, &cache);
+        EXPECT_EQ(cached, plan->execute());
+        return cached.to_ids();
+    };
+
+    EXPECT_EQ(run_cached(R"-(query ("Favorite" = Yes) && ("DPI" > 100))-"),
+              (vector<std::uint32_t>{3}));
+    EXPECT_EQ(cache.stats().misses, 2);
+    EXPECT_EQ(run_cached(R"-(query ("Favorite" = yes) && ("Type" = png))-"),
+              (vector<std::uint32_t>{1}));
+    EXPECT_EQ(cache.stats().hits, 1);
+
+    // The same tags in another order are the same clause.
+    run_cached(R"-(query ("User Tags" tags Dusk, Fog))-");
+    run_cached(R"-(query ("User Tags" tags Fog, Dusk, Fog))-");
+    EXPECT_EQ(cache.stats().hits, 2);
+
+    // A table with the same data is still a different table.
+    const table other = make_sample_table();
+    const auto statement = parse_query_statement(R"-(query ("Favorite" = Yes))-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(other, *statement);
+    ASSERT_TRUE(plan.has_value());
+    plan->execute(execution_mode::fused, nullptr, &cache);
+    EXPECT_EQ(cache.stats().hits, 2);
+}
+
+TEST_F(query_plan_test_fixture, CachedClausesShareOneScan) {
+    const table t = make_numbered_table(3 * morsel_rows + 100);
+    clause_cache cache{};
+    auto run_cached = [&](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        const bitmap cached =
+            plan->execute(execution_mode::fused, &scheduler::shared(), &cache);
+        EXPECT_EQ(cached, plan->execute()) << line;
+    };
+
+    // Scanned together, each into a complete result of its own.
+    run_cached(
+        R"-(query ("Score" > 50) && ("Ratio" < 3.5) && ("Flag" = Yes))-");
+    EXPECT_EQ(cache.stats().entries, 3);
+    const size_t hits = cache.stats().hits;
+    run_cached(R"-(query ("Flag" = Yes))-");
+    run_cached(R"-(query ("Ratio" < 3.5))-");
+    EXPECT_EQ(cache.stats().hits, hits + 2);
+
+    // The cached clause leaves few rows, so the other is only scanned over
+    // those, and is not cached.
+    run_cached(R"-(query ("Id" < 100))-");
+    EXPECT_EQ(cache.stats().entries, 4);
+    run_cached(R"-(query ("Id" < 100) && ("Score" < 20))-");
+    EXPECT_EQ(cache.stats().entries, 4);
+}
+
+TEST_F(query_plan_test_fixture, ParseRefine) {
+    const auto statement =
+        parse_query_statement(R"-(refine ("DPI" > 100))-");
+    ASSERT_TRUE(statement.has_value());
+    EXPECT_EQ(statement->statement_kind, query_statement::kind::refine);
+    EXPECT_EQ(statement->where.size(), 1);
+    EXPECT_FALSE(parse_query_statement(R"-(refine)-").has_value());
+    EXPECT_FALSE(parse_query_statement(R"-(select ("DPI" > 100))-").has_value());
+}
+
+TEST_F(query_plan_test_fixture, RefiningMatchesFullQuery) {
+    const table t = make_sample_table();
+    auto plan_of = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        return *plan;
+    };
+
+    const query_plan first = plan_of(R"-(query ("Favorite" = Yes))-");
+    const query_plan both =
+        plan_of(R"-(query ("DPI" > 100) && ("Favorite" = yes))-");
+    vector<clause_key> done{};
+    for (const plan_clause& pc : first.clauses()) {
+        done.push_back(make_clause_key(pc));
+    }
+    const query_plan rest = both.without(done);
+    EXPECT_EQ(rest.clauses().size(), 1);
+    EXPECT_EQ(rest.execute_within(first.execute()), both.execute());
+
+    // Without any clauses, the candidates are the result.
+    const query_plan none = first.without(done);
+    EXPECT_TRUE(none.clauses().empty());
+    EXPECT_EQ(none.execute_within(first.execute()), first.execute());
+}
+
+TEST_F(query_plan_test_fixture, CountMatchesExecute) {
+    const table t = make_sample_table();
+    for (const char* line : {
+             R"-(count ("DPI" = 72))-",
+             R"-(count ("DPI" != 72))-",
+             R"-(count ("Image Size (MB)" > 10.0))-",
+             R"-(count ("Type" = png))-",
+             R"-(count ("Type" >= jpeg))-",
+             R"-(count ("User Tags" tags Dusk))-",
+             R"-(count ("User Tags" tags "Mt Fuji", Dusk))-",
+             R"-(count ("Favorite" = yes) && ("DPI" > 100))-",
+         }) {
+        const auto statement = parse_query_statement(line);
+        ASSERT_TRUE(statement.has_value()) << line;
+        EXPECT_EQ(statement->statement_kind, query_statement::kind::count);
+        const auto plan = query_plan::make(t, *statement);
+        ASSERT_TRUE(plan.has_value()) << line;
+        EXPECT_EQ(plan->count(), plan->execute().count()) << line;
+    }
+}
+
+TEST_F(query_plan_test_fixture, CountFromIndex) {
+    const table t = make_sample_table();
+    auto counted = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        return count_from_index(t.columns(), plan->clauses().front());
+    };
+    EXPECT_EQ(counted(R"-(count ("DPI" = 72))-"), 2);
+    EXPECT_EQ(counted(R"-(count ("Type" = png))-"), 2);
+    EXPECT_EQ(counted(R"-(count ("User Tags" tags Dusk))-"), 2);
+
+    // Rows can have more than one of several tags, and boolean columns have
+    // no index.
+    EXPECT_FALSE(counted(R"-(count ("User Tags" tags "Mt Fuji", Dusk))-"));
+    EXPECT_FALSE(counted(R"-(count ("Favorite" = yes))-"));
+}
+
+TEST_F(query_plan_test_fixture, ParseOrderByAndLimit) {
+    const auto statement = parse_query_statement(
+        R"-(query ("DPI" > 80) order by "Image Size (MB)" desc limit 2)-");
+    ASSERT_TRUE(statement.has_value());
+    ASSERT_TRUE(statement->order_by.has_value());
+    EXPECT_EQ(statement->order_by->column_name, "Image Size (MB)");
+    EXPECT_TRUE(statement->order_by->descending);
+    EXPECT_EQ(statement->limit, 2);
+
+    const auto ascending =
+        parse_query_statement(R"-(query ("DPI" > 80) order by "DPI")-");
+    ASSERT_TRUE(ascending.has_value());
+    EXPECT_FALSE(ascending->order_by->descending);
+    EXPECT_FALSE(ascending->limit.has_value());
+
+    EXPECT_FALSE(parse_query_statement(R"-(query ("DPI" > 80) order "DPI")-")
+                     .has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(query ("DPI" > 80) limit ten)-").has_value());
+    EXPECT_FALSE(
+        parse_query_statement(R"-(query ("DPI" > 80) limit 5 order by "DPI")-")
+            .has_value());
+}
+
+TEST_F(query_plan_test_fixture, OrderByLimit) {
+    const table t = make_sample_table();
+    auto ordered = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        const auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        return plan->ordered_rows(plan->execute());
+    };
+    // Rows: 0 Iceland 72 DPI, 1 Italy 96, 2 Japan 600, 3 Calgary 1200,
+    // 4 Edmonton 72.
+    EXPECT_EQ(ordered(R"-(query ("DPI" > 0) order by "DPI" desc limit 2)-"),
+              (vector<std::uint32_t>{3, 2}));
+    EXPECT_EQ(ordered(R"-(query ("DPI" > 0) order by "DPI")-"),
+              (vector<std::uint32_t>{0, 4, 1, 2, 3}));
+    EXPECT_EQ(ordered(R"-(query ("DPI" > 0) order by "Type" desc)-"),
+              (vector<std::uint32_t>{3, 0, 1, 2, 4}));
+    EXPECT_EQ(ordered(R"-(query ("DPI" > 0) limit 3)-"),
+              (vector<std::uint32_t>{0, 1, 2}));
+
+    // Rows without a value come last either way.
+    EXPECT_EQ(ordered(R"-(query ("DPI" > 0) order by "Favorite" desc)-"),
+              (vector<std::uint32_t>{1, 3, 0, 2, 4}));
+
+    const auto statement = parse_query_statement(
+        R"-(query ("DPI" > 0) order by "User Tags")-");
+    ASSERT_TRUE(statement.has_value());
+    const auto plan = query_plan::make(t, *statement);
+    ASSERT_FALSE(plan.has_value());
+    EXPECT_EQ(plan.error().error_kind, plan_error::kind::unsupported);
+}
+
+TEST_F(query_plan_test_fixture, IndexOrderMatchesHeap) {
+    const table t = make_numbered_table(5000);
+    const column_store& cs = t.columns();
+    const bitmap selection = evaluate_clause(
+        cs, plan_clause{"Flag", 3, e_cell_data_type::boolean,
+                        comparison_op::equal_to, true});
+
+    const auto* scores = cs.get_if<integer_column>(1);
+    const auto* score_index = cs.get_index_if<sorted_index<std::int32_t>>(1);
+    const auto* names = cs.get_if<text_column>(4);
+    const auto* name_index = cs.get_index_if<posting_lists>(4);
+    ASSERT_TRUE(scores && score_index && names && name_index);
+    const std::span<const std::int32_t> score_values{scores->values};
+    const std::span<const std::int32_t> name_codes{names->codes};
+
+    for (const bool desc : {false, true}) {
+        for (const size_t k :
+             {size_t{0}, size_t{1}, size_t{40}, size_t{5000}}) {
+            const row_order<std::span<const std::int32_t>> by_score{
+                &score_values, &scores->present, desc};
+            EXPECT_EQ(
+                rows_in_index_order(*scores, *score_index, selection, desc, k),
+                top_rows(selection, k, by_score));
+
+            const row_order<std::span<const std::int32_t>> by_name{
+                &name_codes, &names->present, desc};
+            EXPECT_EQ(
+                rows_in_index_order(*names, *name_index, selection, desc, k),
+                top_rows(selection, k, by_name));
+        }
+    }
+
+    // The heap agrees with sorting every match.
+    vector<std::uint32_t> all = selection.to_ids();
+    const row_order<std::span<const std::int32_t>> by_score{
+        &score_values, &scores->present, true};
+    std::ranges::sort(all, by_score);
+    all.resize(25);
+    EXPECT_EQ(top_rows(selection, 25, by_score), all);
+}
+
+TEST_F(query_plan_test_fixture, WalkIndexMatchesOrderedRows) {
+    const table t = make_numbered_table(3 * morsel_rows);
+    auto plan_for = [&t](const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value());
+        auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value());
+        return std::move(*plan);
+    };
+    for (const string line :
+         {R"-(query ("Flag" = No) order by "Score" desc limit 5)-",
+          R"-(query ("Score" > 10) && ("Flag" = No) order by "Name" limit 40)-",
+          R"-(query ("Ratio" < 5.5) order by "Ratio" desc limit 12)-",
+          R"-(select "Id" order by "Id" desc limit 3)-"}) {
+        const query_plan plan = plan_for(line);
+        const auto walked = plan.walk_index();
+        ASSERT_TRUE(walked.has_value()) << line;
+        EXPECT_EQ(*walked, plan.ordered_rows(plan.execute())) << line;
+    }
+    // Most of the table would be tested, or there is no limit.
+    EXPECT_FALSE(
+        plan_for(R"-(query ("Flag" = No) order by "Score" limit 30000)-")
+            .walk_index());
+    EXPECT_FALSE(
+        plan_for(R"-(query ("Flag" = No) order by "Score")-").walk_index());
+    EXPECT_FALSE(plan_for(R"-(query ("Flag" = No) limit 5)-").walk_index());
+
+    // Rows without a value are tested too, after the others.
+    const table sample = make_sample_table();
+    const column_store& cs = sample.columns();
+    const auto* continents = cs.get_if<text_column>(8);
+    const auto* continent_index = cs.get_index_if<posting_lists>(8);
+    ASSERT_TRUE(continents && continent_index);
+    const bitmap odd = bitmap::from_ids(5, vector<std::uint32_t>{1, 3});
+    auto is_odd = [](std::uint32_t r) { return r % 2 == 1; };
+    for (const bool desc : {false, true}) {
+        EXPECT_EQ(
+            rows_in_index_order(*continents, *continent_index, is_odd, desc, 5),
+            rows_in_index_order(*continents, *continent_index, odd, desc, 5));
+    }
+}
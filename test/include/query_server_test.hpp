@@ -0,0 +1,165 @@
+#pragma once
+
+#if !defined(_WIN64)
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "live_table.hpp"
+#include "query_server.hpp"
+#include "query_socket.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct query_server_test_fixture : google_test_fixture {
+    /// @brief The two frames of an answer.
+    struct answer {
+        string out{};
+        string err{};
+    };
+
+    /// @brief Sends a command and reads the answer.
+    std::optional<answer> ask(int fd, const string& command) {
+        if (!write_frame(fd, command)) return std::nullopt;
+        auto out = read_frame(fd);
+        auto err = out ? read_frame(fd) : std::nullopt;
+        if (!err) return std::nullopt;
+        return answer{std::move(*out), std::move(*err)};
+    }
+};
+}  // namespace
+
+TEST_F(query_server_test_fixture, Frames) {
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    EXPECT_TRUE(write_frame(fds[0], "count (\"DPI\" > 80)"));
+    EXPECT_TRUE(write_frame(fds[0], ""));
+    EXPECT_EQ(read_frame(fds[1]), "count (\"DPI\" > 80)");
+    EXPECT_EQ(read_frame(fds[1]), "");
+
+    // Too long for the reader.
+    EXPECT_TRUE(write_frame(fds[0], string(100, 'x')));
+    EXPECT_FALSE(read_frame(fds[1], 99).has_value());
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    // Cut off part way.
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const char partial[] = {0, 0, 0, 10, 'a', 'b'};
+    EXPECT_TRUE(write_all(fds[0], partial, sizeof partial));
+    ::close(fds[0]);
+    EXPECT_FALSE(read_frame(fds[1]).has_value());
+    ::close(fds[1]);
+}
+
+TEST_F(query_server_test_fixture, ServeConnection) {
+    live_table tables{"", make_sample_table()};
+    query_server server{tables};
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::jthread serving{[&] { server.serve_connection(fds[1]); }};
+
+    const auto count = ask(fds[0], R"-(count ("Type" = png))-");
+    ASSERT_TRUE(count.has_value());
+    EXPECT_EQ(count->out, "2 rows found\n");
+    EXPECT_TRUE(count->err.starts_with("planning ")) << count->err;
+
+    const auto rows =
+        ask(fds[0], R"-(select "Filename" where ("DPI" > 80))-");
+    ASSERT_TRUE(rows.has_value());
+    EXPECT_EQ(rows->out,
+              "Filename\nItaly.png\nJapan.jpeg\nCalgary.tif\n3 rows found\n");
+
+    // Refining works from this connection's previous query.
+    const auto refined = ask(fds[0], R"-(refine ("Type" = png))-");
+    ASSERT_TRUE(refined.has_value());
+    EXPECT_TRUE(refined->out.ends_with("1 rows found\n")) << refined->out;
+
+    const auto unknown = ask(fds[0], "frobnicate");
+    ASSERT_TRUE(unknown.has_value());
+    EXPECT_EQ(unknown->out, "command line \"frobnicate\" not understood\n");
+
+    // The server answers "quit", then stops serving the connection.
+    EXPECT_TRUE(ask(fds[0], "quit").has_value());
+    serving.join();
+    ::close(fds[1]);
+    EXPECT_FALSE(read_frame(fds[0]).has_value());
+    ::close(fds[0]);
+}
+
+TEST_F(query_server_test_fixture, ConcurrentClients) {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "dimroom_server_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const string csv = (dir / "sample.csv").string();
+    {
+        std::ofstream out{csv};
+        for (const string& line : sample_csv_rows) out << line << '\n';
+    }
+    auto loaded = table::make_table_from_file(csv);
+    ASSERT_TRUE(loaded.has_value());
+    live_table tables{csv, std::move(*loaded)};
+
+    const string path = (dir / "dimroom.sock").string();
+    query_server server{tables};
+    ASSERT_TRUE(server.listen(path).has_value());
+    std::jthread running{[&] { server.run(); }};
+
+    vector<std::jthread> clients{};
+    vector<size_t> answered(4, 0);
+    for (size_t c = 0; c < answered.size(); ++c) {
+        clients.emplace_back([&, c] {
+            const auto fd = connect_to_server(path);
+            if (!fd) return;
+            for (size_t i = 0; i < 25; ++i) {
+                const auto count = ask(*fd, R"-(count ("DPI" >= 96))-");
+                if (count && count->out == "3 rows found\n") ++answered[c];
+            }
+            ::close(*fd);
+        });
+    }
+    // Queries are answered while another client reloads the table.
+    size_t reloads = 0;
+    clients.emplace_back([&] {
+        const auto fd = connect_to_server(path);
+        if (!fd) return;
+        for (size_t i = 0; i < 5; ++i) {
+            const auto reloaded = ask(*fd, "reload");
+            if (reloaded && reloaded->out.starts_with("Reloaded 5 rows")) {
+                ++reloads;
+            }
+        }
+        ::close(*fd);
+    });
+    clients.clear();
+    for (const size_t n : answered) EXPECT_EQ(n, 25);
+    EXPECT_EQ(reloads, 5);
+
+    // A client still connected when the server stops is disconnected.
+    const auto idle = connect_to_server(path);
+    ASSERT_TRUE(idle.has_value());
+    EXPECT_TRUE(ask(*idle, R"-(count ("DPI" >= 96))-").has_value());
+    server.stop();
+    running.join();
+    EXPECT_FALSE(read_frame(*idle).has_value());
+    ::close(*idle);
+    fs::remove_all(dir);
+}
+
+#endif
@@ -125,3 +125,61 @@ TEST_F(query_test_fixture, IntegerTestIntegerSearch4) {
     EXPECT_TRUE(!q_result.empty());
     EXPECT_TRUE(q_result.size() == 4);
 }
+
+TEST_F(query_test_fixture, FloatingTestGreaterEqual) {
+    auto input_ = parse_lines(query_test_fixture::sample_csv_rows);
+    EXPECT_TRUE(input_.has_value());
+    const parser::header_and_data input = *input_;
+    const auto all_data_cells =
+        data_cell::make_all_data_cells(input.all_data_fields);
+    table test_table(input.header_fields, all_data_cells);
+
+    const string column_name = "Image Size (MB)";
+    query q(test_table, column_name, query::comparison::greater_equal);
+    auto q_result = q.floating_match(10.5f);
+    EXPECT_EQ(q_result.size(), 3);
+}
+
+TEST_F(query_test_fixture, TextTestStringNotEqual) {
+    auto input_ = parse_lines(query_test_fixture::sample_csv_rows);
+    EXPECT_TRUE(input_.has_value());
+    const parser::header_and_data input = *input_;
+    const auto all_data_cells =
+        data_cell::make_all_data_cells(input.all_data_fields);
+    table test_table(input.header_fields, all_data_cells);
+
+    const string column_name = "Type";
+    query q(test_table, column_name, query::comparison::not_equal_to);
+    auto q_result = q.string_match("jpeg");
+    EXPECT_EQ(q_result.size(), 3);
+}
+
+TEST_F(query_test_fixture, BooleanTestEmptyCellsAreFalse) {
+    auto input_ = parse_lines(query_test_fixture::sample_csv_rows);
+    EXPECT_TRUE(input_.has_value());
+    const parser::header_and_data input = *input_;
+    const auto all_data_cells =
+        data_cell::make_all_data_cells(input.all_data_fields);
+    table test_table(input.header_fields, all_data_cells);
+
+    const string column_name = "Favorite";
+    query q(test_table, column_name);
+    auto q_result = q.boolean_match(false);
+    EXPECT_EQ(q_result.size(), 3);
+}
+
+TEST_F(query_test_fixture, IntegerTestMissingColumn) {
+    auto input_ = parse_lines(query_test_fixture::sample_csv_rows);
+    EXPECT_TRUE(input_.has_value());
+    const parser::header_and_data input = *input_;
+    const auto all_data_cells =
+        data_cell::make_all_data_cells(input.all_data_fields);
+    table test_table(input.header_fields, all_data_cells);
+
+    query q(test_table, "Flavour");
+    auto q_result = q.integer_match(600);
+    EXPECT_TRUE(q_result.empty());
+}
+
+static_assert(predicate<int, comparison_op::less_equal>{}(3, 3));
+static_assert(!predicate<bool, comparison_op::greater>{}(true, true));
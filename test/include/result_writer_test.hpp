@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdio>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "projection.hpp"
+#include "query_ast.hpp"
+#include "result_writer.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct result_writer_test_fixture : google_test_fixture {
+    /// @brief Writes the headings and the given rows; returns the lines
+    /// written.
+    vector<string> write(const projection& columns,
+                         const vector<size_t>& rows, output_format format) {
+        std::FILE* out = std::tmpfile();
+        EXPECT_NE(out, nullptr);
+        if (!out) return {};
+        {
+            result_writer writer(columns, out, format);
+            writer.write_headings();
+            for (const size_t r : rows) writer.write_row(r);
+        }
+        std::rewind(out);
+        string text{};
+        char chunk[4096];
+        while (const size_t n = std::fread(chunk, 1, sizeof chunk, out)) {
+            text.append(chunk, n);
+        }
+        std::fclose(out);
+
+        vector<string> lines{};
+        size_t begin = 0;
+        for (size_t end = text.find('\n'); end != string::npos;
+             end = text.find('\n', begin)) {
+            lines.push_back(text.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        EXPECT_EQ(begin, text.size()) << "last line not ended";
+        return lines;
+    }
+
+    projection columns(const table& t, const vector<string>& names) {
+        vector<column_ref> refs{};
+        for (const string& name : names) refs.push_back({name});
+        auto result = projection::make(t, refs);
+        EXPECT_TRUE(result.has_value());
+        return result ? *result : projection::all(t);
+    }
+};
+}  // namespace
+
+TEST_F(result_writer_test_fixture, FormatNames) {
+    EXPECT_EQ(output_format_from_name("csv"), output_format::csv);
+    EXPECT_EQ(output_format_from_name("TSV"), output_format::tsv);
+    EXPECT_EQ(output_format_from_name("jsonl"), output_format::jsonl);
+    EXPECT_FALSE(output_format_from_name("json").has_value());
+}
+
+TEST_F(result_writer_test_fixture, WriteCsv) {
+    const table t = make_sample_table();
+    EXPECT_EQ(write(projection::all(t), {0, 3}, output_format::csv),
+              (vector<string>{
+                  sample_csv_rows[0],
+                  R"(Iceland.png,png,8.35,600,800,72,,,,,,Team Iceland,"""Johnson, Volcano, Dusk""")",
+                  // The coordinate has a comma, so it is quoted.
+                  R"-(Calgary.tif,tiff,30.6,600,800,1200,"(51.05011, -114.08529)",1,,32,Y,Flames,"""Urban, Dusk""")-"}));
+}
+
+TEST_F(result_writer_test_fixture, WriteTsv) {
+    const table t = make_sample_table();
+    EXPECT_EQ(write(columns(t, {"Filename", "(Center) Coordinate", "Favorite",
+                                "User Tags", "Image Size (MB)"}),
+                    {3, 4}, output_format::tsv),
+              (vector<string>{
+                  "Filename\t(Center) Coordinate\tFavorite\tUser Tags\tImage "
+                  "Size (MB)",
+                  "Calgary.tif\t(51.05011, -114.08529)\t1\tUrban, Dusk\t30.6",
+                  "Edmonton.jpg\t(53.55014, -113.46871)\t\t\t5.6"}));
+}
+
+TEST_F(result_writer_test_fixture, WriteJsonLines) {
+    const table t = make_sample_table();
+    EXPECT_EQ(
+        write(columns(t, {"Filename", "DPI", "Favorite", "User Tags",
+                          "Continent"}),
+              {0, 1}, output_format::jsonl),
+        (vector<string>{
+            R"({"Filename":"Iceland.png","DPI":72,"Favorite":null,"User Tags":["Johnson","Volcano","Dusk"],"Continent":null})",
+            R"({"Filename":"Italy.png","DPI":96,"Favorite":true,"User Tags":null,"Continent":"Europe"})"}));
+}
+
+TEST_F(result_writer_test_fixture, QuotesAndEscapes) {
+    auto input_ = parse_lines(
+        vector<string>{"Name,Note", R"(a,say "hi")", R"(b,back\slash)"});
+    ASSERT_TRUE(input_.has_value());
+    const table t(*input_);
+
+    EXPECT_EQ(write(projection::all(t), {0, 1}, output_format::csv),
+              (vector<string>{"Name,Note", R"(a,"say ""hi""")",
+                              R"(b,back\slash)"}));
+    EXPECT_EQ(write(projection::all(t), {0, 1}, output_format::tsv),
+              (vector<string>{"Name\tNote", "a\tsay \"hi\"",
+                              "b\tback\\\\slash"}));
+    EXPECT_EQ(write(projection::all(t), {0, 1}, output_format::jsonl),
+              (vector<string>{R"({"Name":"a","Note":"say \"hi\""})",
+                              R"({"Name":"b","Note":"back\\slash"})"}));
+}
+
+TEST_F(result_writer_test_fixture, WritesMoreThanOneChunk) {
+    vector<string> lines{"Id,Name"};
+    for (size_t i = 0; i < 20000; ++i) {
+        lines.push_back(std::format("{},name {}", i, i));
+    }
+    auto input_ = parse_lines(lines);
+    ASSERT_TRUE(input_.has_value());
+    const table t(*input_);
+
+    vector<size_t> rows(t.rows_.size());
+    for (size_t r = 0; r < rows.size(); ++r) rows[r] = r;
+    const auto written = write(projection::all(t), rows, output_format::csv);
+    EXPECT_EQ(written, lines);
+}
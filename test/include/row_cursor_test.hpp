@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "clause_cache.hpp"
+#include "google_test_fixture.hpp"
+#include "query_ast.hpp"
+#include "query_plan.hpp"
+#include "row_cursor.hpp"
+#include "scheduler.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct row_cursor_test_fixture : google_test_fixture {
+    query_plan plan_for(const table& t, const string& line) {
+        const auto statement = parse_query_statement(line);
+        EXPECT_TRUE(statement.has_value()) << line;
+        auto plan = query_plan::make(t, *statement);
+        EXPECT_TRUE(plan.has_value()) << line;
+        return *plan;
+    }
+
+    /// @brief Pulls every row from a cursor, batch_rows at a time.
+    vector<std::uint32_t> drain(row_cursor& cursor, size_t batch_rows) {
+        vector<std::uint32_t> rows{};
+        for (auto batch = cursor.next(batch_rows); !batch.empty();
+             batch = cursor.next(batch_rows)) {
+            EXPECT_LE(batch.size(), batch_rows);
+            rows.insert(rows.end(), batch.begin(), batch.end());
+        }
+        EXPECT_TRUE(cursor.done());
+        return rows;
+    }
+};
+}  // namespace
+
+TEST_F(row_cursor_test_fixture, StreamMatchesExecute) {
+    // Several morsels, the last one partial.
+    const table t = make_numbered_table(3 * morsel_rows + 1000);
+    scheduler sched{4};
+    const string queries[] = {
+        R"-(query ("Score" > 50) && ("Flag" = Yes))-",
+        R"-(query ("Score" <= 20) && ("Name" != name4))-",
+        R"-(query ("Id" >= 15000))-",
+        R"-(query ("Score" > 500))-"};
+    for (const string& q : queries) {
+        const query_plan plan = plan_for(t, q);
+        const bitmap expected = plan.execute();
+        for (scheduler* s : {static_cast<scheduler*>(nullptr), &sched}) {
+            for (const size_t batch_rows : {size_t{7}, size_t{4096}}) {
+                row_cursor cursor = row_cursor::stream(plan, s);
+                EXPECT_EQ(drain(cursor, batch_rows), expected.to_ids()) << q;
+                EXPECT_EQ(cursor.finish(), expected) << q;
+            }
+        }
+    }
+}
+
+TEST_F(row_cursor_test_fixture, FirstRowsBeforeFullScan) {
+    const table t = make_numbered_table(3 * morsel_rows + 1000);
+    const query_plan plan = plan_for(t, R"-(query ("Score" > 50))-");
+    const bitmap expected = plan.execute();
+
+    row_cursor cursor = row_cursor::stream(plan, nullptr);
+    const auto first = cursor.next(10);
+    ASSERT_EQ(first.size(), 10);
+    const auto ids = expected.to_ids();
+    EXPECT_TRUE(std::equal(first.begin(), first.end(), ids.begin()));
+    EXPECT_FALSE(cursor.done());
+    EXPECT_EQ(cursor.produced(), 10);
+
+    // Stopping early still gives the whole result.
+    EXPECT_EQ(cursor.finish(), expected);
+    EXPECT_TRUE(cursor.next(10).empty());
+}
+
+TEST_F(row_cursor_test_fixture, LimitIsRespected) {
+    const table t = make_numbered_table(2 * morsel_rows);
+    const query_plan plan =
+        plan_for(t, R"-(query ("Flag" = Yes) limit 25)-");
+    row_cursor cursor = row_cursor::stream(plan, nullptr);
+    const auto rows = drain(cursor, 10);
+    ASSERT_EQ(rows.size(), 25);
+    EXPECT_EQ(rows.front(), 0);
+    EXPECT_EQ(rows.back(), 72);
+
+    // Only the first morsel was scanned.
+    const bitmap& found = cursor.finish();
+    EXPECT_TRUE(cursor.truncated());
+    EXPECT_EQ(found.count(), (morsel_rows + 2) / 3);
+    bitmap expected = plan.execute();
+    expected &= found;
+    EXPECT_EQ(found, expected);
+
+    // A limit the result does not reach leaves it complete.
+    const query_plan wide =
+        plan_for(t, R"-(query ("Flag" = Yes) limit 100000)-");
+    row_cursor all = row_cursor::stream(wide, nullptr);
+    drain(all, 4096);
+    EXPECT_EQ(all.finish(), wide.execute());
+    EXPECT_FALSE(all.truncated());
+}
+
+TEST_F(row_cursor_test_fixture, OrderedPlanIsSorted) {
+    const table t = make_numbered_table(2 * morsel_rows);
+    const query_plan plan =
+        plan_for(t, R"-(query ("Flag" = Yes) order by "Score" desc)-");
+    const bitmap expected = plan.execute();
+    row_cursor cursor = row_cursor::stream(plan);
+    EXPECT_EQ(drain(cursor, 4096), plan.ordered_rows(expected));
+    EXPECT_EQ(cursor.finish(), expected);
+    EXPECT_FALSE(cursor.truncated());
+
+    // With a small limit the index is walked, and the search stops there.
+    const query_plan limited = plan_for(
+        t, R"-(query ("Flag" = Yes) order by "Score" desc limit 30)-");
+    row_cursor first = row_cursor::stream(limited);
+    const auto rows = drain(first, 8);
+    EXPECT_EQ(rows, limited.ordered_rows(expected));
+    EXPECT_EQ(first.finish().count(), 30);
+    EXPECT_TRUE(first.truncated());
+}
+
+TEST_F(row_cursor_test_fixture, CachedClauses) {
+    const table t = make_numbered_table(3 * morsel_rows);
+    clause_cache cache{};
+    const query_plan plan =
+        plan_for(t, R"-(query ("Score" > 50) && ("Flag" = Yes))-");
+    const bitmap expected = plan.execute();
+
+    row_cursor first = row_cursor::stream(plan, nullptr, &cache);
+    first.next(5);
+    EXPECT_EQ(cache.stats().entries, 0);
+    EXPECT_EQ(first.finish(), expected);
+    EXPECT_EQ(cache.stats().entries, 2);
+
+    const size_t hits = cache.stats().hits;
+    row_cursor second = row_cursor::stream(plan, nullptr, &cache);
+    EXPECT_EQ(cache.stats().hits, hits + 2);
+    EXPECT_EQ(drain(second, 4096), expected.to_ids());
+}
+
+TEST_F(row_cursor_test_fixture, FewCachedRowsAreNotCachedAgain) {
+    const table t = make_numbered_table(3 * morsel_rows);
+    clause_cache cache{};
+    row_cursor::stream(plan_for(t, R"-(query ("Id" < 100))-"), nullptr, &cache)
+        .finish();
+    EXPECT_EQ(cache.stats().entries, 1);
+
+    // Only the hundred rows the cache leaves are scanned for the rest.
+    const query_plan plan =
+        plan_for(t, R"-(query ("Id" < 100) && ("Score" > 50))-");
+    row_cursor cursor = row_cursor::stream(plan, nullptr, &cache);
+    EXPECT_EQ(drain(cursor, 64), plan.execute().to_ids());
+    EXPECT_EQ(cache.stats().entries, 1);
+}
+
+TEST_F(row_cursor_test_fixture, FromRows) {
+    bitmap selection(10);
+    selection.set(2);
+    selection.set(7);
+    row_cursor cursor = row_cursor::from_rows({7, 2}, selection);
+    EXPECT_FALSE(cursor.done());
+    EXPECT_EQ(drain(cursor, 1), (vector<std::uint32_t>{7, 2}));
+    EXPECT_EQ(cursor.produced(), 2);
+    EXPECT_EQ(cursor.finish(), selection);
+}
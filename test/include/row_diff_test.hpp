@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "row_diff.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct row_diff_test_fixture : google_test_fixture {
+    static vector<std::uint64_t> hashes(const vector<string>& lines) {
+        vector<std::uint64_t> result{};
+        for (const string& line : lines) result.push_back(line_hash(line));
+        return result;
+    }
+};
+}  // namespace
+
+TEST_F(row_diff_test_fixture, LineHash) {
+    // xxHash64 reference values.
+    EXPECT_EQ(line_hash(""), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(line_hash("abc"), 0x44BC2CF5AD770999ULL);
+    const string longer(100, 'x');
+    EXPECT_EQ(line_hash(longer), line_hash(string(100, 'x')));
+    EXPECT_NE(line_hash(longer), line_hash(string(99, 'x') + "y"));
+}
+
+TEST_F(row_diff_test_fixture, DiffLines) {
+    constexpr auto no = line_diff::no_line;
+    const auto old_lines = hashes({"a", "b", "c", "d", "e"});
+
+    const auto same = diff_lines(old_lines, old_lines, 0);
+    ASSERT_TRUE(same.has_value());
+    EXPECT_EQ(same->source, (vector<std::uint32_t>{0, 1, 2, 3, 4}));
+    EXPECT_EQ(same->changed(), 0);
+
+    const auto edited =
+        diff_lines(old_lines, hashes({"a", "B", "c", "e", "f"}), 10);
+    ASSERT_TRUE(edited.has_value());
+    EXPECT_EQ(edited->source, (vector<std::uint32_t>{0, no, 2, 4, no}));
+    EXPECT_EQ(edited->updated, 1);
+    EXPECT_EQ(edited->deleted, 1);
+    EXPECT_EQ(edited->inserted, 1);
+
+    const auto emptied = diff_lines(old_lines, {}, 10);
+    ASSERT_TRUE(emptied.has_value());
+    EXPECT_TRUE(emptied->source.empty());
+    EXPECT_EQ(emptied->deleted, 5);
+
+    // Reversing the lines needs eight edits.
+    const auto reversed = hashes({"e", "d", "c", "b", "a"});
+    EXPECT_FALSE(diff_lines(old_lines, reversed, 7).has_value());
+    const auto allowed = diff_lines(old_lines, reversed, 8);
+    ASSERT_TRUE(allowed.has_value());
+    EXPECT_EQ(allowed->inserted + allowed->updated, 4);
+    EXPECT_EQ(allowed->deleted + allowed->updated, 4);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+
+#include "google_test_fixture.hpp"
+#include "scheduler.hpp"
+
+namespace {
+using std::vector;
+using namespace jt;
+
+struct scheduler_test_fixture : google_test_fixture {};
+}  // namespace
+
+TEST_F(scheduler_test_fixture, ParallelForRunsEveryIndexOnce) {
+    scheduler sched{4};
+    vector<std::atomic<int>> calls(1000);
+    sched.parallel_for(calls.size(), [&calls](size_t i) { ++calls[i]; });
+    for (const auto& c : calls) EXPECT_EQ(c.load(), 1);
+}
+
+TEST_F(scheduler_test_fixture, ParallelForWithoutWorkers) {
+    scheduler sched{0};
+    EXPECT_EQ(sched.worker_count(), 0);
+    size_t sum = 0;
+    sched.parallel_for(10, [&sum](size_t i) { sum += i; });
+    EXPECT_EQ(sum, 45);
+}
+
+TEST_F(scheduler_test_fixture, NestedParallelFor) {
+    // The inner loops run on workers; the waiting threads help rather than
+    // block, so this cannot deadlock.
+    scheduler sched{2};
+    std::atomic<size_t> sum{0};
+    sched.parallel_for(8, [&](size_t i) {
+        sched.parallel_for(8, [&](size_t j) { sum += i * 8 + j; });
+    });
+    EXPECT_EQ(sum.load(), 63 * 64 / 2);
+}
+
+TEST_F(scheduler_test_fixture, TaskGroupWaitsForItsTasks) {
+    scheduler sched{3};
+    std::atomic<int> runs{0};
+    task_group group{sched};
+    for (int i = 0; i < 100; ++i) group.run([&runs] { ++runs; });
+    group.wait();
+    EXPECT_EQ(runs.load(), 100);
+    EXPECT_FALSE(group.cancelled());
+}
+
+TEST_F(scheduler_test_fixture, CancelledTasksAreSkipped) {
+    // With no workers, nothing runs until wait(), so every task is skipped.
+    scheduler sched{0};
+    std::atomic<int> runs{0};
+    task_group group{sched};
+    for (int i = 0; i < 10; ++i) group.run([&runs] { ++runs; });
+    group.cancel();
+    group.wait();
+    EXPECT_EQ(runs.load(), 0);
+
+    // A running task sees the cancellation through its stop_token.
+    task_group stopping{sched};
+    bool saw_stop = false;
+    stopping.run([&](std::stop_token token) {
+        stopping.cancel();
+        saw_stop = token.stop_requested();
+    });
+    stopping.wait();
+    EXPECT_TRUE(saw_stop);
+}
+
+TEST_F(scheduler_test_fixture, WorkerCounters) {
+    scheduler sched{2};
+    sched.parallel_for(64, [](size_t) {});
+    const auto counters = sched.counters();
+    ASSERT_EQ(counters.size(), 2);
+    std::uint64_t worker_runs = 0;
+    for (const worker_counters& c : counters) {
+        worker_runs += c.tasks_run;
+        EXPECT_LE(c.tasks_stolen, c.tasks_run);
+    }
+    // The calling thread runs some of the tasks itself.
+    EXPECT_LE(worker_runs, 64);
+}
+
+TEST_F(scheduler_test_fixture, SubmittedTasksRunBeforeDestruction) {
+    std::atomic<int> runs{0};
+    {
+        scheduler sched{2};
+        for (int i = 0; i < 100; ++i) sched.submit([&runs] { ++runs; });
+    }
+    EXPECT_EQ(runs.load(), 100);
+}
+
+TEST_F(scheduler_test_fixture, ShortLivedTaskGroups) {
+    // Each group is gone as soon as wait() returns, while the worker that ran
+    // its last task may still be signalling it.
+    scheduler sched{4};
+    std::atomic<int> runs{0};
+    for (int i = 0; i < 2000; ++i) {
+        task_group group{sched};
+        group.run([&runs] { ++runs; });
+        group.run([&runs] { ++runs; });
+    }
+    for (int i = 0; i < 2000; ++i) {
+        sched.parallel_for(3, [&runs](size_t) { ++runs; });
+    }
+    EXPECT_EQ(runs.load(), 10000);
+}
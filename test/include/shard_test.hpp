@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "command_line.hpp"
+#include "google_test_fixture.hpp"
+#include "live_table.hpp"
+#include "query_server.hpp"
+#include "shard.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct shard_test_fixture : google_test_fixture {
+    /// @brief The lines of a catalog with a different DPI in every row, so
+    /// that ordered results do not depend on how ties are broken.
+    vector<string> catalog_lines(size_t rows) {
+        vector<string> lines{"Filename,Type,DPI,Size,Coordinate"};
+        const char* const types[] = {"png", "jpeg", "tiff"};
+        for (size_t i = 0; i < rows; ++i) {
+            const string dpi =
+                i % 9 == 0 ? string{} : std::format("{}", (i * 37) % 101);
+            lines.push_back(std::format(
+                "img{:03}.{},{},{},{}.5,\"{}.5, {}.25\"", i, types[i % 3],
+                types[i % 3], dpi, i % 17, static_cast<int>(i % 160) - 80,
+                static_cast<int>((i * 7) % 360) - 180));
+        }
+        return lines;
+    }
+
+    /// @brief The table catalog_lines() parse to.
+    table make_catalog(size_t rows) {
+        auto input_ = parse_lines(catalog_lines(rows));
+        EXPECT_TRUE(input_.has_value());
+        const parser::header_and_data input = *input_;
+        return table(input.header_fields,
+                     data_cell::make_all_data_cells(input.all_data_fields));
+    }
+
+    /// @brief Reads back what was written to a temporary file.
+    static string read_back(std::FILE* f) {
+        std::rewind(f);
+        string text{};
+        char buffer[4096];
+        while (const size_t n = std::fread(buffer, 1, sizeof buffer, f)) {
+            text.append(buffer, n);
+        }
+        std::fclose(f);
+        return text;
+    }
+
+    static vector<string> sorted_lines(const string& text) {
+        vector<string> lines{};
+        for (size_t start = 0; start < text.size();) {
+            const size_t end = text.find('\n', start);
+            lines.push_back(text.substr(start, end - start));
+            start = end == string::npos ? text.size() : end + 1;
+        }
+        std::ranges::sort(lines);
+        return lines;
+    }
+};
+}  // namespace
+
+TEST_F(shard_test_fixture, EveryRowInOneShard) {
+    const table t = make_catalog(80);
+    for (const shard_key key : {shard_key::filename, shard_key::tile}) {
+        std::multiset<string> names{};
+        for (size_t i = 0; i < 3; ++i) {
+            const table part = make_shard(t, {i, 3, key});
+            EXPECT_EQ(part.header_fields_.size(), t.header_fields_.size());
+            for (const row& r : part.rows_) {
+                names.insert(cell_value_types_value_as_string(*r[0].value));
+            }
+        }
+        EXPECT_EQ(names.size(), 80);
+        EXPECT_EQ(std::set<string>(names.begin(), names.end()).size(), 80);
+    }
+    // A row goes to the same shard every time.
+    auto names_in = [&t](size_t i) {
+        vector<string> names{};
+        for (const row& r : make_shard(t, {i, 3}).rows_) {
+            names.push_back(cell_value_types_value_as_string(*r[0].value));
+        }
+        return names;
+    };
+    EXPECT_EQ(names_in(1), names_in(1));
+    EXPECT_FALSE(names_in(1).empty());
+}
+
+TEST_F(shard_test_fixture, ParsedRowsGoToTheSameShard) {
+    const auto input = parse_lines(catalog_lines(80));
+    ASSERT_TRUE(input.has_value());
+    const table whole(input->header_fields,
+                      data_cell::make_all_data_cells(input->all_data_fields));
+    auto names = [](const table& t) {
+        vector<string> result{};
+        for (const row& r : t.rows_) {
+            result.push_back(cell_value_types_value_as_string(*r[0].value));
+        }
+        return result;
+    };
+    for (const shard_key key : {shard_key::filename, shard_key::tile}) {
+        for (size_t i = 0; i < 3; ++i) {
+            parser::all_data_fields_t rows = input->all_data_fields;
+            keep_shard_fields(input->header_fields, rows, {i, 3, key});
+            const table part(input->header_fields,
+                             data_cell::make_all_data_cells(rows));
+            EXPECT_EQ(names(part), names(make_shard(whole, {i, 3, key})));
+        }
+    }
+}
+
+TEST_F(shard_test_fixture, Fields) {
+    string record{};
+    append_field(record, "");
+    append_field(record, "a:b");
+    append_field(record, "line\nbreak");
+    EXPECT_EQ(record, "0:3:a:b10:line\nbreak");
+    const auto fields = split_fields(record);
+    ASSERT_TRUE(fields.has_value());
+    EXPECT_EQ(*fields, (vector<string>{"", "a:b", "line\nbreak"}));
+
+    EXPECT_EQ(split_fields(""), vector<string>{});
+    EXPECT_FALSE(split_fields("5:abc").has_value());
+    EXPECT_FALSE(split_fields("x:abc").has_value());
+    EXPECT_FALSE(split_fields("3").has_value());
+}
+
+#if !defined(_WIN64)
+
+TEST_F(shard_test_fixture, SameAnswersAsOneProcess) {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "dimroom_shard_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    const table whole = make_catalog(80);
+    live_table whole_tables{"", table(whole)};
+    command_line session{};
+
+    // Three workers in this process, each on its own socket.
+    vector<std::unique_ptr<live_table>> shards{};
+    vector<std::unique_ptr<query_server>> servers{};
+    vector<std::jthread> running{};
+    vector<string> sockets{};
+    for (size_t i = 0; i < 3; ++i) {
+        shards.push_back(
+            std::make_unique<live_table>("", make_shard(whole, {i, 3})));
+        servers.push_back(std::make_unique<query_server>(*shards.back()));
+        sockets.push_back((dir / std::format("shard-{}.sock", i)).string());
+        ASSERT_TRUE(servers.back()->listen(sockets.back()).has_value());
+        running.emplace_back(
+            [server = servers.back().get()] { server->run(); });
+    }
+    auto coordinator = shard_coordinator::connect(sockets);
+    ASSERT_TRUE(coordinator.has_value()) << coordinator.error();
+    EXPECT_EQ(coordinator->shard_count(), 3);
+    EXPECT_EQ(coordinator->schema().header_fields_, whole.header_fields_);
+
+    auto one_process = [&](const string& line) {
+        std::FILE* out = std::tmpfile();
+        std::FILE* err = std::tmpfile();
+        session.set_output(out, err, false);
+        session.run_command(whole_tables, line);
+        session.set_output(stdout, stderr, false);
+        std::fclose(err);
+        return read_back(out);
+    };
+    auto sharded = [&](const string& line) {
+        std::FILE* out = std::tmpfile();
+        std::FILE* err = std::tmpfile();
+        EXPECT_TRUE(coordinator->run_command(line, out, err));
+        std::fclose(err);
+        return read_back(out);
+    };
+
+    for (const string line :
+         {R"-(count ("DPI" > 50))-", R"-(count ("DPI" > 5) limit 7)-",
+          R"-(query ("DPI" > 20) order by "DPI" desc limit 5)-",
+          R"-(select "Filename", "Size" where ("Type" = png) order by "DPI" limit 4)-",
+          R"-(select "Filename" where ("Type" = jpeg) order by "Filename" desc limit 6)-",
+          R"-(aggregate count, avg("DPI"), min("Size"), max("DPI") group by "Type" where ("DPI" > 10))-",
+          R"-(aggregate count, sum("DPI"), count("DPI"))-",
+          R"-(facets ("Size" >= 2.5) by "Type", "Filename" top 3)-"}) {
+        EXPECT_EQ(sharded(line), one_process(line)) << line;
+    }
+    // Without "order by" the rows come shard by shard.
+    const string select = R"-(select "Filename", "DPI" where ("DPI" < 40))-";
+    EXPECT_EQ(sorted_lines(sharded(select)), sorted_lines(one_process(select)));
+
+    // Mistakes are reported without asking the workers.
+    const string mistake = sharded(R"-(query ("Nope" > 1))-");
+    EXPECT_EQ(mistake, one_process(R"-(query ("Nope" > 1))-"));
+
+    EXPECT_FALSE(coordinator->run_command("quit"));
+    for (auto& server : servers) server->stop();
+    running.clear();
+    fs::remove_all(dir);
+}
+
+#endif
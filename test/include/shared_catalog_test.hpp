@@ -0,0 +1,114 @@
+#pragma once
+
+#if !defined(_WIN64)
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cell_types.hpp"
+#include "google_test_fixture.hpp"
+#include "shared_catalog.hpp"
+#include "table.hpp"
+
+namespace {
+using std::string;
+using std::vector;
+using namespace jt;
+
+struct shared_catalog_test_fixture : google_test_fixture {
+    const string name = std::format("/dimroom-test-{}", ::getpid());
+
+    /// @brief Each row's cells as text, with their types.
+    static vector<string> cells(const table& t) {
+        vector<string> result{};
+        for (const row& r : t.rows_) {
+            string line{};
+            for (const data_cell& cell : r) {
+                line += std::format(
+                    "{}:{};", static_cast<size_t>(cell.data_type),
+                    cell.value ? cell_value_types_value_as_string(*cell.value)
+                               : "-");
+            }
+            result.push_back(std::move(line));
+        }
+        return result;
+    }
+};
+}  // namespace
+
+TEST_F(shared_catalog_test_fixture, PublishAndAttach) {
+    table t = make_sample_table();
+    t.name = "sample";
+    {
+        auto published = shared_catalog::publish(t, name);
+        ASSERT_TRUE(published.has_value()) << published.error();
+        EXPECT_EQ(published->holders(), 1);
+        EXPECT_GT(published->image_bytes(), 0);
+
+        auto attached = shared_catalog::attach(name);
+        ASSERT_TRUE(attached.has_value()) << attached.error();
+        EXPECT_EQ(attached->holders(), 2);
+
+        const table copy = attached->read_table();
+        EXPECT_EQ(copy.name, "sample");
+        EXPECT_EQ(copy.header_fields_, t.header_fields_);
+        EXPECT_EQ(cells(copy), cells(t));
+        EXPECT_EQ(copy.columns().row_count(), t.rows_.size());
+        EXPECT_NE(copy.columns().generation(), t.columns().generation());
+
+        // Publishing again attaches to the image already there.
+        auto again = shared_catalog::publish(t, name);
+        ASSERT_TRUE(again.has_value()) << again.error();
+        EXPECT_EQ(again->holders(), 3);
+    }
+    // The last to detach removed it.
+    EXPECT_FALSE(shared_catalog::attach(name).has_value());
+}
+
+TEST_F(shared_catalog_test_fixture, StaysWhileAttached) {
+    auto published = shared_catalog::publish(make_sample_table(), name);
+    ASSERT_TRUE(published.has_value()) << published.error();
+    auto attached = shared_catalog::attach(name);
+    ASSERT_TRUE(attached.has_value());
+    published = std::unexpected(string{});
+    // The publisher has gone; the image stays for the process still using
+    // it.
+    EXPECT_EQ(attached->holders(), 1);
+    auto later = shared_catalog::attach(name);
+    ASSERT_TRUE(later.has_value());
+    EXPECT_EQ(cells(later->read_table()), cells(make_sample_table()));
+}
+
+TEST_F(shared_catalog_test_fixture, NameFollowsFile) {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "dimroom_shared_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const string csv = (dir / "catalog.csv").string();
+    {
+        std::ofstream out{csv};
+        for (size_t i = 0; i < 3; ++i) out << sample_csv_rows[i] << '\n';
+    }
+    const auto first = shared_catalog::name_for(csv);
+    ASSERT_TRUE(first.has_value()) << first.error();
+    EXPECT_EQ(shared_catalog::name_for(csv), first);
+    {
+        std::ofstream out{csv, std::ios::app};
+        out << sample_csv_rows[3] << '\n';
+    }
+    const auto second = shared_catalog::name_for(csv);
+    ASSERT_TRUE(second.has_value());
+    EXPECT_NE(*second, *first);
+    EXPECT_FALSE(shared_catalog::name_for((dir / "none.csv").string())
+                     .has_value());
+    fs::remove_all(dir);
+}
+
+#endif
@@ -2,14 +2,31 @@
 #include "gtest/gtest.h"
 // NOLINTBEGIN(unused-includes)
 #include "../include/google_test_fixture.hpp"
+#include "../include/aggregate_test.hpp"
+#include "../include/batch_test.hpp"
+#include "../include/catalog_files_test.hpp"
 #include "../include/cell_test.hpp"
 #include "../include/cell_types_test.hpp"
+#include "../include/clause_cache_test.hpp"
+#include "../include/column_store_test.hpp"
 #include "../include/command_interpreter_test.hpp"
 #include "../include/coordinates_test.hpp"
+#include "../include/facets_test.hpp"
+#include "../include/image_scan_test.hpp"
+#include "../include/live_table_test.hpp"
 #include "../include/parse_utils_test.hpp"
 #include "../include/parser_test.hpp"
+#include "../include/projection_test.hpp"
+#include "../include/query_plan_test.hpp"
+#include "../include/query_server_test.hpp"
 #include "../include/query_test.hpp"
+#include "../include/result_writer_test.hpp"
+#include "../include/row_cursor_test.hpp"
+#include "../include/row_diff_test.hpp"
 #include "../include/table_test.hpp"
+#include "../include/scheduler_test.hpp"
+#include "../include/shard_test.hpp"
+#include "../include/shared_catalog_test.hpp"
 #include "../include/utility_test.hpp"
 // NOLINTEND(unused-includes)
 